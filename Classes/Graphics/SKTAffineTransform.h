@@ -0,0 +1,36 @@
+/*  SKTAffineTransform.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Applying a 2D affine transform to packed coordinates: pointCount x,y pairs stored back to back, as in SKTPoly's
+ vertices or runs of SKTPath's segment coordinates. Moving, resizing and flipping those graphics all come down to
+ one of these calls.
+ */
+
+/// Transform the points in place, two at a time with clang's vector extensions where they're available, so the
+/// compiler picks the SSE, AVX or NEON instructions. Otherwise the same as SKTTransformPointsScalar().
+void SKTTransformPoints(CGAffineTransform transform, CGFloat *coords, NSUInteger pointCount);
+
+/// Transform the points in place, one at a time.
+void SKTTransformPointsScalar(CGAffineTransform transform, CGFloat *coords, NSUInteger pointCount);
+
+/// The transform that maps fromRect onto toRect, as -setBounds: resizes a graphic. An empty width or height of
+/// fromRect doesn't scale on that axis.
+CGAffineTransform SKTTransformMappingRect(CGRect fromRect, CGRect toRect);
+
+/// Mirror left to right, or top to bottom, within bounds.
+CGAffineTransform SKTTransformFlipHorizontallyInRect(CGRect bounds);
+CGAffineTransform SKTTransformFlipVerticallyInRect(CGRect bounds);
+
+#if DEBUG
+/// Time SKTTransformPoints against SKTTransformPointsScalar on pointCount points. Also checks that transforming an arc
+/// segment matches transforming its flattened samples, under rotations and mirrors. Logs the results.
+void SKTTransformBenchmark(NSUInteger pointCount);
+#endif
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,136 @@
+/*  SKTAffineTransform.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTAffineTransform.h"
+
+#if DEBUG
+#import "SKTPathAtom.h"
+#endif
+
+#if defined(__clang__) && CGFLOAT_IS_DOUBLE
+#define SKT_TRANSFORM_VECTOR 1
+// Two points: x0, y0, x1, y1.
+typedef double SKTPointPair __attribute__((ext_vector_type(4)));
+#endif
+
+void SKTTransformPoints(CGAffineTransform transform, CGFloat *coords, NSUInteger pointCount) {
+#if SKT_TRANSFORM_VECTOR
+  // x' = a*x + c*y + tx and y' = b*x + d*y + ty for two points at once: the a and d terms multiply the pair as it is,
+  // the c and b terms multiply it with x and y swapped.
+  const SKTPointPair diagonal = {transform.a, transform.d, transform.a, transform.d};
+  const SKTPointPair offDiagonal = {transform.c, transform.b, transform.c, transform.b};
+  const SKTPointPair translation = {transform.tx, transform.ty, transform.tx, transform.ty};
+  NSUInteger pairCount = pointCount / 2;
+  for (NSUInteger i = 0; i < pairCount; ++i, coords += 4) {
+    SKTPointPair pair;
+    memcpy(&pair, coords, sizeof pair);  // coords are only CGFloat aligned.
+    pair = pair * diagonal + pair.yxwz * offDiagonal + translation;
+    memcpy(coords, &pair, sizeof pair);
+  }
+  SKTTransformPointsScalar(transform, coords, pointCount % 2);
+#else
+  SKTTransformPointsScalar(transform, coords, pointCount);
+#endif
+}
+
+void SKTTransformPointsScalar(CGAffineTransform transform, CGFloat *coords, NSUInteger pointCount) {
+  for (NSUInteger i = 0; i < pointCount; ++i, coords += 2) {
+    CGFloat x = coords[0];
+    CGFloat y = coords[1];
+    coords[0] = transform.a * x + transform.c * y + transform.tx;
+    coords[1] = transform.b * x + transform.d * y + transform.ty;
+  }
+}
+
+CGAffineTransform SKTTransformMappingRect(CGRect fromRect, CGRect toRect) {
+  CGFloat sx = (0 == fromRect.size.width) ? 1 : toRect.size.width / fromRect.size.width;
+  CGFloat sy = (0 == fromRect.size.height) ? 1 : toRect.size.height / fromRect.size.height;
+  return CGAffineTransformMake(sx, 0, 0, sy, toRect.origin.x - fromRect.origin.x * sx, toRect.origin.y - fromRect.origin.y * sy);
+}
+
+CGAffineTransform SKTTransformFlipHorizontallyInRect(CGRect bounds) {
+  return CGAffineTransformMake(-1, 0, 0, 1, 2 * bounds.origin.x + bounds.size.width, 0);
+}
+
+CGAffineTransform SKTTransformFlipVerticallyInRect(CGRect bounds) {
+  return CGAffineTransformMake(1, 0, 0, -1, 0, 2 * bounds.origin.y + bounds.size.height);
+}
+
+#pragma mark - Benchmark
+
+#if DEBUG
+// The farthest apart any two corresponding samples are: the arc flattened then transformed, against the arc
+// transformed by SKTPathSegmentApplyTransform then flattened. The transforms all keep lengths, so both flatten to the
+// same number of samples. Infinity if they don't.
+static CGFloat ArcRoundTripError(void) {
+  const CGFloat arc[] = {150, 100, 100, 100, 50, 30, 250, 0};
+  CGAffineTransform transforms[] = {
+    CGAffineTransformMakeRotation(3 * M_PI / 4),
+    CGAffineTransformMakeScale(-1, 1),
+    CGAffineTransformMake(0, 1, 1, 0, 0, 0),
+    CGAffineTransformRotate(CGAffineTransformMakeTranslation(40, -25), -1),
+    CGAffineTransformScale(CGAffineTransformMakeRotation(0.5), 1, -1),
+  };
+  __block CGFloat maxError = 0;
+  for (size_t t = 0; t < sizeof transforms / sizeof transforms[0]; ++t) {
+    for (NSUInteger clockwise = 0; clockwise < 2; ++clockwise) {
+      CGFloat coords[8];
+      memcpy(coords, arc, sizeof coords);
+      coords[7] = clockwise;
+      NSMutableData *expected = [NSMutableData data];
+      SKTPathSegmentFlatten(SKTPathVerbArc, coords, CGPointZero, 0.1, ^(CGPoint p) {
+        p = CGPointApplyAffineTransform(p, transforms[t]);
+        [expected appendBytes:&p length:sizeof p];
+      });
+      SKTPathSegmentApplyTransform(SKTPathVerbArc, coords, transforms[t]);
+      const CGPoint *expectedPoints = [expected bytes];
+      NSUInteger expectedCount = [expected length] / sizeof(CGPoint);
+      __block NSUInteger i = 0;
+      SKTPathSegmentFlatten(SKTPathVerbArc, coords, CGPointZero, 0.1, ^(CGPoint p) {
+        maxError = (i < expectedCount) ? MAX(maxError, hypot(p.x - expectedPoints[i].x, p.y - expectedPoints[i].y)) : INFINITY;
+        ++i;
+      });
+      if (i != expectedCount) {
+        maxError = INFINITY;
+      }
+    }
+  }
+  return maxError;
+}
+
+void SKTTransformBenchmark(NSUInteger pointCount) {
+  CGFloat *scalarCoords = malloc(MAX(pointCount, 1) * 2 * sizeof(CGFloat));
+  CGFloat *vectorCoords = malloc(MAX(pointCount, 1) * 2 * sizeof(CGFloat));
+  if (NULL == scalarCoords || NULL == vectorCoords) {
+    free(scalarCoords);
+    free(vectorCoords);
+    NSLog(@"Could not allocate %lu points.", (unsigned long)pointCount);
+    return;
+  }
+  srandom(1);
+  for (NSUInteger i = 0; i < pointCount * 2; ++i) {
+    scalarCoords[i] = vectorCoords[i] = 1000.0 * random() / RAND_MAX;
+  }
+  // A rotation, so every term of the matrix matters.
+  CGAffineTransform transform = CGAffineTransformTranslate(CGAffineTransformMakeRotation(0.3), 12, -7);
+
+  NSDate *start = [NSDate date];
+  SKTTransformPointsScalar(transform, scalarCoords, pointCount);
+  NSTimeInterval scalarTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  SKTTransformPoints(transform, vectorCoords, pointCount);
+  NSTimeInterval vectorTime = -[start timeIntervalSinceNow];
+
+  CGFloat maxDifference = 0;
+  for (NSUInteger i = 0; i < pointCount * 2; ++i) {
+    maxDifference = MAX(maxDifference, fabs(scalarCoords[i] - vectorCoords[i]));
+  }
+  free(scalarCoords);
+  free(vectorCoords);
+  NSLog(@"%lu points: scalar %.4fs, vector %.4fs (%.2fx), max difference %g, arc round trip error %g",
+    (unsigned long)pointCount, scalarTime, vectorTime, vectorTime ? scalarTime / vectorTime : 0, maxDifference,
+    ArcRoundTripError());
+}
+#endif
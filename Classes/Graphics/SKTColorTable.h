@@ -0,0 +1,37 @@
+/*  SKTColorTable.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+// Equal colors as one shared NSColor, with one shared archive of it, so a plan of 100,000 walls in three colors holds
+// three colors and three archives, not 100,000 of each. Colors are immutable, so graphics may share them. Every
+// graphic's colors pass through the shared table, whichever document it's in, from the property list format, SVG
+// import, the native format's color chunk, or a setter. Safe to call from several threads at once.
+//
+// Past a few thousand distinct colors, new ones are passed through without being kept, so a file of random colors
+// can't grow the table without bound.
+@interface SKTColorTable : NSObject
+
++ (SKTColorTable *)sharedColorTable;
+
+// The first color put in the table equal to color, or color itself if it is the first. nil for nil.
+- (NSColor *)internedColor:(NSColor *)color;
+
+// The archive of color, made once per distinct color, as the property list format stores it. nil for nil.
+- (NSData *)archiveDataOfColor:(NSColor *)color;
+
+// The interned color data is an archive of, unarchiving each distinct archive once. nil if data isn't an NSData
+// holding an archived NSColor.
+- (NSColor *)colorWithArchiveData:(id)data;
+
+// How many distinct colors the table holds.
+@property(readonly) NSUInteger count;
+
+@end
+
+#if DEBUG
+// Logs the distinct colors, and the time, for graphicCount graphics made from property lists that cycle through
+// colorCount colors, as a plan read from the property list format or imported would be.
+void SKTColorTableBenchmark(NSUInteger graphicCount, NSUInteger colorCount);
+#endif
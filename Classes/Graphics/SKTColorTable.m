@@ -0,0 +1,187 @@
+/*  SKTColorTable.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTColorTable.h"
+
+#import "NSColor_SKT.h"
+
+#if DEBUG
+#import "SKTGraphic.h"
+#import "SKTRectangle.h"
+#endif
+
+enum {
+  kMaximumColorCount = 4096
+};
+
+// NSData's own -hash looks at only the first 80 bytes, and archived colors all start alike. Hash them all.
+static CFHashCode ArchiveHash(const void *value) {
+  NSData *data = (__bridge NSData *)value;
+  const uint8_t *bytes = [data bytes];
+  NSUInteger length = [data length];
+  uint32_t hash = 2166136261u;
+  for (NSUInteger i = 0; i < length; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static Boolean ArchiveEqual(const void *a, const void *b) {
+  return [(__bridge NSData *)a isEqualToData:(__bridge NSData *)b];
+}
+
+@interface SKTColorTable () {
+  // Each interned color, keyed by itself, so an equal color finds it.
+  NSMutableDictionary<NSColor *, NSColor *> *_colors;
+  // Keyed by the interned colors.
+  NSMutableDictionary<NSColor *, NSData *> *_archives;
+  // NSData to interned NSColor, hashed by ArchiveHash().
+  CFMutableDictionaryRef _colorsByArchive;
+}
+@end
+
+@implementation SKTColorTable
+
++ (SKTColorTable *)sharedColorTable {
+  static SKTColorTable *sSharedColorTable;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    sSharedColorTable = [[SKTColorTable alloc] init];
+  });
+  return sSharedColorTable;
+}
+
+- (instancetype)init {
+  self = [super init];
+  if (self) {
+    _colors = [NSMutableDictionary dictionary];
+    _archives = [NSMutableDictionary dictionary];
+    CFDictionaryKeyCallBacks keyCallBacks = kCFTypeDictionaryKeyCallBacks;
+    keyCallBacks.hash = ArchiveHash;
+    keyCallBacks.equal = ArchiveEqual;
+    _colorsByArchive = CFDictionaryCreateMutable(NULL, 0, &keyCallBacks, &kCFTypeDictionaryValueCallBacks);
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (_colorsByArchive) {
+    CFRelease(_colorsByArchive);
+  }
+}
+
+// Call with the table locked.
+- (NSColor *)lockedInternedColor:(NSColor *)color {
+  NSColor *result = _colors[color];
+  if (nil == result) {
+    result = color;
+    if ([_colors count] < kMaximumColorCount) {
+      _colors[color] = color;
+    }
+  }
+  return result;
+}
+
+- (NSColor *)internedColor:(NSColor *)color {
+  if (nil == color) {
+    return nil;
+  }
+  @synchronized(self) {
+    return [self lockedInternedColor:color];
+  }
+}
+
+- (NSData *)archiveDataOfColor:(NSColor *)color {
+  if (nil == color) {
+    return nil;
+  }
+  @synchronized(self) {
+    color = [self lockedInternedColor:color];
+    NSData *data = _archives[color];
+    if (data) {
+      return data;
+    }
+  }
+  // Archive outside the lock: it's the slow part, and another thread may race us to it harmlessly.
+  NSData *data = [color asArchiveData];
+  @synchronized(self) {
+    if (_colors[color]) {
+      NSData *existing = _archives[color];
+      if (existing) {
+        return existing;
+      }
+      _archives[color] = data;
+    }
+  }
+  return data;
+}
+
+- (NSColor *)colorWithArchiveData:(id)data {
+  if ( ! [data isKindOfClass:[NSData class]]) {
+    return nil;
+  }
+  @synchronized(self) {
+    NSColor *color = (__bridge NSColor *)CFDictionaryGetValue(_colorsByArchive, (__bridge const void *)data);
+    if (color) {
+      return color;
+    }
+  }
+  NSColor *color = [NSColor colorWithArchiveData:data];
+  if (nil == color) {
+    return nil;
+  }
+  @synchronized(self) {
+    color = [self lockedInternedColor:color];
+    if (_colors[color] && CFDictionaryGetCount(_colorsByArchive) < kMaximumColorCount) {
+      NSData *key = [data copy];
+      CFDictionarySetValue(_colorsByArchive, (__bridge const void *)key, (__bridge const void *)color);
+      if (nil == _archives[color]) {
+        _archives[color] = key;
+      }
+    }
+  }
+  return color;
+}
+
+- (NSUInteger)count {
+  @synchronized(self) {
+    return [_colors count];
+  }
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+void SKTColorTableBenchmark(NSUInteger graphicCount, NSUInteger colorCount) {
+  colorCount = MAX(colorCount, 1);
+  NSMutableArray *propertiesArray = [NSMutableArray arrayWithCapacity:graphicCount];
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    CGFloat shade = (CGFloat)(i % colorCount) / colorCount;
+    // A new archive for each, as reading a property list file gives.
+    [propertiesArray addObject:@{
+      SKTGraphicClassNameKey : NSStringFromClass([SKTRectangle class]),
+      SKTGraphicBoundsKey : NSStringFromRect(NSMakeRect(i % 1000, i / 1000, 1, 1)),
+      SKTGraphicFillColorKey : [[NSColor colorWithCalibratedRed:shade green:0.5 blue:1 - shade alpha:1] asArchiveData],
+    }];
+  }
+  NSDate *start = [NSDate date];
+  NSArray *graphics = [SKTGraphic graphicsWithProperties:propertiesArray];
+  NSTimeInterval readTime = -[start timeIntervalSinceNow];
+  NSMutableSet *distinctColors = [NSMutableSet set];
+  for (SKTGraphic *graphic in graphics) {
+    [distinctColors addObject:[NSValue valueWithNonretainedObject:[graphic fillColor]]];
+  }
+  start = [NSDate date];
+  NSMutableSet *distinctArchives = [NSMutableSet set];
+  for (SKTGraphic *graphic in graphics) {
+    [distinctArchives addObject:[NSValue valueWithNonretainedObject:[graphic properties][SKTGraphicFillColorKey]]];
+  }
+  NSTimeInterval writeTime = -[start timeIntervalSinceNow];
+  NSLog(@"%lu graphics in %lu colors: %lu NSColors read in %.3fs, %lu archives written in %.3fs, table holds %lu",
+    (unsigned long)[graphics count], (unsigned long)colorCount, (unsigned long)[distinctColors count], readTime,
+    (unsigned long)[distinctArchives count], writeTime, (unsigned long)[[SKTColorTable sharedColorTable] count]);
+}
+#endif
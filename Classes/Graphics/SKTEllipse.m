@@ -11,6 +11,8 @@
 
 #import "SKTEllipse.h"
 
+#import "SKTSVGWriter.h"
+
 @implementation SKTEllipse
 
 - (NSBezierPath *)bezierPathForDrawing {
@@ -24,15 +26,21 @@
 }
 
 
-- (NSString *)asSVGString {
-  return [self asSVGStringVerb:@"ellipse"];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [self writeSVGToWriter:writer verb:"ellipse"];
 }
 
-- (NSString *)svgAttributesString {
-  return [NSString stringWithFormat:@"cx=\"%.5g\" cy=\"%.5g\" rx=\"%.5g\" ry=\"%.5g\" %@",
-    self.bounds.origin.x + self.bounds.size.width/2, self.bounds.origin.y + self.bounds.size.height/2,
-    self.bounds.size.width/2, self.bounds.size.height/2,
-    [super svgAttributesString]];
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"cx=\""];
+  [writer writeFloat:self.bounds.origin.x + self.bounds.size.width/2];
+  [writer writeUTF8:"\" cy=\""];
+  [writer writeFloat:self.bounds.origin.y + self.bounds.size.height/2];
+  [writer writeUTF8:"\" rx=\""];
+  [writer writeFloat:self.bounds.size.width/2];
+  [writer writeUTF8:"\" ry=\""];
+  [writer writeFloat:self.bounds.size.height/2];
+  [writer writeUTF8:"\" "];
+  [super writeSVGAttributesToWriter:writer];
 }
 
 @end
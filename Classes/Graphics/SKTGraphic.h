@@ -11,6 +11,12 @@
 
 #import <Cocoa/Cocoa.h>
 
+#import "SKTSimplify.h"
+
+@class SKTNativeDecoder;
+@class SKTNativeWriter;
+@class SKTSVGWriter;
+
 // The keys described down below.
 extern NSString *const SKTGraphicCanSetDrawingFillKey;
 extern NSString *const SKTGraphicCanSetDrawingStrokeKey;
@@ -71,7 +77,7 @@ extern const NSInteger SKTGraphicNoHandle;
 
  "scriptingStrokeWidth" (a floating point NSNumber; read-write) - The width of the stroke that will be used for this graphic when it's drawn, or nil if stroking is not being done. This attribute is derived from "strokeWidth." It's here because we want to accurately report "missing value" when stroking is not being done. Since it's here we might as well let scripters turn off stroking by setting "missing value" too.
 
- In FloorSketch various properties of the controls of the grid inspector are bound to the properties of the selection of the graphics controller belonging to the window controller of the main window. Each SKTGraphicView observes the "drawingBounds" and "drawingContents" properties of every graphic that it's displaying so it knows when they need redrawing. Each SKTDocument observes many properties of every of one of its graphics so it can register undo actions when they change; for each graphic the exact set of such properties is determined by the current value of the "keysForValuesToObserveForUndo" property. Also, many of these properties are scriptable.
+ In FloorSketch various properties of the controls of the grid inspector are bound to the properties of the selection of the graphics controller belonging to the window controller of the main window. Rather than observe each graphic with KVO, each SKTDocument and each SKTGraphicView subscribes to the document's SKTGraphicChangeBus, to which its graphics post their changes. The bus tells the views when the "drawingBounds" or "drawingContents" of a graphic change, so they know when it needs redrawing, and tells the document when any of a graphic's "keysForValuesToObserveForUndo" properties change, so it can register undo actions. The setters of those properties send -willChangeValueForKey: and -didChangeValueForKey: themselves, so that they're sent whether or not anything observes the graphic. Also, many of these properties are scriptable.
 
  */
 // The object that contains the graphic (unretained), from the point of view of scriptability. This is here only for use by this class' override of scripting's -objectSpecifier method. In FloorSketch this is an SKTDocument or SKTGroup.
@@ -114,6 +120,16 @@ extern const NSInteger SKTGraphicNoHandle;
 // Return a dictionary that can be used as property list object and contains enough information to recreate the graphic (except for its class, which is handled by +propertiesWithGraphics:). The returned dictionary must be mutable so that it can be added to efficiently, but the receiver must ignore any mutations made to it after it's been returned.
 @property (NS_NONATOMIC_IOSONLY, readonly, copy) NSMutableDictionary *properties;
 
+// The same, for the binary format of FloorSketch 3 files (see SKTNativeFormat.h): initialize from the record -writeNativeToWriter: wrote. A subclass that stores more than SKTGraphic does overrides both, invoking super first, and reads exactly what it writes. If what's read makes no sense, invoke -[SKTNativeDecoder markDamaged] and the graphic will be dropped.
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder;
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer;
+
+// What the last save wrote for this graphic, so the next only encodes what's changed since: the dictionary +propertiesWithGraphics: returns for it, its native record, and its SVG. They're thrown away by any change the graphic KVO-notifies about, by -invalidateBezierPathCache, and by -invalidateSerializationCache, which subclasses send when they change some other way. A group's go with any of its members'.
+- (void)invalidateSerializationCache;
+
+// Kept here by SKTNativeWriter, which alone knows what it is.
+@property (NS_NONATOMIC_IOSONLY, strong) id nativeRecordCache;
+
 #pragma mark - Simple Property Getting
 
 // Accessors for properties that this class stores as instance variables. These methods provide readable KVC-compliance for several of the keys mentioned in comments above, but that's not why they're here (KVC direct instance variable access makes them unnecessary for that). They're here just for invoking and overriding by subclass code.
@@ -128,6 +144,13 @@ extern const NSInteger SKTGraphicNoHandle;
 @property (NS_NONATOMIC_IOSONLY, readonly) BOOL canClosePolygon;
 @property (NS_NONATOMIC_IOSONLY) BOOL locked;
 
+// SVG export. Subclasses override -writeSVGToWriter:, usually by calling -writeSVGToWriter:verb:, and -writeSVGAttributesToWriter:,
+// writing their own attributes, then a space, then calling super. The string methods are for callers that want an NSString.
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer;
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer verb:(const char *)verb;
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer;
+// -writeSVGToWriter:, or what it wrote last time if nothing's changed since.
+- (void)writeCachedSVGToWriter:(SKTSVGWriter *)writer;
 - (NSString *)asSVGString;
 - (NSString *)asSVGStringVerb:(NSString *)verb;
 - (NSString *)svgAttributesString;
@@ -141,12 +164,36 @@ extern const NSInteger SKTGraphicNoHandle;
 // Return the bounding box of everything the receiver might draw when sent a -draw...InView: message. The default implementation of this method returns a bounds that assumes the default implementations of -drawContentsInView: and -drawHandlesInView:. Subclasses that override this probably have to override +keyPathsForValuesAffectingDrawingBounds too.
 @property (NS_NONATOMIC_IOSONLY, readonly) NSRect drawingBounds;
 
+// The scale of the current graphics context in device pixels per unit, for drawing in view at a level of detail. 0, meaning draw in full detail, if there's no view, as in raster export, or if the context isn't drawing to the screen, as in printing and PDF.
+CGFloat SKTGraphicPixelsPerUnitInView(NSView *view);
+
+#if DEBUG
+// Whether SKTGraphicPixelsPerUnitInView() ever returns anything but 0. Default YES. For timing drawing both ways.
+void SKTGraphicSetLevelOfDetailEnabled(BOOL isEnabled);
+#endif
+
 // Draw the contents the receiver in a specific view. Use isBeingCreatedOrEditing if the graphic draws differently during its creation or while it's being edited. The default implementation of this method just draws the result of invoking -bezierPathForDrawing using the current fill and stroke parameters. Subclasses have to override either this method or -bezierPathForDrawing. Subclasses that override this may have to override +keyPathsForValuesAffectingDrawingBounds, +keyPathsForValuesAffectingDrawingContents, and -drawingBounds too.
 - (void)drawContentsInView:(NSView *)view rect:(NSRect)rect isBeingCreateOrEdited:(BOOL)isBeingCreatedOrEditing;
 
 // Return a bezier path that can be stroked and filled to draw the graphic, if the graphic can be drawn so simply, nil otherwise. The default implementation of this method returns nil. Subclasses have to override either this method or -drawContentsInView:. Any returned bezier path should already have the graphic's current stroke width set in it.
 @property (NS_NONATOMIC_IOSONLY, readonly, copy) NSBezierPath *bezierPathForDrawing;
 
+// For subclasses whose -bezierPathForDrawing is expensive to build. Returns the path that build returns, and keeps returning it without calling build again until the updateCount, bounds or stroke width change, or -invalidateBezierPathCache is sent. Drawing and hit-testing share the one path, so nobody may modify it.
+- (NSBezierPath *)cachedBezierPath:(NSBezierPath *(NS_NOESCAPE ^)(void))build;
+
+// Subclasses send this when they change their geometry in a way that leaves the updateCount and bounds alone, such as flipping.
+- (void)invalidateBezierPathCache;
+
+// How often -cachedBezierPath: has reused a path, and how often it had to build one, over all graphics.
++ (NSUInteger)bezierPathCacheHitCount;
++ (NSUInteger)bezierPathCacheMissCount;
+
+// -bezierPathForDrawing, or, if that has many elements and pixelsPerUnit isn't 0, a simplified version of it that's off by less than a pixel at that scale. The simplified path is kept for the zoom level, to within a factor of two, until the path it came from changes.
+- (NSBezierPath *)bezierPathForDrawingAtPixelsPerUnit:(CGFloat)pixelsPerUnit;
+
+// If what the graphic would draw at pixelsPerUnit is too small to make out, draw a stand-in and return YES. Otherwise return NO, so -drawContentsInView:rect:isBeingCreateOrEdited: draws it in full. A pixelsPerUnit of 0 means full detail. The default implementation draws a graphic less than a pixel across as a dot of its stroke color, or its fill color, or nothing. Subclasses may stand in for more.
+- (BOOL)drawPlaceholderAtPixelsPerUnit:(CGFloat)pixelsPerUnit;
+
 // Draw the handles of the receiver in a specific view. The default implementation of this method just invokes -drawHandleInView:atPoint: for each point at the corners and on the sides of the rectangle returned by -bounds. Subclasses that override this probably have to override -handleUnderPoint: too.
 - (void)drawHandlesInView:(NSView *)view;
 
@@ -171,6 +218,9 @@ extern const NSInteger SKTGraphicNoHandle;
 // Return YES if the point is in the contents of the receiver, NO otherwise. The default implementation of this method returns YES if the point is inside [self bounds].
 - (BOOL)isContentsUnderPoint:(NSPoint)point;
 
+// The same, for a click from a view where tolerance, in the receiver's units, is as far as a pointer can be trusted to land from where the user meant. The default implementation of this method ignores the tolerance and invokes -isContentsUnderPoint:. Subclasses made of strokes override it to count the stroke, widened by the tolerance, as well as the fill.
+- (BOOL)isContentsUnderPoint:(NSPoint)point tolerance:(CGFloat)tolerance;
+
 // If the point is in one of the handles of the receiver return its number, SKTGraphicNoHandle otherwise. The default implementation of this method invokes -isHandleAtPoint:underPoint: for the corners and on the sides of the rectangle returned by -bounds. Subclasses that override this probably have to override several other methods too.
 - (NSInteger)handleUnderPoint:(NSPoint)point inView:(NSView<SKTHasHandles> *)view;
 
@@ -184,6 +234,9 @@ extern const NSInteger SKTGraphicNoHandle;
 - (void)flipHorizontally;
 - (void)flipVertically;
 
+// Move, resize, flip, rotate or skew the receiver by an affine transform, as an SVG transform attribute does. The default implementation of this method can only set the bounds to the bounding box of the transformed bounds, flipping if the transform mirrors it; subclasses made of points override it to transform them exactly.
+- (void)applyTransform:(CGAffineTransform)transform;
+
 // Given that [[self class] canMakeNaturalSize] would return YES, set the the bounds of the receiver to whatever is "natural" for its particular subclass of SKTGraphic. The default implementation of this method just squares the bounds.
 - (void)makeNaturalSize;
 
@@ -206,6 +259,12 @@ extern const NSInteger SKTGraphicNoHandle;
 // return self, here in the base class.
 - (SKTGraphic *)graphicByClosing;
 
+// Return YES if sending -simplifyWithMethod:tolerance: to the receiver could drop any vertices. NO, here in the base class.
+@property (NS_NONATOMIC_IOSONLY, readonly) BOOL canSimplify;
+
+// Drop the vertices the shape can do without, so that no original vertex moves more than about tolerance from it, undoably, and report what was done. The default implementation of this method does nothing and reports no vertices. SKTPoly, SKTPath and SKTGroup override it.
+- (SKTSimplifyReport)simplifyWithMethod:(SKTSimplifyMethod)method tolerance:(CGFloat)tolerance;
+
 #pragma mark - Undo
 
 // Return the keys of all of the properties for which value changes are undoable. In FloorSketch SKTDocument observes the value for each key in the set returned by invoking this method on each graphic in the document, and registers undo operations when the values change. It also observes this "keysForValuesToObserveForUndo" property itself and reacts accordingly, because the value can change dynamically. For example, SKTText overrides this (and KVO-notifies about changes to what the override would return) for a couple of reasons.
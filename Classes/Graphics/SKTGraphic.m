@@ -11,27 +11,34 @@
 
 #import "SKTGraphic.h"
 
-#import "NSColor_SKT.h"
+#import "SKTColorTable.h"
+#import "SKTGraphicChangeBus.h"
+#import "SKTGraphicsOwner.h"
+#import "SKTNativeFormat.h"
+#import "SKTSVGWriter.h"
 #import "SKTError.h"
 
-@interface NSColor(SKTGraphic)
-- (NSString *)svgSpecifier:(CGFloat *)outAlpha;
-@end
+#include <stdatomic.h>
 
-@implementation NSColor(SKTGraphic)
-- (NSString *)svgSpecifier:(CGFloat *)outAlpha {
-  NSColor *c = [self colorUsingColorSpaceName:NSCalibratedRGBColorSpace];
+// Write the color as #rrggbb. Returns its alpha.
+static CGFloat WriteSVGColor(SKTSVGWriter *writer, NSColor *color) {
+  NSColor *c = [color colorUsingColorSpaceName:NSCalibratedRGBColorSpace];
   CGFloat red;
   CGFloat blue;
   CGFloat green;
   CGFloat alpha;
   [c getRed:&red green:&green blue:&blue alpha:&alpha];
-  *outAlpha = alpha;
-  return [NSString stringWithFormat:@"#%02x%02x%02x", (int)(255*red), (int)(255*green), (int)(255*blue)];
+  char buffer[8];
+  snprintf(buffer, sizeof buffer, "#%02x%02x%02x", (int)(255*red), (int)(255*green), (int)(255*blue));
+  [writer writeBytes:buffer length:7];
+  return alpha;
 }
-@end
 
-static NSUInteger sUpdateCount;
+// Graphics are drawn, and so their paths cached, from several threads at once: tiled export and batch conversion.
+static atomic_size_t sBezierPathCacheHitCount;
+static atomic_size_t sBezierPathCacheMissCount;
+
+static BOOL sLevelOfDetailDisabled;
 
 // String constants declared in the header. A lot of them aren't used by any other class in the project, but it's a good idea to provide and use them, if only to help prevent typos in source code.
 // Why are there @"drawingFill" and @"drawingStroke" keys here when @"isDrawingFill" and @"isDrawingStroke" would be a little more consistent with Cocoa convention for boolean values? Because we might want to add setter methods for these properties some day, and key-value coding isn't smart enough to ignore "is" when looking for setter methods, and having to give methods ugly names -setIsDrawingFill: and -setIsDrawingStroke: would be irritating. In general it's best to leave the "is" off the front of keys that identify boolean values.
@@ -73,6 +80,14 @@ enum {
   SKTGraphicLowerRightHandle = 8,
 };
 
+enum {
+  // The biggest SVG fragment -writeCachedSVGToWriter: keeps.
+  SKTGraphicSVGFragmentCacheLimit = 64 * 1024,
+
+  // Paths with fewer elements than this are quicker to draw than to simplify.
+  SKTGraphicMinimumSimplifiedElementCount = 64,
+};
+
 @interface SKTGraphic(){
   // The values underlying some of the key-value coding (KVC) and observing (KVO) compliance described below. Any corresponding getter or setter methods are there for invocation by code in subclasses, not for KVC or KVO compliance. KVC's direct instance variable access, KVO's autonotifying, and KVO's property dependency mechanism makes them unnecessary for the latter purpose.
   // If you look closely, you'll notice that SKTGraphic itself never touches these instance variables directly except in initializers, -copyWithZone:, and public accessors. SKTGraphic is following a good rule: if a class publishes getters and setters it should itself invoke them, because people who override methods to customize behavior are right to expect their overrides to actually be invoked.
@@ -82,6 +97,24 @@ enum {
   BOOL _isDrawingStroke;
   NSColor *_strokeColor;
   CGFloat _strokeWidth;
+
+  // Bumped by subclasses around a change of their points, to trigger redraws. Each graphic's own, so that one changing doesn't invalidate every other graphic's caches, which are keyed on it.
+  NSUInteger _updateCount;
+
+  // The result of -cachedBezierPath:, and the values it was built for.
+  NSBezierPath *_cachedBezierPath;
+  NSUInteger _cachedBezierPathUpdateCount;
+  NSRect _cachedBezierPathBounds;
+  CGFloat _cachedBezierPathStrokeWidth;
+
+  // The result of -bezierPathForDrawingAtPixelsPerUnit:, the path it simplifies, and the zoom level, log2 of the pixels per unit rounded down, it was simplified for.
+  NSBezierPath *_cachedSimplifiedBezierPath;
+  NSBezierPath *_cachedSimplifiedBezierPathSource;
+  NSInteger _cachedSimplifiedBezierPathLevel;
+
+  // What the last save wrote, until something changes. See -invalidateSerializationCache.
+  NSDictionary *_cachedProperties;
+  NSData *_cachedSVGFragment;
 }
 
 @end
@@ -96,9 +129,9 @@ enum {
     // Set up decent defaults for a new graphic.
     _bounds = NSZeroRect;
     _isDrawingFill = NO;
-    _fillColor = [NSColor whiteColor];
+    _fillColor = [[SKTColorTable sharedColorTable] internedColor:[NSColor whiteColor]];
     _isDrawingStroke = YES;
-    _strokeColor = [NSColor blackColor];
+    _strokeColor = [[SKTColorTable sharedColorTable] internedColor:[NSColor blackColor]];
     _strokeWidth = 1.0f;
   }
   return self;
@@ -126,9 +159,12 @@ enum {
 + (BOOL)automaticallyNotifiesObserversForKey:(NSString *)key {
 
   // We don't want KVO autonotification for these properties. Because the setters for all of them invoke -setBounds:, and this class is KVO-compliant for "bounds," and we declared that the values of these properties depend on "bounds," we would up end up with double notifications for them. That would probably be unnoticable, but it's a little wasteful. Something you have to think about with codependent mutable properties like these (regardless of what notification mechanism you're using).
+  // The setters of the properties that matter to undo and drawing notify by hand, so the document's change bus hears about changes to graphics that nothing observes with KVO. See -willChangeValueForKey:.
   BOOL automaticallyNotifies;
   if ([[NSSet setWithObjects:SKTGraphicXPositionKey, SKTGraphicYPositionKey, SKTGraphicWidthKey, SKTGraphicHeightKey, nil] containsObject:key]) {
     automaticallyNotifies = NO;
+  } else if ([[NSSet setWithObjects:SKTGraphicBoundsKey, SKTGraphicIsDrawingFillKey, SKTGraphicFillColorKey, SKTGraphicIsDrawingStrokeKey, SKTGraphicStrokeColorKey, SKTGraphicStrokeWidthKey, SKTGraphicLockedKey, SKTGraphicUpateCountKey, nil] containsObject:key]) {
+    automaticallyNotifies = NO;
   } else {
     automaticallyNotifies = [super automaticallyNotifiesObserversForKey:key];
   }
@@ -137,6 +173,30 @@ enum {
 }
 
 
+// The change bus of the document this graphic is in, if it's in one. Graphics in groups aren't: as before, only the top level graphics of a document are watched for undo and redraw.
+- (SKTGraphicChangeBus *)changeBus {
+  NSObject *container = _scriptingContainer;
+  return [container respondsToSelector:@selector(graphicChangeBus)] ? [(id<SKTGraphicsOwner>)container graphicChangeBus] : nil;
+}
+
+
+// Overrides of the NSObject(NSKeyValueObserverNotification) methods. KVO only sends these itself for objects something observes, which is why so many setters here send them by hand: then every change reaches the change bus, and the document and its views subscribe to that once, instead of registering with each graphic they're shown.
+- (void)willChangeValueForKey:(NSString *)key {
+  [super willChangeValueForKey:key];
+  [[self changeBus] graphic:self willChangeValueForKey:key];
+
+  // Neither of these is a change to what's saved: one is only news that an image has been decoded, the other only what undo watches.
+  if ( ! ([key isEqualToString:SKTGraphicDrawingContentsKey] || [key isEqualToString:SKTGraphicKeysForValuesToObserveForUndoKey])) {
+    [self invalidateSerializationCache];
+  }
+}
+
+- (void)didChangeValueForKey:(NSString *)key {
+  [super didChangeValueForKey:key];
+  [[self changeBus] graphic:self didChangeValueForKey:key];
+}
+
+
 // In Mac OS 10.5 and newer KVO's dependency mechanism invokes class methods to find out what properties affect properties being observed, like these.
 + (NSSet *)keyPathsForValuesAffectingXPosition {
   return [NSSet setWithObject:SKTGraphicBoundsKey];
@@ -183,6 +243,12 @@ enum {
   [self setBounds:bounds];
 }
 
+- (void)setLocked:(BOOL)locked {
+  [self willChangeValueForKey:SKTGraphicLockedKey];
+  _locked = locked;
+  [self didChangeValueForKey:SKTGraphicLockedKey];
+}
+
 - (void)setLockedValue:(NSNumber *)boolN {
   [self setLocked:[boolN boolValue]];
 }
@@ -203,60 +269,122 @@ enum {
   return self;
 }
 
+- (BOOL)canSimplify {
+  return NO; // subclasses may override
+}
 
-- (NSString *)asSVGString {
-  return @""; // subclasses should override!
+- (SKTSimplifyReport)simplifyWithMethod:(SKTSimplifyMethod)method tolerance:(CGFloat)tolerance {
+  return (SKTSimplifyReport){0, 0, 0};
 }
 
-- (NSString *)asSVGStringVerb:(NSString *)verb {
-  return [NSString stringWithFormat:@"<%@ %@/>", verb, [self svgAttributesString]];
+
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  // subclasses should override!
+}
+
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer verb:(const char *)verb {
+  [writer writeUTF8:"<"];
+  [writer writeUTF8:verb];
+  [writer writeUTF8:" "];
+  [self writeSVGAttributesToWriter:writer];
+  [writer writeUTF8:"/>"];
+}
+
+- (BOOL)hasSVGFillSpecifier {
+  return ! ([self isDrawingFill] && nil == self.fillColor);
 }
 
-- (NSString *)svgFillSpecifier {
+- (void)writeSVGFillSpecifierToWriter:(SKTSVGWriter *)writer {
   if ([self isDrawingFill]) {
-    if (nil == self.fillColor) {
-      return nil;
-    }
-    CGFloat alpha;
-    NSString *s = [self.fillColor svgSpecifier:&alpha];
+    CGFloat alpha = WriteSVGColor(writer, self.fillColor);
     if (1.0 != alpha) {
-      s = [NSString stringWithFormat:@"%@;fill-opacity: %.5g", s, alpha];
+      [writer writeUTF8:";fill-opacity: "];
+      [writer writeFloat:alpha];
     }
-    return s;
   } else {
-    return @"none";
+    [writer writeUTF8:"none"];
   }
 }
 
-- (NSString *)svgStrokeSpecifier {
+- (BOOL)hasSVGStrokeSpecifier {
+  return ! ([self isDrawingStroke] && nil == self.strokeColor);
+}
+
+- (void)writeSVGStrokeSpecifierToWriter:(SKTSVGWriter *)writer {
   if ([self isDrawingStroke]) {
-    if (nil == self.strokeColor) {
-      return nil;
-    }
-    CGFloat alpha;
-    NSString *s = [NSString stringWithFormat:@"%@; stroke-width:%.5g ",
-        [self.strokeColor svgSpecifier:&alpha], self.strokeWidth];
+    CGFloat alpha = WriteSVGColor(writer, self.strokeColor);
+    [writer writeUTF8:"; stroke-width:"];
+    [writer writeFloat:self.strokeWidth];
+    [writer writeUTF8:" "];
     if (1.0 != alpha) {
-      s = [NSString stringWithFormat:@"%@;stroke-opacity: %.5g", s, alpha];
+      [writer writeUTF8:";stroke-opacity: "];
+      [writer writeFloat:alpha];
     }
-    return s;
   } else {
-    return @"none";
+    [writer writeUTF8:"none"];
   }
 }
 
-- (NSString *)svgAttributesString {
-  NSString *fillSpec = [self svgFillSpecifier];
-  NSString *strokeSpec = [self svgStrokeSpecifier];
-  NSString *s = @"";
-  if (nil != fillSpec && nil != strokeSpec) {
-    s = [NSString stringWithFormat:@"style=\"fill: %@; stroke: %@\"", fillSpec, strokeSpec];
-  } else if (nil != fillSpec) {
-    s = [NSString stringWithFormat:@"style=\"fill: %@\"", fillSpec];
-  } else if (nil != strokeSpec) {
-    s = [NSString stringWithFormat:@"style=\"stroke: %@\"", strokeSpec];
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  BOOL hasFill = [self hasSVGFillSpecifier];
+  BOOL hasStroke = [self hasSVGStrokeSpecifier];
+  if (hasFill) {
+    [writer writeUTF8:"style=\"fill: "];
+    [self writeSVGFillSpecifierToWriter:writer];
+    if (hasStroke) {
+      [writer writeUTF8:"; stroke: "];
+      [self writeSVGStrokeSpecifierToWriter:writer];
+    }
+    [writer writeUTF8:"\""];
+  } else if (hasStroke) {
+    [writer writeUTF8:"style=\"stroke: "];
+    [self writeSVGStrokeSpecifierToWriter:writer];
+    [writer writeUTF8:"\""];
+  }
+}
+
+// Collect what a block writes into a string.
+static NSString *StringWrittenBy(void (^block)(SKTSVGWriter *writer)) {
+  NSMutableData *data = [NSMutableData data];
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:data];
+  block(writer);
+  [writer finish];
+  return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
+- (void)writeCachedSVGToWriter:(SKTSVGWriter *)writer {
+  if (_cachedSVGFragment) {
+    [writer writeBytes:[_cachedSVGFragment bytes] length:[_cachedSVGFragment length]];
+    return;
+  }
+  NSMutableData *fragment = [NSMutableData data];
+  SKTSVGWriter *fragmentWriter = [[SKTSVGWriter alloc] initWithMutableData:fragment];
+  [self writeSVGToWriter:fragmentWriter];
+  [fragmentWriter finish];
+  [writer writeBytes:[fragment bytes] length:[fragment length]];
+
+  // A big fragment is an image's base64, which takes longer to keep in memory than to stream again.
+  if ([fragment length] <= SKTGraphicSVGFragmentCacheLimit) {
+    _cachedSVGFragment = fragment;
   }
-  return s;
+}
+
+- (NSString *)asSVGString {
+  return StringWrittenBy(^(SKTSVGWriter *writer) {
+    [self writeSVGToWriter:writer];
+  });
+}
+
+- (NSString *)asSVGStringVerb:(NSString *)verb {
+  return StringWrittenBy(^(SKTSVGWriter *writer) {
+    [self writeSVGToWriter:writer verb:[verb UTF8String]];
+  });
+}
+
+- (NSString *)svgAttributesString {
+  return StringWrittenBy(^(SKTSVGWriter *writer) {
+    [self writeSVGAttributesToWriter:writer];
+  });
 }
 
 #pragma mark - Convenience
@@ -361,9 +489,14 @@ enum {
   for (NSUInteger index = 0; index < graphicCount; index++) {
     SKTGraphic *graphic = graphics[index];
 
-    // Get the properties of the graphic, add the class name that can be used by +graphicsWithProperties: to it, and add the properties to the array we're building.
-    NSMutableDictionary *properties = [graphic properties];
-    properties[SKTGraphicClassNameKey] = NSStringFromClass([graphic class]);
+    // Get the properties of the graphic, add the class name that can be used by +graphicsWithProperties: to it, and add the properties to the array we're building. Keep them, since archiving the colors and images is slow, until the graphic changes.
+    NSDictionary *properties = graphic->_cachedProperties;
+    if (nil == properties) {
+      NSMutableDictionary *mutableProperties = [graphic properties];
+      mutableProperties[SKTGraphicClassNameKey] = NSStringFromClass([graphic class]);
+      properties = [mutableProperties copy];
+      graphic->_cachedProperties = properties;
+    }
     [propertiesArray addObject:properties];
 
   }
@@ -386,12 +519,12 @@ enum {
     if ([isDrawingFillNumber isKindOfClass:numberClass]) {
       _isDrawingFill = [isDrawingFillNumber boolValue];
     }
-    _fillColor = [NSColor colorWithArchiveData:properties[SKTGraphicFillColorKey]];
+    _fillColor = [[SKTColorTable sharedColorTable] colorWithArchiveData:properties[SKTGraphicFillColorKey]];
     NSNumber *isDrawingStrokeNumber = properties[SKTGraphicIsDrawingStrokeKey];
     if ([isDrawingStrokeNumber isKindOfClass:numberClass]) {
       _isDrawingStroke = [isDrawingStrokeNumber boolValue];
     }
-    _strokeColor = [NSColor colorWithArchiveData:properties[SKTGraphicStrokeColorKey]];
+    _strokeColor = [[SKTColorTable sharedColorTable] colorWithArchiveData:properties[SKTGraphicStrokeColorKey]];
     NSNumber *strokeWidthNumber = properties[SKTGraphicStrokeWidthKey];
     if ([strokeWidthNumber isKindOfClass:numberClass]) {
       _strokeWidth = [strokeWidthNumber doubleValue];
@@ -406,14 +539,54 @@ enum {
   NSMutableDictionary *properties = [NSMutableDictionary dictionary];
   properties[SKTGraphicBoundsKey] = NSStringFromRect([self bounds]);
   properties[SKTGraphicIsDrawingFillKey] = @([self isDrawingFill]);
-  properties[SKTGraphicFillColorKey] = [[self fillColor] asArchiveData];
+  properties[SKTGraphicFillColorKey] = [[SKTColorTable sharedColorTable] archiveDataOfColor:[self fillColor]];
   properties[SKTGraphicIsDrawingStrokeKey] = @([self isDrawingStroke]);
-  properties[SKTGraphicStrokeColorKey] = [[self strokeColor] asArchiveData];
+  properties[SKTGraphicStrokeColorKey] = [[SKTColorTable sharedColorTable] archiveDataOfColor:[self strokeColor]];
   properties[SKTGraphicStrokeWidthKey] = @([self strokeWidth]);
   return properties;
 
 }
 
+enum {
+  // The flags byte of SKTGraphic's part of a native record.
+  SKTGraphicNativeIsDrawingFill = 1,
+  SKTGraphicNativeIsDrawingStroke = 2,
+};
+
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+  self = [self init];
+  if (self) {
+    _bounds = [decoder readRect];
+    uint8_t flags = [decoder readUInt8];
+    _isDrawingFill = 0 != (flags & SKTGraphicNativeIsDrawingFill);
+    _isDrawingStroke = 0 != (flags & SKTGraphicNativeIsDrawingStroke);
+    _fillColor = [decoder readColor];
+    _strokeColor = [decoder readColor];
+    _strokeWidth = [decoder readDouble];
+  }
+  return self;
+}
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [writer writeRect:[self bounds]];
+  [writer writeUInt8:([self isDrawingFill] ? SKTGraphicNativeIsDrawingFill : 0) | ([self isDrawingStroke] ? SKTGraphicNativeIsDrawingStroke : 0)];
+  [writer writeColor:[self fillColor]];
+  [writer writeColor:[self strokeColor]];
+  [writer writeDouble:[self strokeWidth]];
+}
+
+- (void)invalidateSerializationCache {
+  _cachedProperties = nil;
+  _cachedSVGFragment = nil;
+  _nativeRecordCache = nil;
+
+  // A group's saved forms include this graphic's.
+  NSObject *container = _scriptingContainer;
+  if ([container isKindOfClass:[SKTGraphic class]]) {
+    [(SKTGraphic *)container invalidateSerializationCache];
+  }
+}
+
 - (NSMutableDictionary *)debugProperties {
   NSMutableDictionary *result = [self properties];
   NSColor *fillColor = [self fillColor];
@@ -436,7 +609,9 @@ enum {
 
 - (void)setDrawingFill:(BOOL)drawingFill {
   if ( ! _locked) {
+    [self willChangeValueForKey:SKTGraphicIsDrawingFillKey];
     _isDrawingFill = drawingFill;
+    [self didChangeValueForKey:SKTGraphicIsDrawingFillKey];
   }
 }
 
@@ -446,7 +621,9 @@ enum {
 
 - (void)setFillColor:(NSColor *)fillColor {
   if ( ! _locked) {
-    _fillColor = fillColor;
+    [self willChangeValueForKey:SKTGraphicFillColorKey];
+    _fillColor = [[SKTColorTable sharedColorTable] internedColor:fillColor];
+    [self didChangeValueForKey:SKTGraphicFillColorKey];
   }
 }
 
@@ -456,7 +633,9 @@ enum {
 
 - (void)setDrawingStroke:(BOOL)drawingStroke {
   if ( ! _locked) {
+    [self willChangeValueForKey:SKTGraphicIsDrawingStrokeKey];
     _isDrawingStroke = drawingStroke;
+    [self didChangeValueForKey:SKTGraphicIsDrawingStrokeKey];
   }
 }
 
@@ -466,7 +645,9 @@ enum {
 
 - (void)setStrokeColor:(NSColor *)strokeColor {
   if ( ! _locked) {
-    _strokeColor = strokeColor;
+    [self willChangeValueForKey:SKTGraphicStrokeColorKey];
+    _strokeColor = [[SKTColorTable sharedColorTable] internedColor:strokeColor];
+    [self didChangeValueForKey:SKTGraphicStrokeColorKey];
   }
 }
 
@@ -477,7 +658,9 @@ enum {
 
 - (void)setStrokeWidth:(CGFloat)strokeWidth {
   if ( ! _locked) {
+    [self willChangeValueForKey:SKTGraphicStrokeWidthKey];
     _strokeWidth = strokeWidth;
+    [self didChangeValueForKey:SKTGraphicStrokeWidthKey];
   }
 }
 
@@ -514,18 +697,20 @@ enum {
 }
 
 - (NSUInteger)updateCount {
-  return sUpdateCount;
+  return _updateCount;
 }
 
 - (void)setUpdateCount:(NSUInteger)updateCount {
-  sUpdateCount = updateCount;
+  [self willChangeValueForKey:SKTGraphicUpateCountKey];
+  _updateCount = updateCount;
+  [self didChangeValueForKey:SKTGraphicUpateCountKey];
 }
 
 
 - (void)drawContentsInView:(NSView *)view rect:(NSRect)rect isBeingCreateOrEdited:(BOOL)isBeingCreatedOrEditing {
 
   // If the graphic is so so simple that it can be boiled down to a bezier path then just draw a bezier path. It's -bezierPathForDrawing's responsibility to return a path with the current stroke width.
-  NSBezierPath *path = [self bezierPathForDrawing];
+  NSBezierPath *path = [self bezierPathForDrawingAtPixelsPerUnit:isBeingCreatedOrEditing ? 0 : SKTGraphicPixelsPerUnitInView(view)];
   if (path) {
     if ([self isDrawingFill]) {
       [[self fillColor] set];
@@ -548,6 +733,156 @@ enum {
 }
 
 
+- (NSBezierPath *)cachedBezierPath:(NSBezierPath *(NS_NOESCAPE ^)(void))build {
+  NSUInteger updateCount = [self updateCount];
+  NSRect bounds = [self bounds];
+  CGFloat strokeWidth = [self strokeWidth];
+  if (_cachedBezierPath && updateCount == _cachedBezierPathUpdateCount && NSEqualRects(bounds, _cachedBezierPathBounds) && strokeWidth == _cachedBezierPathStrokeWidth) {
+    atomic_fetch_add_explicit(&sBezierPathCacheHitCount, 1, memory_order_relaxed);
+    return _cachedBezierPath;
+  }
+  atomic_fetch_add_explicit(&sBezierPathCacheMissCount, 1, memory_order_relaxed);
+  _cachedBezierPath = build();
+  _cachedBezierPathUpdateCount = updateCount;
+  _cachedBezierPathBounds = bounds;
+  _cachedBezierPathStrokeWidth = strokeWidth;
+  return _cachedBezierPath;
+}
+
+- (void)invalidateBezierPathCache {
+  _cachedBezierPath = nil;
+  _cachedSimplifiedBezierPath = nil;
+  _cachedSimplifiedBezierPathSource = nil;
+  [self invalidateSerializationCache];
+}
+
++ (NSUInteger)bezierPathCacheHitCount {
+  return atomic_load_explicit(&sBezierPathCacheHitCount, memory_order_relaxed);
+}
+
++ (NSUInteger)bezierPathCacheMissCount {
+  return atomic_load_explicit(&sBezierPathCacheMissCount, memory_order_relaxed);
+}
+
+#pragma mark - Level of Detail
+
+CGFloat SKTGraphicPixelsPerUnitInView(NSView *view) {
+  NSGraphicsContext *currentContext = [NSGraphicsContext currentContext];
+  if (nil == view || sLevelOfDetailDisabled || ! [currentContext isDrawingToScreen]) {
+    return 0;
+  }
+  CGAffineTransform ctm = CGContextGetCTM((CGContextRef)[currentContext graphicsPort]);
+  return sqrt(fabs(ctm.a * ctm.d - ctm.b * ctm.c));
+}
+
+#if DEBUG
+void SKTGraphicSetLevelOfDetailEnabled(BOOL isEnabled) {
+  sLevelOfDetailDisabled = ! isEnabled;
+}
+#endif
+
+static CGFloat DistanceSquared(NSPoint a, NSPoint b) {
+  return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+}
+
+// From p to the nearest point of the segment from a to b.
+static CGFloat SegmentDistanceSquared(NSPoint p, NSPoint a, NSPoint b) {
+  CGFloat lengthSquared = DistanceSquared(a, b);
+  CGFloat t = (0 < lengthSquared) ? ((p.x - a.x) * (b.x - a.x) + (p.y - a.y) * (b.y - a.y)) / lengthSquared : 0;
+  t = MAX(0, MIN(1, t));
+  return DistanceSquared(p, NSMakePoint(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y)));
+}
+
+// path, less every point within tolerance of the last point kept, and with every curve whose control points are within tolerance of its chord made a line. Each subpath keeps its first and last points, so nothing moves by more than tolerance.
+static NSBezierPath *SimplifiedBezierPath(NSBezierPath *path, CGFloat tolerance) {
+  NSBezierPath *result = [NSBezierPath bezierPath];
+  [result setLineWidth:[path lineWidth]];
+  [result setLineCapStyle:[path lineCapStyle]];
+  [result setLineJoinStyle:[path lineJoinStyle]];
+  [result setMiterLimit:[path miterLimit]];
+  [result setWindingRule:[path windingRule]];
+  CGFloat toleranceSquared = tolerance * tolerance;
+  NSPoint points[3];
+  NSPoint lastKept = NSZeroPoint;
+  NSPoint subpathStart = NSZeroPoint;
+  // The last point dropped since lastKept, to end its subpath with.
+  NSPoint dropped = NSZeroPoint;
+  BOOL hasDropped = NO;
+  NSInteger elementCount = [path elementCount];
+  for (NSInteger i = 0; i < elementCount; ++i) {
+    NSBezierPathElement element = [path elementAtIndex:i associatedPoints:points];
+    if (NSLineToBezierPathElement == element || NSCurveToBezierPathElement == element) {
+      NSPoint end = (NSLineToBezierPathElement == element) ? points[0] : points[2];
+      if (DistanceSquared(end, lastKept) < toleranceSquared && (NSLineToBezierPathElement == element || (DistanceSquared(points[0], lastKept) < toleranceSquared && DistanceSquared(points[1], lastKept) < toleranceSquared))) {
+        dropped = end;
+        hasDropped = YES;
+      } else if (NSLineToBezierPathElement == element || (SegmentDistanceSquared(points[0], lastKept, end) < toleranceSquared && SegmentDistanceSquared(points[1], lastKept, end) < toleranceSquared)) {
+        [result lineToPoint:end];
+        lastKept = end;
+        hasDropped = NO;
+      } else {
+        [result curveToPoint:end controlPoint1:points[0] controlPoint2:points[1]];
+        lastKept = end;
+        hasDropped = NO;
+      }
+      continue;
+    }
+    if (hasDropped) {
+      [result lineToPoint:dropped];
+      hasDropped = NO;
+    }
+    if (NSMoveToBezierPathElement == element) {
+      [result moveToPoint:points[0]];
+      lastKept = subpathStart = points[0];
+    } else {
+      [result closePath];
+      lastKept = subpathStart;
+    }
+  }
+  if (hasDropped) {
+    [result lineToPoint:dropped];
+  }
+  return result;
+}
+
+- (NSBezierPath *)bezierPathForDrawingAtPixelsPerUnit:(CGFloat)pixelsPerUnit {
+  NSBezierPath *path = [self bezierPathForDrawing];
+  if (0 == pixelsPerUnit || [path elementCount] < SKTGraphicMinimumSimplifiedElementCount) {
+    return path;
+  }
+
+  // Zoom levels within a factor of two of each other share a path, simplified to half a pixel at the lowest of them, so less than a pixel at the highest.
+  NSInteger level = (NSInteger)floor(log2(pixelsPerUnit));
+  if (nil == _cachedSimplifiedBezierPath || path != _cachedSimplifiedBezierPathSource || level != _cachedSimplifiedBezierPathLevel) {
+    _cachedSimplifiedBezierPath = SimplifiedBezierPath(path, 0.5 / ldexp(1, (int)level));
+    _cachedSimplifiedBezierPathSource = path;
+    _cachedSimplifiedBezierPathLevel = level;
+  }
+  return _cachedSimplifiedBezierPath;
+}
+
+- (BOOL)drawPlaceholderAtPixelsPerUnit:(CGFloat)pixelsPerUnit {
+  if (0 == pixelsPerUnit) {
+    return NO;
+  }
+  NSRect bounds = [self bounds];
+  if ([self isDrawingStroke]) {
+    CGFloat halfStrokeWidth = [self strokeWidth] / 2.0f;
+    bounds = NSInsetRect(bounds, -halfStrokeWidth, -halfStrokeWidth);
+  }
+  if (1 <= NSWidth(bounds) * pixelsPerUnit || 1 <= NSHeight(bounds) * pixelsPerUnit) {
+    return NO;
+  }
+  NSColor *color = [self isDrawingStroke] ? [self strokeColor] : ([self isDrawingFill] ? [self fillColor] : nil);
+  if (color) {
+    CGFloat pixel = 1 / pixelsPerUnit;
+    [color set];
+    NSRectFillUsingOperation(NSMakeRect(NSMidX(bounds) - pixel / 2, NSMidY(bounds) - pixel / 2, pixel, pixel), NSCompositeSourceOver);
+  }
+  return YES;
+}
+
+
 - (void)drawHandlesInView:(NSView *)view {
 
   // Draw handles at the corners and on the sides.
@@ -641,6 +976,10 @@ enum {
 
 }
 
+- (BOOL)isContentsUnderPoint:(NSPoint)point tolerance:(CGFloat)tolerance {
+  return [self isContentsUnderPoint:point];
+}
+
 
 - (NSInteger)handleUnderPoint:(NSPoint)point  inView:(NSView<SKTHasHandles> *)view {
 
@@ -792,6 +1131,26 @@ enum {
 }
 
 
+- (void)applyTransform:(CGAffineTransform)transform {
+
+  // All we know about is the bounds, so rotation and skew turn into whatever bounding box they make.
+  [self setBounds:CGRectApplyAffineTransform([self bounds], transform)];
+
+  // Split what's left into a mirror of the y axis, if the transform turns the plane over (its determinant is negative),
+  // then a rotation by atan2(b, a), which takes the x axis where the transform does. Of rotations, the bounds can only
+  // show a half turn, as a flip both ways, so one nearer a half turn than none (a < 0) counts as one.
+  BOOL isMirror = transform.a * transform.d - transform.b * transform.c < 0;
+  BOOL isHalfTurn = transform.a < 0;
+  if (isHalfTurn) {
+    [self flipHorizontally];
+  }
+  if (isMirror != isHalfTurn) {
+    [self flipVertically];
+  }
+
+}
+
+
 - (void)makeNaturalSize {
 
   // Just make the graphic square.
@@ -812,7 +1171,9 @@ enum {
 
 - (void)setBounds:(NSRect)bounds {
   if ( ! _locked) {
+    [self willChangeValueForKey:SKTGraphicBoundsKey];
     _bounds = bounds;
+    [self didChangeValueForKey:SKTGraphicBoundsKey];
   }
 }
 
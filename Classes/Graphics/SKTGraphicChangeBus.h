@@ -0,0 +1,46 @@
+/*  SKTGraphicChangeBus.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+@class SKTGraphic;
+
+// What a subscriber to an SKTGraphicChangeBus hears, on the main thread.
+@protocol SKTGraphicChangeObserver <NSObject>
+@optional
+
+// The value for key, one of the graphic's keysForValuesToObserveForUndo, may have changed. Like KVO's change
+// dictionaries, nil values are NSNull, and not every call is a real change.
+- (void)graphic:(SKTGraphic *)graphic didChangeValueForKey:(NSString *)key oldValue:(id)oldValue newValue:(id)newValue;
+
+// Something that affects the graphic's drawingBounds changed.
+- (void)graphic:(SKTGraphic *)graphic didChangeDrawingBoundsFrom:(NSRect)oldDrawingBounds to:(NSRect)newDrawingBounds;
+
+// Something that affects how the graphic draws, but not where, changed.
+- (void)graphicDidChangeDrawingContents:(SKTGraphic *)graphic;
+
+@end
+
+// One per document. A document's graphics post their changes to it whether or not anything observes them with KVO,
+// and it works out what each change means for undo and for drawing from the same +keyPathsForValuesAffecting<Key>
+// methods KVO would use. So there's nothing to register per graphic: subscribing costs the same for a document of a
+// million graphics as for an empty one, and inserting graphics costs nothing here at all.
+@interface SKTGraphicChangeBus : NSObject
+
+// Held weakly.
+- (void)addObserver:(id<SKTGraphicChangeObserver>)observer;
+- (void)removeObserver:(id<SKTGraphicChangeObserver>)observer;
+
+// Sent by SKTGraphic's -willChangeValueForKey: and -didChangeValueForKey:. Calls for one graphic nest: each old value
+// is the one from before the first will that affected it, and the observers hear about it all at the outermost did.
+- (void)graphic:(SKTGraphic *)graphic willChangeValueForKey:(NSString *)key;
+- (void)graphic:(SKTGraphic *)graphic didChangeValueForKey:(NSString *)key;
+
+@end
+
+#if DEBUG
+// Logs how long it takes to start watching graphicCount rectangles for undo and redraw, then move each once, with KVO
+// registration per graphic as FloorSketch used to, and with a change bus.
+void SKTGraphicChangeBusBenchmark(NSUInteger graphicCount);
+#endif
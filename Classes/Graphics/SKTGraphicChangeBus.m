@@ -0,0 +1,237 @@
+/*  SKTGraphicChangeBus.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTGraphicChangeBus.h"
+
+#import "SKTGraphic.h"
+#import "SKTRectangle.h"
+
+// What's known so far about a change of one graphic, between its outermost will and did.
+@interface SKTGraphicChange : NSObject {
+ @public
+  NSUInteger _depth;
+  BOOL _affectsDrawingBounds;
+  BOOL _affectsDrawingContents;
+  NSRect _oldDrawingBounds;
+  // The undo keys affected, in the order they first were, and their values from just before.
+  NSMutableArray<NSString *> *_keys;
+  NSMutableArray *_oldValues;
+}
+@end
+
+@implementation SKTGraphicChange
+@end
+
+@interface SKTGraphicChangeBus () {
+  NSHashTable<id<SKTGraphicChangeObserver>> *_observers;
+
+  // Of the graphics between their outermost will and did.
+  NSMapTable<SKTGraphic *, SKTGraphicChange *> *_changes;
+
+  // For each graphic class, the keys affecting its drawingBounds, its drawingContents, and each of its undo keys, as
+  // KVO would ask for them.
+  NSMapTable<Class, NSMutableDictionary<NSString *, NSSet *> *> *_affectingKeysByClass;
+}
+@end
+
+@implementation SKTGraphicChangeBus
+
+- (instancetype)init {
+  self = [super init];
+  if (self) {
+    _observers = [NSHashTable weakObjectsHashTable];
+    _changes = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    _affectingKeysByClass = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+  }
+  return self;
+}
+
+- (void)addObserver:(id<SKTGraphicChangeObserver>)observer {
+  [_observers addObject:observer];
+}
+
+- (void)removeObserver:(id<SKTGraphicChangeObserver>)observer {
+  [_observers removeObject:observer];
+}
+
+- (NSSet *)keysAffectingKey:(NSString *)key ofClass:(Class)graphicClass {
+  NSMutableDictionary<NSString *, NSSet *> *affectingKeys = [_affectingKeysByClass objectForKey:graphicClass];
+  if (nil == affectingKeys) {
+    affectingKeys = [NSMutableDictionary dictionary];
+    [_affectingKeysByClass setObject:affectingKeys forKey:graphicClass];
+  }
+  NSSet *keys = affectingKeys[key];
+  if (nil == keys) {
+    keys = [graphicClass keyPathsForValuesAffectingValueForKey:key] ?: [NSSet set];
+    affectingKeys[key] = keys;
+  }
+  return keys;
+}
+
+- (void)graphic:(SKTGraphic *)graphic willChangeValueForKey:(NSString *)key {
+  SKTGraphicChange *change = [_changes objectForKey:graphic];
+  if (nil == change) {
+    change = [[SKTGraphicChange alloc] init];
+    change->_keys = [NSMutableArray array];
+    change->_oldValues = [NSMutableArray array];
+    [_changes setObject:change forKey:graphic];
+  }
+  change->_depth += 1;
+
+  // Record the old values of whatever this key affects, unless an outer will already has.
+  Class graphicClass = [graphic class];
+  if ( ! change->_affectsDrawingBounds && ([key isEqualToString:SKTGraphicDrawingBoundsKey] || [[self keysAffectingKey:SKTGraphicDrawingBoundsKey ofClass:graphicClass] containsObject:key])) {
+    change->_affectsDrawingBounds = YES;
+    change->_oldDrawingBounds = [graphic drawingBounds];
+  } else if ([key isEqualToString:SKTGraphicDrawingContentsKey] || [[self keysAffectingKey:SKTGraphicDrawingContentsKey ofClass:graphicClass] containsObject:key]) {
+    change->_affectsDrawingContents = YES;
+  }
+  for (NSString *undoKey in [graphic keysForValuesToObserveForUndo]) {
+    if (([undoKey isEqualToString:key] || [[self keysAffectingKey:undoKey ofClass:graphicClass] containsObject:key]) && ! [change->_keys containsObject:undoKey]) {
+      [change->_keys addObject:undoKey];
+      [change->_oldValues addObject:[graphic valueForKey:undoKey] ?: [NSNull null]];
+    }
+  }
+}
+
+- (void)graphic:(SKTGraphic *)graphic didChangeValueForKey:(NSString *)key {
+  SKTGraphicChange *change = [_changes objectForKey:graphic];
+  if (nil == change || 0 < --change->_depth) {
+    return;
+  }
+  [_changes removeObjectForKey:graphic];
+
+  // The observers may well change graphics themselves, so tell them about a snapshot of everything.
+  NSArray<id<SKTGraphicChangeObserver>> *observers = [_observers allObjects];
+  NSUInteger keyCount = [change->_keys count];
+  for (NSUInteger i = 0; i < keyCount; ++i) {
+    NSString *undoKey = change->_keys[i];
+    id newValue = [graphic valueForKey:undoKey] ?: [NSNull null];
+    for (id<SKTGraphicChangeObserver> observer in observers) {
+      if ([observer respondsToSelector:@selector(graphic:didChangeValueForKey:oldValue:newValue:)]) {
+        [observer graphic:graphic didChangeValueForKey:undoKey oldValue:change->_oldValues[i] newValue:newValue];
+      }
+    }
+  }
+  // Redrawing where it was and where it is covers redrawing what it looks like.
+  if (change->_affectsDrawingBounds) {
+    NSRect newDrawingBounds = [graphic drawingBounds];
+    for (id<SKTGraphicChangeObserver> observer in observers) {
+      if ([observer respondsToSelector:@selector(graphic:didChangeDrawingBoundsFrom:to:)]) {
+        [observer graphic:graphic didChangeDrawingBoundsFrom:change->_oldDrawingBounds to:newDrawingBounds];
+      }
+    }
+  } else if (change->_affectsDrawingContents) {
+    for (id<SKTGraphicChangeObserver> observer in observers) {
+      if ([observer respondsToSelector:@selector(graphicDidChangeDrawingContents:)]) {
+        [observer graphicDidChangeDrawingContents:graphic];
+      }
+    }
+  }
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+// Stands in for both a document and a graphic view: the owner of the graphics, and the observer of their changes.
+@interface SKTGraphicChangeBusBenchmarkOwner : NSObject<SKTGraphicChangeObserver> {
+ @public
+  SKTGraphicChangeBus *_graphicChangeBus;
+  NSUInteger _notificationCount;
+}
+@end
+
+@implementation SKTGraphicChangeBusBenchmarkOwner
+
+- (SKTGraphicChangeBus *)graphicChangeBus {
+  return _graphicChangeBus;
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context {
+  _notificationCount += 1;
+}
+
+- (void)graphic:(SKTGraphic *)graphic didChangeValueForKey:(NSString *)key oldValue:(id)oldValue newValue:(id)newValue {
+  _notificationCount += 1;
+}
+
+- (void)graphic:(SKTGraphic *)graphic didChangeDrawingBoundsFrom:(NSRect)oldDrawingBounds to:(NSRect)newDrawingBounds {
+  _notificationCount += 1;
+}
+
+@end
+
+static NSArray<SKTGraphic *> *BenchmarkGraphics(NSUInteger graphicCount) {
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:graphicCount];
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    SKTRectangle *rectangle = [[SKTRectangle alloc] init];
+    [rectangle setBounds:NSMakeRect(i % 1000 * 20, i / 1000 * 20, 12, 3)];
+    [graphics addObject:rectangle];
+  }
+  return graphics;
+}
+
+static void MoveGraphics(NSArray<SKTGraphic *> *graphics) {
+  for (SKTGraphic *graphic in graphics) {
+    [graphic setBounds:NSOffsetRect([graphic bounds], 5, 5)];
+  }
+}
+
+void SKTGraphicChangeBusBenchmark(NSUInteger graphicCount) {
+  // What SKTDocument and SKTGraphicView used to register for each graphic inserted.
+  NSArray<SKTGraphic *> *graphics = BenchmarkGraphics(graphicCount);
+  SKTGraphicChangeBusBenchmarkOwner *observer = [[SKTGraphicChangeBusBenchmarkOwner alloc] init];
+  NSKeyValueObservingOptions options = NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld;
+  NSIndexSet *allGraphicIndexes = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, graphicCount)];
+  NSDate *start = [NSDate date];
+  for (SKTGraphic *graphic in graphics) {
+    for (NSString *key in [graphic keysForValuesToObserveForUndo]) {
+      [graphic addObserver:observer forKeyPath:key options:options context:NULL];
+    }
+    [graphic addObserver:observer forKeyPath:SKTGraphicKeysForValuesToObserveForUndoKey options:options context:NULL];
+  }
+  [graphics addObserver:observer toObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingBoundsKey options:options context:NULL];
+  [graphics addObserver:observer toObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingContentsKey options:0 context:NULL];
+  NSTimeInterval kvoRegisterTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  MoveGraphics(graphics);
+  NSTimeInterval kvoMoveTime = -[start timeIntervalSinceNow];
+  NSUInteger kvoNotificationCount = observer->_notificationCount;
+
+  start = [NSDate date];
+  [graphics removeObserver:observer fromObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingContentsKey];
+  [graphics removeObserver:observer fromObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingBoundsKey];
+  for (SKTGraphic *graphic in graphics) {
+    [graphic removeObserver:observer forKeyPath:SKTGraphicKeysForValuesToObserveForUndoKey];
+    for (NSString *key in [graphic keysForValuesToObserveForUndo]) {
+      [graphic removeObserver:observer forKeyPath:key];
+    }
+  }
+  NSTimeInterval kvoUnregisterTime = -[start timeIntervalSinceNow];
+
+  // The same, through a change bus. Every inserted graphic points back to its container either way.
+  graphics = BenchmarkGraphics(graphicCount);
+  SKTGraphicChangeBusBenchmarkOwner *owner = [[SKTGraphicChangeBusBenchmarkOwner alloc] init];
+  owner->_graphicChangeBus = [[SKTGraphicChangeBus alloc] init];
+  [graphics makeObjectsPerformSelector:@selector(setScriptingContainer:) withObject:owner];
+  start = [NSDate date];
+  [owner->_graphicChangeBus addObserver:owner];
+  NSTimeInterval busRegisterTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  MoveGraphics(graphics);
+  NSTimeInterval busMoveTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  [owner->_graphicChangeBus removeObserver:owner];
+  NSTimeInterval busUnregisterTime = -[start timeIntervalSinceNow];
+
+  NSLog(@"%lu graphics: KVO register %.3fs move %.3fs (%lu notifications) unregister %.3fs; bus register %.6fs move %.3fs (%lu notifications) unregister %.6fs",
+    (unsigned long)graphicCount, kvoRegisterTime, kvoMoveTime, (unsigned long)kvoNotificationCount, kvoUnregisterTime,
+    busRegisterTime, busMoveTime, (unsigned long)owner->_notificationCount, busUnregisterTime);
+}
+#endif
@@ -13,6 +13,8 @@
 // I could have just copied the code, but that seems error-prone.
 
 @class SKTGraphic;
+@class SKTGraphicChangeBus;
+@class SKTSpatialIndex;
 
 @protocol SKTGraphicsOwner<NSObject>
 @property(nonatomic) NSMutableArray *graphics;
@@ -31,6 +33,12 @@
 - (BOOL)isBeingCreateOrEdited:(SKTGraphic *)graphic;
 - (BOOL)isHidingHandles;
 - (void)drawGraphics:(NSArray<SKTGraphic *> *)graphics view:(NSView *)view rect:(NSRect)rect;
+
+// An up to date index of graphics, or nil if the owner doesn't keep one for that array, in which case callers scan it.
+- (SKTSpatialIndex *)spatialIndexOfGraphics:(NSArray<SKTGraphic *> *)graphics;
+
+// Where the owner's graphics post their changes, for undo and redrawing. Owners without one aren't watched.
+- (SKTGraphicChangeBus *)graphicChangeBus;
 @end
 
 @interface NSObject(SKTGraphicsOwner)
@@ -13,6 +13,7 @@
 #import "SKTPath.h"
 #import "SKTPoly.h"
 #import "SKTRectangle.h"
+#import "SKTSpatialIndex.h"
 #import "SKTText.h"
 
 @implementation NSObject(SKTGraphicsOwner)
@@ -80,7 +81,24 @@
   return result;
 }
 
+// GraphicView and SKTGroup override this.
+- (SKTSpatialIndex *)spatialIndexOfGraphics:(NSArray<SKTGraphic *> *)graphics {
+  return nil;
+}
+
 - (void)drawGraphics:(NSArray<SKTGraphic *> *)graphics view:(NSView *)view rect:(NSRect)rect {
+  SKTSpatialIndex *spatialIndex = [self spatialIndexOfGraphics:graphics];
+  if (spatialIndex) {
+    // Back to front, only the graphics the index says are in rect.
+    NSIndexSet *indexes = [spatialIndex indexesOfGraphicsIntersectingRect:rect];
+    for (NSUInteger index = [indexes lastIndex]; index != NSNotFound; index = [indexes indexLessThanIndex:index]) {
+      NSGraphicsContext *currentContext = [NSGraphicsContext currentContext];
+      [currentContext saveGraphicsState];
+      [self drawGraphic:graphics[index] view:view rect:rect index:index];
+      [currentContext restoreGraphicsState];
+    }
+    return;
+  }
   NSInteger graphicCount = [graphics count];
   for (NSInteger index = graphicCount - 1; index >= 0; index--) {
     SKTGraphic *graphic = graphics[index];
@@ -110,11 +128,13 @@
       drawSelectionHandles = [self isInSelectionSet:index];
     }
 
-    // Draw the graphic, possibly with selection handles.
+    // Draw the graphic, or a stand-in if it's too small to make out at the view's zoom, possibly with selection handles.
     NSGraphicsContext *currentContext = [NSGraphicsContext currentContext];
     [currentContext saveGraphicsState];
     [NSBezierPath clipRect:rect];
-    [graphic drawContentsInView:view rect:rect isBeingCreateOrEdited:isBeingCreateOrEdited];
+    if (isBeingCreateOrEdited || ! [graphic drawPlaceholderAtPixelsPerUnit:SKTGraphicPixelsPerUnitInView(view)]) {
+      [graphic drawContentsInView:view rect:rect isBeingCreateOrEdited:isBeingCreateOrEdited];
+    }
     if (drawSelectionHandles) {
       [graphic drawHandlesInView:view];
     }
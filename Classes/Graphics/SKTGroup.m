@@ -4,14 +4,25 @@
 
 #import "SKTGroup.h"
 
-#import "SKTDocument.h"
+#import "SKTAffineTransform.h"
+#import "SKTDocumentFormat.h"
 #import "SKTGraphic.h"
 #import "SKTGraphicsOwner.h"
+#import "SKTNativeFormat.h"
+#import "SKTSpatialIndex.h"
+#import "SKTSVGWriter.h"
 
 // Most of the scripting support is in SKTGraphicsOwner.h
 
+enum {
+  // Smaller groups just scan their graphics when drawing.
+  kMinSpatialIndexCount = 64
+};
 
-@interface SKTGroup()<SKTGraphicsOwner>
+@interface SKTGroup()<SKTGraphicsOwner> {
+  // Built lazily for drawing big groups, such as an imported floor plan. A group doesn't observe its graphics, so this is thrown away whenever the group changes its graphics, and, by -invalidateSerializationCache, whenever one of them changes.
+  SKTSpatialIndex *_spatialIndex;
+}
 @end
 
 @implementation SKTGroup
@@ -55,6 +66,19 @@
   return properties;
 }
 
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+  self = [super initWithNativeDecoder:decoder];
+  if (self) {
+    _graphics = [[decoder readGraphics] mutableCopy];
+  }
+  return self;
+}
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [super writeNativeToWriter:writer];
+  [writer writeGraphics:_graphics];
+}
+
 
 - (instancetype)copyWithZone:(NSZone *)zone {
   SKTGroup *result = [super copyWithZone:zone];
@@ -78,6 +102,7 @@
     graphic.scriptingContainer = nil;
   }
   _graphics = graphics;
+  _spatialIndex = nil;
   for (SKTGraphic *graphic in _graphics) {
     graphic.scriptingContainer = self;
   }
@@ -114,66 +139,86 @@
 // self setbounds would try to translate/scale to new bounds, so we call super to skup that.
 // Incrementing the update count before and after the change triggers a redraw of the old and new positions.
 - (void)updateBounds {
+  _spatialIndex = nil;
   [self setUpdateCount:1 + [self updateCount]];
   CGRect newBounds = [self computeBounds];
   [super setBounds:newBounds];
   [self setUpdateCount:1 + [self updateCount]];
 }
 
+- (void)applyTransform:(CGAffineTransform)transform {
+  for (SKTGraphic *graphic in _graphics) {
+    [graphic applyTransform:transform];
+  }
+  [self updateBounds];
+}
+
+- (BOOL)canSimplify {
+  for (SKTGraphic *graphic in _graphics) {
+    if ([graphic canSimplify]) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+- (SKTSimplifyReport)simplifyWithMethod:(SKTSimplifyMethod)method tolerance:(CGFloat)tolerance {
+  SKTSimplifyReport report = {0, 0, 0};
+  for (SKTGraphic *graphic in _graphics) {
+    report = SKTSimplifyReportAdd(report, [graphic simplifyWithMethod:method tolerance:tolerance]);
+  }
+  if (report.vertexCount < report.originalVertexCount) {
+    [self updateBounds];
+  }
+  return report;
+}
+
 - (void)setBounds:(NSRect)bounds {
   CGRect oldBounds = [self computeBounds];
   [super setBounds:bounds];
   if ( ! CGRectEqualToRect(bounds, oldBounds)) {
-    CGPoint translate = CGPointMake(bounds.origin.x - oldBounds.origin.x, bounds.origin.y - oldBounds.origin.y);
-    CGFloat sx;
-    if (oldBounds.size.width == 0) {
-      sx = 1;
-    } else {
-      sx = bounds.size.width / oldBounds.size.width;
-    }
-    CGFloat sy;
-    if (oldBounds.size.height == 0) {
-      sy = 1;
-    } else {
-      sy = bounds.size.height / oldBounds.size.height;
-    }
-    CGSize scale = CGSizeMake(sx, sy);
-    if ( ! (CGPointEqualToPoint(CGPointZero, translate) && CGSizeEqualToSize(CGSizeMake(1,1), scale))) {
+    CGAffineTransform transform = SKTTransformMappingRect(oldBounds, bounds);
+    if ( ! CGAffineTransformIsIdentity(transform)) {
       for (SKTGraphic *graphic in _graphics) {
-        CGRect itemBounds = [graphic bounds];
-        CGFloat tl = itemBounds.origin.x - bounds.origin.x;
-        CGFloat tr = tl + itemBounds.size.width;
-
-        CGFloat bl = itemBounds.origin.y - bounds.origin.y ;
-        CGFloat br = bl + itemBounds.size.height;
-
-        tl = (tl + translate.x) * scale.width;
-        tr = (tr + translate.x) * scale.width;
-
-        bl = (bl + translate.y) * scale.height;
-        br = (br + translate.y) * scale.height;
-
-        CGRect newItemBounds = CGRectMake(tl + bounds.origin.x, bl + bounds.origin.y, tr - tl, br - bl);
-        [graphic setBounds:newItemBounds];
+        [graphic setBounds:CGRectApplyAffineTransform([graphic bounds], transform)];
       }
+      _spatialIndex = nil;
     }
   }
 }
 
+// Override of the NSObject(SKTGraphicsOwner) method.
+- (SKTSpatialIndex *)spatialIndexOfGraphics:(NSArray<SKTGraphic *> *)graphics {
+  if (graphics != _graphics || [_graphics count] < kMinSpatialIndexCount) {
+    return nil;
+  }
+  if (nil == _spatialIndex) {
+    _spatialIndex = [[SKTSpatialIndex alloc] initWithGraphics:_graphics owner:self];
+  }
+  return _spatialIndex;
+}
+
+// A member sends this to its group on any change, its bounds included, so the index's cells go stale with it.
+- (void)invalidateSerializationCache {
+  _spatialIndex = nil;
+  [super invalidateSerializationCache];
+}
+
 - (void)drawContentsInView:(NSView *)view rect:(NSRect)rect isBeingCreateOrEdited:(BOOL)isBeingCreateOrEdited {
   [self drawGraphics:[self graphics] view:view rect:rect];
 }
 
 
-- (NSString *)asSVGString {
-  NSMutableArray *a = [NSMutableArray array];
-  [a addObject:[NSString stringWithFormat:@"<g %@>", [self svgAttributesString]]];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"<g "];
+  [self writeSVGAttributesToWriter:writer];
+  [writer writeUTF8:">"];
   for (int i = ((int)[_graphics count]) - 1; 0 <= i; --i) {
     SKTGraphic *graphic = _graphics[i];
-    [a addObject:[graphic asSVGString]];
+    [writer writeUTF8:"\n"];
+    [graphic writeCachedSVGToWriter:writer];
   }
-  [a addObject:@"</g>"];
-  return [a componentsJoinedByString:@"\n"];
+  [writer writeUTF8:"\n</g>"];
 }
 
 
@@ -190,10 +235,14 @@
 }
 
 - (void)startObservingGraphics:(NSArray *)graphics {
+  _spatialIndex = nil;  // graphics were just inserted.
+  [self invalidateSerializationCache];
   NSLog(@"startObservingGraphics - what should this do? delegate to the document?");
 }
 
 - (void)stopObservingGraphics:(NSArray *)graphics {
+  _spatialIndex = nil;  // graphics are about to be removed.
+  [self invalidateSerializationCache];
   NSLog(@"startObservingGraphics - what should this do? delegate to the document?");
 }
 
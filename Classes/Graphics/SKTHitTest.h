@@ -0,0 +1,62 @@
+/*  SKTHitTest.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+#import "SKTPathAtom.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Hit testing on raw coordinates, so a click on a graphic of a hundred thousand vertices costs one pass over them and
+ no NSBezierPath. SKTPoly tests its point buffer directly; SKTPath flattens its segments into an SKTFlattenedPath and
+ keeps it.
+ */
+
+typedef NS_ENUM(NSInteger, SKTWindingRule) {
+  /// Inside where the winding number isn't 0. How NSBezierPath fills by default, so how FloorSketch draws.
+  SKTWindingRuleNonZero,
+  /// Inside where the winding number is odd.
+  SKTWindingRuleEvenOdd,
+};
+
+/// How many times the ring of count points, closed back to its first, winds counterclockwise around point.
+NSInteger SKTRingWindingNumber(const CGPoint *pts, NSUInteger count, CGPoint point);
+
+/// Whether a winding number is inside by the rule.
+BOOL SKTWindingNumberIsInside(NSInteger windingNumber, SKTWindingRule rule);
+
+/// Whether any segment of the polyline of count points, and the one from its last point back to its first if isClosed,
+/// comes within distance of point. Stops at the first that does.
+BOOL SKTPolylineIsWithinDistance(const CGPoint *pts, NSUInteger count, BOOL isClosed, CGPoint point, CGFloat distance);
+
+/// A path's segments flattened to polylines, one per subpath.
+@interface SKTFlattenedPath : NSObject
+
+/// The subpaths as NSBezierPath would draw the packed segments, with curves and arcs flattened to within flatness. If
+/// isClosed, the last subpath is closed, as SKTPath's closed property closes it.
+- (instancetype)initWithVerbs:(const SKTPathVerb *)verbs count:(NSUInteger)verbCount coords:(const CGFloat *)coords isClosed:(BOOL)isClosed flatness:(CGFloat)flatness NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) CGFloat flatness;
+
+/// How many points, over all the subpaths.
+@property (nonatomic, readonly) NSUInteger pointCount;
+
+/// Whether the fill would cover point. Every subpath counts as closed for this, as it does for filling.
+- (BOOL)containsPoint:(CGPoint)point windingRule:(SKTWindingRule)rule;
+
+/// Whether the stroke's centerline comes within distance of point. Only closed subpaths have closing segments.
+- (BOOL)isStrokeWithinDistance:(CGFloat)distance ofPoint:(CGPoint)point;
+
+@end
+
+#if DEBUG
+/// Time hit tests on a polygon and a path of vertexCount vertices with NSBezierPath's -containsPoint: and with this
+/// kernel's containment and stroke distance. Logs the times per test.
+void SKTHitTestBenchmark(NSUInteger vertexCount);
+#endif
+
+NS_ASSUME_NONNULL_END
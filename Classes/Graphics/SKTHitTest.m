@@ -0,0 +1,327 @@
+/*  SKTHitTest.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTHitTest.h"
+
+#if DEBUG
+#import <Cocoa/Cocoa.h>
+#endif
+
+// Positive if point is left of the line from a through b, negative if right, 0 if on it.
+static CGFloat IsLeft(CGPoint a, CGPoint b, CGPoint point) {
+  return (b.x - a.x) * (point.y - a.y) - (point.x - a.x) * (b.y - a.y);
+}
+
+// Sunday's crossing rule: an edge counts only when it crosses the horizontal through point, so no trigonometry and no
+// special cases for vertices on that line.
+NSInteger SKTRingWindingNumber(const CGPoint *pts, NSUInteger count, CGPoint point) {
+  NSInteger windingNumber = 0;
+  for (NSUInteger i = 0; i < count; ++i) {
+    CGPoint a = pts[i];
+    CGPoint b = pts[(i + 1 < count) ? i + 1 : 0];
+    if (a.y <= point.y) {
+      if (point.y < b.y && 0 < IsLeft(a, b, point)) {
+        windingNumber += 1;
+      }
+    } else if (b.y <= point.y && IsLeft(a, b, point) < 0) {
+      windingNumber -= 1;
+    }
+  }
+  return windingNumber;
+}
+
+BOOL SKTWindingNumberIsInside(NSInteger windingNumber, SKTWindingRule rule) {
+  return (SKTWindingRuleEvenOdd == rule) ? 0 != (windingNumber & 1) : 0 != windingNumber;
+}
+
+// From point to the nearest point of the segment from a to b, squared.
+static CGFloat SegmentDistanceSquared(CGPoint point, CGPoint a, CGPoint b) {
+  CGFloat dx = b.x - a.x;
+  CGFloat dy = b.y - a.y;
+  CGFloat lengthSquared = dx * dx + dy * dy;
+  CGFloat t = (0 < lengthSquared) ? ((point.x - a.x) * dx + (point.y - a.y) * dy) / lengthSquared : 0;
+  t = MAX(0, MIN(1, t));
+  CGFloat ex = a.x + t * dx - point.x;
+  CGFloat ey = a.y + t * dy - point.y;
+  return ex * ex + ey * ey;
+}
+
+BOOL SKTPolylineIsWithinDistance(const CGPoint *pts, NSUInteger count, BOOL isClosed, CGPoint point, CGFloat distance) {
+  if (count < 2) {
+    return NO;
+  }
+  CGFloat distanceSquared = distance * distance;
+  NSUInteger segmentCount = isClosed ? count : count - 1;
+  for (NSUInteger i = 0; i < segmentCount; ++i) {
+    CGPoint a = pts[i];
+    CGPoint b = pts[(i + 1 < count) ? i + 1 : 0];
+    // Most segments are nowhere near, and their bounding boxes say so without a multiply.
+    if ((point.x + distance < a.x && point.x + distance < b.x) || (a.x < point.x - distance && b.x < point.x - distance) ||
+        (point.y + distance < a.y && point.y + distance < b.y) || (a.y < point.y - distance && b.y < point.y - distance)) {
+      continue;
+    }
+    if (SegmentDistanceSquared(point, a, b) <= distanceSquared) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+// One subpath of an SKTFlattenedPath: count points from first, and the box around them.
+typedef struct SKTFlattenedSubpath {
+  NSUInteger first;
+  NSUInteger count;
+  BOOL isClosed;
+  CGPoint min;
+  CGPoint max;
+} SKTFlattenedSubpath;
+
+@interface SKTFlattenedPath () {
+  CGPoint *_pts;
+  NSUInteger _pointCapacity;
+  SKTFlattenedSubpath *_subpaths;
+  NSUInteger _subpathCount;
+  NSUInteger _subpathCapacity;
+  // Whether the last of the _subpaths is still being added to.
+  BOOL _isOpen;
+}
+@end
+
+@implementation SKTFlattenedPath
+
+- (instancetype)initWithVerbs:(const SKTPathVerb *)verbs count:(NSUInteger)verbCount coords:(const CGFloat *)coords isClosed:(BOOL)isClosed flatness:(CGFloat)flatness {
+  self = [super init];
+  if (self) {
+    _flatness = flatness;
+    CGPoint current = CGPointZero;
+    CGPoint subpathStart = CGPointZero;
+    BOOL hasCurrent = NO;
+    for (NSUInteger i = 0; i < verbCount; ++i) {
+      SKTPathVerb verb = verbs[i];
+      switch (verb) {
+        case SKTPathVerbMove:
+          current = subpathStart = CGPointMake(coords[0], coords[1]);
+          hasCurrent = YES;
+          [self beginSubpathAtPoint:current];
+          break;
+        case SKTPathVerbClose:
+          if (_isOpen) {
+            _subpaths[_subpathCount - 1].isClosed = YES;
+            [self endSubpath];
+          }
+          // NSBezierPath starts whatever comes next where the closed subpath started.
+          current = subpathStart;
+          break;
+        default: {
+          if ( ! _isOpen && hasCurrent) {
+            [self beginSubpathAtPoint:current];
+          }
+          SKTPathSegmentFlatten(verb, coords, current, flatness, ^(CGPoint p) {
+            if (self->_isOpen) {
+              [self addPoint:p];
+            } else {
+              [self beginSubpathAtPoint:p];
+            }
+          });
+          current = SKTPathSegmentEndPoint(verb, coords, current);
+          if ( ! hasCurrent) {
+            subpathStart = _pts[_subpaths[_subpathCount - 1].first];
+          }
+          hasCurrent = YES;
+          break;
+        }
+      }
+      coords += SKTPathVerbCoordCount(verb);
+    }
+    if (isClosed && _isOpen) {
+      _subpaths[_subpathCount - 1].isClosed = YES;
+    }
+    [self endSubpath];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  free(_pts);
+  free(_subpaths);
+}
+
+- (void)endSubpath {
+  if (_isOpen) {
+    SKTFlattenedSubpath *subpath = &_subpaths[_subpathCount - 1];
+    subpath->count = _pointCount - subpath->first;
+    subpath->min = subpath->max = _pts[subpath->first];
+    for (NSUInteger i = subpath->first + 1; i < _pointCount; ++i) {
+      subpath->min.x = MIN(subpath->min.x, _pts[i].x);
+      subpath->min.y = MIN(subpath->min.y, _pts[i].y);
+      subpath->max.x = MAX(subpath->max.x, _pts[i].x);
+      subpath->max.y = MAX(subpath->max.y, _pts[i].y);
+    }
+    _isOpen = NO;
+  }
+}
+
+- (void)beginSubpathAtPoint:(CGPoint)point {
+  [self endSubpath];
+  if (_subpathCapacity <= _subpathCount) {
+    _subpathCapacity = _subpathCapacity ? 2 * _subpathCapacity : 4;
+    SKTFlattenedSubpath *subpaths = realloc(_subpaths, _subpathCapacity * sizeof(SKTFlattenedSubpath));
+    if (NULL == subpaths) {
+      [NSException raise:NSMallocException format:@"Could not allocate %lu subpaths.", (unsigned long)_subpathCapacity];
+    }
+    _subpaths = subpaths;
+  }
+  _subpaths[_subpathCount++] = (SKTFlattenedSubpath){_pointCount, 0, NO, point, point};
+  _isOpen = YES;
+  [self addPoint:point];
+}
+
+- (void)addPoint:(CGPoint)point {
+  if (_pointCapacity <= _pointCount) {
+    _pointCapacity = _pointCapacity ? 2 * _pointCapacity : 16;
+    CGPoint *pts = realloc(_pts, _pointCapacity * sizeof(CGPoint));
+    if (NULL == pts) {
+      [NSException raise:NSMallocException format:@"Could not allocate %lu points.", (unsigned long)_pointCapacity];
+    }
+    _pts = pts;
+  }
+  _pts[_pointCount++] = point;
+}
+
+- (BOOL)containsPoint:(CGPoint)point windingRule:(SKTWindingRule)rule {
+  NSInteger windingNumber = 0;
+  for (NSUInteger i = 0; i < _subpathCount; ++i) {
+    SKTFlattenedSubpath *subpath = &_subpaths[i];
+    // A subpath can only wind around points in its box.
+    if (subpath->min.x <= point.x && point.x <= subpath->max.x && subpath->min.y <= point.y && point.y <= subpath->max.y) {
+      windingNumber += SKTRingWindingNumber(_pts + subpath->first, subpath->count, point);
+    }
+  }
+  return SKTWindingNumberIsInside(windingNumber, rule);
+}
+
+- (BOOL)isStrokeWithinDistance:(CGFloat)distance ofPoint:(CGPoint)point {
+  for (NSUInteger i = 0; i < _subpathCount; ++i) {
+    SKTFlattenedSubpath *subpath = &_subpaths[i];
+    if (subpath->min.x - distance <= point.x && point.x <= subpath->max.x + distance &&
+        subpath->min.y - distance <= point.y && point.y <= subpath->max.y + distance &&
+        SKTPolylineIsWithinDistance(_pts + subpath->first, subpath->count, subpath->isClosed, point, distance)) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+// A room-sized outline of count points, wavy enough that no scanline is simple.
+static void BenchmarkOutline(CGPoint *pts, NSUInteger count) {
+  for (NSUInteger i = 0; i < count; ++i) {
+    CGFloat angle = 2 * M_PI * i / count;
+    CGFloat radius = 1000 + 50 * sin(40 * angle);
+    pts[i] = CGPointMake(radius * cos(angle), radius * sin(angle));
+  }
+}
+
+void SKTHitTestBenchmark(NSUInteger vertexCount) {
+  const NSUInteger testCount = 1000;
+  const CGFloat distance = 2;
+  CGPoint *pts = malloc(vertexCount * sizeof(CGPoint));
+  BenchmarkOutline(pts, vertexCount);
+  CGPoint *testPts = malloc(testCount * sizeof(CGPoint));
+  srandom(1);
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    // Half scattered over the box, half right on the outline, where a click on a wall lands.
+    if (i & 1) {
+      CGPoint p = pts[(NSUInteger)random() % vertexCount];
+      testPts[i] = CGPointMake(p.x + 1, p.y - 1);
+    } else {
+      testPts[i] = CGPointMake(2100.0 * random() / RAND_MAX - 1050, 2100.0 * random() / RAND_MAX - 1050);
+    }
+  }
+
+  // The polygon, as SKTPoly has it.
+  NSBezierPath *path = [NSBezierPath bezierPath];
+  [path appendBezierPathWithPoints:pts count:(NSInteger)vertexCount];
+  [path closePath];
+  NSUInteger bezierHits = 0;
+  NSDate *start = [NSDate date];
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    bezierHits += [path containsPoint:testPts[i]];
+  }
+  NSTimeInterval bezierTime = -[start timeIntervalSinceNow];
+  NSUInteger windingHits = 0;
+  start = [NSDate date];
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    windingHits += SKTWindingNumberIsInside(SKTRingWindingNumber(pts, vertexCount, testPts[i]), SKTWindingRuleNonZero);
+  }
+  NSTimeInterval windingTime = -[start timeIntervalSinceNow];
+  NSUInteger strokeHits = 0;
+  start = [NSDate date];
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    strokeHits += SKTPolylineIsWithinDistance(pts, vertexCount, YES, testPts[i], distance);
+  }
+  NSTimeInterval strokeTime = -[start timeIntervalSinceNow];
+  NSLog(@"Polygon of %lu vertices, per test: NSBezierPath %.1fµs (%lu in), winding %.1fµs (%lu in), stroke %.1fµs (%lu near)",
+    (unsigned long)vertexCount, 1e6 * bezierTime / testCount, (unsigned long)bezierHits, 1e6 * windingTime / testCount, (unsigned long)windingHits,
+    1e6 * strokeTime / testCount, (unsigned long)strokeHits);
+
+  // The same outline as a path of cubics through every third point, as SKTPath has it.
+  NSUInteger cubicCount = vertexCount / 3;
+  SKTPathVerb *verbs = malloc((cubicCount + 2) * sizeof(SKTPathVerb));
+  CGFloat *coords = malloc((2 + 6 * cubicCount) * sizeof(CGFloat));
+  NSUInteger verbCount = 0;
+  CGFloat *coord = coords;
+  verbs[verbCount++] = SKTPathVerbMove;
+  *coord++ = pts[0].x;
+  *coord++ = pts[0].y;
+  for (NSUInteger i = 0; i < cubicCount; ++i) {
+    verbs[verbCount++] = SKTPathVerbCubic;
+    for (NSUInteger k = 1; k <= 3; ++k) {
+      CGPoint p = pts[(3 * i + k) % vertexCount];
+      *coord++ = p.x;
+      *coord++ = p.y;
+    }
+  }
+  verbs[verbCount++] = SKTPathVerbClose;
+  path = [NSBezierPath bezierPath];
+  CGPoint position = CGPointZero;
+  coord = coords;
+  for (NSUInteger i = 0; i < verbCount; ++i) {
+    SKTPathSegmentAppendToPath(verbs[i], coord, path, &position);
+    coord += SKTPathVerbCoordCount(verbs[i]);
+  }
+  bezierHits = 0;
+  start = [NSDate date];
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    bezierHits += [path containsPoint:testPts[i]];
+  }
+  bezierTime = -[start timeIntervalSinceNow];
+  start = [NSDate date];
+  SKTFlattenedPath *flattened = [[SKTFlattenedPath alloc] initWithVerbs:verbs count:verbCount coords:coords isClosed:NO flatness:distance / 4];
+  NSTimeInterval flattenTime = -[start timeIntervalSinceNow];
+  windingHits = 0;
+  start = [NSDate date];
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    windingHits += [flattened containsPoint:testPts[i] windingRule:SKTWindingRuleNonZero];
+  }
+  windingTime = -[start timeIntervalSinceNow];
+  strokeHits = 0;
+  start = [NSDate date];
+  for (NSUInteger i = 0; i < testCount; ++i) {
+    strokeHits += [flattened isStrokeWithinDistance:distance ofPoint:testPts[i]];
+  }
+  strokeTime = -[start timeIntervalSinceNow];
+  NSLog(@"Path of %lu cubics, flattened to %lu points in %.3fs, per test: NSBezierPath %.1fµs (%lu in), winding %.1fµs (%lu in), stroke %.1fµs (%lu near)",
+    (unsigned long)cubicCount, (unsigned long)[flattened pointCount], flattenTime, 1e6 * bezierTime / testCount, (unsigned long)bezierHits,
+    1e6 * windingTime / testCount, (unsigned long)windingHits, 1e6 * strokeTime / testCount, (unsigned long)strokeHits);
+  free(verbs);
+  free(coords);
+  free(testPts);
+  free(pts);
+}
+#endif
@@ -15,6 +15,11 @@ extern NSString *SKTImageIsFlippedHorizontallyKey;
 extern NSString *SKTImageIsFlippedVerticallyKey;
 extern NSString *SKTImageFilePathKey;
 extern NSString *SKTImageContentsKey;
+extern NSString *SKTImageEncodedDataKey;
+extern NSString *SKTImageEncodedTypeKey;
+
+// "image/png" or "image/jpeg", for the image files whose bytes an SKTImage can keep as they are. Otherwise nil.
+NSString *SKTImageMIMETypeOfPathExtension(NSString *extension);
 
 // Represented in SVG as a url:data://;base64 of a PNG or JPEG for pasted images. otherwise, uses the filePath script command.
 @interface SKTImage : SKTGraphic
@@ -31,4 +36,7 @@ extern NSString *SKTImageContentsKey;
 // Initialize, given the image to be presented and the location on which it should be centered.
 - (instancetype)initWithPosition:(NSPoint)position contents:(NSImage *)contents;
 
+// Likewise, given the bytes of a PNG or JPEG and their MIME type. The bytes are what's saved, unchanged. Returns nil if they aren't an image.
+- (instancetype)initWithPosition:(NSPoint)position encodedData:(NSData *)data type:(NSString *)mimeType;
+
 @end
@@ -11,22 +11,64 @@
 
 #import "SKTImage.h"
 
+#import "SKTImageCache.h"
+#import "SKTNativeFormat.h"
+#import "SKTSVGWriter.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
 
 // String constants declared in the header. They may not be used by any other class in the project, but it's a good idea to provide and use them, if only to help prevent typos in source code.
 NSString *SKTImageIsFlippedHorizontallyKey = @"flippedHorizontally";
 NSString *SKTImageIsFlippedVerticallyKey = @"flippedVertically";
 NSString *SKTImageFilePathKey = @"filePath";
 
-// Another key, which is just used in persistent property dictionaries.
+// More keys, which are just used in persistent property dictionaries.
 NSString *SKTImageContentsKey = @"contents";
+NSString *SKTImageEncodedDataKey = @"encodedData";
+NSString *SKTImageEncodedTypeKey = @"encodedType";
+
+NSString *SKTImageMIMETypeOfPathExtension(NSString *extension) {
+  extension = [extension lowercaseString];
+  if ([extension isEqual:@"png"]) {
+    return @"image/png";
+  } else if ([extension isEqual:@"jpg"] || [extension isEqual:@"jpeg"]) {
+    return @"image/jpeg";
+  }
+  return nil;
+}
+
+// The PNGs written to SVG for images that have no encoded bytes of their own, keyed by the SHA-256 of the archived image, so saving again, or saving a copy, doesn't encode again.
+static NSCache *PNGCache(void) {
+  static NSCache *sCache;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    sCache = [[NSCache alloc] init];
+    [sCache setTotalCostLimit:64 * 1024 * 1024];
+  });
+  return sCache;
+}
 
-@interface SKTImage() {
-  // The image that's being presented.
+@interface SKTImage() <SKTImageCacheClient> {
+  // The image that's being presented. Nil until -contents first needs it, if _contentsData is set.
   NSImage *_contents;
 
+  // The NSArchiver'd image it was read from, or nil. Kept so that saving needn't archive the image again.
+  NSData *_contentsData;
+
+  // The PNG or JPEG bytes it was read from, or nil, and their MIME type. Saved just as they are: re-encoding is slow, and would turn a JPEG into a much bigger PNG.
+  NSData *_encodedData;
+  NSString *_encodedType;
+
   // The values underlying some of the key-value coding (KVC) and observing (KVO) compliance described below.
   BOOL _isFlippedHorizontally;
   BOOL _isFlippedVertically;
+
+  // What's drawn, decoded in the background the first time the image is drawn on screen. Nil until then, or once
+  // SKTImageCache has asked for the memory back. _cacheToken is its entry in the cache.
+  SKTImagePyramid *_pyramid;
+  id _cacheToken;
+  BOOL _isDecoding;
 }
 
 @end
@@ -36,33 +78,71 @@ NSString *SKTImageContentsKey = @"contents";
 
 - (id)copyWithZone:(NSZone *)zone {
   SKTImage *copy = [super copyWithZone:zone];
-  copy->_contents = [_contents copy];
+  @synchronized(self) {
+    copy->_contents = [_contents copy];
+    copy->_contentsData = _contentsData;
+    copy->_encodedData = _encodedData;
+    copy->_encodedType = _encodedType;
+  }
   return copy;
 }
 
+- (void)dealloc {
+  if (_cacheToken) {
+    [[SKTImageCache sharedCache] remove:_cacheToken];
+  }
+}
+
 
 
 
 #pragma mark - Private KVC-Compliance for Public Properties
 
 
+// An override of the NSObject(NSKeyValueObservingCustomization) method. The flips' setters notify by hand, as SKTGraphic's do, so the change bus hears about them.
++ (BOOL)automaticallyNotifiesObserversForKey:(NSString *)key {
+  if ([key isEqualToString:SKTImageIsFlippedHorizontallyKey] || [key isEqualToString:SKTImageIsFlippedVerticallyKey]) {
+    return NO;
+  }
+  return [super automaticallyNotifiesObserversForKey:key];
+}
+
 - (void)setFlippedHorizontally:(BOOL)isFlippedHorizontally {
 
   // Record the value and flush the transformed contents cache.
+  [self willChangeValueForKey:SKTImageIsFlippedHorizontallyKey];
   _isFlippedHorizontally = isFlippedHorizontally;
+  [self didChangeValueForKey:SKTImageIsFlippedHorizontallyKey];
 }
 
 - (void)setFlippedVertically:(BOOL)isFlippedVertically {
   // Record the value and flush the transformed contents cache.
+  [self willChangeValueForKey:SKTImageIsFlippedVerticallyKey];
   _isFlippedVertically = isFlippedVertically;
+  [self didChangeValueForKey:SKTImageIsFlippedVerticallyKey];
 
 }
 
 - (void)setFilePath:(NSString *)filePath {
-  // If there's a transformed version of the contents being held as a cache, it's invalid now.
-  NSImage *newContents = [[NSImage alloc] initWithContentsOfFile:[filePath stringByStandardizingPath]];
-  _contents = newContents;
-
+  // If there's a transformed version of the contents being held as a cache, it's invalid now. Keep a PNG or JPEG file's bytes, to be saved as they are.
+  filePath = [filePath stringByStandardizingPath];
+  NSString *newEncodedType = SKTImageMIMETypeOfPathExtension([filePath pathExtension]);
+  NSData *newEncodedData = newEncodedType ? [NSData dataWithContentsOfFile:filePath] : nil;
+  NSImage *newContents = newEncodedData ? [[NSImage alloc] initWithData:newEncodedData] : [[NSImage alloc] initWithContentsOfFile:filePath];
+  id oldToken;
+  @synchronized(self) {
+    _contents = newContents;
+    _contentsData = nil;
+    _encodedData = newContents ? newEncodedData : nil;
+    _encodedType = _encodedData ? newEncodedType : nil;
+    _pyramid = nil;
+    oldToken = _cacheToken;
+    _cacheToken = nil;
+  }
+  if (oldToken) {
+    [[SKTImageCache sharedCache] remove:oldToken];
+  }
+  [self invalidateSerializationCache];
 }
 
 #pragma mark - Public Methods
@@ -72,12 +152,25 @@ NSString *SKTImageContentsKey = @"contents";
   if (self) {
     _contents = contents;
     // Leave the image centered on the mouse pointer.
-    NSSize contentsSize = [_contents size];
+    NSSize contentsSize = [contents size];
     [self setBounds:NSMakeRect((position.x - (contentsSize.width / 2.0f)), (position.y - (contentsSize.height / 2.0f)), contentsSize.width, contentsSize.height)];
   }
   return self;
 }
 
+- (instancetype)initWithPosition:(NSPoint)position encodedData:(NSData *)data type:(NSString *)mimeType {
+  NSImage *contents = [[NSImage alloc] initWithData:data];
+  if (nil == contents) {
+    return nil;
+  }
+  self = [self initWithPosition:position contents:contents];
+  if (self) {
+    _encodedData = data;
+    _encodedType = [mimeType copy];
+  }
+  return self;
+}
+
 #pragma mark - Overrides of SKTGraphic Methods
 
 
@@ -96,10 +189,13 @@ NSString *SKTImageContentsKey = @"contents";
     // The dictionary entries are all instances of the classes that can be written in property lists. Don't trust the type of something you get out of a property list unless you know your process created it or it was read from your application or framework's resources. We don't have to worry about KVO-compliance in initializers like this by the way; no one should be observing an unitialized object.
     NSData *contentsData = properties[SKTImageContentsKey];
     if ([contentsData isKindOfClass:[NSData class]]) {
-      NSImage *contents = [NSUnarchiver unarchiveObjectWithData:contentsData];
-      if ([contents isKindOfClass:[NSImage class]]) {
-        _contents = contents;
-      }
+      _contentsData = contentsData;
+    }
+    NSData *encodedData = properties[SKTImageEncodedDataKey];
+    NSString *encodedType = properties[SKTImageEncodedTypeKey];
+    if ([encodedData isKindOfClass:[NSData class]] && [encodedType isKindOfClass:[NSString class]]) {
+      _encodedData = encodedData;
+      _encodedType = encodedType;
     }
     NSNumber *isFlippedHorizontallyNumber = properties[SKTImageIsFlippedHorizontallyKey];
     if ([isFlippedHorizontallyNumber isKindOfClass:[NSNumber class]]) {
@@ -118,42 +214,249 @@ NSString *SKTImageContentsKey = @"contents";
 
 - (NSMutableDictionary *)properties {
 
-  // Let SKTGraphic do its job and then handle the one additional property defined by this subclass. The dictionary must contain nothing but values that can be written in old-style property lists.
+  // Let SKTGraphic do its job and then handle the additional properties defined by this subclass. The dictionary must contain nothing but values that can be written in old-style property lists. Versions that don't know the encoded bytes still find the archived image.
   NSMutableDictionary *properties = [super properties];
-  properties[SKTImageContentsKey] = [NSArchiver archivedDataWithRootObject:_contents];
+  properties[SKTImageContentsKey] = [self contentsData];
+  @synchronized(self) {
+    if (_encodedData) {
+      properties[SKTImageEncodedDataKey] = _encodedData;
+      properties[SKTImageEncodedTypeKey] = _encodedType;
+    }
+  }
   properties[SKTImageIsFlippedHorizontallyKey] = @(_isFlippedHorizontally);
   properties[SKTImageIsFlippedVerticallyKey] = @(_isFlippedVertically);
   return properties;
 
 }
 
-- (NSString *)imageAsBase64 {
-    [_contents lockFocus];
-    NSBitmapImageRep *bitmapRep = [[NSBitmapImageRep alloc] initWithFocusedViewRect:NSMakeRect(0, 0, _contents.size.width, _contents.size.height)];
-    [_contents unlockFocus];
-    NSData *data = [bitmapRep representationUsingType:NSPNGFileType properties:@{}];
-    return [data base64EncodedStringWithOptions:NSDataBase64Encoding76CharacterLineLength | NSDataBase64EncodingEndLineWithLineFeed];
+
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+
+  // The image stays in the file, which is likely mapped, until it's first drawn.
+  self = [super initWithNativeDecoder:decoder];
+  if (self) {
+    uint8_t flags = [decoder readUInt8];
+    _isFlippedHorizontally = 0 != (flags & 1);
+    _isFlippedVertically = 0 != (flags & 2);
+    if (flags & 4) {
+      NSData *typeData = [decoder readData];
+      _encodedType = [[NSString alloc] initWithData:typeData encoding:NSUTF8StringEncoding];
+      _encodedData = [decoder readImageData];
+      if (nil == _encodedType) {
+        [decoder markDamaged];
+      }
+    } else {
+      _contentsData = [decoder readImageData];
+    }
+  }
+  return self;
+
+}
+
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [super writeNativeToWriter:writer];
+  NSData *encodedData;
+  NSString *encodedType;
+  @synchronized(self) {
+    encodedData = _encodedData;
+    encodedType = _encodedType;
+  }
+  [writer writeUInt8:(_isFlippedHorizontally ? 1 : 0) | (_isFlippedVertically ? 2 : 0) | (encodedData ? 4 : 0)];
+  if (encodedData) {
+    [writer writeData:[encodedType dataUsingEncoding:NSUTF8StringEncoding]];
+    [writer writeImageData:encodedData];
+  } else {
+    [writer writeImageData:[self contentsData]];
+  }
+}
+
+
+// Whichever of the encoded bytes and the archived image the image came from, decoded. Call with self locked.
+- (NSImage *)decodedContents {
+  NSImage *contents = nil;
+  if (_encodedData) {
+    contents = [[NSImage alloc] initWithData:_encodedData];
+  } else if (_contentsData) {
+    contents = [NSUnarchiver unarchiveObjectWithData:_contentsData];
+  }
+  return [contents isKindOfClass:[NSImage class]] ? contents : nil;
+}
+
+
+// Files hold images encoded or NSArchiver'd. Decoding is put off until the image is needed, from whichever thread needs it first.
+- (NSImage *)contents {
+  @synchronized(self) {
+    if (nil == _contents && (_encodedData || _contentsData)) {
+      _contents = [self decodedContents];
+      if (nil == _contents) {
+        _contentsData = nil;
+        _encodedData = nil;
+        _encodedType = nil;
+      }
+    }
+    return _contents;
+  }
 }
 
-- (NSString *)imageAsXlink {
-  if (_contents) {
-    NSString *imageAsBase64 = [self imageAsBase64];
-    if (imageAsBase64) {
-      return [NSString stringWithFormat:@"xlink:href=\"data:image/png;base64,%@\"", imageAsBase64];
+
+- (NSData *)contentsData {
+  @synchronized(self) {
+    if (nil == _contentsData) {
+      NSImage *contents = [self contents];
+      if (contents) {
+        _contentsData = [NSArchiver archivedDataWithRootObject:contents];
+      }
     }
+    return _contentsData ?: [NSData data];
+  }
+}
+
+#pragma mark - Decoding for Drawing
+
+// Like -contents, but doesn't keep an image it had to decode: once the pyramid is made it isn't needed.
+- (NSImage *)imageForDecoding {
+  @synchronized(self) {
+    return _contents ?: [self decodedContents];
   }
-  return @"";
 }
 
-- (NSString *)asSVGString {
-  return [self asSVGStringVerb:@"image"];
+- (SKTImagePyramid *)decodePyramid {
+  SKTImagePyramid *pyramid = [[SKTImagePyramid alloc] initWithImage:[self imageForDecoding]];
+  id token = pyramid ? [[SKTImageCache sharedCache] addClient:self byteCount:[pyramid byteCount]] : nil;
+  id oldToken;
+  @synchronized(self) {
+    _pyramid = pyramid;
+    oldToken = _cacheToken;
+    _cacheToken = token;
+    _isDecoding = NO;
+
+    // An image that can be decoded again needn't be held as well as its pixels.
+    if (_contentsData || _encodedData) {
+      _contents = nil;
+    }
+  }
+  if (oldToken) {
+    [[SKTImageCache sharedCache] remove:oldToken];
+  }
+  return pyramid;
 }
 
-- (NSString *)svgAttributesString {
-  return [NSString stringWithFormat:@"x=\"%.5g\" y=\"%.5g\" width=\"%.5g\" height=\"%.5g\" %@ %@",
-    self.bounds.origin.x, self.bounds.origin.y, self.bounds.size.width, self.bounds.size.height,
-    [self imageAsXlink],
-    [super svgAttributesString]];
+// Returns nil, having started decoding in the background if it wasn't already, unless synchronously or already decoded.
+- (SKTImagePyramid *)pyramidDecodingSynchronously:(BOOL)synchronously {
+  SKTImagePyramid *pyramid;
+  id token;
+  @synchronized(self) {
+    pyramid = _pyramid;
+    token = _cacheToken;
+    if (nil == pyramid && ! synchronously) {
+      if (_isDecoding) {
+        return nil;
+      }
+      _isDecoding = YES;
+    }
+  }
+  if (pyramid) {
+    [[SKTImageCache sharedCache] touch:token];
+    return pyramid;
+  }
+  if (synchronously) {
+    return [self decodePyramid];
+  }
+
+  static dispatch_queue_t sDecodingQueue;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    sDecodingQueue = dispatch_queue_create("com.turbozen.SKTImage.decoding", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(sDecodingQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+  });
+  __weak SKTImage *weakSelf = self;
+  dispatch_async(sDecodingQueue, ^{
+    SKTImage *image = weakSelf;
+    if ([image decodePyramid]) {
+      dispatch_async(dispatch_get_main_queue(), ^{
+        // Views redraw when the drawing contents change. The pixels are what changed.
+        [image willChangeValueForKey:SKTGraphicDrawingContentsKey];
+        [image didChangeValueForKey:SKTGraphicDrawingContentsKey];
+      });
+    }
+  });
+  return nil;
+}
+
+- (BOOL)isDecoding {
+  @synchronized(self) {
+    return _isDecoding;
+  }
+}
+
+- (void)discardDecodedImage {
+  @synchronized(self) {
+    _pyramid = nil;
+    _cacheToken = nil;
+  }
+}
+
+#pragma mark - SVG
+
+// The image's own encoded bytes if it has them. Otherwise a PNG of it, made once per distinct image.
+- (NSData *)encodedDataReturningType:(NSString **)outType {
+  @synchronized(self) {
+    if (_encodedData) {
+      *outType = _encodedType;
+      return _encodedData;
+    }
+  }
+  *outType = @"image/png";
+  NSData *contentsData = [self contentsData];
+  if (0 == [contentsData length]) {
+    return nil;
+  }
+  NSMutableData *key = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+  CC_SHA256([contentsData bytes], (CC_LONG)[contentsData length], [key mutableBytes]);
+  NSData *png = [PNGCache() objectForKey:key];
+  if (nil == png) {
+    CGImageRef image = [[self contents] CGImageForProposedRect:NULL context:nil hints:nil];
+    if (NULL == image) {
+      return nil;
+    }
+    png = [[[NSBitmapImageRep alloc] initWithCGImage:image] representationUsingType:NSPNGFileType properties:@{}];
+    if (png) {
+      [PNGCache() setObject:png forKey:key cost:[png length]];
+    }
+  }
+  return png;
+}
+
+- (void)writeImageAsXlinkToWriter:(SKTSVGWriter *)writer {
+  NSString *type = nil;
+  NSData *data = [self encodedDataReturningType:&type];
+  if (data) {
+    [writer writeUTF8:"xlink:href=\"data:"];
+    [writer writeString:type];
+    [writer writeUTF8:";base64,"];
+    [writer writeBase64Data:data];
+    [writer writeUTF8:"\""];
+  }
+}
+
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [self writeSVGToWriter:writer verb:"image"];
+}
+
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"x=\""];
+  [writer writeFloat:self.bounds.origin.x];
+  [writer writeUTF8:"\" y=\""];
+  [writer writeFloat:self.bounds.origin.y];
+  [writer writeUTF8:"\" width=\""];
+  [writer writeFloat:self.bounds.size.width];
+  [writer writeUTF8:"\" height=\""];
+  [writer writeFloat:self.bounds.size.height];
+  [writer writeUTF8:"\" "];
+  [self writeImageAsXlinkToWriter:writer];
+  [writer writeUTF8:" "];
+  [super writeSVGAttributesToWriter:writer];
 }
 
 
@@ -203,21 +506,38 @@ NSString *SKTImageContentsKey = @"contents";
   [transform translateXBy:(_isFlippedHorizontally ? bounds.size.width : 0.0f) yBy:(_isFlippedVertically ? bounds.size.height : 0.0f)];
   [transform scaleXBy:(_isFlippedHorizontally ? -1.0f : 1.0f) yBy:(_isFlippedVertically ? -1.0f : 1.0f)];
 
+  // On screen, don't hold up drawing to decode: show where the image will be until it's ready. Printing and exporting need the image now.
+  NSGraphicsContext *currentContext = [NSGraphicsContext currentContext];
+  SKTImagePyramid *pyramid = [self pyramidDecodingSynchronously:(nil == view || ! [currentContext isDrawingToScreen])];
+  if (nil == pyramid) {
+    if ([self isDecoding]) {
+      [[NSColor colorWithCalibratedWhite:0.9 alpha:1] set];
+      NSRectFillUsingOperation(bounds, NSCompositeSourceOver);
+    }
+    return;
+  }
+
   // Scaling to actually size the image (as opposed to scaling as part of flipping).
-  NSSize contentsSize = [_contents size];
+  NSSize contentsSize = [pyramid size];
   [transform scaleXBy:(bounds.size.width / contentsSize.width) yBy:(bounds.size.height / contentsSize.height)];
 
-  // Flipping to accomodate -[NSImage drawAtPoint:fromRect:operation:fraction:]'s odd behavior.
-  if ([view isFlipped]) {
+  // Flipping, since CGContextDrawImage() draws right way up only in an unflipped context. Ask the context, not the view: raster export draws into flipped contexts with no view at all.
+  if ([currentContext isFlipped]) {
     [transform translateXBy:0.0f yBy:contentsSize.height];
     [transform scaleXBy:1.0f yBy:-1.0f];
   }
 
+  // The level to draw is the smallest that still has a pixel for every device pixel the bounds cover at the current zoom.
+  CGContextRef context = (CGContextRef)[currentContext graphicsPort];
+  CGSize pixelSize = CGSizeApplyAffineTransform(NSSizeToCGSize(bounds.size), CGContextGetCTM(context));
+  pixelSize = CGSizeMake(fabs(pixelSize.width), fabs(pixelSize.height));
+
   // Do the actual drawing, saving and restoring the graphics state so as not to interfere with the drawing of selection handles or anything else in the same view.
-  [[NSGraphicsContext currentContext] saveGraphicsState];
+  [currentContext saveGraphicsState];
   [transform concat];
-  [_contents drawAtPoint:NSZeroPoint fromRect:NSMakeRect(0.0f, 0.0f, contentsSize.width, contentsSize.height) operation:NSCompositeSourceOver fraction:1.0f];
-  [[NSGraphicsContext currentContext] restoreGraphicsState];
+  CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+  CGContextDrawImage(context, CGRectMake(0, 0, contentsSize.width, contentsSize.height), [pyramid levelForPixelSize:pixelSize]);
+  [currentContext restoreGraphicsState];
 
 }
 
@@ -257,7 +577,7 @@ NSString *SKTImageContentsKey = @"contents";
 
   // Return the image to its natural size and stop flipping it.
   NSRect bounds = [self bounds];
-  bounds.size = [_contents size];
+  bounds.size = [[self contents] size];
   [self setBounds:bounds];
   [self setFlippedHorizontally:NO];
   [self setFlippedVertically:NO];
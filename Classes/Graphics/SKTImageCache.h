@@ -0,0 +1,55 @@
+/*  SKTImageCache.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+// The user default for SKTImageCache's byteLimit, in megabytes.
+extern NSString *const SKTImageCacheMegabytesKey;
+
+// An image decoded to pixels, then halved again and again, so drawing can use the level nearest the size it's drawn
+// at rather than resample the full size pixels every time. Immutable once made, so any thread may draw it.
+@interface SKTImagePyramid : NSObject
+
+// Decodes on the calling thread. Returns nil if image has no pixels.
+- (instancetype)initWithImage:(NSImage *)image;
+
+// The size of the image it was made from, in points.
+@property(nonatomic, readonly) NSSize size;
+
+// Of all the levels.
+@property(nonatomic, readonly) NSUInteger byteCount;
+
+@property(nonatomic, readonly) NSUInteger levelCount;
+
+// The smallest level at least pixelSize both ways, or the full size level if none is that big. Lives as long as the
+// pyramid does.
+- (CGImageRef)levelForPixelSize:(CGSize)pixelSize CF_RETURNS_NOT_RETAINED;
+
+@end
+
+@protocol SKTImageCacheClient <NSObject>
+// Let go of the decoded pixels. Called on any thread, but never with the cache locked, so it may call the cache.
+- (void)discardDecodedImage;
+@end
+
+// Keeps count of the bytes of every client's decoded pixels. Past the limit, the clients whose pixels were least
+// recently drawn are asked to let them go, until the rest fit. The most recently drawn always stays.
+@interface SKTImageCache : NSObject
+
++ (SKTImageCache *)sharedCache;
+
+// Default: the SKTImageCacheMegabytesKey user default, or 256 MB.
+@property NSUInteger byteLimit;
+
+@property(readonly) NSUInteger byteCount;
+
+// Returns a token for the entry, for the other methods. Holds client weakly.
+- (id)addClient:(id<SKTImageCacheClient>)client byteCount:(NSUInteger)byteCount;
+
+// Marks the entry most recently used.
+- (void)touch:(id)token;
+
+- (void)remove:(id)token;
+
+@end
@@ -0,0 +1,215 @@
+/*  SKTImageCache.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTImageCache.h"
+
+NSString *const SKTImageCacheMegabytesKey = @"SKTImageCacheMegabytes";
+
+enum {
+  // A pyramid stops halving once its next level would be smaller than this both ways.
+  kMinLevelSide = 64,
+
+  kDefaultMegabytes = 256,
+};
+
+static CGContextRef CreateBitmapContext(size_t width, size_t height) {
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+  CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+  CGColorSpaceRelease(colorSpace);
+  return context;
+}
+
+@interface SKTImagePyramid () {
+  // Of CGImageRefs, full size first.
+  NSArray *_levels;
+}
+@end
+
+@implementation SKTImagePyramid
+
+- (instancetype)initWithImage:(NSImage *)image {
+  self = [super init];
+  if (self) {
+    _size = [image size];
+
+    // The image's own pixel size: that of its biggest bitmap, or its size in points if it has no bitmap, a PDF say.
+    NSInteger pixelsWide = 0;
+    NSInteger pixelsHigh = 0;
+    for (NSImageRep *rep in [image representations]) {
+      if (pixelsWide * pixelsHigh < [rep pixelsWide] * [rep pixelsHigh]) {
+        pixelsWide = [rep pixelsWide];
+        pixelsHigh = [rep pixelsHigh];
+      }
+    }
+    if (pixelsWide <= 0 || pixelsHigh <= 0) {
+      pixelsWide = (NSInteger)ceil(_size.width);
+      pixelsHigh = (NSInteger)ceil(_size.height);
+    }
+    CGContextRef context = (0 < pixelsWide && 0 < pixelsHigh) ? CreateBitmapContext((size_t)pixelsWide, (size_t)pixelsHigh) : NULL;
+    if (NULL == context) {
+      return nil;
+    }
+    NSGraphicsContext *graphicsContext = [NSGraphicsContext graphicsContextWithCGContext:context flipped:NO];
+    [NSGraphicsContext saveGraphicsState];
+    [NSGraphicsContext setCurrentContext:graphicsContext];
+    [image drawInRect:NSMakeRect(0, 0, pixelsWide, pixelsHigh) fromRect:NSZeroRect operation:NSCompositeCopy fraction:1];
+    [NSGraphicsContext restoreGraphicsState];
+    CGImageRef level = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+
+    NSMutableArray *levels = [NSMutableArray array];
+    while (level) {
+      [levels addObject:(__bridge_transfer id)level];
+      size_t width = CGImageGetWidth(level);
+      size_t height = CGImageGetHeight(level);
+      _byteCount += CGImageGetBytesPerRow(level) * height;
+      if (width / 2 < kMinLevelSide && height / 2 < kMinLevelSide) {
+        break;
+      }
+      width = MAX(width / 2, 1);
+      height = MAX(height / 2, 1);
+      context = CreateBitmapContext(width, height);
+      if (NULL == context) {
+        break;
+      }
+      CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+      CGContextSetBlendMode(context, kCGBlendModeCopy);
+      CGContextDrawImage(context, CGRectMake(0, 0, width, height), level);
+      level = CGBitmapContextCreateImage(context);
+      CGContextRelease(context);
+    }
+    if (0 == [levels count]) {
+      return nil;
+    }
+    _levels = levels;
+  }
+  return self;
+}
+
+- (NSUInteger)levelCount {
+  return [_levels count];
+}
+
+- (CGImageRef)levelForPixelSize:(CGSize)pixelSize {
+  for (NSUInteger i = [_levels count]; 0 < i--;) {
+    CGImageRef level = (__bridge CGImageRef)_levels[i];
+    if (pixelSize.width <= CGImageGetWidth(level) && pixelSize.height <= CGImageGetHeight(level)) {
+      return level;
+    }
+  }
+  return (__bridge CGImageRef)_levels[0];
+}
+
+@end
+
+@interface SKTImageCacheEntry : NSObject {
+ @public
+  __weak id<SKTImageCacheClient> _client;
+  NSUInteger _byteCount;
+}
+@end
+
+@implementation SKTImageCacheEntry
+@end
+
+@interface SKTImageCache () {
+  // Least recently drawn first.
+  NSMutableOrderedSet<SKTImageCacheEntry *> *_entries;
+  NSUInteger _byteLimit;
+  NSUInteger _byteCount;
+}
+@end
+
+@implementation SKTImageCache
+
++ (SKTImageCache *)sharedCache {
+  static SKTImageCache *sSharedCache;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    sSharedCache = [[SKTImageCache alloc] init];
+  });
+  return sSharedCache;
+}
+
+- (instancetype)init {
+  self = [super init];
+  if (self) {
+    _entries = [NSMutableOrderedSet orderedSet];
+    NSInteger megabytes = [[NSUserDefaults standardUserDefaults] integerForKey:SKTImageCacheMegabytesKey];
+    _byteLimit = (NSUInteger)(0 < megabytes ? megabytes : kDefaultMegabytes) * 1024 * 1024;
+  }
+  return self;
+}
+
+- (NSUInteger)byteLimit {
+  @synchronized(self) {
+    return _byteLimit;
+  }
+}
+
+- (void)setByteLimit:(NSUInteger)byteLimit {
+  @synchronized(self) {
+    _byteLimit = byteLimit;
+  }
+  [self evict];
+}
+
+- (NSUInteger)byteCount {
+  @synchronized(self) {
+    return _byteCount;
+  }
+}
+
+- (id)addClient:(id<SKTImageCacheClient>)client byteCount:(NSUInteger)byteCount {
+  SKTImageCacheEntry *entry = [[SKTImageCacheEntry alloc] init];
+  entry->_client = client;
+  entry->_byteCount = byteCount;
+  @synchronized(self) {
+    [_entries addObject:entry];
+    _byteCount += byteCount;
+  }
+  [self evict];
+  return entry;
+}
+
+- (void)touch:(id)token {
+  SKTImageCacheEntry *entry = token;
+  @synchronized(self) {
+    if ([_entries lastObject] != entry && [_entries containsObject:entry]) {
+      [_entries removeObject:entry];
+      [_entries addObject:entry];
+    }
+  }
+}
+
+- (void)remove:(id)token {
+  SKTImageCacheEntry *entry = token;
+  @synchronized(self) {
+    if ([_entries containsObject:entry]) {
+      [_entries removeObject:entry];
+      _byteCount -= entry->_byteCount;
+    }
+  }
+}
+
+// The clients are told outside the lock, since they'll likely call -remove: or -addClient:byteCount: themselves.
+- (void)evict {
+  NSMutableArray *victims = [NSMutableArray array];
+  @synchronized(self) {
+    while (_byteLimit < _byteCount && 1 < [_entries count]) {
+      SKTImageCacheEntry *entry = [_entries firstObject];
+      [_entries removeObjectAtIndex:0];
+      _byteCount -= entry->_byteCount;
+      id<SKTImageCacheClient> client = entry->_client;
+      if (client) {
+        [victims addObject:client];
+      }
+    }
+  }
+  for (id<SKTImageCacheClient> client in victims) {
+    [client discardDecodedImage];
+  }
+}
+
+@end
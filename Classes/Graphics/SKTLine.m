@@ -11,6 +11,9 @@
 
 #import "SKTLine.h"
 
+#import "SKTNativeFormat.h"
+#import "SKTSVGWriter.h"
+
 
 // String constants declared in the header. They may not be used by any other class in the project, but it's a good idea to provide and use them, if only to help prevent typos in source code.
 NSString *SKTLineBeginPointKey = @"beginPoint";
@@ -39,15 +42,21 @@ enum {
   return copy;
 }
 
-- (NSString *)asSVGString {
-  return [self asSVGStringVerb:@"line"];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [self writeSVGToWriter:writer verb:"line"];
 }
 
-- (NSString *)svgAttributesString {
-  return [NSString stringWithFormat:@"x1=\"%.5g\" y1=\"%.5g\" x2=\"%.5g\" y2=\"%.5g\" %@",
-    self.beginPoint.x, self.beginPoint.y,
-    self.endPoint.x, self.endPoint.y,
-    [super svgAttributesString]];
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"x1=\""];
+  [writer writeFloat:self.beginPoint.x];
+  [writer writeUTF8:"\" y1=\""];
+  [writer writeFloat:self.beginPoint.y];
+  [writer writeUTF8:"\" x2=\""];
+  [writer writeFloat:self.endPoint.x];
+  [writer writeUTF8:"\" y2=\""];
+  [writer writeFloat:self.endPoint.y];
+  [writer writeUTF8:"\" "];
+  [super writeSVGAttributesToWriter:writer];
 }
 
 
@@ -158,6 +167,27 @@ enum {
 }
 
 
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+
+  // As with the property list format, the begin and end points are what place the line, not the bounds.
+  self = [super initWithNativeDecoder:decoder];
+  if (self) {
+    NSPoint beginPoint = [decoder readPoint];
+    NSPoint endPoint = [decoder readPoint];
+    [self setBounds:[[self class] boundsWithBeginPoint:beginPoint endPoint:endPoint pointsRight:&_pointsRight down:&_pointsDown]];
+  }
+  return self;
+
+}
+
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [super writeNativeToWriter:writer];
+  [writer writePoint:[self beginPoint]];
+  [writer writePoint:[self endPoint]];
+}
+
+
 // We don't bother overriding +[SKTGraphic keyPathsForValuesAffectingDrawingBounds] because we don't need to take advantage of the KVO dependency mechanism enabled by that method. We fulfill our KVO compliance obligations (inherited from SKTGraphic) for SKTGraphicDrawingBoundsKey by just always invoking -setBounds: in -setBeginPoint: and -setEndPoint:. "bounds" is always in the set returned by +[SKTGraphic keyPathsForValuesAffectingDrawingBounds]. Now, there's nothing in SKTGraphic.h that actually guarantees that, so we're taking advantage of "undefined" behavior. If we didn't have the source to SKTGraphic right next to the source for this class it would probably be prudent to override +keyPathsForValuesAffectingDrawingBounds, and make sure.
 
 // We don't bother overriding +[SKTGraphic keyPathsForValuesAffectingDrawingContents] because this class doesn't define any properties that affect drawing without affecting the bounds.
@@ -268,6 +298,14 @@ enum {
 }
 
 
+- (void)applyTransform:(CGAffineTransform)transform {
+  // A line is just its two points, so transform them exactly, and set them together like -setBeginPoint: does.
+  NSPoint beginPoint = CGPointApplyAffineTransform([self beginPoint], transform);
+  NSPoint endPoint = CGPointApplyAffineTransform([self endPoint], transform);
+  [self setBounds:[[self class] boundsWithBeginPoint:beginPoint endPoint:endPoint pointsRight:&_pointsRight down:&_pointsDown]];
+}
+
+
 - (void)setColor:(NSColor *)color {
   // Because lines aren't filled we'll consider the stroke's color to be the one.
   [self setValue:color forKey:SKTGraphicStrokeColorKey];
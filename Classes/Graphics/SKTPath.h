@@ -8,7 +8,7 @@
 
 extern NSString *const SKTPathString;
 
-// Represents an SVG path. Basically an array of path atoms.
+// Represents an SVG path. Basically an array of path atoms, stored packed as verbs and coordinates.
 @interface SKTPath : SKTGraphic
 
 @property (NS_NONATOMIC_IOSONLY, getter = isClosed) BOOL closed;
@@ -23,3 +23,9 @@ extern NSString *const SKTPathString;
 - (void)replacePathAtomAtIndexes:(NSIndexSet *)indexes withPathAtom:(NSArray<SKTPathAtom *> *)objects;
 
 @end
+
+#if DEBUG
+// Measure malloc'd bytes per segment of a segmentCount line segment path, held as one SKTPathAtom per segment
+// against the packed SKTPath. Logs the result.
+void SKTPathMemoryBenchmark(NSUInteger segmentCount);
+#endif
@@ -5,24 +5,54 @@
 #import "SKTPath.h"
 
 #import "NSColor_SKT.h"
+#import "SKTAffineTransform.h"
+#import "SKTHitTest.h"
+#import "SKTNativeFormat.h"
 #import "SKTPathAtom.h"
-#import "SKTPathScanner.h"
+#import "SKTPathTokenizer.h"
+#import "SKTSVGWriter.h"
+
+#if DEBUG
+#include <malloc/malloc.h>
+#endif
 
 NSString *const SKTPathString = @"pathString";
 
-@interface SKTPath()
-@property(nonatomic) NSMutableArray *atoms;
+// The finest a path is flattened for hit testing, in its own units, however small the tolerance.
+static const CGFloat kMinimumHitTestFlatness = 0.01;
+
+@interface SKTPath() {
+  // The segments, packed: a verb each, and their coordinates back to back (see SKTPathVerb). SKTPathAtoms are
+  // only made on demand, for scripting and undo.
+  SKTPathVerb *_verbs;
+  NSUInteger _verbCount;
+  NSUInteger _verbCapacity;
+  CGFloat *_coords;
+  NSUInteger _coordCount;
+  NSUInteger _coordCapacity;
+
+  // For hit testing, and the updateCount and bounds it was flattened at.
+  SKTFlattenedPath *_flattenedPath;
+  NSUInteger _flattenedPathUpdateCount;
+  CGRect _flattenedPathBounds;
+}
 @end
 
 @implementation SKTPath
 
+- (void)dealloc {
+  free(_verbs);
+  free(_coords);
+}
+
 - (instancetype)initWithProperties:(NSDictionary *)properties {
   self = [super initWithProperties:properties];
   if (self) {
     _closed = [properties[SKTGraphicClosed] boolValue];
     NSString *s = properties[SKTPathString];
     if ([s respondsToSelector:@selector(characterAtIndex:)]) {
-      _atoms = [SKTPath stringToPathAtoms:s];
+      [self removeAllSegments];
+      [self appendSegmentsFromString:s];
       CGRect bounds = [self computeBounds];
       if (CGRectIsEmpty(bounds)) {
         return nil;
@@ -40,26 +70,190 @@ NSString *const SKTPathString = @"pathString";
   if (_closed) {
     [result setClosed:YES];
   }
-  NSMutableArray *atomsCopy = [[self atoms] mutableCopyWithZone:zone];
-  NSUInteger count = [atomsCopy count];
-  for (NSUInteger i = 0; i < count; ++i) {
-    atomsCopy[i] = [atomsCopy[i] copyWithZone:zone];
+  [result setVerbs:_verbs count:_verbCount coords:_coords count:_coordCount];
+  return result;
+}
+
+#pragma mark - Segment buffers
+
+// Grow, never shrink, the buffers to hold at least verbCapacity verbs and coordCapacity coordinates.
+- (void)reserveVerbCapacity:(NSUInteger)verbCapacity coordCapacity:(NSUInteger)coordCapacity {
+  if (_verbCapacity < verbCapacity) {
+    NSUInteger newCapacity = _verbCapacity ? _verbCapacity : 8;
+    while (newCapacity < verbCapacity) {
+      newCapacity *= 2;
+    }
+    SKTPathVerb *verbs = realloc(_verbs, newCapacity * sizeof(SKTPathVerb));
+    if (NULL == verbs) {
+      [NSException raise:NSMallocException format:@"Could not allocate %lu path verbs.", (unsigned long)newCapacity];
+    }
+    _verbs = verbs;
+    _verbCapacity = newCapacity;
+  }
+  if (_coordCapacity < coordCapacity) {
+    NSUInteger newCapacity = _coordCapacity ? _coordCapacity : 16;
+    while (newCapacity < coordCapacity) {
+      newCapacity *= 2;
+    }
+    CGFloat *coords = realloc(_coords, newCapacity * sizeof(CGFloat));
+    if (NULL == coords) {
+      [NSException raise:NSMallocException format:@"Could not allocate %lu path coordinates.", (unsigned long)newCapacity];
+    }
+    _coords = coords;
+    _coordCapacity = newCapacity;
+  }
+}
+
+- (void)appendSegment:(SKTPathVerb)verb coords:(const CGFloat *)coords {
+  NSUInteger coordCount = SKTPathVerbCoordCount(verb);
+  [self reserveVerbCapacity:_verbCount + 1 coordCapacity:_coordCount + coordCount];
+  _verbs[_verbCount++] = verb;
+  if (coordCount) {
+    memcpy(_coords + _coordCount, coords, coordCount * sizeof(CGFloat));
+    _coordCount += coordCount;
+  }
+}
+
+// Keeps the buffers, so a later parse doesn't take the interactive creation path in -setBounds:.
+- (void)removeAllSegments {
+  [self reserveVerbCapacity:1 coordCapacity:1];
+  _verbCount = 0;
+  _coordCount = 0;
+  [self invalidateBezierPathCache];
+}
+
+- (void)setVerbs:(const SKTPathVerb *)verbs count:(NSUInteger)verbCount coords:(const CGFloat *)coords count:(NSUInteger)coordCount {
+  [self reserveVerbCapacity:MAX(verbCount, 1) coordCapacity:MAX(coordCount, 1)];
+  memcpy(_verbs, verbs, verbCount * sizeof(SKTPathVerb));
+  memcpy(_coords, coords, coordCount * sizeof(CGFloat));
+  _verbCount = verbCount;
+  _coordCount = coordCount;
+  [self invalidateBezierPathCache];
+}
+
+// Parsing doubles the buffers as it goes. Big paths are usually read once and then left alone, so give back the slack.
+- (void)trimSegmentCapacity {
+  if (8 < _verbCount && _verbCount < _verbCapacity) {
+    SKTPathVerb *verbs = realloc(_verbs, _verbCount * sizeof(SKTPathVerb));
+    if (verbs) {
+      _verbs = verbs;
+      _verbCapacity = _verbCount;
+    }
+  }
+  if (16 < _coordCount && _coordCount < _coordCapacity) {
+    CGFloat *coords = realloc(_coords, _coordCount * sizeof(CGFloat));
+    if (coords) {
+      _coords = coords;
+      _coordCapacity = _coordCount;
+    }
+  }
+}
+
+- (void)checkSegmentIndexes:(NSIndexSet *)indexes count:(NSUInteger)count {
+  if ([indexes count] && count <= [indexes lastIndex]) {
+    [NSException raise:NSRangeException format:@"Index %lu beyond %lu path atoms.", (unsigned long)[indexes lastIndex], (unsigned long)count];
+  }
+}
+
+// Atoms for the segments at indexes, not yet attached to self for scripting.
+- (NSMutableArray<SKTPathAtom *> *)makeAtomsAtIndexes:(NSIndexSet *)indexes {
+  [self checkSegmentIndexes:indexes count:_verbCount];
+  NSMutableArray *result = [NSMutableArray arrayWithCapacity:[indexes count]];
+  const CGFloat *coords = _coords;
+  NSUInteger i = 0;
+  for (NSUInteger wanted = [indexes firstIndex]; NSNotFound != wanted; wanted = [indexes indexGreaterThanIndex:wanted]) {
+    for (; i < wanted; ++i) {
+      coords += SKTPathVerbCoordCount(_verbs[i]);
+    }
+    [result addObject:[SKTPathAtom pathAtomWithVerb:_verbs[i] coords:coords]];
   }
-  [result setAtoms:atomsCopy];
   return result;
 }
 
+- (void)removeSegmentsAtIndexes:(NSIndexSet *)indexes {
+  [self checkSegmentIndexes:indexes count:_verbCount];
+  NSUInteger verbTo = 0;
+  NSUInteger coordTo = 0;
+  NSUInteger coordFrom = 0;
+  for (NSUInteger verbFrom = 0; verbFrom < _verbCount; ++verbFrom) {
+    SKTPathVerb verb = _verbs[verbFrom];
+    NSUInteger coordCount = SKTPathVerbCoordCount(verb);
+    if ( ! [indexes containsIndex:verbFrom]) {
+      _verbs[verbTo++] = verb;
+      memmove(_coords + coordTo, _coords + coordFrom, coordCount * sizeof(CGFloat));
+      coordTo += coordCount;
+    }
+    coordFrom += coordCount;
+  }
+  _verbCount = verbTo;
+  _coordCount = coordTo;
+  [self invalidateBezierPathCache];
+}
+
+// Matches NSMutableArray's -insertObjects:atIndexes:, so each atom's segment ends up at the corresponding index.
+// Segments vary in length, so merge into new buffers rather than shuffling in place.
+- (void)insertSegmentsFromAtoms:(NSArray<SKTPathAtom *> *)atoms atIndexes:(NSIndexSet *)indexes {
+  NSUInteger insertCount = [indexes count];
+  NSUInteger newVerbCount = _verbCount + insertCount;
+  [self checkSegmentIndexes:indexes count:newVerbCount];
+  NSUInteger newCoordCount = _coordCount;
+  for (SKTPathAtom *atom in atoms) {
+    newCoordCount += SKTPathVerbCoordCount([atom verb]);
+  }
+  SKTPathVerb *verbs = malloc(MAX(newVerbCount, 1) * sizeof(SKTPathVerb));
+  CGFloat *coords = malloc(MAX(newCoordCount, 1) * sizeof(CGFloat));
+  if (NULL == verbs || NULL == coords) {
+    free(verbs);
+    free(coords);
+    [NSException raise:NSMallocException format:@"Could not allocate %lu path verbs.", (unsigned long)newVerbCount];
+  }
+  NSUInteger k = 0;
+  NSUInteger verbFrom = 0;
+  NSUInteger coordFrom = 0;
+  NSUInteger coordTo = 0;
+  for (NSUInteger to = 0; to < newVerbCount; ++to) {
+    if ([indexes containsIndex:to]) {
+      SKTPathAtom *atom = atoms[k++];
+      verbs[to] = [atom verb];
+      [atom getCoords:coords + coordTo];
+      coordTo += SKTPathVerbCoordCount(verbs[to]);
+    } else {
+      SKTPathVerb verb = _verbs[verbFrom++];
+      NSUInteger coordCount = SKTPathVerbCoordCount(verb);
+      verbs[to] = verb;
+      memcpy(coords + coordTo, _coords + coordFrom, coordCount * sizeof(CGFloat));
+      coordFrom += coordCount;
+      coordTo += coordCount;
+    }
+  }
+  free(_verbs);
+  free(_coords);
+  _verbs = verbs;
+  _coords = coords;
+  _verbCount = _verbCapacity = newVerbCount;
+  _coordCount = _coordCapacity = newCoordCount;
+  [self invalidateBezierPathCache];
+}
+
+#pragma mark -
+
+// The bounds of the path as drawn. Curves only count out to their extrema, so this can be much smaller than the
+// box around the control points, and so are the areas redrawn and hit-tested.
 - (CGRect)computeBounds {
   CGPoint minP;
   CGPoint maxP;
   BOOL didInit = NO;
-  for (SKTPathAtom *pA in _atoms) {
-    if (pA.hasPointValue) {
+  CGPoint position = (0 < _verbCount) ? SKTPathSegmentPoint(_verbs[0], _coords) : CGPointZero;
+  const CGFloat *coords = _coords;
+  for (NSUInteger i = 0; i < _verbCount; coords += SKTPathVerbCoordCount(_verbs[i]), ++i) {
+    SKTPathVerb verb = _verbs[i];
+    if (SKTPathSegmentHasPoint(verb)) {
+      MinMaxPt minMaxPt = SKTPathSegmentMinMax(verb, coords, position);
       if ( ! didInit) {
-        maxP = minP = [pA pointValue];
+        minP = minMaxPt.min;
+        maxP = minMaxPt.max;
         didInit = YES;
       } else {
-        MinMaxPt minMaxPt = [pA minMax];
         if (minMaxPt.min.x < minP.x) {
           minP.x = minMaxPt.min.x;
         }
@@ -74,6 +268,7 @@ NSString *const SKTPathString = @"pathString";
         }
       }
     }
+    position = SKTPathSegmentEndPoint(verb, coords, position);
   }
   if ( ! didInit) {
     return CGRectZero;
@@ -82,13 +277,20 @@ NSString *const SKTPathString = @"pathString";
 }
 
 - (NSBezierPath *)bezierPathForDrawing {
+  return [self cachedBezierPath:^{
+    return [self makeBezierPathForDrawing];
+  }];
+}
+
+- (NSBezierPath *)makeBezierPathForDrawing {
   NSBezierPath *path = nil;
-  NSUInteger count = [_atoms count];
-  if (2 <= count) {
+  if (2 <= _verbCount) {
 		CGPoint position = CGPointZero;
     path = [NSBezierPath bezierPath];
-    for (SKTPathAtom *atom in _atoms) {
-      [atom appendToPath:path nowAt:&position];
+    const CGFloat *coords = _coords;
+    for (NSUInteger i = 0; i < _verbCount; ++i) {
+      SKTPathSegmentAppendToPath(_verbs[i], coords, path, &position);
+      coords += SKTPathVerbCoordCount(_verbs[i]);
     }
     if ([self isClosed]) {
       [path closePath];
@@ -100,44 +302,72 @@ NSString *const SKTPathString = @"pathString";
 
 - (void)setBounds:(CGRect)bounds {
   [super setBounds:bounds];
-  if (0.001 <= bounds.size.width && 0.001 <= bounds.size.height && nil == _atoms) {
+  if (0.001 <= bounds.size.width && 0.001 <= bounds.size.height && NULL == _verbs) {
     // Assme we're creating interactively.
     CGPoint p1 = CGPointMake(bounds.origin.x, bounds.origin.y + bounds.size.height);
     CGPoint p2 = CGPointMake(bounds.origin.x + bounds.size.width/2, bounds.origin.y);
     CGPoint p3 = CGPointMake(bounds.origin.x + bounds.size.width, bounds.origin.y + bounds.size.height);
-    _atoms = [@[ [SKTPathAtom pathAtomWithPt:p1], [SKTPathAtom pathAtomWithPt:p2], [SKTPathAtom pathAtomWithPt:p3] ] mutableCopy];
+    [self appendSegment:SKTPathVerbMove coords:(const CGFloat[]){p1.x, p1.y}];
+    [self appendSegment:SKTPathVerbLine coords:(const CGFloat[]){p2.x, p2.y}];
+    [self appendSegment:SKTPathVerbLine coords:(const CGFloat[]){p3.x, p3.y}];
     _closed = YES;
   }
   CGRect oldBounds = [self computeBounds];
 
   if ( ! CGRectEqualToRect(bounds, oldBounds)) {
-    CGPoint translate = CGPointMake(bounds.origin.x - oldBounds.origin.x, bounds.origin.y - oldBounds.origin.y);
-    if ( ! CGPointEqualToPoint(CGPointZero, translate)) {
-      for (SKTPathAtom *atom in _atoms) {
-        [atom translateBy:translate];
-      }
-    }
-    CGSize scale = CGSizeMake(bounds.size.width / oldBounds.size.width, bounds.size.height / oldBounds.size.height);
-    if ( ! CGSizeEqualToSize(CGSizeMake(1,1), scale)) {
-      for (SKTPathAtom *atom in _atoms) {
-        [atom scale:scale relativeToOrigin:bounds.origin];
-      }
-    }
+    [self transformSegments:SKTTransformMappingRect(oldBounds, bounds)];
   }
 }
 
 - (void)flipHorizontally {
-  CGRect bounds = [self bounds];
-  for (SKTPathAtom *atom in _atoms) {
-    [atom flipHorizontallyRelatveToBounds:bounds];
-  }
+  [self transformSegments:SKTTransformFlipHorizontallyInRect([self bounds])];
 }
 
 - (void)flipVertically {
-  CGRect bounds = [self bounds];
-  for (SKTPathAtom *atom in _atoms) {
-    [atom flipVerticallyRelatveToBounds:bounds];
+  [self transformSegments:SKTTransformFlipVerticallyInRect([self bounds])];
+}
+
+- (void)applyTransform:(CGAffineTransform)transform {
+  [self transformSegments:transform];
+  [self updateBounds];
+}
+
+// Only arcs have coordinates that aren't points, so the coordinates of the segments between arcs go to the kernel
+// a run at a time. Most paths have no arcs at all, and are a single run.
+- (void)transformSegments:(CGAffineTransform)transform {
+  if (0 == _verbCount || NULL == memchr(_verbs, SKTPathVerbArc, _verbCount)) {
+    SKTTransformPoints(transform, _coords, _coordCount / 2);
+  } else {
+    CGFloat *runStart = _coords;
+    CGFloat *coords = _coords;
+    for (NSUInteger i = 0; i < _verbCount; ++i) {
+      SKTPathVerb verb = _verbs[i];
+      NSUInteger coordCount = SKTPathVerbCoordCount(verb);
+      if ( ! SKTPathVerbIsAllPoints(verb)) {
+        SKTTransformPoints(transform, runStart, (NSUInteger)(coords - runStart) / 2);
+        SKTPathSegmentApplyTransform(verb, coords, transform);
+        runStart = coords + coordCount;
+      }
+      coords += coordCount;
+    }
+    SKTTransformPoints(transform, runStart, (NSUInteger)(coords - runStart) / 2);
+  }
+  [self invalidateBezierPathCache];
+}
+
+// An override of the NSObject(NSKeyValueObservingCustomization) method. -setClosed: notifies by hand, as SKTGraphic's setters do, so the change bus hears about it.
++ (BOOL)automaticallyNotifiesObserversForKey:(NSString *)key {
+  if ([key isEqualToString:SKTGraphicClosed]) {
+    return NO;
   }
+  return [super automaticallyNotifiesObserversForKey:key];
+}
+
+- (void)setClosed:(BOOL)closed {
+  [self willChangeValueForKey:SKTGraphicClosed];
+  _closed = closed;
+  [self invalidateBezierPathCache];
+  [self didChangeValueForKey:SKTGraphicClosed];
 }
 
 - (BOOL)canOpenPolygon {
@@ -158,19 +388,168 @@ NSString *const SKTPathString = @"pathString";
   return [self copy];
 }
 
+#pragma mark - Simplifying
+
+static void AppendSegment(NSMutableData *verbs, NSMutableData *coords, SKTPathVerb verb, const CGFloat *segmentCoords) {
+  [verbs appendBytes:&verb length:sizeof(verb)];
+  [coords appendBytes:segmentCoords length:SKTPathVerbCoordCount(verb) * sizeof(CGFloat)];
+}
+
+// Append the line segments through the run of points, the first of which is where the run starts from, simplified.
+// Returns how far the simplified run may be from the original. Overwrites the run.
+static CGFloat AppendSimplifiedRun(CGPoint *run, NSUInteger runCount, SKTSimplifyMethod method, CGFloat tolerance, BOOL *keep, NSMutableData *verbs, NSMutableData *coords) {
+  // Curve fitting shares the tolerance between its two passes.
+  if (SKTSimplifyMethodVisvalingamWhyatt == method) {
+    SKTSimplifyVisvalingamWhyatt(run, runCount, tolerance, keep);
+  } else {
+    SKTSimplifyDouglasPeucker(run, runCount, (SKTSimplifyMethodCurveFit == method) ? tolerance / 2 : tolerance, keep);
+  }
+  CGFloat deviation = SKTSimplifyMaxDeviation(run, runCount, keep);
+  if (SKTSimplifyMethodCurveFit != method) {
+    for (NSUInteger i = 1; i < runCount; ++i) {
+      if (keep[i]) {
+        AppendSegment(verbs, coords, SKTPathVerbLine, (const CGFloat *)&run[i]);
+      }
+    }
+    return deviation;
+  }
+  NSUInteger keptCount = 0;
+  for (NSUInteger i = 0; i < runCount; ++i) {
+    if (keep[i]) {
+      run[keptCount++] = run[i];
+    }
+  }
+  deviation += SKTFitCubics(run, keptCount, tolerance / 2, ^(BOOL isLine, CGPoint control1, CGPoint control2, CGPoint end) {
+    if (isLine) {
+      AppendSegment(verbs, coords, SKTPathVerbLine, (const CGFloat *)&end);
+    } else {
+      CGFloat cubic[6] = {control1.x, control1.y, control2.x, control2.y, end.x, end.y};
+      AppendSegment(verbs, coords, SKTPathVerbCubic, cubic);
+    }
+  });
+  return deviation;
+}
+
+// Traced outlines come in as long runs of line segments, so there's something to simplify if there are two in a row.
+- (BOOL)canSimplify {
+  for (NSUInteger i = 1; i < _verbCount; ++i) {
+    if (SKTPathVerbLine == _verbs[i] && SKTPathVerbLine == _verbs[i - 1]) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+// Undoably make the segments the packed verbs and coordinates in the data.
+- (void)replaceAllSegmentsWithVerbs:(NSData *)verbs coords:(NSData *)coords {
+  NSUndoManager *undoManager = [self undoManager];
+  if (undoManager) {
+    [[undoManager prepareWithInvocationTarget:self] replaceAllSegmentsWithVerbs:[NSData dataWithBytes:_verbs length:_verbCount * sizeof(SKTPathVerb)]
+                                                                          coords:[NSData dataWithBytes:_coords length:_coordCount * sizeof(CGFloat)]];
+  }
+  [self setVerbs:[verbs bytes] count:[verbs length] / sizeof(SKTPathVerb) coords:[coords bytes] count:[coords length] / sizeof(CGFloat)];
+  [self updateBounds];
+}
+
+// Simplifies each run of line segments, and keeps every other segment as it is. Counts a segment as a vertex.
+- (SKTSimplifyReport)simplifyWithMethod:(SKTSimplifyMethod)method tolerance:(CGFloat)tolerance {
+  SKTSimplifyReport report = {_verbCount, _verbCount, 0};
+  if ( ! [self canSimplify]) {
+    return report;
+  }
+  NSMutableData *verbs = [NSMutableData dataWithCapacity:_verbCount * sizeof(SKTPathVerb)];
+  NSMutableData *coords = [NSMutableData dataWithCapacity:_coordCount * sizeof(CGFloat)];
+  CGPoint *run = malloc((_verbCount + 1) * sizeof(CGPoint));
+  BOOL *keep = malloc((_verbCount + 1) * sizeof(BOOL));
+  NSUInteger runCount = 0;
+  CGPoint current = CGPointZero;
+  CGPoint subpathStart = CGPointZero;
+  const CGFloat *segmentCoords = _coords;
+  for (NSUInteger i = 0; i < _verbCount; ++i) {
+    SKTPathVerb verb = _verbs[i];
+    if (SKTPathVerbLine == verb) {
+      if (0 == runCount) {
+        run[runCount++] = current;
+      }
+      current = CGPointMake(segmentCoords[0], segmentCoords[1]);
+      run[runCount++] = current;
+      segmentCoords += 2;
+      continue;
+    }
+    if (runCount) {
+      report.maxDeviation = MAX(report.maxDeviation, AppendSimplifiedRun(run, runCount, method, tolerance, keep, verbs, coords));
+      runCount = 0;
+    }
+    AppendSegment(verbs, coords, verb, segmentCoords);
+    if (SKTPathVerbClose == verb) {
+      current = subpathStart;
+    } else {
+      current = SKTPathSegmentEndPoint(verb, segmentCoords, current);
+      if (SKTPathVerbMove == verb) {
+        subpathStart = current;
+      }
+    }
+    segmentCoords += SKTPathVerbCoordCount(verb);
+  }
+  if (runCount) {
+    report.maxDeviation = MAX(report.maxDeviation, AppendSimplifiedRun(run, runCount, method, tolerance, keep, verbs, coords));
+  }
+  free(run);
+  free(keep);
+  report.vertexCount = [verbs length] / sizeof(SKTPathVerb);
+  if (report.vertexCount < _verbCount) {
+    [self replaceAllSegmentsWithVerbs:verbs coords:coords];
+  } else {
+    // Curve fitting may not pay, and a fit that isn't fewer segments isn't simpler.
+    report.vertexCount = _verbCount;
+    report.maxDeviation = 0;
+  }
+  return report;
+}
+
 
 - (BOOL)isContentsUnderPoint:(NSPoint)point {
-  return [[self bezierPathForDrawing] containsPoint:point];
+  return [self isContentsUnderPoint:point tolerance:0];
+}
+
+// Inside, as -[NSBezierPath containsPoint:] would say, or on the stroke if one is drawn, from the flattened segments.
+- (BOOL)isContentsUnderPoint:(NSPoint)point tolerance:(CGFloat)tolerance {
+  if (_verbCount < 2) {
+    return NO;
+  }
+  SKTFlattenedPath *flattenedPath = [self flattenedPathWithFlatness:MAX(tolerance / 4, kMinimumHitTestFlatness)];
+  if ([flattenedPath containsPoint:point windingRule:SKTWindingRuleNonZero]) {
+    return YES;
+  }
+  return [self isDrawingStroke] && [flattenedPath isStrokeWithinDistance:[self strokeWidth] / 2 + tolerance ofPoint:point];
+}
+
+// Kept until the segments change, and reused for any coarser flatness.
+- (SKTFlattenedPath *)flattenedPathWithFlatness:(CGFloat)flatness {
+  NSUInteger updateCount = [self updateCount];
+  CGRect bounds = [self bounds];
+  if (nil == _flattenedPath || flatness < [_flattenedPath flatness] || updateCount != _flattenedPathUpdateCount || ! CGRectEqualToRect(bounds, _flattenedPathBounds)) {
+    _flattenedPath = [[SKTFlattenedPath alloc] initWithVerbs:_verbs count:_verbCount coords:_coords isClosed:[self isClosed] flatness:flatness];
+    _flattenedPathUpdateCount = updateCount;
+    _flattenedPathBounds = bounds;
+  }
+  return _flattenedPath;
 }
 
-- (NSString *)asSVGString {
-  return [self asSVGStringVerb:@"path"];
+- (void)invalidateBezierPathCache {
+  _flattenedPath = nil;
+  [super invalidateBezierPathCache];
 }
 
-- (NSString *)svgAttributesString {
-  return [NSString stringWithFormat:@"d=\"%@\" %@",
-    [self atomsAsString],
-    [super svgAttributesString]];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [self writeSVGToWriter:writer verb:"path"];
+}
+
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"d=\""];
+  [self writeAtomsToWriter:writer];
+  [writer writeUTF8:"\" "];
+  [super writeSVGAttributesToWriter:writer];
 }
 
 /*
@@ -191,14 +570,26 @@ The sweepflag (0 or 1) determines which way the arc goes (underneath or above).
 Z Closepath
  */
 + (NSMutableArray *)stringToPathAtoms:(NSString *)s {
-  NSMutableArray *a = [NSMutableArray array];
-  SKTPathScanner *scanner = [SKTPathScanner scannerWithString:s];
-  unichar verb;
-  NSUInteger argCount;
-  CGFloat args[SKTScannerMaxArgCount];
+  SKTPath *path = [[SKTPath alloc] init];
+  [path appendSegmentsFromString:s];
+  return [path makeAtomsAtIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, path->_verbCount)]];
+}
+
+- (void)appendSegmentsFromString:(NSString *)s {
+  // Tokenize the UTF-8 bytes in place, then append segments from the packed verbs and arguments.
+  const char *bytes = [s UTF8String];
+  if (NULL == bytes) {
+    return;
+  }
+  SKTPathTokens tokens = {0};
+  // A malformed path still gets every segment before the error, as SVG's error handling says it should, so whether
+  // it was all well formed doesn't matter here.
+  SKTPathTokenize(bytes, strlen(bytes), &tokens);
   CGPoint lastPoint = CGPointZero;
   CGPoint lastControlPoint = CGPointZero;
-  while ([scanner getVerb:&verb argCount:&argCount args:args]) {
+  const CGFloat *args = tokens.args;
+  for (NSUInteger verbIndex = 0; verbIndex < tokens.verbCount; args += SKTPathTokenArgCount(tokens.verbs[verbIndex]), ++verbIndex) {
+    char verb = tokens.verbs[verbIndex];
     switch (verb) {
       case 'H':
       case 'h': {
@@ -208,9 +599,7 @@ Z Closepath
         }
 
         lastPoint.x = args[0] + deltaPoint.x;
-        SKTPathLine *at = [[SKTPathLine alloc] init];
-        at.p = lastPoint;
-        [a addObject:at];
+        [self appendSegment:SKTPathVerbLine coords:(const CGFloat[]){lastPoint.x, lastPoint.y}];
         break;
         }
       case 'V':
@@ -220,8 +609,7 @@ Z Closepath
           deltaPoint = lastPoint;
         }
         lastPoint.y = args[0] + deltaPoint.y;
-        SKTPathLine *at = [SKTPathLine pathAtomWithPt:lastPoint];
-        [a addObject:at];
+        [self appendSegment:SKTPathVerbLine coords:(const CGFloat[]){lastPoint.x, lastPoint.y}];
         break;
       }
       case 'L':
@@ -232,8 +620,7 @@ Z Closepath
         }
         lastPoint.x = args[0] + deltaPoint.x;
         lastPoint.y = args[1] + deltaPoint.y;
-        SKTPathLine *at = [SKTPathLine pathAtomWithPt:lastPoint];
-        [a addObject:at];
+        [self appendSegment:SKTPathVerbLine coords:(const CGFloat[]){lastPoint.x, lastPoint.y}];
         break;
       }
       case 'M':
@@ -244,8 +631,7 @@ Z Closepath
         }
         lastPoint.x = args[0] + deltaPoint.x;
         lastPoint.y = args[1] + deltaPoint.y;
-        SKTPathPoint *at = [SKTPathPoint pathAtomWithPt:lastPoint];
-        [a addObject:at];
+        [self appendSegment:SKTPathVerbMove coords:(const CGFloat[]){lastPoint.x, lastPoint.y}];
         break;
       }
       case 'T':
@@ -255,17 +641,15 @@ Z Closepath
           deltaPoint = lastPoint;
         }
         CGPoint p = CGPointMake(deltaPoint.x + args[0], deltaPoint.y + args[1]);
-        SKTPathQuadratic *at = [SKTPathQuadratic pathAtomWithPt:p];
-        at.pControl1 = [self reflect:lastControlPoint about:lastPoint];
+        CGPoint pControl1 = [SKTPath reflect:lastControlPoint about:lastPoint];
+        [self appendSegment:SKTPathVerbQuadratic coords:(const CGFloat[]){pControl1.x, pControl1.y, p.x, p.y}];
         lastPoint = p;
-        lastControlPoint = at.pControl1;
-        [a addObject:at];
+        lastControlPoint = pControl1;
         break;
       }
       case 'Z':
       case 'z': {
-        SKTPathAtom *at = [[SKTPathClosed alloc] init];
-        [a addObject:at];
+        [self appendSegment:SKTPathVerbClose coords:NULL];
         break;
       }
       case 'A':
@@ -276,9 +660,8 @@ Z Closepath
         }
         CGPoint p = CGPointMake(deltaPoint.x + args[5], deltaPoint.y + args[6]);
         if (p.x == p.y) { } // for unused warning.
-        SKTPathArc *at = [[SKTPathArc alloc] init];
-        at.radius = args[0];
-        if (at.radius == args[1]) { // circular arc.
+        CGFloat radius = args[0];
+        if (radius == args[1]) { // circular arc.
           // lastPoint is on the circle. P is on the circle. We know the radius. Find the two centers.
           // Use the boolean parameters to pick which center and which arc.
         } else {  // elliptical arc.
@@ -296,11 +679,10 @@ Z Closepath
           deltaPoint = lastPoint;
         }
         lastPoint = CGPointMake(args[4]+deltaPoint.x, args[5]+deltaPoint.y);
-        SKTPathCubic *at = [SKTPathCubic pathAtomWithPt:lastPoint];
-        at.pControl1 = CGPointMake(args[0]+deltaPoint.x, args[1]+deltaPoint.y);
-        at.pControl2 = CGPointMake(args[2]+deltaPoint.x, args[3]+deltaPoint.y);
-        lastControlPoint = at.pControl2;
-        [a addObject:at];
+        CGPoint pControl1 = CGPointMake(args[0]+deltaPoint.x, args[1]+deltaPoint.y);
+        CGPoint pControl2 = CGPointMake(args[2]+deltaPoint.x, args[3]+deltaPoint.y);
+        [self appendSegment:SKTPathVerbCubic coords:(const CGFloat[]){pControl1.x, pControl1.y, pControl2.x, pControl2.y, lastPoint.x, lastPoint.y}];
+        lastControlPoint = pControl2;
         break;
       }
       case 'Q':
@@ -310,10 +692,8 @@ Z Closepath
           deltaPoint = lastPoint;
         }
         lastPoint = CGPointMake(args[2]+deltaPoint.x, args[3]+deltaPoint.y);
-        SKTPathQuadratic *at = [SKTPathQuadratic pathAtomWithPt:lastPoint];
         lastControlPoint = CGPointMake(args[0]+deltaPoint.x, args[1]+deltaPoint.y);
-        at.pControl1 = lastControlPoint;
-        [a addObject:at];
+        [self appendSegment:SKTPathVerbQuadratic coords:(const CGFloat[]){lastControlPoint.x, lastControlPoint.y, lastPoint.x, lastPoint.y}];
         break;
       }
       case 'S':
@@ -323,12 +703,11 @@ Z Closepath
           deltaPoint = lastPoint;
         }
         CGPoint p = CGPointMake(args[2]+deltaPoint.x, args[3]+deltaPoint.y);
-        SKTPathCubic *at = [SKTPathCubic pathAtomWithPt:p];
-        at.pControl1 = [self reflect:lastControlPoint about:lastPoint];
-        at.pControl2 = CGPointMake(args[0]+deltaPoint.x, args[1]+deltaPoint.y);
-        lastControlPoint = at.pControl2;
+        CGPoint pControl1 = [SKTPath reflect:lastControlPoint about:lastPoint];
+        CGPoint pControl2 = CGPointMake(args[0]+deltaPoint.x, args[1]+deltaPoint.y);
+        [self appendSegment:SKTPathVerbCubic coords:(const CGFloat[]){pControl1.x, pControl1.y, pControl2.x, pControl2.y, p.x, p.y}];
+        lastControlPoint = pControl2;
         lastPoint = p;
-        [a addObject:at];
         break;
       }
       default:
@@ -336,7 +715,9 @@ Z Closepath
         break;
     }
   }
-  return a;
+  SKTPathTokensFree(&tokens);
+  [self trimSegmentCapacity];
+  [self invalidateBezierPathCache];
 }
 
 // reflect point 'target' about 'center'
@@ -361,27 +742,83 @@ Z Closepath
   return properties;
 }
 
-- (NSString *)atomsAsString {
-  NSMutableArray *a = [NSMutableArray array];
-  for (SKTPathAtom *pA in _atoms) {
-    NSString *svg = [pA svgString];
-    [a addObject:svg];
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+  self = [super initWithNativeDecoder:decoder];
+  if (self) {
+    _closed = 0 != [decoder readUInt8];
+    NSUInteger verbCount = [decoder readUInt32];
+    NSUInteger coordCount = [decoder readUInt32];
+    // Check the counts against what's left before allocating for them: the file may be damaged.
+    if (verbCount + coordCount * sizeof(double) <= [decoder remainingLength]) {
+      [self removeAllSegments];
+      [self reserveVerbCapacity:MAX(verbCount, 1) coordCapacity:MAX(coordCount, 1)];
+      [decoder readBytes:_verbs length:verbCount * sizeof(SKTPathVerb)];
+      [decoder readDoubles:_coords count:coordCount];
+      NSUInteger expectedCoordCount = 0;
+      for (NSUInteger i = 0; i < verbCount; ++i) {
+        if (SKTPathVerbClose < _verbs[i]) {
+          [decoder markDamaged];
+          return self;
+        }
+        expectedCoordCount += SKTPathVerbCoordCount(_verbs[i]);
+      }
+      if (expectedCoordCount != coordCount) {
+        [decoder markDamaged];
+        return self;
+      }
+      _verbCount = verbCount;
+      _coordCount = coordCount;
+      CGRect bounds = [self computeBounds];
+      if (CGRectIsEmpty(bounds)) {
+        return nil;
+      }
+      [self setBounds:bounds];
+    } else {
+      [decoder markDamaged];
+    }
+  }
+  return self;
+}
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [super writeNativeToWriter:writer];
+  [writer writeUInt8:[self isClosed]];
+  [writer writeUInt32:(uint32_t)_verbCount];
+  [writer writeUInt32:(uint32_t)_coordCount];
+  [writer writeBytes:_verbs length:_verbCount * sizeof(SKTPathVerb)];
+  [writer writeDoubles:_coords count:_coordCount];
+}
+
+- (void)writeAtomsToWriter:(SKTSVGWriter *)writer {
+  const CGFloat *coords = _coords;
+  for (NSUInteger i = 0; i < _verbCount; coords += SKTPathVerbCoordCount(_verbs[i]), ++i) {
+    if (0 != i) {
+      [writer writeUTF8:"  "];
+    }
+    SKTPathSegmentWriteSVG(_verbs[i], coords, writer);
   }
-  return [a componentsJoinedByString:@"  "];
+}
+
+- (NSString *)atomsAsString {
+  NSMutableData *data = [NSMutableData data];
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:data];
+  [self writeAtomsToWriter:writer];
+  [writer finish];
+  return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 }
 
 
 - (NSUInteger)countOfPathAtom {
-  return [_atoms count];
+  return _verbCount;
 }
 
 - (NSArray<SKTPathAtom *> *)pathAtomAtIndexes:(NSIndexSet *)indexes {
-  NSMutableArray *result = [NSMutableArray array];
+  NSMutableArray *result = [self makeAtomsAtIndexes:indexes];
+  NSUInteger k = 0;
   for (NSUInteger i = [indexes firstIndex]; NSNotFound != i; i = [indexes indexGreaterThanIndex:i]) {
-    SKTPathAtom *atom = _atoms[i];
+    SKTPathAtom *atom = result[k++];
     atom.index = i;
     atom.scriptingContainer = self;
-    [result addObject:atom];
   }
   return result;
 }
@@ -400,7 +837,7 @@ Z Closepath
     [undoManager setActionName:s];
   }
 
-  [_atoms removeObjectsAtIndexes:indexes];
+  [self removeSegmentsAtIndexes:indexes];
   [self updateBounds];
 }
 
@@ -418,7 +855,7 @@ Z Closepath
     [undoManager setActionName:s];
   }
 
-  [_atoms insertObjects:atoms atIndexes:indexes];
+  [self insertSegmentsFromAtoms:atoms atIndexes:indexes];
   [self updateBounds];
 }
 
@@ -436,15 +873,14 @@ Z Closepath
     [undoManager setActionName:s];
   }
 
-  for (NSUInteger k = [objects count] - 1, i = [indexes lastIndex]; NSNotFound != i; i = [indexes indexLessThanIndex:i], --k) {
-    SKTPathAtom *a = objects[k];
-    _atoms[i] = a;
-  }
+  // Segments vary in length, so take the old ones out and put the new ones in at the same indexes.
+  [self removeSegmentsAtIndexes:indexes];
+  [self insertSegmentsFromAtoms:objects atIndexes:indexes];
   [self updateBounds];
 }
 
 - (NSArray *)pathAtoms {
-  return _atoms;
+  return [self pathAtomAtIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, _verbCount)]];
 }
 
 // Call this after modifying the points array to trigger drawing by changing bounds.
@@ -489,3 +925,44 @@ Z Closepath
 
 
 @end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+static size_t MallocBytesInUse(void) {
+  malloc_statistics_t stats;
+  malloc_zone_statistics(NULL, &stats);
+  return stats.size_in_use;
+}
+
+void SKTPathMemoryBenchmark(NSUInteger segmentCount) {
+  NSMutableString *s = [NSMutableString stringWithString:@"M0,0"];
+  for (NSUInteger i = 1; i < segmentCount; ++i) {
+    [s appendFormat:@" L%lu,%lu", (unsigned long)(i % 1000), (unsigned long)(i / 1000)];
+  }
+  size_t atomBytes;
+  NSTimeInterval atomTime;
+  @autoreleasepool {
+    size_t before = MallocBytesInUse();
+    NSDate *start = [NSDate date];
+    NSMutableArray *atoms = [SKTPath stringToPathAtoms:s];
+    atomTime = -[start timeIntervalSinceNow];
+    atomBytes = MallocBytesInUse() - before;
+    atoms = nil;
+  }
+  size_t packedBytes;
+  NSTimeInterval packedTime;
+  @autoreleasepool {
+    size_t before = MallocBytesInUse();
+    NSDate *start = [NSDate date];
+    SKTPath *path = [[SKTPath alloc] initWithProperties:@{SKTPathString : s}];
+    packedTime = -[start timeIntervalSinceNow];
+    packedBytes = MallocBytesInUse() - before;
+    path = nil;
+  }
+  NSLog(@"%lu path segments: one atom each %.1f bytes/segment %.3fs; packed %.1f bytes/segment %.3fs",
+    (unsigned long)segmentCount,
+    (double)atomBytes / MAX(segmentCount, 1), atomTime,
+    (double)packedBytes / MAX(segmentCount, 1), packedTime);
+}
+#endif
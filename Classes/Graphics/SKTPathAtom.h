@@ -4,11 +4,54 @@
 
 #import <Foundation/Foundation.h>
 
+@class SKTSVGWriter;
+
 typedef struct MinMaxPt {
   CGPoint min;
   CGPoint max;
 } MinMaxPt;
 
+// SKTPath stores its segments packed: one verb per segment, and the coordinates of every segment back to back.
+// The coordinates of each verb, in order:
+typedef NS_ENUM(uint8_t, SKTPathVerb) {
+  SKTPathVerbMove,       // p
+  SKTPathVerbLine,       // p
+  SKTPathVerbQuadratic,  // pControl1, p
+  SKTPathVerbCubic,      // pControl1, pControl2, p
+  SKTPathVerbArc,        // p, pCenter, radius, startAngle, endAngle, flags (see SKTPathArcFlag)
+  SKTPathVerbClose,      // none
+};
+
+enum {
+  SKTPathArcFlagClockwise = 1,
+  SKTPathArcFlagLargeArc = 2,
+
+  // The most coordinates of any verb.
+  SKTPathVerbMaxCoordCount = 8
+};
+
+NSUInteger SKTPathVerbCoordCount(SKTPathVerb verb);
+
+// The operations on one packed segment. SKTPath applies them to its packed segments, SKTPathAtom to its own.
+BOOL SKTPathSegmentHasPoint(SKTPathVerb verb);
+CGPoint SKTPathSegmentPoint(SKTPathVerb verb, const CGFloat *coords);
+// The exact bounds of the segment as drawn from start, the end point of the segment before it: curves are bounded
+// at their extrema, not their control points, and an arc by only the part of its circle it sweeps.
+MinMaxPt SKTPathSegmentMinMax(SKTPathVerb verb, const CGFloat *coords, CGPoint start);
+// Where the segment leaves the drawing cursor, as SKTPathSegmentAppendToPath() tracks it.
+CGPoint SKTPathSegmentEndPoint(SKTPathVerb verb, const CGFloat *coords, CGPoint start);
+void SKTPathSegmentAppendToPath(SKTPathVerb verb, const CGFloat *coords, NSBezierPath *path, CGPoint *atp);
+void SKTPathSegmentWriteSVG(SKTPathVerb verb, const CGFloat *coords, SKTSVGWriter *writer);
+// Call add with points along the segment as drawn from start, not including start, so that the lines between them
+// stay within flatness of it. Lines add their end, arcs the start of the arc first. Moves and closes add nothing.
+void SKTPathSegmentFlatten(SKTPathVerb verb, const CGFloat *coords, CGPoint start, CGFloat flatness, void (NS_NOESCAPE ^add)(CGPoint p));
+
+// The coordinates of every verb but SKTPathVerbArc are nothing but points, so runs of them may be transformed
+// together with SKTTransformPoints().
+BOOL SKTPathVerbIsAllPoints(SKTPathVerb verb);
+void SKTPathSegmentApplyTransform(SKTPathVerb verb, CGFloat *coords, CGAffineTransform transform);
+
+// One segment of an SKTPath as an object, made on demand for scripting and undo.
 // spelled with a lower case 'A' to make key value coding work.
 @interface SKTPathAtom : NSObject
 @property(nonatomic) CGPoint p;
@@ -19,11 +62,23 @@ typedef struct MinMaxPt {
 
 @property(nonatomic, readonly) NSString *svgString;
 
-- (MinMaxPt)minMax;
+// The packed form. Subclasses override these three; the geometry methods below are written in terms of them.
+@property(nonatomic, readonly) SKTPathVerb verb;
+- (void)getCoords:(CGFloat *)coords;
+- (void)setCoords:(const CGFloat *)coords;
+
+// An atom of the subclass for verb.
++ (SKTPathAtom *)pathAtomWithVerb:(SKTPathVerb)verb coords:(const CGFloat *)coords;
+
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer;
+
+// The segment's bounds as drawn from start. See SKTPathSegmentMinMax().
+- (MinMaxPt)minMaxFrom:(CGPoint)start;
 
 // 'at' is in-out, at the current "cursor" position. Quadratic splines need it.
 - (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp;
 
+- (void)applyTransform:(CGAffineTransform)transform;
 - (void)translateBy:(CGPoint)p;
 - (void)scale:(CGSize)scale relativeToOrigin:(CGPoint)origin;
 - (void)flipHorizontallyRelatveToBounds:(CGRect)bounds;
@@ -42,7 +97,7 @@ typedef struct MinMaxPt {
 @interface SKTPathLine : SKTPathAtom
 @end
 
-// used during parsing to denote a closed path. Removed by the time parsing is done.
+// Closes the subpath.
 @interface SKTPathClosed : SKTPathAtom
 @end
 
@@ -65,3 +120,9 @@ typedef struct MinMaxPt {
 @property(nonatomic) CGPoint pControl1;
 @property(nonatomic) CGPoint pControl2;
 @end
+
+#if DEBUG
+// Compare SKTPathSegmentMinMax() with the bounds of AppKit's drawing of segmentCount random quadratic, cubic and arc
+// segments, densely flattened. Logs the failures and the worst differences.
+void SKTPathSegmentMinMaxCheck(NSUInteger segmentCount);
+#endif
@@ -4,7 +4,9 @@
 
 #import "SKTPathAtom.h"
 
+#import "SKTAffineTransform.h"
 #import "SKTGraphic.h"
+#import "SKTSVGWriter.h"
 
 static NSString *const SKTPathAtomPtKey = @"p";
 static NSString *const SKTPathAtomPtToKey = @"pTo";
@@ -13,47 +15,492 @@ static NSString *const SKTPathAtomPtControl1Key = @"pControl1";
 static NSString *const SKTPathAtomPtControl2Key = @"pControl2";
 static NSString *const SKTPathAtomRadiusKey = @"radius";
 
+static CGPoint PointAdd(CGPoint p1, CGPoint p2) {
+	return CGPointMake(p1.x + p2.x, p1.y + p2.y);
+}
+
+static CGPoint PointDiff(CGPoint p1, CGPoint p2) {
+	return CGPointMake(p1.x - p2.x, p1.y - p2.y);
+}
+
+static CGPoint PointMult(CGPoint p, CGFloat c){
+	return CGPointMake(p.x*c, p.y*c);
+}
+
+// Given two points on a circle, and a radius, solve for the center point.
+
+
+// Given a center, and a point, solve for the angle.
+//static CGFloat AngleFromCenterPoint(CGPoint center, CGPoint p) {
+//  return atan2(p.x - center.x, p.y - center.y);
+//}
+
+#pragma mark - Packed segments
+
+NSUInteger SKTPathVerbCoordCount(SKTPathVerb verb) {
+  switch (verb) {
+    case SKTPathVerbMove:
+    case SKTPathVerbLine:
+      return 2;
+    case SKTPathVerbQuadratic:
+      return 4;
+    case SKTPathVerbCubic:
+      return 6;
+    case SKTPathVerbArc:
+      return 8;
+    case SKTPathVerbClose:
+    default:
+      return 0;
+  }
+}
+
+// The number of leading coordinate pairs that are points. An arc's center only matters to
+// SKTPathSegmentApplyTransform(); its radius and angles aren't points at all.
+static NSUInteger PointCount(SKTPathVerb verb) {
+  switch (verb) {
+    case SKTPathVerbMove:
+    case SKTPathVerbLine:
+    case SKTPathVerbArc:
+      return 1;
+    case SKTPathVerbQuadratic:
+      return 2;
+    case SKTPathVerbCubic:
+      return 3;
+    case SKTPathVerbClose:
+    default:
+      return 0;
+  }
+}
+
+BOOL SKTPathSegmentHasPoint(SKTPathVerb verb) {
+  return SKTPathVerbClose != verb;
+}
+
+CGPoint SKTPathSegmentPoint(SKTPathVerb verb, const CGFloat *coords) {
+  switch (verb) {
+    case SKTPathVerbMove:
+    case SKTPathVerbLine:
+    case SKTPathVerbArc:
+      return CGPointMake(coords[0], coords[1]);
+    case SKTPathVerbQuadratic:
+      return CGPointMake(coords[2], coords[3]);
+    case SKTPathVerbCubic:
+      return CGPointMake(coords[4], coords[5]);
+    case SKTPathVerbClose:
+    default:
+      return CGPointZero;
+  }
+}
+
+static void MinMaxAddPoint(MinMaxPt *minMax, CGPoint p) {
+  minMax->min.x = MIN(minMax->min.x, p.x);
+  minMax->min.y = MIN(minMax->min.y, p.y);
+  minMax->max.x = MAX(minMax->max.x, p.x);
+  minMax->max.y = MAX(minMax->max.y, p.y);
+}
+
+static CGFloat QuadraticAt(CGFloat p0, CGFloat p1, CGFloat p2, CGFloat t) {
+  CGFloat mt = 1 - t;
+  return mt*mt*p0 + 2*mt*t*p1 + t*t*p2;
+}
+
+static CGFloat CubicAt(CGFloat p0, CGFloat p1, CGFloat p2, CGFloat p3, CGFloat t) {
+  CGFloat mt = 1 - t;
+  return mt*mt*mt*p0 + 3*mt*mt*t*p1 + 3*mt*t*t*p2 + t*t*t*p3;
+}
+
+// The parameters in (0, 1) where the derivative of one coordinate of a quadratic is 0. At most 1.
+static NSUInteger QuadraticExtrema(CGFloat p0, CGFloat p1, CGFloat p2, CGFloat *ts) {
+  CGFloat denominator = p0 - 2*p1 + p2;
+  if (0 != denominator) {
+    CGFloat t = (p0 - p1) / denominator;
+    if (0 < t && t < 1) {
+      ts[0] = t;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// The parameters in (0, 1) where the derivative of one coordinate of a cubic is 0. At most 2.
+// One third of the derivative is a t^2 + b t + c.
+static NSUInteger CubicExtrema(CGFloat p0, CGFloat p1, CGFloat p2, CGFloat p3, CGFloat *ts) {
+  CGFloat a = -p0 + 3*p1 - 3*p2 + p3;
+  CGFloat b = 2*(p0 - 2*p1 + p2);
+  CGFloat c = p1 - p0;
+  CGFloat roots[2];
+  NSUInteger rootCount = 0;
+  if (fabs(a) <= 1e-12 * (fabs(b) + fabs(c))) {
+    if (0 != b) {
+      roots[rootCount++] = -c / b;
+    }
+  } else {
+    CGFloat discriminant = b*b - 4*a*c;
+    if (0 <= discriminant) {
+      // The form that doesn't subtract nearly equal numbers.
+      CGFloat q = -(b + copysign(sqrt(discriminant), b)) / 2;
+      roots[rootCount++] = q / a;
+      if (0 != q) {
+        roots[rootCount++] = c / q;
+      }
+    }
+  }
+  NSUInteger count = 0;
+  for (NSUInteger i = 0; i < rootCount; ++i) {
+    if (0 < roots[i] && roots[i] < 1) {
+      ts[count++] = roots[i];
+    }
+  }
+  return count;
+}
+
+// A point on an arc as NSBezierPath draws it: degrees counterclockwise from the x axis.
+static CGPoint ArcPoint(CGPoint center, CGFloat radius, CGFloat degrees) {
+  CGFloat radians = degrees * M_PI / 180;
+  return CGPointMake(center.x + radius*cos(radians), center.y + radius*sin(radians));
+}
+
+// How many degrees the arc sweeps from startAngle, in its direction, in [0, 360].
+static CGFloat ArcSweep(CGFloat startAngle, CGFloat endAngle, BOOL clockwise) {
+  CGFloat difference = clockwise ? startAngle - endAngle : endAngle - startAngle;
+  CGFloat sweep = fmod(difference, 360);
+  if (sweep < 0) {
+    sweep += 360;
+  }
+  if (0 == sweep && 0 != difference) {
+    sweep = 360;
+  }
+  return sweep;
+}
+
+MinMaxPt SKTPathSegmentMinMax(SKTPathVerb verb, const CGFloat *coords, CGPoint start) {
+  MinMaxPt result;
+  result.min = result.max = start;
+  switch (verb) {
+    case SKTPathVerbMove:
+      result.min = result.max = CGPointMake(coords[0], coords[1]);
+      break;
+    case SKTPathVerbLine:
+      MinMaxAddPoint(&result, CGPointMake(coords[0], coords[1]));
+      break;
+    case SKTPathVerbQuadratic: {
+      MinMaxAddPoint(&result, CGPointMake(coords[2], coords[3]));
+      CGFloat ts[2];
+      NSUInteger count = QuadraticExtrema(start.x, coords[0], coords[2], ts);
+      count += QuadraticExtrema(start.y, coords[1], coords[3], ts + count);
+      for (NSUInteger i = 0; i < count; ++i) {
+        MinMaxAddPoint(&result, CGPointMake(QuadraticAt(start.x, coords[0], coords[2], ts[i]),
+                                            QuadraticAt(start.y, coords[1], coords[3], ts[i])));
+      }
+      break;
+    }
+    case SKTPathVerbCubic: {
+      MinMaxAddPoint(&result, CGPointMake(coords[4], coords[5]));
+      CGFloat ts[4];
+      NSUInteger count = CubicExtrema(start.x, coords[0], coords[2], coords[4], ts);
+      count += CubicExtrema(start.y, coords[1], coords[3], coords[5], ts + count);
+      for (NSUInteger i = 0; i < count; ++i) {
+        MinMaxAddPoint(&result, CGPointMake(CubicAt(start.x, coords[0], coords[2], coords[4], ts[i]),
+                                            CubicAt(start.y, coords[1], coords[3], coords[5], ts[i])));
+      }
+      break;
+    }
+    case SKTPathVerbArc: {
+      // NSBezierPath draws a line from start to the beginning of the arc, then the arc. Besides its ends, the arc
+      // reaches out to whichever of the four axis-aligned extremes of the circle fall in its sweep.
+      CGPoint pCenter = CGPointMake(coords[2], coords[3]);
+      CGFloat radius = coords[4];
+      CGFloat startAngle = coords[5];
+      CGFloat endAngle = coords[6];
+      BOOL clockwise = 0 != ((NSUInteger)coords[7] & SKTPathArcFlagClockwise);
+      MinMaxAddPoint(&result, ArcPoint(pCenter, radius, startAngle));
+      MinMaxAddPoint(&result, ArcPoint(pCenter, radius, endAngle));
+      CGFloat sweep = ArcSweep(startAngle, endAngle, clockwise);
+      for (NSUInteger quadrant = 0; quadrant < 4; ++quadrant) {
+        CGFloat angle = quadrant * 90;
+        if (ArcSweep(startAngle, angle, clockwise) <= sweep) {
+          MinMaxAddPoint(&result, ArcPoint(pCenter, radius, angle));
+        }
+      }
+      break;
+    }
+    case SKTPathVerbClose:
+      break;
+  }
+  return result;
+}
+
+CGPoint SKTPathSegmentEndPoint(SKTPathVerb verb, const CGFloat *coords, CGPoint start) {
+  switch (verb) {
+    case SKTPathVerbArc:
+      return ArcPoint(CGPointMake(coords[2], coords[3]), coords[4], coords[6]);
+    case SKTPathVerbClose:
+      return start;
+    default:
+      return SKTPathSegmentPoint(verb, coords);
+  }
+}
+
+void SKTPathSegmentAppendToPath(SKTPathVerb verb, const CGFloat *coords, NSBezierPath *path, CGPoint *atp) {
+  switch (verb) {
+    case SKTPathVerbMove: {
+      CGPoint p = CGPointMake(coords[0], coords[1]);
+      [path moveToPoint:p];
+      *atp = p;
+      break;
+    }
+    case SKTPathVerbLine: {
+      CGPoint p = CGPointMake(coords[0], coords[1]);
+      [path lineToPoint:p];
+      *atp = p;
+      break;
+    }
+    case SKTPathVerbQuadratic: {
+      //	https://www.iro.umontreal.ca/~boyer/typophile/doc/bezier.html says:
+      // CP1 = QP0 + 2/3 *(QP1-QP0)
+      // CP2 = CP1 + 1/3 *(QP2-QP0)
+      CGPoint pControl1 = CGPointMake(coords[0], coords[1]);
+      CGPoint p = CGPointMake(coords[2], coords[3]);
+      CGPoint cp1 = PointAdd(*atp, PointMult(PointDiff(pControl1, *atp), 2.0/3.0));
+      CGPoint cp2 = PointAdd(cp1, PointMult(PointDiff(p, *atp), 1.0/3.0));
+      [path curveToPoint:p
+           controlPoint1:cp1
+           controlPoint2:cp2];
+      *atp = p;
+      break;
+    }
+    case SKTPathVerbCubic: {
+      CGPoint p = CGPointMake(coords[4], coords[5]);
+      [path curveToPoint:p
+           controlPoint1:CGPointMake(coords[0], coords[1])
+           controlPoint2:CGPointMake(coords[2], coords[3])];
+      *atp = p;
+      break;
+    }
+    case SKTPathVerbArc: {
+      CGPoint pCenter = CGPointMake(coords[2], coords[3]);
+      CGFloat radius = coords[4];
+      CGFloat endAngle = coords[6];
+//  [path appendBezierPathWithArcFromPoint:_pFrom toPoint:_pTo radius:_radius];
+      [path appendBezierPathWithArcWithCenter:pCenter
+                                       radius:radius
+                                   startAngle:coords[5]
+                                     endAngle:endAngle
+                                    clockwise:0 != ((NSUInteger)coords[7] & SKTPathArcFlagClockwise)];
+      *atp = ArcPoint(pCenter, radius, endAngle);
+      break;
+    }
+    case SKTPathVerbClose:
+      [path closePath];
+      break;
+  }
+}
+
+// Enough pieces that no chord of a curve is farther than flatness from it, by Wang's formula, though never an absurd number.
+static NSUInteger FlattenPieceCount(CGFloat deviation, CGFloat flatness) {
+  if ( ! (0 < flatness)) {
+    return 1;
+  }
+  CGFloat pieces = ceil(sqrt(deviation / flatness));
+  return (NSUInteger)MAX(1, MIN(pieces, 4096));
+}
+
+void SKTPathSegmentFlatten(SKTPathVerb verb, const CGFloat *coords, CGPoint start, CGFloat flatness, void (NS_NOESCAPE ^add)(CGPoint p)) {
+  switch (verb) {
+    case SKTPathVerbLine:
+      add(CGPointMake(coords[0], coords[1]));
+      break;
+    case SKTPathVerbQuadratic: {
+      CGPoint bend = CGPointMake(start.x - 2*coords[0] + coords[2], start.y - 2*coords[1] + coords[3]);
+      NSUInteger count = FlattenPieceCount(hypot(bend.x, bend.y) / 4, flatness);
+      for (NSUInteger i = 1; i <= count; ++i) {
+        CGFloat t = (CGFloat)i / count;
+        add(CGPointMake(QuadraticAt(start.x, coords[0], coords[2], t), QuadraticAt(start.y, coords[1], coords[3], t)));
+      }
+      break;
+    }
+    case SKTPathVerbCubic: {
+      CGPoint bend1 = CGPointMake(start.x - 2*coords[0] + coords[2], start.y - 2*coords[1] + coords[3]);
+      CGPoint bend2 = CGPointMake(coords[0] - 2*coords[2] + coords[4], coords[1] - 2*coords[3] + coords[5]);
+      NSUInteger count = FlattenPieceCount(0.75 * MAX(hypot(bend1.x, bend1.y), hypot(bend2.x, bend2.y)), flatness);
+      for (NSUInteger i = 1; i <= count; ++i) {
+        CGFloat t = (CGFloat)i / count;
+        add(CGPointMake(CubicAt(start.x, coords[0], coords[2], coords[4], t), CubicAt(start.y, coords[1], coords[3], coords[5], t)));
+      }
+      break;
+    }
+    case SKTPathVerbArc: {
+      // As NSBezierPath draws it: a line to the start of the arc, then the arc, in steps whose chords' sagittas are
+      // within flatness.
+      CGPoint pCenter = CGPointMake(coords[2], coords[3]);
+      CGFloat radius = coords[4];
+      CGFloat startAngle = coords[5];
+      BOOL clockwise = 0 != ((NSUInteger)coords[7] & SKTPathArcFlagClockwise);
+      CGFloat sweep = ArcSweep(startAngle, coords[6], clockwise);
+      add(ArcPoint(pCenter, radius, startAngle));
+      CGFloat step = (0 < flatness && flatness < radius) ? 2 * acos(1 - flatness / radius) * 180 / M_PI : 90;
+      NSUInteger count = (NSUInteger)MAX(1, MIN(ceil(sweep / MAX(step, 0.01)), 4096));
+      for (NSUInteger i = 1; i <= count && 0 < sweep; ++i) {
+        CGFloat angle = sweep * i / count;
+        add(ArcPoint(pCenter, radius, clockwise ? startAngle - angle : startAngle + angle));
+      }
+      break;
+    }
+    case SKTPathVerbMove:
+    case SKTPathVerbClose:
+      break;
+  }
+}
+
+void SKTPathSegmentWriteSVG(SKTPathVerb verb, const CGFloat *coords, SKTSVGWriter *writer) {
+  switch (verb) {
+    case SKTPathVerbMove:
+      [writer writeUTF8:"M"];
+      [writer writePoint:CGPointMake(coords[0], coords[1])];
+      break;
+    case SKTPathVerbLine:
+      [writer writeUTF8:"L"];
+      [writer writePoint:CGPointMake(coords[0], coords[1])];
+      break;
+    case SKTPathVerbQuadratic:
+      [writer writeUTF8:"Q"];
+      [writer writePoint:CGPointMake(coords[0], coords[1])];
+      [writer writeUTF8:" "];
+      [writer writePoint:CGPointMake(coords[2], coords[3])];
+      break;
+    case SKTPathVerbCubic:
+      [writer writeUTF8:"C"];
+      [writer writePoint:CGPointMake(coords[0], coords[1])];
+      [writer writeUTF8:" "];
+      [writer writePoint:CGPointMake(coords[2], coords[3])];
+      [writer writeUTF8:" "];
+      [writer writePoint:CGPointMake(coords[4], coords[5])];
+      break;
+    case SKTPathVerbArc: {
+      CGFloat radius = coords[4];
+      NSUInteger flags = (NSUInteger)coords[7];
+      CGPoint endPoint = ArcPoint(CGPointMake(coords[2], coords[3]), radius, coords[6]);
+      [writer writeUTF8:"A"];
+      [writer writeFloat:radius];
+      [writer writeUTF8:" "];
+      [writer writeFloat:radius];
+      [writer writeUTF8:(flags & SKTPathArcFlagLargeArc) ? " 0 1 " : " 0 0 "];
+      [writer writeUTF8:(flags & SKTPathArcFlagClockwise) ? "1 " : "0 "];
+      [writer writeFloat:endPoint.x];
+      [writer writeUTF8:" "];
+      [writer writeFloat:endPoint.y];
+      break;
+    }
+    case SKTPathVerbClose:
+      [writer writeUTF8:"Z"];
+      break;
+  }
+}
+
+BOOL SKTPathVerbIsAllPoints(SKTPathVerb verb) {
+  return SKTPathVerbArc != verb;
+}
+
+void SKTPathSegmentApplyTransform(SKTPathVerb verb, CGFloat *coords, CGAffineTransform transform) {
+  if (SKTPathVerbArc == verb) {
+    // p and pCenter are points. The radius scales with the area. The angles turn with the x axis, which the transform
+    // takes to the direction atan2(b, a). A mirror, det < 0, also reflects the angles about the x axis first, and
+    // reverses the direction of the sweep. Exact for rotations, mirrors and uniform scales; an arc under a skew or a
+    // non-uniform scale would be part of an ellipse, which an arc can't be.
+    SKTTransformPoints(transform, coords, 2);
+    CGFloat determinant = transform.a * transform.d - transform.b * transform.c;
+    coords[4] *= sqrt(fabs(determinant));
+    CGFloat rotation = atan2(transform.b, transform.a) * 180 / M_PI;
+    if (determinant < 0) {
+      coords[5] = rotation - coords[5];
+      coords[6] = rotation - coords[6];
+      coords[7] = (CGFloat)((NSUInteger)coords[7] ^ SKTPathArcFlagClockwise);
+    } else {
+      coords[5] += rotation;
+      coords[6] += rotation;
+    }
+  } else {
+    SKTTransformPoints(transform, coords, PointCount(verb));
+  }
+}
+
+#pragma mark - Atoms
+
 @implementation SKTPathAtom
 
 - (BOOL)hasPointValue {
-  return YES;
+  return SKTPathSegmentHasPoint([self verb]);
 }
 
 - (CGPoint)pointValue {
   return _p;
 }
 
-- (MinMaxPt)minMax {
-  MinMaxPt result;
-  result.min = _p;
-  result.max = _p;
+// A bare SKTPathAtom acts as a move.
+- (SKTPathVerb)verb {
+  return SKTPathVerbMove;
+}
+
+- (void)getCoords:(CGFloat *)coords {
+  coords[0] = _p.x;
+  coords[1] = _p.y;
+}
+
+- (void)setCoords:(const CGFloat *)coords {
+  _p = CGPointMake(coords[0], coords[1]);
+}
+
++ (SKTPathAtom *)pathAtomWithVerb:(SKTPathVerb)verb coords:(const CGFloat *)coords {
+  Class atomClass;
+  switch (verb) {
+    case SKTPathVerbMove:       atomClass = [SKTPathPoint class]; break;
+    case SKTPathVerbLine:       atomClass = [SKTPathLine class]; break;
+    case SKTPathVerbQuadratic:  atomClass = [SKTPathQuadratic class]; break;
+    case SKTPathVerbCubic:      atomClass = [SKTPathCubic class]; break;
+    case SKTPathVerbArc:        atomClass = [SKTPathArc class]; break;
+    case SKTPathVerbClose:
+    default:                    atomClass = [SKTPathClosed class]; break;
+  }
+  SKTPathAtom *result = [[atomClass alloc] init];
+  [result setCoords:coords];
   return result;
 }
 
+- (MinMaxPt)minMaxFrom:(CGPoint)start {
+  CGFloat coords[SKTPathVerbMaxCoordCount];
+  [self getCoords:coords];
+  return SKTPathSegmentMinMax([self verb], coords, start);
+}
+
 - (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-  [path moveToPoint:self.p];
-  *atp = self.p;
+  CGFloat coords[SKTPathVerbMaxCoordCount];
+  [self getCoords:coords];
+  SKTPathSegmentAppendToPath([self verb], coords, path, atp);
+}
+
+- (void)applyTransform:(CGAffineTransform)transform {
+  CGFloat coords[SKTPathVerbMaxCoordCount];
+  [self getCoords:coords];
+  SKTPathSegmentApplyTransform([self verb], coords, transform);
+  [self setCoords:coords];
 }
 
 - (void)translateBy:(CGPoint)p {
-  _p.x += p.x;
-  _p.y += p.y;
+  [self applyTransform:CGAffineTransformMakeTranslation(p.x, p.y)];
 }
 
 - (void)scale:(CGSize)scale relativeToOrigin:(CGPoint)origin {
-  _p.x = ((_p.x - origin.x) * scale.width) + origin.x;
-  _p.y = ((_p.y - origin.y) * scale.height) + origin.y;
+  [self applyTransform:CGAffineTransformMake(scale.width, 0, 0, scale.height, origin.x - origin.x * scale.width, origin.y - origin.y * scale.height)];
 }
 
 - (void)flipHorizontallyRelatveToBounds:(CGRect)bounds {
-   _p.x = (bounds.origin.x + bounds.size.width) - (_p.x - bounds.origin.x);
+  [self applyTransform:SKTTransformFlipHorizontallyInRect(bounds)];
 }
 
 - (void)flipVerticallyRelatveToBounds:(CGRect)bounds {
-   _p.y = (bounds.origin.y + bounds.size.height) - (_p.y - bounds.origin.y);
+  [self applyTransform:SKTTransformFlipVerticallyInRect(bounds)];
 }
 
-
 + (instancetype)pathAtomWithPt:(CGPoint)p {
   SKTPathAtom *result = [[self alloc] init];
   result.p = p;
@@ -68,62 +515,46 @@ static NSString *const SKTPathAtomRadiusKey = @"radius";
 }
 
 - (NSString *)svgString {
-  // Subcalsses must override.
-  [NSException raise:NSInternalInconsistencyException format:@"TODO: svgString"];
-  return @"";
+  NSMutableData *data = [NSMutableData data];
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:data];
+  [self writeSVGToWriter:writer];
+  [writer finish];
+  return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  CGFloat coords[SKTPathVerbMaxCoordCount];
+  [self getCoords:coords];
+  SKTPathSegmentWriteSVG([self verb], coords, writer);
 }
 
 @end
 
 @implementation SKTPathClosed
 
-- (BOOL)hasPointValue {
-  return NO;
+- (SKTPathVerb)verb {
+  return SKTPathVerbClose;
 }
 
-- (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-  [path closePath];
+- (void)getCoords:(CGFloat *)coords {
 }
 
-- (NSString *)svgString {
-  return @"Z";
+- (void)setCoords:(const CGFloat *)coords {
 }
+
 @end
 
 @implementation SKTPathPoint
-- (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-  [path moveToPoint:self.p];
-	*atp = self.p;
-}
-
-- (NSString *)svgString {
-  return [NSString stringWithFormat:@"M%.5g,%.5g", self.p.x, self.p.y];
-}
 @end
 
 @implementation SKTPathLine
-- (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-  [path lineToPoint:self.p];
-	*atp = self.p;
-}
-- (NSString *)svgString {
-  return [NSString stringWithFormat:@"L%.5g,%.5g", self.p.x, self.p.y];
+
+- (SKTPathVerb)verb {
+  return SKTPathVerbLine;
 }
 
 @end
 
-// Given two points on a circle, and a radius, solve for the center point.
-
-
-// Given a center, and a point, solve for the angle.
-//static CGFloat AngleFromCenterPoint(CGPoint center, CGPoint p) {
-//  return atan2(p.x - center.x, p.y - center.y);
-//}
-
-static CGPoint PointOfCenterRadiusAngle(CGPoint center, CGFloat radius, CGFloat angle) {
-  return CGPointMake(center.x + radius*sin(angle), center.y + radius*cos(angle));
-}
-
 /*
 A rx ry x-axis-rotation large-arc-flag sweepflag x, y
 Draws arc to the point (x,y)
@@ -134,42 +565,29 @@ The sweepflag (0 or 1) determines which way the arc goes (underneath or above).
  */
 @implementation SKTPathArc
 
-- (CGPoint)endPoint {
-  return PointOfCenterRadiusAngle(_pCenter, _radius, _endAngle);
+- (SKTPathVerb)verb {
+  return SKTPathVerbArc;
 }
 
-- (NSString *)svgString {
-  CGPoint endPoint = [self endPoint];
-  return [NSString stringWithFormat:@"A%.5g %.5g 0 %@ %@ %.5g %.5g", _radius, _radius, _largeArc ? @"1":@"0", _clockwise  ? @"1":@"0", endPoint.x, endPoint.y ];
+- (void)getCoords:(CGFloat *)coords {
+  [super getCoords:coords];
+  coords[2] = _pCenter.x;
+  coords[3] = _pCenter.y;
+  coords[4] = _radius;
+  coords[5] = _startAngle;
+  coords[6] = _endAngle;
+  coords[7] = (_clockwise ? SKTPathArcFlagClockwise : 0) | (_largeArc ? SKTPathArcFlagLargeArc : 0);
 }
 
-- (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-//  [path appendBezierPathWithArcFromPoint:_pFrom toPoint:_pTo radius:_radius];
-  [path appendBezierPathWithArcWithCenter:_pCenter
-                                   radius:_radius
-                               startAngle:_startAngle
-                                 endAngle:_endAngle
-                                clockwise:_clockwise];
-	*atp = PointOfCenterRadiusAngle(_pCenter, _radius, _endAngle);
-}
-
-- (void)translateBy:(CGPoint)p {
-  [super translateBy:p];
-  _pCenter.x += p.x;
-  _pCenter.y += p.y;
-}
-
-- (void)scale:(CGSize)scale relativeToOrigin:(CGPoint)origin {
-  [super scale:scale relativeToOrigin:origin];
-  _radius = (scale.width + scale.height) / 2; // is this right?
-}
-
-- (void)flipHorizontallyRelatveToBounds:(CGRect)bounds {
-  [super flipHorizontallyRelatveToBounds:bounds];
-}
-
-- (void)flipVerticallyRelatveToBounds:(CGRect)bounds {
-  [super flipVerticallyRelatveToBounds:bounds];
+- (void)setCoords:(const CGFloat *)coords {
+  [super setCoords:coords];
+  _pCenter = CGPointMake(coords[2], coords[3]);
+  _radius = coords[4];
+  _startAngle = coords[5];
+  _endAngle = coords[6];
+  NSUInteger flags = (NSUInteger)coords[7];
+  _clockwise = 0 != (flags & SKTPathArcFlagClockwise);
+  _largeArc = 0 != (flags & SKTPathArcFlagLargeArc);
 }
 
 - (NSMutableDictionary *)properties {
@@ -180,105 +598,56 @@ The sweepflag (0 or 1) determines which way the arc goes (underneath or above).
 
 @end
 
-static CGPoint PointAdd(CGPoint p1, CGPoint p2) {
-	return CGPointMake(p1.x + p2.x, p1.y + p2.y);
-}
-
-static CGPoint PointDiff(CGPoint p1, CGPoint p2) {
-	return CGPointMake(p1.x - p2.x, p1.y - p2.y);
-}
-
-static CGPoint PointMult(CGPoint p, CGFloat c){
-	return CGPointMake(p.x*c, p.y*c);
-}
-
-
 
 @implementation SKTPathQuadratic
 
-- (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-	//	https://www.iro.umontreal.ca/~boyer/typophile/doc/bezier.html says:
-	// CP1 = QP0 + 2/3 *(QP1-QP0)
-	// CP2 = CP1 + 1/3 *(QP2-QP0)
-	CGPoint cp1 = PointAdd(*atp, PointMult(PointDiff(_pControl1, *atp), 2.0/3.0));
-	CGPoint cp2 = PointAdd(cp1, PointMult(PointDiff(self.p, *atp), 1.0/3.0));
-  [path curveToPoint:self.p
-        controlPoint1:cp1
-        controlPoint2:cp2];
-	*atp = self.p;
+- (SKTPathVerb)verb {
+  return SKTPathVerbQuadratic;
 }
 
-- (NSString *)svgString {
-  return [NSString stringWithFormat:@"Q%.5g,%.5g %.5g,%.5g", _pControl1.x, _pControl1.y, self.p.x, self.p.y];
+- (void)getCoords:(CGFloat *)coords {
+  CGPoint p = self.p;
+  coords[0] = _pControl1.x;
+  coords[1] = _pControl1.y;
+  coords[2] = p.x;
+  coords[3] = p.y;
 }
 
-
-- (MinMaxPt)minMax {
-  MinMaxPt result;
-  result.min.x = MIN(self.p.x, _pControl1.x);
-  result.min.y = MIN(self.p.y, _pControl1.y);
-  result.max.x = MAX(self.p.x, _pControl1.x);
-  result.max.y = MAX(self.p.y, _pControl1.y);
-  return result;
+- (void)setCoords:(const CGFloat *)coords {
+  _pControl1 = CGPointMake(coords[0], coords[1]);
+  self.p = CGPointMake(coords[2], coords[3]);
 }
 
-
 - (NSMutableDictionary *)properties {
   NSMutableDictionary *properties = [super properties];
   properties[SKTPathAtomPtControl1Key] = NSStringFromPoint(_pControl1);
   return properties;
 }
 
-
-- (void)translateBy:(CGPoint)p {
-  [super translateBy:p];
-  _pControl1.x += p.x;
-  _pControl1.y += p.y;
-}
-
-- (void)scale:(CGSize)scale relativeToOrigin:(CGPoint)origin {
-  [super scale:scale relativeToOrigin:origin];
-  _pControl1.x = ((_pControl1.x - origin.x) * scale.width) + origin.x;
-  _pControl1.y = ((_pControl1.y - origin.y) * scale.height) + origin.y;
-}
-
-- (void)flipHorizontallyRelatveToBounds:(CGRect)bounds {
-  [super flipHorizontallyRelatveToBounds:bounds];
-   _pControl1.x = (bounds.origin.x + bounds.size.width) - (_pControl1.x - bounds.origin.x);
-}
-
-- (void)flipVerticallyRelatveToBounds:(CGRect)bounds {
-  [super flipVerticallyRelatveToBounds:bounds];
-   _pControl1.y = (bounds.origin.y + bounds.size.height) - (_pControl1.y - bounds.origin.y);
-}
-
-
 @end
 
 @implementation SKTPathCubic
 
-- (void)appendToPath:(NSBezierPath *)path nowAt:(CGPoint *)atp {
-  [path curveToPoint:self.p
-        controlPoint1:_pControl1
-        controlPoint2:_pControl2];
-	*atp = self.p;
+- (SKTPathVerb)verb {
+  return SKTPathVerbCubic;
 }
 
-- (NSString *)svgString {
-  return [NSString stringWithFormat:@"C%.5g,%.5g %.5g,%.5g %.5g,%.5g", _pControl1.x, _pControl1.y, _pControl2.x, _pControl2.y, self.p.x, self.p.y];
+- (void)getCoords:(CGFloat *)coords {
+  CGPoint p = self.p;
+  coords[0] = _pControl1.x;
+  coords[1] = _pControl1.y;
+  coords[2] = _pControl2.x;
+  coords[3] = _pControl2.y;
+  coords[4] = p.x;
+  coords[5] = p.y;
 }
 
-
-- (MinMaxPt)minMax {
-  MinMaxPt result;
-  result.min.x = MIN(MIN(self.p.x, _pControl1.x), _pControl2.x);
-  result.min.y = MIN(MIN(self.p.y, _pControl1.y), _pControl2.y);
-  result.max.x = MAX(MAX(self.p.x, _pControl1.x), _pControl2.x);
-  result.max.y = MAX(MAX(self.p.y, _pControl1.y), _pControl2.y);
-  return result;
+- (void)setCoords:(const CGFloat *)coords {
+  _pControl1 = CGPointMake(coords[0], coords[1]);
+  _pControl2 = CGPointMake(coords[2], coords[3]);
+  self.p = CGPointMake(coords[4], coords[5]);
 }
 
-
 - (NSMutableDictionary *)properties {
   NSMutableDictionary *properties = [super properties];
   properties[SKTPathAtomPtControl1Key] = NSStringFromPoint(_pControl1);
@@ -286,33 +655,67 @@ static CGPoint PointMult(CGPoint p, CGFloat c){
   return properties;
 }
 
-- (void)translateBy:(CGPoint)p {
-  [super translateBy:p];
-  _pControl1.x += p.x;
-  _pControl1.y += p.y;
-  _pControl2.x += p.x;
-  _pControl2.y += p.y;
-}
-
-- (void)scale:(CGSize)scale relativeToOrigin:(CGPoint)origin {
-  [super scale:scale relativeToOrigin:origin];
-  _pControl1.x = ((_pControl1.x - origin.x) * scale.width) + origin.x;
-  _pControl1.y = ((_pControl1.y - origin.y) * scale.height) + origin.y;
-  _pControl2.x = ((_pControl2.x - origin.x) * scale.width) + origin.x;
-  _pControl2.y = ((_pControl2.y - origin.y) * scale.height) + origin.y;
-}
-
-- (void)flipHorizontallyRelatveToBounds:(CGRect)bounds {
-  [super flipHorizontallyRelatveToBounds:bounds];
-   _pControl1.x = (bounds.origin.x + bounds.size.width) - (_pControl1.x - bounds.origin.x);
-   _pControl2.x = (bounds.origin.x + bounds.size.width) - (_pControl2.x - bounds.origin.x);
-}
-
-- (void)flipVerticallyRelatveToBounds:(CGRect)bounds {
-  [super flipVerticallyRelatveToBounds:bounds];
-   _pControl1.y = (bounds.origin.y + bounds.size.height) - (_pControl1.y - bounds.origin.y);
-   _pControl2.y = (bounds.origin.y + bounds.size.height) - (_pControl2.y - bounds.origin.y);
-}
-
-
 @end
+
+#pragma mark - Check
+
+#if DEBUG
+// A coordinate in [-100, 100).
+static CGFloat RandomCoordinate(void) {
+  return 200.0 * random() / RAND_MAX - 100;
+}
+
+void SKTPathSegmentMinMaxCheck(NSUInteger segmentCount) {
+  static const SKTPathVerb verbs[] = {SKTPathVerbQuadratic, SKTPathVerbCubic, SKTPathVerbArc};
+  NSUInteger failures = 0;
+  CGFloat worstOutside = 0;
+  CGFloat worstSlack = 0;
+  double exactArea = 0;
+  double hullArea = 0;
+  srandom(1);
+  for (NSUInteger n = 0; n < segmentCount; ++n) {
+    SKTPathVerb verb = verbs[n % 3];
+    CGFloat coords[SKTPathVerbMaxCoordCount];
+    for (NSUInteger i = 0; i < SKTPathVerbMaxCoordCount; ++i) {
+      coords[i] = RandomCoordinate();
+    }
+    if (SKTPathVerbArc == verb) {
+      coords[4] = fabs(coords[4]);
+      coords[5] *= 4;
+      coords[6] *= 4;
+      coords[7] = random() % 2;
+    }
+    CGPoint start = CGPointMake(RandomCoordinate(), RandomCoordinate());
+    MinMaxPt minMax = SKTPathSegmentMinMax(verb, coords, start);
+
+    // Ground truth: AppKit's own drawing of the segment, flattened finely. The flattened points lie on the curve.
+    NSBezierPath *path = [NSBezierPath bezierPath];
+    [path moveToPoint:start];
+    CGPoint position = start;
+    SKTPathSegmentAppendToPath(verb, coords, path, &position);
+    CGFloat flatness = [NSBezierPath defaultFlatness];
+    [NSBezierPath setDefaultFlatness:0.001];
+    NSRect sampled = [[path bezierPathByFlatteningPath] bounds];
+    [NSBezierPath setDefaultFlatness:flatness];
+
+    CGFloat outside = MAX(MAX(minMax.min.x - NSMinX(sampled), minMax.min.y - NSMinY(sampled)),
+                          MAX(NSMaxX(sampled) - minMax.max.x, NSMaxY(sampled) - minMax.max.y));
+    CGFloat slack = MAX(MAX(NSMinX(sampled) - minMax.min.x, NSMinY(sampled) - minMax.min.y),
+                        MAX(minMax.max.x - NSMaxX(sampled), minMax.max.y - NSMaxY(sampled)));
+    worstOutside = MAX(worstOutside, outside);
+    worstSlack = MAX(worstSlack, slack);
+    // NSBezierPath draws an arc as cubics, which stray from the circle by a few parts in 10^4 of the radius.
+    CGFloat tolerance = 0.01 + 0.001 * MAX(NSWidth(sampled), NSHeight(sampled));
+    if (tolerance < outside || tolerance < slack) {
+      failures += 1;
+    }
+
+    // What bounding the control points used to give.
+    NSRect hull = [path controlPointBounds];
+    hullArea += NSWidth(hull) * NSHeight(hull);
+    exactArea += (minMax.max.x - minMax.min.x) * (minMax.max.y - minMax.min.y);
+  }
+  NSLog(@"%lu segments: %lu failures, worst sample outside bounds %g, worst bounds beyond samples %g, control point bounds %.2fx the area",
+    (unsigned long)segmentCount, (unsigned long)failures, worstOutside, worstSlack, exactArea ? hullArea / exactArea : 0);
+}
+#endif
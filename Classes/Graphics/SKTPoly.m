@@ -5,6 +5,10 @@
 #import "SKTPoly.h"
 
 #import "NSColor_SKT.h"
+#import "SKTAffineTransform.h"
+#import "SKTHitTest.h"
+#import "SKTNativeFormat.h"
+#import "SKTSVGWriter.h"
 #import "SKTVertex.h"
 
 NSString *const SKTPolyPoints = @"pts";
@@ -12,8 +16,12 @@ NSString *const SKTPolyPoints = @"pts";
 NSString *const SKTPolyVertex = @"vertex";
 
 
-@interface SKTPoly()
-@property(nonatomic) NSMutableArray *pts;
+@interface SKTPoly() {
+  // The vertices, back to back, so loops over them don't unbox anything and a vertex costs no more than its CGPoint.
+  CGPoint *_pts;
+  NSUInteger _ptCount;
+  NSUInteger _ptCapacity;
+}
 @end
 
 @implementation SKTPoly
@@ -21,18 +29,22 @@ NSString *const SKTPolyVertex = @"vertex";
 - (instancetype)init {
   self = [super init];
   if (self) {
-    _pts = [NSMutableArray array];
+    [self reservePtCapacity:4];
   }
   return self;
 }
 
+- (void)dealloc {
+  free(_pts);
+}
+
 - (instancetype)initWithProperties:(NSDictionary *)properties {
   self = [super initWithProperties:properties];
   if (self) {
     _closed = [properties[SKTGraphicClosed] boolValue];
     NSString *s = properties[SKTPolyPoints];
     if ([s respondsToSelector:@selector(characterAtIndex:)]) {
-      _pts = [SKTPoly stringToPoints:s];
+      [self appendPtsFromString:s];
       [self setBounds:[self computeBounds]];
     } else {
       return nil;
@@ -46,18 +58,87 @@ NSString *const SKTPolyVertex = @"vertex";
   if (_closed) {
     [result setClosed:YES];
   }
-  [result setPts:[[self pts] mutableCopyWithZone:zone]];
+  [result setPts:_pts count:_ptCount];
   return result;
 }
 
+#pragma mark - Point buffer
+
+// Grow, never shrink, the buffer to hold at least capacity points.
+- (void)reservePtCapacity:(NSUInteger)capacity {
+  if (_ptCapacity < capacity) {
+    NSUInteger newCapacity = _ptCapacity ? _ptCapacity : 4;
+    while (newCapacity < capacity) {
+      newCapacity *= 2;
+    }
+    CGPoint *pts = realloc(_pts, newCapacity * sizeof(CGPoint));
+    if (NULL == pts) {
+      [NSException raise:NSMallocException format:@"Could not allocate %lu points.", (unsigned long)newCapacity];
+    }
+    _pts = pts;
+    _ptCapacity = newCapacity;
+  }
+}
+
+- (void)setPts:(const CGPoint *)pts count:(NSUInteger)count {
+  [self reservePtCapacity:count];
+  memcpy(_pts, pts, count * sizeof(CGPoint));
+  _ptCount = count;
+  [self invalidateBezierPathCache];
+}
+
+// Matches NSMutableArray's -insertObjects:atIndexes:, so each point ends up at the corresponding index.
+- (void)insertPts:(const CGPoint *)pts atIndexes:(NSIndexSet *)indexes {
+  NSUInteger insertCount = [indexes count];
+  NSUInteger newCount = _ptCount + insertCount;
+  if (insertCount && newCount <= [indexes lastIndex]) {
+    [NSException raise:NSRangeException format:@"Index %lu beyond %lu points.", (unsigned long)[indexes lastIndex], (unsigned long)newCount];
+  }
+  [self reservePtCapacity:newCount];
+  // Work from the end so each old point moves at most once, and never onto a point that hasn't moved yet.
+  NSUInteger from = _ptCount;
+  NSUInteger k = insertCount;
+  for (NSUInteger to = newCount; 0 < to; --to) {
+    if ([indexes containsIndex:to - 1]) {
+      _pts[to - 1] = pts[--k];
+    } else {
+      _pts[to - 1] = _pts[--from];
+    }
+  }
+  _ptCount = newCount;
+  [self invalidateBezierPathCache];
+}
+
+- (void)removePtsAtIndexes:(NSIndexSet *)indexes {
+  if ([indexes count] && _ptCount <= [indexes lastIndex]) {
+    [NSException raise:NSRangeException format:@"Index %lu beyond %lu points.", (unsigned long)[indexes lastIndex], (unsigned long)_ptCount];
+  }
+  NSUInteger to = 0;
+  for (NSUInteger from = 0; from < _ptCount; ++from) {
+    if ( ! [indexes containsIndex:from]) {
+      _pts[to++] = _pts[from];
+    }
+  }
+  _ptCount = to;
+  [self invalidateBezierPathCache];
+}
+
+- (void)checkPtIndex:(NSUInteger)index {
+  if (_ptCount <= index) {
+    [NSException raise:NSRangeException format:@"Index %lu beyond %lu points.", (unsigned long)index, (unsigned long)_ptCount];
+  }
+}
+
+#pragma mark -
+
 - (CGRect)computeBounds {
-  if (0 == [_pts count]) {
+  if (0 == _ptCount) {
     return CGRectZero;
   }
-  CGPoint minP = [_pts[0] pointValue];
+  CGPoint minP = _pts[0];
   CGPoint maxP = minP;
-  for (NSValue *pV in _pts) {
-    CGPoint pt = [pV pointValue];
+  for (NSUInteger i = 1; i < _ptCount; ++i) {
+    CGPoint pt = _pts[i];
     if (pt.x < minP.x) {
       minP.x = pt.x;
     }
@@ -74,8 +155,7 @@ NSString *const SKTPolyVertex = @"vertex";
   return CGRectMake(minP.x, minP.y, maxP.x - minP.x, maxP.y - minP.y);
 }
 
-+ (NSMutableArray *)stringToPoints:(NSString *)s {
-  NSMutableArray *a = [NSMutableArray array];
+- (void)appendPtsFromString:(NSString *)s {
   NSScanner *scanner = [[NSScanner alloc] initWithString:s];
   NSMutableCharacterSet *skipChars = [NSMutableCharacterSet whitespaceAndNewlineCharacterSet];
   [skipChars addCharactersInString:@","];
@@ -83,11 +163,19 @@ NSString *const SKTPolyVertex = @"vertex";
   float x, y;
   while ([scanner scanFloat:&x] && [scanner scanFloat:&y]) {
     if (!(isnan(x) || isnan(y))) {
-      NSValue *p = [NSValue valueWithPoint:CGPointMake(x, y)];
-      [a addObject:p];
+      [self reservePtCapacity:_ptCount + 1];
+      _pts[_ptCount++] = CGPointMake(x, y);
     }
   }
-  return a;
+  // Big polylines are usually read once and then left alone, so give back the slack from doubling.
+  if (4 < _ptCount && _ptCount < _ptCapacity) {
+    CGPoint *pts = realloc(_pts, _ptCount * sizeof(CGPoint));
+    if (pts) {
+      _pts = pts;
+      _ptCapacity = _ptCount;
+    }
+  }
+  [self invalidateBezierPathCache];
 }
 
 - (NSMutableDictionary *)properties {
@@ -99,17 +187,43 @@ NSString *const SKTPolyVertex = @"vertex";
   return properties;
 }
 
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+  self = [super initWithNativeDecoder:decoder];
+  if (self) {
+    _closed = 0 != [decoder readUInt8];
+    NSUInteger count = [decoder readUInt32];
+    // Check the count against what's left before allocating for it: the file may be damaged.
+    if (count <= [decoder remainingLength] / (2 * sizeof(double))) {
+      [self reservePtCapacity:MAX(count, 1)];
+      [decoder readDoubles:(CGFloat *)_pts count:2 * count];
+      _ptCount = count;
+      [self setBounds:[self computeBounds]];
+    } else {
+      [decoder markDamaged];
+    }
+  }
+  return self;
+}
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [super writeNativeToWriter:writer];
+  [writer writeUInt8:[self isClosed]];
+  [writer writeUInt32:(uint32_t)_ptCount];
+  [writer writeDoubles:(const CGFloat *)_pts count:2 * _ptCount];
+}
+
 - (NSBezierPath *)bezierPathForDrawing {
+  return [self cachedBezierPath:^{
+    return [self makeBezierPathForDrawing];
+  }];
+}
+
+- (NSBezierPath *)makeBezierPathForDrawing {
   NSBezierPath *path = nil;
-  NSUInteger count = [_pts count];
-  if (2 <= count) {
+  if (2 <= _ptCount) {
     path = [NSBezierPath bezierPath];
-    CGPoint p = [self ptAtIndex:0];
-    [path moveToPoint:p];
-    for (NSUInteger i = 1; i < count; ++i) {
-      CGPoint p = [self ptAtIndex:i];
-      [path lineToPoint:p];
-    }
+    // A move to the first point, then lines to the rest.
+    [path appendBezierPathWithPoints:_pts count:(NSInteger)_ptCount];
     if ([self isClosed]) {
       [path closePath];
     }
@@ -123,120 +237,97 @@ NSString *const SKTPolyVertex = @"vertex";
 }
 
 - (BOOL)isContentsUnderPoint:(NSPoint)point {
-  return [[self bezierPathForDrawing] containsPoint:point];
+  return [self isContentsUnderPoint:point tolerance:0];
+}
+
+// Inside, as -[NSBezierPath containsPoint:] would say, or on the stroke if one is drawn, straight from the point buffer.
+- (BOOL)isContentsUnderPoint:(NSPoint)point tolerance:(CGFloat)tolerance {
+  if (_ptCount < 2) {
+    return NO;
+  }
+  if (SKTWindingNumberIsInside(SKTRingWindingNumber(_pts, _ptCount, point), SKTWindingRuleNonZero)) {
+    return YES;
+  }
+  return [self isDrawingStroke] && SKTPolylineIsWithinDistance(_pts, _ptCount, [self isClosed], point, [self strokeWidth] / 2 + tolerance);
 }
 
-- (NSString *)asSVGString {
-  return [self asSVGStringVerb:[self isClosed] ? @"polygon" : @"polyline"];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [self writeSVGToWriter:writer verb:[self isClosed] ? "polygon" : "polyline"];
 }
 
-- (NSString *)svgAttributesString {
-  return [NSString stringWithFormat:@"points=\"%@\" %@",
-    [self ptsAsString],
-    [super svgAttributesString]];
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"points=\""];
+  [self writePtsToWriter:writer];
+  [writer writeUTF8:"\" "];
+  [super writeSVGAttributesToWriter:writer];
 }
 
-- (NSString *)ptsAsString {
-  NSMutableArray *a = [NSMutableArray array];
-  for (NSValue *pV in _pts) {
-    CGPoint pt = [pV pointValue];
-    NSString *s = [NSString stringWithFormat:@"%.5g,%.5g", pt.x, pt.y];
-    [a addObject:s];
+- (void)writePtsToWriter:(SKTSVGWriter *)writer {
+  for (NSUInteger i = 0; i < _ptCount; ++i) {
+    if (i) {
+      [writer writeUTF8:"  "];
+    }
+    [writer writePoint:_pts[i]];
   }
-  return [a componentsJoinedByString:@"  "];
+}
+
+- (NSString *)ptsAsString {
+  NSMutableData *data = [NSMutableData data];
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:data];
+  [self writePtsToWriter:writer];
+  [writer finish];
+  return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 }
 
 - (void)setBounds:(CGRect)bounds {
   [super setBounds:bounds];
-  if (0.001 <= bounds.size.width && 0.001 <= bounds.size.height && nil == _pts) {
+  if (0.001 <= bounds.size.width && 0.001 <= bounds.size.height && NULL == _pts) {
 #if 0 // diamond
     CGPoint p1 = CGPointMake(bounds.origin.x, bounds.origin.y + bounds.size.height/2);
     CGPoint p2 = CGPointMake(bounds.origin.x + bounds.size.width/2, bounds.origin.y);
     CGPoint p3 = CGPointMake(bounds.origin.x + bounds.size.width, bounds.origin.y + bounds.size.height/2);
     CGPoint p4 = CGPointMake(bounds.origin.x + bounds.size.width/2, bounds.origin.y + bounds.size.height);
-    _pts = [@[ [NSValue valueWithPoint:p1], [NSValue valueWithPoint:p2], [NSValue valueWithPoint:p3], [NSValue valueWithPoint:p4] ] mutableCopy];
+    CGPoint pts[] = {p1, p2, p3, p4};
 #else
     // Assme we're creating interactively.
     CGPoint p1 = CGPointMake(bounds.origin.x, bounds.origin.y + bounds.size.height);
     CGPoint p2 = CGPointMake(bounds.origin.x + bounds.size.width/2, bounds.origin.y);
     CGPoint p3 = CGPointMake(bounds.origin.x + bounds.size.width, bounds.origin.y + bounds.size.height);
-    _pts = [@[ [NSValue valueWithPoint:p1], [NSValue valueWithPoint:p2], [NSValue valueWithPoint:p3] ] mutableCopy];
+    CGPoint pts[] = {p1, p2, p3};
 #endif
+    [self setPts:pts count:sizeof pts / sizeof pts[0]];
     _closed = YES;
   }
   CGRect oldBounds = [self computeBounds];
 
   if ( ! CGRectEqualToRect(bounds, oldBounds)) {
-    CGPoint translate = CGPointMake(bounds.origin.x - oldBounds.origin.x, bounds.origin.y - oldBounds.origin.y);
-    if ( ! CGPointEqualToPoint(CGPointZero, translate)) {
-      int count = (int)[_pts count];
-      for (int i = 0; i < count; ++i) {
-        NSValue *pV = _pts[i];
-        CGPoint pt = [pV pointValue];
-        pt.x += translate.x;
-        pt.y += translate.y;
-        pV = [NSValue valueWithPoint:pt];
-        _pts[i] = pV;
-      }
-    }
-    CGFloat sx;
-    if (oldBounds.size.width == 0){
-      sx = 1;
-    } else {
-      sx = bounds.size.width / oldBounds.size.width;
-    }
-    CGFloat sy;
-    if (oldBounds.size.height == 0) {
-      sy = 1;
-    } else {
-      sy = bounds.size.height / oldBounds.size.height;
-    }
-    CGSize scale = CGSizeMake(sx, sy);
-    if ( ! CGSizeEqualToSize(CGSizeMake(1,1), scale)) {
-      int count = (int)[_pts count];
-      for (int i = 0; i < count; ++i) {
-        NSValue *pV = _pts[i];
-        CGPoint pt = [pV pointValue];
-        pt.x = ((pt.x - bounds.origin.x) * scale.width) + bounds.origin.x;
-        pt.y = ((pt.y- bounds.origin.y) * scale.height) + bounds.origin.y;
-        pV = [NSValue valueWithPoint:pt];
-        _pts[i] = pV;
-      }
-    }
+    SKTTransformPoints(SKTTransformMappingRect(oldBounds, bounds), (CGFloat *)_pts, _ptCount);
   }
 }
 
 - (void)flipHorizontally {
-  CGRect bounds = [self bounds];
-  int count = (int)[_pts count];
-  for (int i = 0; i < count; ++i) {
-    NSValue *pV = _pts[i];
-    CGPoint pt = [pV pointValue];
-    pt.x = (bounds.origin.x + bounds.size.width) - (pt.x - bounds.origin.x);
-    pV = [NSValue valueWithPoint:pt];
-    _pts[i] = pV;
-  }
+  [self invalidateBezierPathCache];
+  SKTTransformPoints(SKTTransformFlipHorizontallyInRect([self bounds]), (CGFloat *)_pts, _ptCount);
 }
 
 - (void)flipVertically {
-  CGRect bounds = [self bounds];
-  int count = (int)[_pts count];
-  for (int i = 0; i < count; ++i) {
-    NSValue *pV = _pts[i];
-    CGPoint pt = [pV pointValue];
-    pt.y = (bounds.origin.y + bounds.size.height) - (pt.y - bounds.origin.y);
-    pV = [NSValue valueWithPoint:pt];
-    _pts[i] = pV;
-  }
+  [self invalidateBezierPathCache];
+  SKTTransformPoints(SKTTransformFlipVerticallyInRect([self bounds]), (CGFloat *)_pts, _ptCount);
+}
+
+- (void)applyTransform:(CGAffineTransform)transform {
+  [self invalidateBezierPathCache];
+  SKTTransformPoints(transform, (CGFloat *)_pts, _ptCount);
+  [self updateBounds];
 }
 
 - (NSUInteger)countOfPt {
-  return [_pts count];
+  return _ptCount;
 }
 
 - (CGPoint)ptAtIndex:(NSUInteger)index {
-  NSValue *p = _pts[index];
-  return [p pointValue];
+  [self checkPtIndex:index];
+  return _pts[index];
 }
 
 - (void)addPt:(CGPoint)pt {
@@ -244,8 +335,14 @@ NSString *const SKTPolyVertex = @"vertex";
 }
 
 - (void)insertPt:(CGPoint)pt atIndex:(NSUInteger)index {
-  NSValue *p = [NSValue valueWithPoint:pt];
-  [_pts insertObject:p atIndex:index];
+  if (_ptCount < index) {
+    [self checkPtIndex:index];
+  }
+  [self reservePtCapacity:_ptCount + 1];
+  memmove(&_pts[index + 1], &_pts[index], (_ptCount - index) * sizeof(CGPoint));
+  _pts[index] = pt;
+  _ptCount += 1;
+  [self invalidateBezierPathCache];
 }
 
 - (void)removeLastPt {
@@ -256,7 +353,10 @@ NSString *const SKTPolyVertex = @"vertex";
 }
 
 - (void)removePtAtIndex:(NSUInteger)index {
-  [_pts removeObjectAtIndex:index];
+  [self checkPtIndex:index];
+  memmove(&_pts[index], &_pts[index + 1], (_ptCount - index - 1) * sizeof(CGPoint));
+  _ptCount -= 1;
+  [self invalidateBezierPathCache];
 }
 
 - (void)replacePtAtIndex:(NSUInteger)index withPt:(CGPoint)pt {
@@ -267,8 +367,7 @@ NSString *const SKTPolyVertex = @"vertex";
     if ( ! ([undoManager isUndoing] || [undoManager isRedoing])) {
       [undoManager setActionName:NSLocalizedStringFromTable(@"Move Vertex", @"UndoStrings", @"Action name for moving a point.")];
     }
-    NSValue *p = [NSValue valueWithPoint:pt];
-    [_pts replaceObjectAtIndex:index withObject:p];
+    _pts[index] = pt;
     [self updateBounds];
   }
 }
@@ -284,14 +383,13 @@ NSString *const SKTPolyVertex = @"vertex";
 }
 
 - (NSUInteger)countOfVertex {
-  return [_pts count];
+  return _ptCount;
 }
 
 - (NSArray < SKTVertex *> *)vertexAtIndexes:(NSIndexSet *)indexes {
   NSMutableArray *vertices = [NSMutableArray array];
   for (NSUInteger i = [indexes firstIndex]; NSNotFound != i; i = [indexes indexGreaterThanIndex:i]) {
-    NSValue *pV = _pts[i];
-    CGPoint pt = [pV pointValue];
+    CGPoint pt = [self ptAtIndex:i];
     SKTVertex *vertex = [[SKTVertex alloc] init];
     vertex.xPosition = pt.x;
     vertex.yPosition = pt.y;
@@ -315,7 +413,7 @@ NSString *const SKTPolyVertex = @"vertex";
     }
     [undoManager setActionName:s];
   }
-  [_pts removeObjectsAtIndexes:indexes];
+  [self removePtsAtIndexes:indexes];
   [self updateBounds];
 }
 
@@ -332,13 +430,14 @@ NSString *const SKTPolyVertex = @"vertex";
     }
     [undoManager setActionName:s];
   }
-  NSMutableArray *a = [NSMutableArray array];
-  for (SKTVertex *v in vertices) {
-    CGPoint p = CGPointMake(v.xPosition, v.yPosition);
-    NSValue *pV = [NSValue valueWithPoint:p];
-    [a addObject:pV];
+  NSUInteger count = [vertices count];
+  CGPoint *pts = malloc(MAX(count, 1) * sizeof(CGPoint));
+  for (NSUInteger i = 0; i < count; ++i) {
+    SKTVertex *v = vertices[i];
+    pts[i] = CGPointMake(v.xPosition, v.yPosition);
   }
-  [_pts insertObjects:a atIndexes:indexes];
+  [self insertPts:pts atIndexes:indexes];
+  free(pts);
   [self updateBounds];
 }
 
@@ -358,9 +457,8 @@ NSString *const SKTPolyVertex = @"vertex";
 
   for (NSUInteger k = [objects count] - 1, i = [indexes lastIndex]; NSNotFound != i; i = [indexes indexLessThanIndex:i], --k) {
     SKTVertex *v = objects[k];
-    CGPoint p = CGPointMake(v.xPosition, v.yPosition);
-    NSValue *pV = [NSValue valueWithPoint:p];
-    _pts[i] = pV;
+    [self checkPtIndex:i];
+    _pts[i] = CGPointMake(v.xPosition, v.yPosition);
   }
   [self updateBounds];
 }
@@ -369,6 +467,21 @@ NSString *const SKTPolyVertex = @"vertex";
   return [self vertices];
 }
 
+// An override of the NSObject(NSKeyValueObservingCustomization) method. -setClosed: notifies by hand, as SKTGraphic's setters do, so the change bus hears about it.
++ (BOOL)automaticallyNotifiesObserversForKey:(NSString *)key {
+  if ([key isEqualToString:SKTGraphicClosed]) {
+    return NO;
+  }
+  return [super automaticallyNotifiesObserversForKey:key];
+}
+
+- (void)setClosed:(BOOL)closed {
+  [self willChangeValueForKey:SKTGraphicClosed];
+  _closed = closed;
+  [self invalidateBezierPathCache];
+  [self didChangeValueForKey:SKTGraphicClosed];
+}
+
 - (BOOL)canOpenPolygon {
   return self.closed;
 }
@@ -387,6 +500,49 @@ NSString *const SKTPolyVertex = @"vertex";
   return [self copy];
 }
 
+#pragma mark - Simplifying
+
+- (BOOL)canSimplify {
+  return 2 < _ptCount;
+}
+
+// Undoably make the points the packed CGPoints in data.
+- (void)replaceAllPtsWithData:(NSData *)data {
+  NSUndoManager *undoManager = [self undoManager];
+  if (undoManager) {
+    [[undoManager prepareWithInvocationTarget:self] replaceAllPtsWithData:[NSData dataWithBytes:_pts length:_ptCount * sizeof(CGPoint)]];
+  }
+  [self setPts:[data bytes] count:[data length] / sizeof(CGPoint)];
+  [self updateBounds];
+}
+
+// A polyline can't hold curves, so curve fitting is just Douglas-Peucker. A polygon's closing segment is left as is.
+- (SKTSimplifyReport)simplifyWithMethod:(SKTSimplifyMethod)method tolerance:(CGFloat)tolerance {
+  SKTSimplifyReport report = {_ptCount, _ptCount, 0};
+  if ( ! [self canSimplify]) {
+    return report;
+  }
+  BOOL *keep = malloc(_ptCount * sizeof(BOOL));
+  if (SKTSimplifyMethodVisvalingamWhyatt == method) {
+    report.vertexCount = SKTSimplifyVisvalingamWhyatt(_pts, _ptCount, tolerance, keep);
+  } else {
+    report.vertexCount = SKTSimplifyDouglasPeucker(_pts, _ptCount, tolerance, keep);
+  }
+  if (report.vertexCount < _ptCount) {
+    report.maxDeviation = SKTSimplifyMaxDeviation(_pts, _ptCount, keep);
+    NSMutableData *data = [NSMutableData dataWithLength:report.vertexCount * sizeof(CGPoint)];
+    CGPoint *pts = [data mutableBytes];
+    for (NSUInteger i = 0; i < _ptCount; ++i) {
+      if (keep[i]) {
+        *pts++ = _pts[i];
+      }
+    }
+    [self replaceAllPtsWithData:data];
+  }
+  free(keep);
+  return report;
+}
+
 
 #pragma mark - Drawing
 
@@ -431,10 +587,8 @@ NSString *const SKTPolyVertex = @"vertex";
 
 - (NSArray *)vertices {
   NSMutableArray *vertices = [NSMutableArray array];
-  int count = (int)[_pts count];
-  for (int i = 0; i < count; ++i) {
-    NSValue *pV = _pts[i];
-    CGPoint pt = [pV pointValue];
+  for (NSUInteger i = 0; i < _ptCount; ++i) {
+    CGPoint pt = _pts[i];
     SKTVertex *vertex = [[SKTVertex alloc] init];
     vertex.xPosition = pt.x;
     vertex.yPosition = pt.y;
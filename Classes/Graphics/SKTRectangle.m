@@ -11,6 +11,7 @@
 
 #import "SKTRectangle.h"
 #import "SKTPoly.h"
+#import "SKTSVGWriter.h"
 
 @implementation SKTRectangle
 
@@ -42,14 +43,21 @@
   return path;
 }
 
-- (NSString *)asSVGString {
-  return [self asSVGStringVerb:@"rect"];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  [self writeSVGToWriter:writer verb:"rect"];
 }
 
-- (NSString *)svgAttributesString {
-  return [NSString stringWithFormat:@"x=\"%.5g\" y=\"%.5g\" width=\"%.5g\" height=\"%.5g\" %@",
-    self.bounds.origin.x, self.bounds.origin.y, self.bounds.size.width, self.bounds.size.height,
-    [super svgAttributesString]];
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
+  [writer writeUTF8:"x=\""];
+  [writer writeFloat:self.bounds.origin.x];
+  [writer writeUTF8:"\" y=\""];
+  [writer writeFloat:self.bounds.origin.y];
+  [writer writeUTF8:"\" width=\""];
+  [writer writeFloat:self.bounds.size.width];
+  [writer writeUTF8:"\" height=\""];
+  [writer writeFloat:self.bounds.size.height];
+  [writer writeUTF8:"\" "];
+  [super writeSVGAttributesToWriter:writer];
 }
 
 @end
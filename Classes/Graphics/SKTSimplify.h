@@ -0,0 +1,71 @@
+/*  SKTSimplify.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Simplifying dense geometry, such as the polylines of a traced or scanned floor plan, which can have thousands of
+ nearly collinear vertices per wall. These kernels work on packed CGPoints and know nothing of graphics; SKTPoly and
+ SKTPath apply them to their buffers.
+ */
+
+typedef NS_ENUM(NSInteger, SKTSimplifyMethod) {
+  /// Keep the vertex farthest from the line between the ends if it's farther than the tolerance, and repeat on both
+  /// halves.
+  SKTSimplifyMethodDouglasPeucker,
+
+  /// Repeatedly drop the vertex that makes the smallest triangle with its neighbors, while that's less than the
+  /// square of the tolerance. Tends to keep the shape better than Douglas-Peucker at the same vertex count.
+  SKTSimplifyMethodVisvalingamWhyatt,
+
+  /// Douglas-Peucker, then fit runs of line segments between corners with cubic Béziers. Polylines, which can't hold
+  /// curves, get just the Douglas-Peucker.
+  SKTSimplifyMethodCurveFit,
+};
+
+/// The user default for the tolerance of the Simplify command, in document units. 0.5 if unset or not positive.
+extern NSString *const SKTSimplifyToleranceKey;
+
+/// The SKTSimplifyToleranceKey user default, or its default.
+CGFloat SKTSimplifyDefaultTolerance(void);
+
+/// What a simplification did.
+typedef struct SKTSimplifyReport {
+  NSUInteger originalVertexCount;
+  NSUInteger vertexCount;
+  /// The farthest any original vertex is from the simplified geometry. For curve fitting, a bound on it.
+  CGFloat maxDeviation;
+} SKTSimplifyReport;
+
+/// Both reports' counts added together, and the greater deviation.
+SKTSimplifyReport SKTSimplifyReportAdd(SKTSimplifyReport a, SKTSimplifyReport b);
+
+/// Set keep[i] for each of the count points to keep. The first and last are always kept. Returns how many are kept.
+/// Iterative, so a million points need no deep recursion. O(n log n): on input that would make it O(n²), the spans
+/// left once it has done a few n log n work are simplified by Visvalingam-Whyatt instead.
+NSUInteger SKTSimplifyDouglasPeucker(const CGPoint *pts, NSUInteger count, CGFloat tolerance, BOOL *keep);
+
+/// The same, by Visvalingam-Whyatt, with a heap of the triangle areas. O(n log n).
+NSUInteger SKTSimplifyVisvalingamWhyatt(const CGPoint *pts, NSUInteger count, CGFloat tolerance, BOOL *keep);
+
+/// The farthest of the points not kept from the segment between the kept points on either side of it.
+CGFloat SKTSimplifyMaxDeviation(const CGPoint *pts, NSUInteger count, const BOOL *keep);
+
+/// Fit the polyline through the count points with cubic Béziers, each within tolerance of the points it replaces,
+/// by Schneider's algorithm ("An Algorithm for Automatically Fitting Digitized Curves", Graphics Gems, 1990). The
+/// polyline is split at corners sharper than 45 degrees first, so walls stay square. Calls emit once per piece, in
+/// order, from the end of the one before; a piece that's straight to within the tolerance comes with isLine YES and
+/// its control points at its ends. Returns the greatest distance of any point from its fitted piece.
+CGFloat SKTFitCubics(const CGPoint *pts, NSUInteger count, CGFloat tolerance,
+                     void (NS_NOESCAPE ^emit)(BOOL isLine, CGPoint control1, CGPoint control2, CGPoint end));
+
+#if DEBUG
+/// Simplify a traced wall outline of pointCount points by each method. Logs the times, vertex reductions and
+/// deviations.
+void SKTSimplifyBenchmark(NSUInteger pointCount);
+#endif
+
+NS_ASSUME_NONNULL_END
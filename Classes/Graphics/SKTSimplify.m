@@ -0,0 +1,506 @@
+/*  SKTSimplify.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTSimplify.h"
+
+NSString *const SKTSimplifyToleranceKey = @"SKTSimplifyTolerance";
+
+CGFloat SKTSimplifyDefaultTolerance(void) {
+  double tolerance = [[NSUserDefaults standardUserDefaults] doubleForKey:SKTSimplifyToleranceKey];
+  return (0 < tolerance) ? tolerance : 0.5;
+}
+
+SKTSimplifyReport SKTSimplifyReportAdd(SKTSimplifyReport a, SKTSimplifyReport b) {
+  a.originalVertexCount += b.originalVertexCount;
+  a.vertexCount += b.vertexCount;
+  a.maxDeviation = MAX(a.maxDeviation, b.maxDeviation);
+  return a;
+}
+
+static CGFloat Dot(CGPoint a, CGPoint b) {
+  return a.x * b.x + a.y * b.y;
+}
+
+static CGPoint Sub(CGPoint a, CGPoint b) {
+  return CGPointMake(a.x - b.x, a.y - b.y);
+}
+
+static CGPoint AddScaled(CGPoint a, CGPoint b, CGFloat scale) {
+  return CGPointMake(a.x + b.x * scale, a.y + b.y * scale);
+}
+
+static CGFloat DistanceSquared(CGPoint a, CGPoint b) {
+  return Dot(Sub(a, b), Sub(a, b));
+}
+
+static CGPoint Normalized(CGPoint v) {
+  CGFloat length = sqrt(Dot(v, v));
+  return (0 < length) ? CGPointMake(v.x / length, v.y / length) : v;
+}
+
+// From p to the nearest point of the segment from a to b.
+static CGFloat SegmentDistanceSquared(CGPoint p, CGPoint a, CGPoint b) {
+  CGPoint ab = Sub(b, a);
+  CGFloat lengthSquared = Dot(ab, ab);
+  CGFloat t = (0 < lengthSquared) ? Dot(Sub(p, a), ab) / lengthSquared : 0;
+  t = MAX(0, MIN(1, t));
+  return DistanceSquared(p, AddScaled(a, ab, t));
+}
+
+#pragma mark - Douglas-Peucker
+
+enum {
+  // Point visits allowed per point per halving, before Douglas-Peucker gives the rest to Visvalingam-Whyatt.
+  kDouglasPeuckerVisitsPerLevel = 4
+};
+
+NSUInteger SKTSimplifyDouglasPeucker(const CGPoint *pts, NSUInteger count, CGFloat tolerance, BOOL *keep) {
+  if (count <= 2) {
+    memset(keep, YES, count * sizeof(BOOL));
+    return count;
+  }
+  memset(keep, NO, count * sizeof(BOOL));
+  keep[0] = keep[count - 1] = YES;
+  NSUInteger keptCount = 2;
+  CGFloat toleranceSquared = tolerance * tolerance;
+
+  // Each span costs a scan of its points. When the farthest point splits spans near their middles, as it does on
+  // traced walls, that's about n log n visits in all, but a spiral or zigzag that peels one point off a span at a time
+  // makes it n². So past a budget of a few n log n visits, each span left goes to Visvalingam-Whyatt, O(n log n).
+  NSUInteger visitBudget = kDouglasPeuckerVisitsPerLevel * count * (NSUInteger)ceil(log2(count));
+  NSUInteger visitCount = 0;
+
+  // The spans still to look at, as pairs of kept indexes. They never overlap, so there are never more than count.
+  NSUInteger capacity = 64;
+  NSUInteger *stack = malloc(capacity * 2 * sizeof(NSUInteger));
+  if (NULL == stack) {
+    [NSException raise:NSMallocException format:@"Could not simplify %lu points.", (unsigned long)count];
+  }
+  NSUInteger depth = 0;
+  stack[depth * 2] = 0;
+  stack[depth * 2 + 1] = count - 1;
+  depth += 1;
+  while (depth) {
+    depth -= 1;
+    NSUInteger first = stack[depth * 2];
+    NSUInteger last = stack[depth * 2 + 1];
+    visitCount += last - first - 1;
+    if (visitBudget < visitCount) {
+      // Its ends are kept already, and Visvalingam-Whyatt always keeps the ends of what it's given.
+      keptCount += SKTSimplifyVisvalingamWhyatt(pts + first, last - first + 1, tolerance, keep + first) - 2;
+      continue;
+    }
+    CGFloat farthest = 0;
+    NSUInteger farthestIndex = 0;
+    for (NSUInteger i = first + 1; i < last; ++i) {
+      CGFloat distanceSquared = SegmentDistanceSquared(pts[i], pts[first], pts[last]);
+      if (farthest < distanceSquared) {
+        farthest = distanceSquared;
+        farthestIndex = i;
+      }
+    }
+    if (toleranceSquared < farthest) {
+      keep[farthestIndex] = YES;
+      keptCount += 1;
+      if (capacity < depth + 2) {
+        capacity *= 2;
+        stack = reallocf(stack, capacity * 2 * sizeof(NSUInteger));
+        if (NULL == stack) {
+          [NSException raise:NSMallocException format:@"Could not simplify %lu points.", (unsigned long)count];
+        }
+      }
+      if (1 < farthestIndex - first) {
+        stack[depth * 2] = first;
+        stack[depth * 2 + 1] = farthestIndex;
+        depth += 1;
+      }
+      if (1 < last - farthestIndex) {
+        stack[depth * 2] = farthestIndex;
+        stack[depth * 2 + 1] = last;
+        depth += 1;
+      }
+    }
+  }
+  free(stack);
+  return keptCount;
+}
+
+#pragma mark - Visvalingam-Whyatt
+
+// A binary min-heap of point indexes by area, which knows where each index is so it can move one whose area changed.
+typedef struct AreaHeap {
+  NSUInteger *indexes;
+  NSUInteger *positions;
+  CGFloat *areas;
+  NSUInteger count;
+} AreaHeap;
+
+static void HeapSwap(AreaHeap *heap, NSUInteger a, NSUInteger b) {
+  NSUInteger index = heap->indexes[a];
+  heap->indexes[a] = heap->indexes[b];
+  heap->indexes[b] = index;
+  heap->positions[heap->indexes[a]] = a;
+  heap->positions[heap->indexes[b]] = b;
+}
+
+static void HeapSiftUp(AreaHeap *heap, NSUInteger position) {
+  while (0 < position) {
+    NSUInteger parent = (position - 1) / 2;
+    if (heap->areas[heap->indexes[parent]] <= heap->areas[heap->indexes[position]]) {
+      break;
+    }
+    HeapSwap(heap, parent, position);
+    position = parent;
+  }
+}
+
+static void HeapSiftDown(AreaHeap *heap, NSUInteger position) {
+  for (;;) {
+    NSUInteger smallest = position;
+    NSUInteger left = 2 * position + 1;
+    NSUInteger right = left + 1;
+    if (left < heap->count && heap->areas[heap->indexes[left]] < heap->areas[heap->indexes[smallest]]) {
+      smallest = left;
+    }
+    if (right < heap->count && heap->areas[heap->indexes[right]] < heap->areas[heap->indexes[smallest]]) {
+      smallest = right;
+    }
+    if (smallest == position) {
+      break;
+    }
+    HeapSwap(heap, smallest, position);
+    position = smallest;
+  }
+}
+
+static CGFloat TriangleArea(CGPoint a, CGPoint b, CGPoint c) {
+  return fabs((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y)) / 2;
+}
+
+NSUInteger SKTSimplifyVisvalingamWhyatt(const CGPoint *pts, NSUInteger count, CGFloat tolerance, BOOL *keep) {
+  memset(keep, YES, count * sizeof(BOOL));
+  if (count <= 2) {
+    return count;
+  }
+  NSUInteger *previous = malloc(count * sizeof(NSUInteger));
+  NSUInteger *next = malloc(count * sizeof(NSUInteger));
+  AreaHeap heap = {malloc(count * sizeof(NSUInteger)), malloc(count * sizeof(NSUInteger)), malloc(count * sizeof(CGFloat)), 0};
+  if (NULL == previous || NULL == next || NULL == heap.indexes || NULL == heap.positions || NULL == heap.areas) {
+    free(previous);
+    free(next);
+    free(heap.indexes);
+    free(heap.positions);
+    free(heap.areas);
+    [NSException raise:NSMallocException format:@"Could not simplify %lu points.", (unsigned long)count];
+  }
+  for (NSUInteger i = 1; i + 1 < count; ++i) {
+    previous[i] = i - 1;
+    next[i] = i + 1;
+    heap.areas[i] = TriangleArea(pts[i - 1], pts[i], pts[i + 1]);
+    heap.indexes[heap.count] = i;
+    heap.positions[i] = heap.count;
+    heap.count += 1;
+  }
+  for (NSUInteger position = heap.count / 2 + 1; 0 < position; --position) {
+    HeapSiftDown(&heap, position - 1);
+  }
+
+  // A point's area never counts as less than that of a point dropped before it, so dropping in order of area is the
+  // same as dropping in order of importance.
+  CGFloat threshold = tolerance * tolerance;
+  NSUInteger keptCount = count;
+  while (heap.count) {
+    NSUInteger i = heap.indexes[0];
+    CGFloat area = heap.areas[i];
+    if (threshold <= area) {
+      break;
+    }
+    heap.count -= 1;
+    HeapSwap(&heap, 0, heap.count);
+    HeapSiftDown(&heap, 0);
+    keep[i] = NO;
+    keptCount -= 1;
+    NSUInteger before = previous[i];
+    NSUInteger after = next[i];
+    if (0 < before) {
+      next[before] = after;
+      heap.areas[before] = MAX(area, TriangleArea(pts[previous[before]], pts[before], pts[after]));
+      HeapSiftUp(&heap, heap.positions[before]);
+      HeapSiftDown(&heap, heap.positions[before]);
+    }
+    if (after + 1 < count) {
+      previous[after] = before;
+      heap.areas[after] = MAX(area, TriangleArea(pts[before], pts[after], pts[next[after]]));
+      HeapSiftUp(&heap, heap.positions[after]);
+      HeapSiftDown(&heap, heap.positions[after]);
+    }
+  }
+  free(previous);
+  free(next);
+  free(heap.indexes);
+  free(heap.positions);
+  free(heap.areas);
+  return keptCount;
+}
+
+CGFloat SKTSimplifyMaxDeviation(const CGPoint *pts, NSUInteger count, const BOOL *keep) {
+  CGFloat deviationSquared = 0;
+  NSUInteger lastKept = 0;
+  for (NSUInteger i = 1; i < count; ++i) {
+    if (keep[i]) {
+      for (NSUInteger j = lastKept + 1; j < i; ++j) {
+        deviationSquared = MAX(deviationSquared, SegmentDistanceSquared(pts[j], pts[lastKept], pts[i]));
+      }
+      lastKept = i;
+    }
+  }
+  return sqrt(deviationSquared);
+}
+
+#pragma mark - Curve fitting
+
+static CGPoint BezierPoint(const CGPoint bezier[4], CGFloat t) {
+  CGFloat s = 1 - t;
+  CGFloat b0 = s * s * s;
+  CGFloat b1 = 3 * t * s * s;
+  CGFloat b2 = 3 * t * t * s;
+  CGFloat b3 = t * t * t;
+  return CGPointMake(b0 * bezier[0].x + b1 * bezier[1].x + b2 * bezier[2].x + b3 * bezier[3].x,
+                     b0 * bezier[0].y + b1 * bezier[1].y + b2 * bezier[2].y + b3 * bezier[3].y);
+}
+
+// The cubic from pts[first] to pts[last], leaving and arriving along the unit tangents, whose control points are a
+// least squares fit to the points at the parameters u.
+static void FitBezier(const CGPoint *pts, const CGFloat *u, NSUInteger first, NSUInteger last, CGPoint tangent1, CGPoint tangent2, CGPoint bezier[4]) {
+  CGPoint p0 = pts[first];
+  CGPoint p3 = pts[last];
+  CGFloat c00 = 0, c01 = 0, c11 = 0, x0 = 0, x1 = 0;
+  for (NSUInteger i = first; i <= last; ++i) {
+    CGFloat t = u[i];
+    CGFloat s = 1 - t;
+    CGFloat b0 = s * s * s;
+    CGFloat b1 = 3 * t * s * s;
+    CGFloat b2 = 3 * t * t * s;
+    CGFloat b3 = t * t * t;
+    CGPoint a1 = CGPointMake(tangent1.x * b1, tangent1.y * b1);
+    CGPoint a2 = CGPointMake(tangent2.x * b2, tangent2.y * b2);
+    c00 += Dot(a1, a1);
+    c01 += Dot(a1, a2);
+    c11 += Dot(a2, a2);
+    CGPoint rest = Sub(pts[i], CGPointMake(p0.x * (b0 + b1) + p3.x * (b2 + b3), p0.y * (b0 + b1) + p3.y * (b2 + b3)));
+    x0 += Dot(a1, rest);
+    x1 += Dot(a2, rest);
+  }
+  CGFloat determinant = c00 * c11 - c01 * c01;
+  CGFloat alpha1 = (0 != determinant) ? (x0 * c11 - x1 * c01) / determinant : 0;
+  CGFloat alpha2 = (0 != determinant) ? (c00 * x1 - c01 * x0) / determinant : 0;
+
+  // Fall back on a third of the chord when the fit is degenerate, or puts a control point behind its end.
+  CGFloat chord = sqrt(DistanceSquared(p0, p3));
+  CGFloat epsilon = 1.0e-6 * chord;
+  if (alpha1 < epsilon || alpha2 < epsilon) {
+    alpha1 = alpha2 = chord / 3;
+  }
+  bezier[0] = p0;
+  bezier[1] = AddScaled(p0, tangent1, alpha1);
+  bezier[2] = AddScaled(p3, tangent2, alpha2);
+  bezier[3] = p3;
+}
+
+// The largest squared distance of a point from the cubic at its parameter, and which point.
+static CGFloat FitError(const CGPoint *pts, const CGFloat *u, NSUInteger first, NSUInteger last, const CGPoint bezier[4], NSUInteger *outWorst) {
+  CGFloat worst = 0;
+  *outWorst = (first + last) / 2;
+  for (NSUInteger i = first + 1; i < last; ++i) {
+    CGFloat distanceSquared = DistanceSquared(BezierPoint(bezier, u[i]), pts[i]);
+    if (worst < distanceSquared) {
+      worst = distanceSquared;
+      *outWorst = i;
+    }
+  }
+  return worst;
+}
+
+// One Newton-Raphson step for each parameter toward the nearest point of the cubic to its point.
+static void Reparameterize(const CGPoint *pts, CGFloat *u, NSUInteger first, NSUInteger last, const CGPoint bezier[4]) {
+  CGPoint d1[3] = {Sub(bezier[1], bezier[0]), Sub(bezier[2], bezier[1]), Sub(bezier[3], bezier[2])};
+  CGPoint d2[2] = {Sub(d1[1], d1[0]), Sub(d1[2], d1[1])};
+  for (NSUInteger i = first; i <= last; ++i) {
+    CGFloat t = u[i];
+    CGFloat s = 1 - t;
+    CGPoint q = BezierPoint(bezier, t);
+    CGPoint q1 = CGPointMake(3 * (s * s * d1[0].x + 2 * s * t * d1[1].x + t * t * d1[2].x), 3 * (s * s * d1[0].y + 2 * s * t * d1[1].y + t * t * d1[2].y));
+    CGPoint q2 = CGPointMake(6 * (s * d2[0].x + t * d2[1].x), 6 * (s * d2[0].y + t * d2[1].y));
+    CGPoint error = Sub(q, pts[i]);
+    CGFloat denominator = Dot(q1, q1) + Dot(error, q2);
+    if (0 != denominator) {
+      u[i] = MAX(0, MIN(1, t - Dot(error, q1) / denominator));
+    }
+  }
+}
+
+typedef struct FitSpan {
+  NSUInteger first;
+  NSUInteger last;
+  CGPoint tangent1;
+  CGPoint tangent2;
+} FitSpan;
+
+CGFloat SKTFitCubics(const CGPoint *inPts, NSUInteger inCount, CGFloat tolerance, void (NS_NOESCAPE ^emit)(BOOL isLine, CGPoint control1, CGPoint control2, CGPoint end)) {
+  if (inCount < 2) {
+    return 0;
+  }
+  // Repeated points have no direction, so drop them.
+  CGPoint *pts = malloc(inCount * sizeof(CGPoint));
+  CGFloat *u = malloc(inCount * sizeof(CGFloat));
+  FitSpan *stack = malloc(inCount * sizeof(FitSpan));
+  if (NULL == pts || NULL == u || NULL == stack) {
+    free(pts);
+    free(u);
+    free(stack);
+    [NSException raise:NSMallocException format:@"Could not fit %lu points.", (unsigned long)inCount];
+  }
+  NSUInteger count = 0;
+  for (NSUInteger i = 0; i < inCount; ++i) {
+    if (0 == count || ! CGPointEqualToPoint(pts[count - 1], inPts[i])) {
+      pts[count++] = inPts[i];
+    }
+  }
+  if (1 == count) {
+    pts[count++] = inPts[inCount - 1];
+  }
+
+  CGFloat toleranceSquared = tolerance * tolerance;
+  CGFloat worstSquared = 0;
+  const CGFloat cornerCosine = M_SQRT1_2;
+  NSUInteger pieceStart = 0;
+  for (NSUInteger pieceEnd = 1; pieceEnd < count; ++pieceEnd) {
+    if (pieceEnd + 1 < count && cornerCosine <= Dot(Normalized(Sub(pts[pieceEnd], pts[pieceEnd - 1])), Normalized(Sub(pts[pieceEnd + 1], pts[pieceEnd])))) {
+      continue;
+    }
+
+    // pieceStart to pieceEnd has no corners. Fit it depth first, so the cubics come out in order.
+    NSUInteger depth = 0;
+    stack[depth++] = (FitSpan){pieceStart, pieceEnd, Normalized(Sub(pts[pieceStart + 1], pts[pieceStart])), Normalized(Sub(pts[pieceEnd - 1], pts[pieceEnd]))};
+    while (depth) {
+      FitSpan span = stack[--depth];
+      CGPoint bezier[4] = {pts[span.first], pts[span.first], pts[span.last], pts[span.last]};
+      CGFloat errorSquared = 0;
+      NSUInteger worst = span.first;
+      if (1 < span.last - span.first) {
+        // Chord length parameters.
+        u[span.first] = 0;
+        for (NSUInteger i = span.first + 1; i <= span.last; ++i) {
+          u[i] = u[i - 1] + sqrt(DistanceSquared(pts[i], pts[i - 1]));
+        }
+        for (NSUInteger i = span.first + 1; i <= span.last; ++i) {
+          u[i] /= u[span.last];
+        }
+        FitBezier(pts, u, span.first, span.last, span.tangent1, span.tangent2, bezier);
+        errorSquared = FitError(pts, u, span.first, span.last, bezier, &worst);
+
+        // Near enough that better parameters may make it good enough.
+        for (NSUInteger iteration = 0; toleranceSquared < errorSquared && errorSquared < 4 * toleranceSquared && iteration < 4; ++iteration) {
+          Reparameterize(pts, u, span.first, span.last, bezier);
+          FitBezier(pts, u, span.first, span.last, span.tangent1, span.tangent2, bezier);
+          errorSquared = FitError(pts, u, span.first, span.last, bezier, &worst);
+        }
+        if (toleranceSquared < errorSquared && span.first < worst && worst < span.last) {
+          CGPoint center = Normalized(Sub(pts[worst - 1], pts[worst + 1]));
+          stack[depth++] = (FitSpan){worst, span.last, CGPointMake(-center.x, -center.y), span.tangent2};
+          stack[depth++] = (FitSpan){span.first, worst, span.tangent1, center};
+          continue;
+        }
+      }
+      worstSquared = MAX(worstSquared, errorSquared);
+      BOOL isLine = SegmentDistanceSquared(bezier[1], bezier[0], bezier[3]) <= toleranceSquared && SegmentDistanceSquared(bezier[2], bezier[0], bezier[3]) <= toleranceSquared;
+      if (isLine) {
+        // The points are all within tolerance of the cubic, and it of its chord. Near enough.
+        emit(YES, bezier[0], bezier[3], bezier[3]);
+      } else {
+        emit(NO, bezier[1], bezier[2], bezier[3]);
+      }
+    }
+    pieceStart = pieceEnd;
+  }
+  free(pts);
+  free(u);
+  free(stack);
+  return sqrt(worstSquared);
+}
+
+#pragma mark - Benchmark
+
+#if DEBUG
+void SKTSimplifyBenchmark(NSUInteger pointCount) {
+  // A room 2000 by 1000 with a round bay window, traced with a little jitter, as a scan comes in.
+  CGPoint *pts = malloc(pointCount * sizeof(CGPoint));
+  BOOL *keep = malloc(pointCount * sizeof(BOOL));
+  srandom(1);
+  for (NSUInteger i = 0; i < pointCount; ++i) {
+    CGFloat t = 6000.0 * i / pointCount;
+    CGPoint pt;
+    if (t < 2000) {
+      pt = CGPointMake(t, 0);
+    } else if (t < 3000) {
+      pt = CGPointMake(2000, t - 2000);
+    } else if (t < 5000) {
+      // The far wall, with a bay window bowing out of its middle.
+      CGFloat x = 2000 - (t - 3000);
+      CGFloat bay = fabs(x - 1000) < 300 ? sqrt(300 * 300 - (x - 1000) * (x - 1000)) : 0;
+      pt = CGPointMake(x, 1000 + bay);
+    } else {
+      pt = CGPointMake(0, 1000 - (t - 5000));
+    }
+    pts[i] = CGPointMake(pt.x + 0.05 * random() / RAND_MAX, pt.y + 0.05 * random() / RAND_MAX);
+  }
+  const CGFloat tolerance = 0.5;
+
+  NSDate *start = [NSDate date];
+  NSUInteger kept = SKTSimplifyDouglasPeucker(pts, pointCount, tolerance, keep);
+  NSTimeInterval time = -[start timeIntervalSinceNow];
+  NSLog(@"Douglas-Peucker: %lu points to %lu in %.3fs, deviation %.3f", (unsigned long)pointCount, (unsigned long)kept, time, SKTSimplifyMaxDeviation(pts, pointCount, keep));
+
+  start = [NSDate date];
+  kept = SKTSimplifyVisvalingamWhyatt(pts, pointCount, tolerance, keep);
+  time = -[start timeIntervalSinceNow];
+  NSLog(@"Visvalingam-Whyatt: %lu points to %lu in %.3fs, deviation %.3f", (unsigned long)pointCount, (unsigned long)kept, time, SKTSimplifyMaxDeviation(pts, pointCount, keep));
+
+  // As SKTPath does it: half the tolerance to Douglas-Peucker, half to the fit.
+  start = [NSDate date];
+  kept = SKTSimplifyDouglasPeucker(pts, pointCount, tolerance / 2, keep);
+  CGFloat deviation = SKTSimplifyMaxDeviation(pts, pointCount, keep);
+  CGPoint *keptPts = malloc(kept * sizeof(CGPoint));
+  NSUInteger k = 0;
+  for (NSUInteger i = 0; i < pointCount; ++i) {
+    if (keep[i]) {
+      keptPts[k++] = pts[i];
+    }
+  }
+  __block NSUInteger lineCount = 0;
+  __block NSUInteger cubicCount = 0;
+  deviation += SKTFitCubics(keptPts, kept, tolerance / 2, ^(BOOL isLine, CGPoint control1, CGPoint control2, CGPoint end) {
+    if (isLine) {
+      lineCount += 1;
+    } else {
+      cubicCount += 1;
+    }
+  });
+  time = -[start timeIntervalSinceNow];
+  NSLog(@"Curve fit: %lu points to %lu lines and %lu cubics in %.3fs, deviation at most %.3f", (unsigned long)pointCount, (unsigned long)lineCount, (unsigned long)cubicCount, time, deviation);
+  free(keptPts);
+
+  // A zigzag whose teeth shrink along it, so each span's farthest point is next to its start, as Douglas-Peucker's
+  // worst case.
+  for (NSUInteger i = 0; i < pointCount; ++i) {
+    pts[i] = CGPointMake(i, (i % 2) ? 1.0e6 / (i + 1) : 0);
+  }
+  start = [NSDate date];
+  kept = SKTSimplifyDouglasPeucker(pts, pointCount, tolerance, keep);
+  time = -[start timeIntervalSinceNow];
+  NSLog(@"Douglas-Peucker, worst case: %lu points to %lu in %.3fs", (unsigned long)pointCount, (unsigned long)kept, time);
+  free(pts);
+  free(keep);
+}
+#endif
@@ -0,0 +1,44 @@
+/*  SKTSpatialIndex.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+@class SKTGraphic;
+@protocol SKTGraphicsOwner;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A uniform grid over the handle drawing bounds of an owner's graphics, so hit-testing, marquee selection and
+ draw culling only look at the graphics near the point or rect in question instead of all of them.
+
+ Built from a snapshot of the graphics array. The owner throws it away when graphics are inserted or removed, and
+ tells it about graphics whose drawing bounds change. Queries return indexes into that array, so enumerating
+ them in ascending order is front to back, as everywhere else in FloorSketch.
+ */
+@interface SKTSpatialIndex : NSObject
+
+/// Records [owner handleDrawingBoundsOfGraphic:] for each graphic.
+- (instancetype)initWithGraphics:(NSArray<SKTGraphic *> *)graphics owner:(id<SKTGraphicsOwner>)owner NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// The graphic now has handleDrawingBounds. Graphics not in the index are ignored.
+- (void)updateGraphic:(SKTGraphic *)graphic handleDrawingBounds:(NSRect)handleDrawingBounds;
+
+/// The same answer as testing NSIntersectsRect(rect, handleDrawingBounds) for every graphic.
+- (NSIndexSet *)indexesOfGraphicsIntersectingRect:(NSRect)rect;
+
+/// The same answer as testing NSPointInRect(point, handleDrawingBounds) for every graphic.
+- (NSIndexSet *)indexesOfGraphicsContainingPoint:(NSPoint)point;
+
+@end
+
+#if DEBUG
+/// Time point and rect queries through SKTSpatialIndex against the linear scans it replaced, over graphicCount
+/// small rectangles. Logs the result.
+void SKTSpatialIndexBenchmark(NSUInteger graphicCount);
+#endif
+
+NS_ASSUME_NONNULL_END
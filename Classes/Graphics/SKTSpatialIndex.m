@@ -0,0 +1,307 @@
+/*  SKTSpatialIndex.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTSpatialIndex.h"
+
+#import "SKTGraphic.h"
+#import "SKTGraphicsOwner.h"
+
+#if DEBUG
+#import "SKTRectangle.h"
+#endif
+
+enum {
+  // A graphic that would cover more cells than this goes in _largeIndexes instead, which every query checks.
+  kMaxCellsPerGraphic = 64,
+
+  // Keeps packed cell coordinates in 32 bits each, whatever the coordinates of a graphic.
+  kMaxCellCoordinate = 1 << 30
+};
+
+static const CGFloat kMinCellSize = 8;
+static const CGFloat kMaxCellSize = 1024;
+
+typedef struct SKTCellRange {
+  NSInteger minX;
+  NSInteger minY;
+  NSInteger maxX;
+  NSInteger maxY;
+} SKTCellRange;
+
+static NSInteger CellCoordinate(CGFloat v, CGFloat cellSize) {
+  CGFloat cell = floor(v / cellSize);
+  if ( ! (-kMaxCellCoordinate < cell)) {
+    return -kMaxCellCoordinate;
+  } else if ( ! (cell < kMaxCellCoordinate)) {
+    return kMaxCellCoordinate;
+  }
+  return (NSInteger)cell;
+}
+
+// Conservative: includes the cells a rect only touches at its edges.
+static SKTCellRange CellRangeOfRect(NSRect r, CGFloat cellSize) {
+  SKTCellRange range;
+  range.minX = CellCoordinate(NSMinX(r), cellSize);
+  range.minY = CellCoordinate(NSMinY(r), cellSize);
+  range.maxX = CellCoordinate(NSMaxX(r), cellSize);
+  range.maxY = CellCoordinate(NSMaxY(r), cellSize);
+  return range;
+}
+
+// As a double, since a huge rect could overflow an NSInteger.
+static double CellRangeCount(SKTCellRange range) {
+  return (double)(range.maxX - range.minX + 1) * (double)(range.maxY - range.minY + 1);
+}
+
+static NSNumber *CellKey(NSInteger x, NSInteger y) {
+  return @((long long)(((uint64_t)(uint32_t)x << 32) | (uint32_t)y));
+}
+
+// About the size of a typical graphic, but no smaller than the spacing between graphics if they were spread out evenly.
+static CGFloat CellSizeOfRects(const NSRect *rects, NSUInteger count) {
+  NSRect unionRect = NSZeroRect;
+  double totalSize = 0;
+  NSUInteger nonEmptyCount = 0;
+  for (NSUInteger i = 0; i < count; ++i) {
+    if ( ! NSIsEmptyRect(rects[i])) {
+      unionRect = nonEmptyCount ? NSUnionRect(unionRect, rects[i]) : rects[i];
+      totalSize += MAX(NSWidth(rects[i]), NSHeight(rects[i]));
+      nonEmptyCount += 1;
+    }
+  }
+  if (0 == nonEmptyCount) {
+    return kMinCellSize;
+  }
+  CGFloat typicalSize = totalSize / nonEmptyCount;
+  CGFloat spacing = sqrt(NSWidth(unionRect) * NSHeight(unionRect) / nonEmptyCount);
+  CGFloat cellSize = MAX(typicalSize, spacing);
+  return MIN(MAX(cellSize, kMinCellSize), kMaxCellSize);
+}
+
+@interface SKTSpatialIndex () {
+  // The graphics the indexes refer to. Retained, so the unretained keys of _graphicIndexes stay valid.
+  NSArray<SKTGraphic *> *_graphics;
+
+  // graphic -> 1 + its index in _graphics.
+  NSMapTable *_graphicIndexes;
+
+  // The handle drawing bounds of each graphic, in the order of _graphics.
+  NSRect *_rects;
+  NSUInteger _count;
+
+  CGFloat _cellSize;
+
+  // packed cell coordinates -> indexes of the graphics whose rects overlap that cell.
+  NSMutableDictionary<NSNumber *, NSMutableIndexSet *> *_cells;
+
+  NSMutableIndexSet *_largeIndexes;
+}
+@end
+
+@implementation SKTSpatialIndex
+
+- (instancetype)initWithGraphics:(NSArray<SKTGraphic *> *)graphics owner:(id<SKTGraphicsOwner>)owner {
+  self = [super init];
+  if (self) {
+    _graphics = [graphics copy];
+    _count = [_graphics count];
+    _rects = calloc(MAX(_count, 1), sizeof(NSRect));
+    _graphicIndexes = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsObjectPointerPersonality
+                                                valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsIntegerPersonality
+                                                    capacity:_count];
+    for (NSUInteger i = 0; i < _count; ++i) {
+      SKTGraphic *graphic = _graphics[i];
+      _rects[i] = [owner handleDrawingBoundsOfGraphic:graphic];
+      NSMapInsert(_graphicIndexes, (__bridge void *)graphic, (void *)(i + 1));
+    }
+    _cellSize = CellSizeOfRects(_rects, _count);
+    _cells = [NSMutableDictionary dictionary];
+    _largeIndexes = [NSMutableIndexSet indexSet];
+    for (NSUInteger i = 0; i < _count; ++i) {
+      [self insertIndex:i];
+    }
+  }
+  return self;
+}
+
+- (void)dealloc {
+  free(_rects);
+}
+
+- (void)insertIndex:(NSUInteger)index {
+  NSRect r = _rects[index];
+  if (NSIsEmptyRect(r)) {
+    return; // Never intersects anything.
+  }
+  SKTCellRange range = CellRangeOfRect(r, _cellSize);
+  if (kMaxCellsPerGraphic < CellRangeCount(range)) {
+    [_largeIndexes addIndex:index];
+    return;
+  }
+  for (NSInteger y = range.minY; y <= range.maxY; ++y) {
+    for (NSInteger x = range.minX; x <= range.maxX; ++x) {
+      NSNumber *key = CellKey(x, y);
+      NSMutableIndexSet *cell = _cells[key];
+      if (nil == cell) {
+        cell = [NSMutableIndexSet indexSet];
+        _cells[key] = cell;
+      }
+      [cell addIndex:index];
+    }
+  }
+}
+
+- (void)removeIndex:(NSUInteger)index {
+  NSRect r = _rects[index];
+  if (NSIsEmptyRect(r)) {
+    return;
+  }
+  SKTCellRange range = CellRangeOfRect(r, _cellSize);
+  if (kMaxCellsPerGraphic < CellRangeCount(range)) {
+    [_largeIndexes removeIndex:index];
+    return;
+  }
+  for (NSInteger y = range.minY; y <= range.maxY; ++y) {
+    for (NSInteger x = range.minX; x <= range.maxX; ++x) {
+      NSNumber *key = CellKey(x, y);
+      NSMutableIndexSet *cell = _cells[key];
+      [cell removeIndex:index];
+      if (cell && 0 == [cell count]) {
+        [_cells removeObjectForKey:key];
+      }
+    }
+  }
+}
+
+- (void)updateGraphic:(SKTGraphic *)graphic handleDrawingBounds:(NSRect)handleDrawingBounds {
+  NSUInteger indexPlusOne = (NSUInteger)NSMapGet(_graphicIndexes, (__bridge void *)graphic);
+  if (0 == indexPlusOne) {
+    return;
+  }
+  NSUInteger index = indexPlusOne - 1;
+  if ( ! NSEqualRects(_rects[index], handleDrawingBounds)) {
+    [self removeIndex:index];
+    _rects[index] = handleDrawingBounds;
+    [self insertIndex:index];
+  }
+}
+
+- (NSIndexSet *)indexesOfGraphicsIntersectingRect:(NSRect)rect {
+  NSMutableIndexSet *result = [NSMutableIndexSet indexSet];
+  if (NSIsEmptyRect(rect)) {
+    return result;
+  }
+  SKTCellRange range = CellRangeOfRect(rect, _cellSize);
+  if (_count < CellRangeCount(range)) {
+    // A rect this big, typically a redraw of the whole view, is quicker to answer by looking at every graphic.
+    for (NSUInteger i = 0; i < _count; ++i) {
+      if (NSIntersectsRect(rect, _rects[i])) {
+        [result addIndex:i];
+      }
+    }
+    return result;
+  }
+  NSMutableIndexSet *candidates = [_largeIndexes mutableCopy];
+  for (NSInteger y = range.minY; y <= range.maxY; ++y) {
+    for (NSInteger x = range.minX; x <= range.maxX; ++x) {
+      NSIndexSet *cell = _cells[CellKey(x, y)];
+      if (cell) {
+        [candidates addIndexes:cell];
+      }
+    }
+  }
+  for (NSUInteger i = [candidates firstIndex]; i != NSNotFound; i = [candidates indexGreaterThanIndex:i]) {
+    if (NSIntersectsRect(rect, _rects[i])) {
+      [result addIndex:i];
+    }
+  }
+  return result;
+}
+
+- (NSIndexSet *)indexesOfGraphicsContainingPoint:(NSPoint)point {
+  NSMutableIndexSet *candidates = [_largeIndexes mutableCopy];
+  NSIndexSet *cell = _cells[CellKey(CellCoordinate(point.x, _cellSize), CellCoordinate(point.y, _cellSize))];
+  if (cell) {
+    [candidates addIndexes:cell];
+  }
+  NSMutableIndexSet *result = [NSMutableIndexSet indexSet];
+  for (NSUInteger i = [candidates firstIndex]; i != NSNotFound; i = [candidates indexGreaterThanIndex:i]) {
+    if (NSPointInRect(point, _rects[i])) {
+      [result addIndex:i];
+    }
+  }
+  return result;
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+void SKTSpatialIndexBenchmark(NSUInteger graphicCount) {
+  enum { kQueryCount = 1000 };
+  // Spread the graphics out like the walls of a floor plan: lots of small things, evenly scattered.
+  CGFloat side = 20 * sqrt(MAX(graphicCount, 1));
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:graphicCount];
+  srandom(1);
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    SKTRectangle *rectangle = [[SKTRectangle alloc] init];
+    [rectangle setBounds:NSMakeRect(side * random() / RAND_MAX, side * random() / RAND_MAX, 12, 3)];
+    [graphics addObject:rectangle];
+  }
+  NSPoint points[kQueryCount];
+  NSRect rects[kQueryCount];
+  for (NSUInteger i = 0; i < kQueryCount; ++i) {
+    points[i] = NSMakePoint(side * random() / RAND_MAX, side * random() / RAND_MAX);
+    rects[i] = NSMakeRect(points[i].x, points[i].y, 100, 100);
+  }
+  id<SKTGraphicsOwner> owner = (id<SKTGraphicsOwner>)[[NSObject alloc] init];
+
+  NSUInteger scanHits = 0;
+  NSDate *start = [NSDate date];
+  for (NSUInteger q = 0; q < kQueryCount; ++q) {
+    for (SKTGraphic *graphic in graphics) {
+      if (NSPointInRect(points[q], [owner handleDrawingBoundsOfGraphic:graphic])) {
+        scanHits += 1;
+      }
+    }
+  }
+  NSTimeInterval scanPointTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  for (NSUInteger q = 0; q < kQueryCount; ++q) {
+    for (SKTGraphic *graphic in graphics) {
+      if (NSIntersectsRect(rects[q], [owner handleDrawingBoundsOfGraphic:graphic])) {
+        scanHits += 1;
+      }
+    }
+  }
+  NSTimeInterval scanRectTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  SKTSpatialIndex *index = [[SKTSpatialIndex alloc] initWithGraphics:graphics owner:owner];
+  NSTimeInterval buildTime = -[start timeIntervalSinceNow];
+
+  NSUInteger indexHits = 0;
+  start = [NSDate date];
+  for (NSUInteger q = 0; q < kQueryCount; ++q) {
+    indexHits += [[index indexesOfGraphicsContainingPoint:points[q]] count];
+  }
+  NSTimeInterval indexPointTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  for (NSUInteger q = 0; q < kQueryCount; ++q) {
+    indexHits += [[index indexesOfGraphicsIntersectingRect:rects[q]] count];
+  }
+  NSTimeInterval indexRectTime = -[start timeIntervalSinceNow];
+
+  NSLog(@"%lu graphics, %d queries each: scan point %.3fs rect %.3fs (%lu hits); index build %.3fs point %.4fs (%.0fx) rect %.4fs (%.0fx) (%lu hits)",
+    (unsigned long)graphicCount, kQueryCount,
+    scanPointTime, scanRectTime, (unsigned long)scanHits,
+    buildTime,
+    indexPointTime, indexPointTime ? scanPointTime / indexPointTime : 0,
+    indexRectTime, indexRectTime ? scanRectTime / indexRectTime : 0,
+    (unsigned long)indexHits);
+}
+#endif
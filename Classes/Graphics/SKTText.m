@@ -11,16 +11,8 @@
 
 #import "SKTText.h"
 
-@interface NSString(SKTText)
-- (NSString *)stringByAmpersandEncoding;
-@end
-@implementation NSString(SKTText)
-- (NSString *)stringByAmpersandEncoding {
-  return [[[self stringByReplacingOccurrencesOfString:@"&" withString:@"&amp;"]
-    stringByReplacingOccurrencesOfString:@"<" withString:@"&lt;"]
-    stringByReplacingOccurrencesOfString:@">" withString:@"&gt;"];
-}
-@end
+#import "SKTNativeFormat.h"
+#import "SKTSVGWriter.h"
 
 
 // String constants declared in the header. They may not be used by any other class in the project, but it's a good idea to provide and use them, if only to help prevent typos in source code.
@@ -124,24 +116,29 @@ NSString *const SKTTextContentsKey = @"contents";
 
 // Conformance to the NSTextStorageDelegate protocol.
 - (void)textStorageDidProcessEditing:(NSNotification *)notification {
+  // The text is saved as it is, whether or not the height changes to match it.
+  [self invalidateSerializationCache];
+
   // The work we're going to do here involves sending -glyphRangeForTextContainer: to a layout manager, but you can't send that message to a layout manager attached to a text storage that's still responding to -endEditing, so defer the work to a point where -endEditing has returned.
   [self performSelector:@selector(setHeightToMatchContents) withObject:nil afterDelay:0.0];
 }
 
-- (NSString *)asSVGString {
-   NSTextStorage *contents = [self contents];
-   NSString *s = [contents string];
-  return [NSString stringWithFormat:@"<text %@>%@</text>", [self svgAttributesString],
-    [s stringByAmpersandEncoding]];
+- (void)writeSVGToWriter:(SKTSVGWriter *)writer {
+  NSTextStorage *contents = [self contents];
+  [writer writeUTF8:"<text "];
+  [self writeSVGAttributesToWriter:writer];
+  [writer writeUTF8:">"];
+  [writer writeEscapedString:[contents string]];
+  [writer writeUTF8:"</text>"];
 }
 
-- (NSString *)svgAttributesString {
+- (void)writeSVGAttributesToWriter:(SKTSVGWriter *)writer {
   // TODO: font-family, font-size, font-weight, forecolor and back color.
-  NSString * s = @"style=\"stroke: black\"";
-
-  return [NSString stringWithFormat:@"x=\"%.5g\" y=\"%.5g\" %@",
-    self.bounds.origin.x, self.bounds.origin.y + self.bounds.size.height, s];
-
+  [writer writeUTF8:"x=\""];
+  [writer writeFloat:self.bounds.origin.x];
+  [writer writeUTF8:"\" y=\""];
+  [writer writeFloat:self.bounds.origin.y + self.bounds.size.height];
+  [writer writeUTF8:"\" style=\"stroke: black\""];
 }
 
 #pragma mark - Private KVC-Compliance for Public Properties
@@ -270,6 +267,33 @@ NSString *const SKTTextContentsKey = @"contents";
 }
 
 
+- (instancetype)initWithNativeDecoder:(SKTNativeDecoder *)decoder {
+
+  // The text is kept as an NSArchiver'd NSTextStorage, as in the property list format: it's rich text, and there's not enough of it in a floor plan to be worth a format of its own.
+  self = [super initWithNativeDecoder:decoder];
+  if (self) {
+    NSData *contentsData = [decoder readData];
+    if ([contentsData length]) {
+      NSTextStorage *contents = [NSUnarchiver unarchiveObjectWithData:contentsData];
+      if ([contents isKindOfClass:[NSTextStorage class]]) {
+        _contents = contents;
+        [_contents setDelegate:self];
+      } else {
+        [decoder markDamaged];
+      }
+    }
+  }
+  return self;
+
+}
+
+
+- (void)writeNativeToWriter:(SKTNativeWriter *)writer {
+  [super writeNativeToWriter:writer];
+  [writer writeData:[NSArchiver archivedDataWithRootObject:[self contents]]];
+}
+
+
 - (BOOL)isDrawingStroke {
 
   // We never draw a stroke on this kind of graphic.
@@ -286,6 +310,43 @@ NSString *const SKTTextContentsKey = @"contents";
 }
 
 
+// Text less than this many pixels high can't be read, so it's drawn as a box.
+static const CGFloat SKTTextMinimumReadablePixels = 4;
+
+- (BOOL)drawPlaceholderAtPixelsPerUnit:(CGFloat)pixelsPerUnit {
+  if ([super drawPlaceholderAtPixelsPerUnit:pixelsPerUnit]) {
+    return YES;
+  }
+  NSTextStorage *contents = [self contents];
+  if (0 == pixelsPerUnit || 0 == [contents length]) {
+    return NO;
+  }
+
+  // Laying out the text just to find out it can't be read would cost as much as drawing it, so go by the biggest font.
+  __block CGFloat pointSize = 0;
+  __block NSColor *textColor = nil;
+  [contents enumerateAttributesInRange:NSMakeRange(0, [contents length]) options:NSAttributedStringEnumerationLongestEffectiveRangeNotRequired usingBlock:^(NSDictionary *attributes, NSRange range, BOOL *stop) {
+    NSFont *font = attributes[NSFontAttributeName] ?: [NSFont fontWithName:@"Helvetica" size:12];
+    if (pointSize < [font pointSize]) {
+      pointSize = [font pointSize];
+      textColor = attributes[NSForegroundColorAttributeName];
+    }
+  }];
+  if (SKTTextMinimumReadablePixels <= pointSize * pixelsPerUnit) {
+    return NO;
+  }
+  NSRect bounds = [self bounds];
+  if ([self isDrawingFill]) {
+    [[self fillColor] set];
+    NSRectFill(bounds);
+  }
+  textColor = textColor ?: [NSColor blackColor];
+  [[textColor colorWithAlphaComponent:[textColor alphaComponent] * 0.25f] set];
+  NSRectFillUsingOperation(bounds, NSCompositeSourceOver);
+  return YES;
+}
+
+
 - (void)drawContentsInView:(NSView *)view rect:(NSRect)rect isBeingCreateOrEdited:(BOOL)isBeingCreatedOrEditing {
 
   // Draw the fill color if appropriate.
@@ -308,17 +369,19 @@ NSString *const SKTTextContentsKey = @"contents";
     NSTextStorage *contents = [self contents];
     if ([contents length]>0) {
 
-      // Get a layout manager, size its text container, and use it to draw text. -glyphRangeForTextContainer: forces layout and tells us how much of text fits in the container.
-      NSLayoutManager *layoutManager = [[self class] sharedLayoutManager];
-      NSTextContainer *textContainer = [layoutManager textContainers][0];
-      [textContainer setContainerSize:bounds.size];
-      [contents addLayoutManager:layoutManager];
-      NSRange glyphRange = [layoutManager glyphRangeForTextContainer:textContainer];
-      if (glyphRange.length > 0) {
-        [layoutManager drawBackgroundForGlyphRange:glyphRange atPoint:bounds.origin];
-        [layoutManager drawGlyphsForGlyphRange:glyphRange atPoint:bounds.origin];
+      // Get a layout manager, size its text container, and use it to draw text. -glyphRangeForTextContainer: forces layout and tells us how much of text fits in the container. The layout manager is shared by every SKTText, and raster export draws tiles on several threads, so they take turns.
+      @synchronized([SKTText class]) {
+        NSLayoutManager *layoutManager = [[self class] sharedLayoutManager];
+        NSTextContainer *textContainer = [layoutManager textContainers][0];
+        [textContainer setContainerSize:bounds.size];
+        [contents addLayoutManager:layoutManager];
+        NSRange glyphRange = [layoutManager glyphRangeForTextContainer:textContainer];
+        if (glyphRange.length > 0) {
+          [layoutManager drawBackgroundForGlyphRange:glyphRange atPoint:bounds.origin];
+          [layoutManager drawGlyphsForGlyphRange:glyphRange atPoint:bounds.origin];
+        }
+        [contents removeLayoutManager:layoutManager];
       }
-      [contents removeLayoutManager:layoutManager];
 
     }
 
@@ -0,0 +1,59 @@
+/*  SKTBatchConverter.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, SKTConvertFormat) {
+  SKTConvertFormatUnknown,
+  SKTConvertFormatNative,  // .floorsketch
+  SKTConvertFormatSVG,
+  SKTConvertFormatPNG      // write only
+};
+
+// By file name extension, since the converter has no NSWorkspace to ask about UTIs.
+SKTConvertFormat SKTConvertFormatOfPathExtension(NSString *extension);
+NSString *SKTConvertPathExtensionOfFormat(SKTConvertFormat format);
+
+// What happened to one file.
+@interface SKTConversion : NSObject
+@property(nonatomic, readonly) NSString *inputPath;
+@property(nonatomic, readonly) NSString *outputPath;
+@property(nonatomic, readonly) unsigned long long inputByteCount;
+@property(nonatomic, readonly) unsigned long long outputByteCount;
+@property(nonatomic, readonly) NSUInteger graphicCount;
+@property(nonatomic, readonly) NSTimeInterval readTime;
+@property(nonatomic, readonly) NSTimeInterval writeTime;
+// nil if the conversion worked.
+@property(nonatomic, readonly, nullable) NSError *error;
+@end
+
+/**
+ Converts FloorSketch and SVG files to FloorSketch, SVG or PNG files without any NSDocument or window, through the
+ same SKTDocumentFormat and SKTRenderingView code the app saves with. Files are converted on a pool of worker threads.
+ */
+@interface SKTBatchConverter : NSObject
+
+@property(nonatomic) SKTConvertFormat outputFormat;
+
+// The most files converted at once. 0, the default, means one per active processor.
+@property(nonatomic) NSUInteger workerCount;
+
+// Where the converted files go, named after their input files. nil, the default, means next to each input file.
+@property(nonatomic, copy, nullable) NSString *outputDirectory;
+
+// PNG pixels per point. Default 1.
+@property(nonatomic) CGFloat scale;
+
+// Write FloorSketch files in the version 2 property list format, for older versions of FloorSketch. Default NO.
+@property(nonatomic) BOOL writesPropertyList;
+
+// Returns one SKTConversion per path, in the same order. handler, if any, is called as each file finishes, on the
+// worker's thread, but never for two files at once.
+- (NSArray<SKTConversion *> *)convertPaths:(NSArray<NSString *> *)paths handler:(nullable void (^)(SKTConversion *conversion))handler;
+
+@end
+
+NS_ASSUME_NONNULL_END
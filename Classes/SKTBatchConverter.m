@@ -0,0 +1,183 @@
+/*  SKTBatchConverter.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTBatchConverter.h"
+
+#import "SKTDocumentFormat.h"
+#import "SKTDocumentSVG.h"
+#import "SKTError.h"
+#import "SKTRenderingView.h"
+#import "SKTSVGWriter.h"
+
+#include <stdatomic.h>
+
+SKTConvertFormat SKTConvertFormatOfPathExtension(NSString *extension) {
+  extension = [extension lowercaseString];
+  if ([extension isEqual:@"floorsketch"]) {
+    return SKTConvertFormatNative;
+  } else if ([extension isEqual:@"svg"]) {
+    return SKTConvertFormatSVG;
+  } else if ([extension isEqual:@"png"]) {
+    return SKTConvertFormatPNG;
+  }
+  return SKTConvertFormatUnknown;
+}
+
+NSString *SKTConvertPathExtensionOfFormat(SKTConvertFormat format) {
+  switch (format) {
+    case SKTConvertFormatNative: return @"floorsketch";
+    case SKTConvertFormatSVG: return @"svg";
+    case SKTConvertFormatPNG: return @"png";
+    default: return @"";
+  }
+}
+
+static unsigned long long FileSize(NSString *path) {
+  return [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL] fileSize];
+}
+
+@interface SKTConversion ()
+@property(nonatomic, readwrite) NSString *inputPath;
+@property(nonatomic, readwrite) NSString *outputPath;
+@property(nonatomic, readwrite) unsigned long long inputByteCount;
+@property(nonatomic, readwrite) unsigned long long outputByteCount;
+@property(nonatomic, readwrite) NSUInteger graphicCount;
+@property(nonatomic, readwrite) NSTimeInterval readTime;
+@property(nonatomic, readwrite) NSTimeInterval writeTime;
+@property(nonatomic, readwrite, nullable) NSError *error;
+@end
+
+@implementation SKTConversion
+@end
+
+@interface SKTBatchConverter () {
+  // For files that don't carry their own page setup: SVG files. Made once, on the calling thread.
+  NSPrintInfo *_defaultPrintInfo;
+}
+@end
+
+@implementation SKTBatchConverter
+
+- (instancetype)init {
+  self = [super init];
+  if (self) {
+    _outputFormat = SKTConvertFormatSVG;
+    _scale = 1;
+  }
+  return self;
+}
+
+- (NSString *)outputPathOfInputPath:(NSString *)inputPath {
+  NSString *name = [[[inputPath lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:SKTConvertPathExtensionOfFormat(_outputFormat)];
+  NSString *directory = _outputDirectory ?: [inputPath stringByDeletingLastPathComponent];
+  return [directory stringByAppendingPathComponent:name];
+}
+
+// Returns nil, and sets *outError, if the file can't be read.
+- (NSArray *)graphicsOfPath:(NSString *)path printInfo:(NSPrintInfo **)outPrintInfo error:(NSError **)outError {
+  NSArray *graphics = nil;
+  NSError *error = nil;
+  switch (SKTConvertFormatOfPathExtension([path pathExtension])) {
+    case SKTConvertFormatNative: {
+      NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:&error];
+      if (data && nil == [SKTDocumentFormat propertiesFromNativeData:data graphics:&graphics printInfo:outPrintInfo error:&error]) {
+        graphics = nil;
+      }
+      break;
+    }
+    case SKTConvertFormatSVG:
+      graphics = [SKTDocumentFormat graphicsSVGTypeFromStream:[NSInputStream inputStreamWithFileAtPath:path] printInfo:outPrintInfo error:&error];
+      break;
+    default:
+      break;
+  }
+  if (nil == graphics && outError) {
+    // The SVG reader reports nothing for a well formed file that just isn't SVG.
+    *outError = error ?: SKTErrorWithCode(SKTUnknownFileReadError);
+  }
+  return graphics;
+}
+
+// Returns NO, and sets *outError, if the file can't be written.
+- (BOOL)writeGraphics:(NSArray *)graphics printInfo:(NSPrintInfo *)printInfo toPath:(NSString *)path error:(NSError **)outError {
+  if (SKTConvertFormatNative == _outputFormat) {
+    NSData *data = _writesPropertyList ?
+        [SKTDocumentFormat propertyListDataWithGraphics:graphics printInfo:printInfo documentProperties:nil] :
+        [SKTDocumentFormat nativeDataWithGraphics:graphics printInfo:printInfo documentProperties:nil];
+    return [data writeToFile:path options:NSDataWritingAtomic error:outError];
+  }
+  NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+  BOOL didWrite = NO;
+  if (SKTConvertFormatSVG == _outputFormat) {
+    SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithOutputStream:stream];
+    didWrite = [SKTDocumentFormat writeSVGWithGraphics:graphics paperSize:[printInfo paperSize] toWriter:writer];
+    if ( ! didWrite && outError) {
+      *outError = [writer streamError];
+    }
+  } else {
+    didWrite = [SKTRenderingView writeGraphics:graphics type:SKTRasterTypePNG scale:_scale toStream:stream error:outError];
+  }
+  [stream close];
+  return didWrite;
+}
+
+- (SKTConversion *)convertPath:(NSString *)inputPath {
+  SKTConversion *conversion = [[SKTConversion alloc] init];
+  conversion.inputPath = inputPath;
+  conversion.outputPath = [self outputPathOfInputPath:inputPath];
+  conversion.inputByteCount = FileSize(inputPath);
+  if ([[conversion.outputPath stringByStandardizingPath] isEqual:[inputPath stringByStandardizingPath]]) {
+    conversion.error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteFileExistsError userInfo:@{NSFilePathErrorKey: inputPath}];
+    return conversion;
+  }
+  NSError *error = nil;
+  NSPrintInfo *printInfo = nil;
+  NSDate *start = [NSDate date];
+  NSArray *graphics = [self graphicsOfPath:inputPath printInfo:&printInfo error:&error];
+  conversion.readTime = -[start timeIntervalSinceNow];
+  if (nil == graphics) {
+    conversion.error = error;
+    return conversion;
+  }
+  conversion.graphicCount = [graphics count];
+  start = [NSDate date];
+  BOOL didWrite = [self writeGraphics:graphics printInfo:(printInfo ?: _defaultPrintInfo) toPath:conversion.outputPath error:&error];
+  conversion.writeTime = -[start timeIntervalSinceNow];
+  if (didWrite) {
+    conversion.outputByteCount = FileSize(conversion.outputPath);
+  } else {
+    conversion.error = error ?: [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSFilePathErrorKey: conversion.outputPath}];
+  }
+  return conversion;
+}
+
+// Same worker pool as SVG import's: each worker claims the next unconverted file until there are none.
+- (NSArray<SKTConversion *> *)convertPaths:(NSArray<NSString *> *)paths handler:(void (^)(SKTConversion *conversion))handler {
+  _defaultPrintInfo = [[NSPrintInfo sharedPrintInfo] copy];
+  NSUInteger count = [paths count];
+  NSMutableArray *conversions = [NSMutableArray arrayWithCapacity:count];
+  for (NSUInteger i = 0; i < count; ++i) {
+    [conversions addObject:[NSNull null]];
+  }
+  NSUInteger workerCount = _workerCount ?: [[NSProcessInfo processInfo] activeProcessorCount];
+  // dispatch_apply() returns only when every worker has, so the workers may share this counter on the stack.
+  atomic_size_t nextPath = 0;
+  atomic_size_t *nextPathp = &nextPath;
+  dispatch_apply(MIN(MAX(workerCount, 1), MAX(count, 1)), DISPATCH_APPLY_AUTO, ^(size_t worker) {
+    for (size_t i; (i = atomic_fetch_add(nextPathp, 1)) < count;) {
+      @autoreleasepool {
+        SKTConversion *conversion = [self convertPath:paths[i]];
+        @synchronized(conversions) {
+          conversions[i] = conversion;
+          if (handler) {
+            handler(conversion);
+          }
+        }
+      }
+    }
+  });
+  return conversions;
+}
+
+@end
@@ -0,0 +1,125 @@
+/* SKTConvertMain.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+
+ fsconvert: converts FloorSketch and SVG files without the app. See Usage() below.
+
+ macOS only. The converter's own interface is Foundation only, but the graphics it reads and writes are built on
+ AppKit and Core Graphics (NSBezierPath, NSColor, NSImage, NSLayoutManager), so there is no Foundation-only or GNUstep
+ build of it yet.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "SKTBatchConverter.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+static void Usage(void) {
+  fprintf(stderr,
+    "usage: fsconvert -t floorsketch|svg|png [-p] [-j workers] [-o directory] [-s scale] [-l listfile] [file ...]\n"
+    "  -t  the type to convert to\n"
+    "  -p  write FloorSketch files as version 2 property lists, for older versions of FloorSketch\n"
+    "  -j  how many files to convert at once (default: one per processor)\n"
+    "  -o  where to write the converted files (default: next to each file)\n"
+    "  -s  PNG pixels per point (default: 1)\n"
+    "  -l  a file of paths to convert, one per line, or - for standard input\n");
+}
+
+// The non-empty lines of the file at path, or of standard input for "-".
+static NSArray<NSString *> *PathsOfListFile(NSString *path) {
+  NSData *data = [path isEqual:@"-"] ? [[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile] : [NSData dataWithContentsOfFile:path];
+  if (nil == data) {
+    return nil;
+  }
+  NSString *list = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+  NSMutableArray *paths = [NSMutableArray array];
+  for (NSString *line in [list componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+    NSString *trimmed = [line stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    if ([trimmed length]) {
+      [paths addObject:trimmed];
+    }
+  }
+  return paths;
+}
+
+int main(int argc, char *const argv[]) {
+  @autoreleasepool {
+    SKTBatchConverter *converter = [[SKTBatchConverter alloc] init];
+    converter.outputFormat = SKTConvertFormatUnknown;
+    NSMutableArray<NSString *> *paths = [NSMutableArray array];
+    int option;
+    while (-1 != (option = getopt(argc, argv, "t:pj:o:s:l:"))) {
+      NSString *argument = optarg ? @(optarg) : nil;
+      switch (option) {
+        case 't':
+          converter.outputFormat = SKTConvertFormatOfPathExtension(argument);
+          break;
+        case 'p':
+          converter.writesPropertyList = YES;
+          break;
+        case 'j':
+          converter.workerCount = (NSUInteger)MAX([argument integerValue], 0);
+          break;
+        case 'o':
+          converter.outputDirectory = argument;
+          break;
+        case 's':
+          converter.scale = [argument doubleValue];
+          break;
+        case 'l': {
+          NSArray *listed = PathsOfListFile(argument);
+          if (nil == listed) {
+            fprintf(stderr, "fsconvert: can't read %s\n", optarg);
+            return 2;
+          }
+          [paths addObjectsFromArray:listed];
+          break;
+        }
+        default:
+          Usage();
+          return 2;
+      }
+    }
+    for (int i = optind; i < argc; ++i) {
+      [paths addObject:@(argv[i])];
+    }
+    if (SKTConvertFormatUnknown == converter.outputFormat || ! (0 < converter.scale) || 0 == [paths count]) {
+      Usage();
+      return 2;
+    }
+
+    NSError *error = nil;
+    if (converter.outputDirectory && ! [[NSFileManager defaultManager] createDirectoryAtPath:converter.outputDirectory withIntermediateDirectories:YES attributes:nil error:&error]) {
+      fprintf(stderr, "fsconvert: %s\n", [[error localizedDescription] UTF8String]);
+      return 2;
+    }
+
+    __block NSUInteger failureCount = 0;
+    NSDate *start = [NSDate date];
+    NSArray<SKTConversion *> *conversions = [converter convertPaths:paths handler:^(SKTConversion *conversion) {
+      if (conversion.error) {
+        failureCount += 1;
+        fprintf(stderr, "FAILED %s: %s\n", [conversion.inputPath UTF8String], [[conversion.error localizedDescription] UTF8String]);
+      } else {
+        printf("%9.1f ms %9.1f ms %8lu graphics  %s -> %s\n", conversion.readTime * 1000, conversion.writeTime * 1000,
+          (unsigned long)conversion.graphicCount, [conversion.inputPath UTF8String], [conversion.outputPath UTF8String]);
+      }
+      fflush(stdout);
+    }];
+    NSTimeInterval time = -[start timeIntervalSinceNow];
+
+    unsigned long long inputBytes = 0;
+    unsigned long long outputBytes = 0;
+    for (SKTConversion *conversion in conversions) {
+      inputBytes += conversion.inputByteCount;
+      outputBytes += conversion.outputByteCount;
+    }
+    printf("%lu files, %lu failed, in %.2f s: %.1f files/s, %.1f MB/s read, %.1f MB/s written\n",
+      (unsigned long)[conversions count], (unsigned long)failureCount, time,
+      time ? [conversions count] / time : 0,
+      time ? inputBytes / (1024.0 * 1024.0) / time : 0,
+      time ? outputBytes / (1024.0 * 1024.0) / time : 0);
+    return failureCount ? 1 : 0;
+  }
+}
@@ -0,0 +1,35 @@
+/*  SKTDamageRegion.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+// The parts of a view that need redrawing, as at most maximumRectCount disjoint rects. A rect that overlaps others, or
+// that would cost less to draw together with one than apart, is merged into it; past the limit, the two rects whose
+// union wastes the least area are merged. So a thousand overlapping rects for a thousand selected graphics come out
+// as a few, and no pixel is in more than one.
+@interface SKTDamageRegion : NSObject
+
+- (instancetype)initWithMaximumRectCount:(NSUInteger)maximumRectCount NS_DESIGNATED_INITIALIZER;
+
+// 16 rects.
+- (instancetype)init;
+
+- (void)addRect:(NSRect)rect;
+
+@property(nonatomic, readonly, getter=isEmpty) BOOL empty;
+
+// Calls block with each rect, then removes them all.
+- (void)flushUsingBlock:(void (NS_NOESCAPE ^)(NSRect rect))block;
+
+// Over the region's life: how many rects were added, and how many came out of -flushUsingBlock:.
+@property(nonatomic, readonly) NSUInteger submittedRectCount;
+@property(nonatomic, readonly) NSUInteger flushedRectCount;
+
+@end
+
+#if DEBUG
+// Logs how many rects come out of a region when rectCount handle rects of graphics in a grid, moved by a drag, go in,
+// and how long it takes.
+void SKTDamageRegionBenchmark(NSUInteger rectCount);
+#endif
@@ -0,0 +1,143 @@
+/*  SKTDamageRegion.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTDamageRegion.h"
+
+enum {
+  kDefaultMaximumRectCount = 16
+};
+
+// What redrawing one more rect costs, whatever its size, in square units of area: setting up its clip, and asking
+// every graphic near it to draw. Two rects are merged if their union is no bigger than they are plus this.
+static const CGFloat kRectOverheadArea = 32 * 32;
+
+static CGFloat Area(NSRect rect) {
+  return NSWidth(rect) * NSHeight(rect);
+}
+
+// How much more area the union of the rects covers than the rects themselves.
+static CGFloat WastedArea(NSRect a, NSRect b) {
+  return Area(NSUnionRect(a, b)) - Area(a) - Area(b) + Area(NSIntersectionRect(a, b));
+}
+
+static BOOL ShouldMerge(NSRect a, NSRect b) {
+  return NSIntersectsRect(a, b) || Area(NSUnionRect(a, b)) <= Area(a) + Area(b) + kRectOverheadArea;
+}
+
+@interface SKTDamageRegion () {
+  NSUInteger _maximumRectCount;
+  // Disjoint. One more than the maximum, for a rect on its way in.
+  NSRect *_rects;
+  NSUInteger _rectCount;
+}
+@end
+
+@implementation SKTDamageRegion
+
+- (instancetype)initWithMaximumRectCount:(NSUInteger)maximumRectCount {
+  self = [super init];
+  if (self) {
+    _maximumRectCount = MAX(maximumRectCount, 1);
+    _rects = malloc((_maximumRectCount + 1) * sizeof(NSRect));
+  }
+  return self;
+}
+
+- (instancetype)init {
+  return [self initWithMaximumRectCount:kDefaultMaximumRectCount];
+}
+
+- (void)dealloc {
+  free(_rects);
+}
+
+- (void)addRect:(NSRect)rect {
+  _submittedRectCount += 1;
+  if ( ! NSIsEmptyRect(rect)) {
+    [self insertRect:rect];
+    while (_maximumRectCount < _rectCount) {
+      [self mergeCheapestPair];
+    }
+  }
+}
+
+// Grow rect to take in every rect it should merge with, and every one the grown rect should merge with in turn, then
+// add it. What's left is disjoint from it.
+- (void)insertRect:(NSRect)rect {
+  BOOL didMerge;
+  do {
+    didMerge = NO;
+    for (NSUInteger i = 0; i < _rectCount; ) {
+      if (ShouldMerge(_rects[i], rect)) {
+        rect = NSUnionRect(rect, _rects[i]);
+        _rects[i] = _rects[--_rectCount];
+        didMerge = YES;
+      } else {
+        ++i;
+      }
+    }
+  } while (didMerge);
+  _rects[_rectCount++] = rect;
+}
+
+- (void)mergeCheapestPair {
+  NSUInteger cheapestI = 0;
+  NSUInteger cheapestJ = 1;
+  CGFloat cheapest = CGFLOAT_MAX;
+  for (NSUInteger i = 0; i < _rectCount; ++i) {
+    for (NSUInteger j = i + 1; j < _rectCount; ++j) {
+      CGFloat wasted = WastedArea(_rects[i], _rects[j]);
+      if (wasted < cheapest) {
+        cheapest = wasted;
+        cheapestI = i;
+        cheapestJ = j;
+      }
+    }
+  }
+  NSRect merged = NSUnionRect(_rects[cheapestI], _rects[cheapestJ]);
+  // Take out j first: it's the later of the two, so moving the last rect into its place leaves i where it is.
+  _rects[cheapestJ] = _rects[--_rectCount];
+  _rects[cheapestI] = _rects[--_rectCount];
+  [self insertRect:merged];
+}
+
+- (BOOL)isEmpty {
+  return 0 == _rectCount;
+}
+
+- (void)flushUsingBlock:(void (NS_NOESCAPE ^)(NSRect rect))block {
+  // Empty first, so the block may add rects of its own.
+  NSUInteger rectCount = _rectCount;
+  NSRect rects[rectCount ? rectCount : 1];
+  memcpy(rects, _rects, rectCount * sizeof(NSRect));
+  _rectCount = 0;
+  _flushedRectCount += rectCount;
+  for (NSUInteger i = 0; i < rectCount; ++i) {
+    block(rects[i]);
+  }
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+void SKTDamageRegionBenchmark(NSUInteger rectCount) {
+  // The old and new handle bounds of rectCount / 2 graphics, laid out like SKTGraphicChangeBusBenchmark's, each moved 5 units.
+  SKTDamageRegion *region = [[SKTDamageRegion alloc] init];
+  NSDate *start = [NSDate date];
+  for (NSUInteger i = 0; i < rectCount / 2; ++i) {
+    NSRect bounds = NSInsetRect(NSMakeRect(i % 1000 * 20, i / 1000 * 20, 12, 3), -3, -3);
+    [region addRect:bounds];
+    [region addRect:NSOffsetRect(bounds, 5, 5)];
+  }
+  __block CGFloat flushedArea = 0;
+  [region flushUsingBlock:^(NSRect rect) {
+    flushedArea += NSWidth(rect) * NSHeight(rect);
+  }];
+  NSTimeInterval time = -[start timeIntervalSinceNow];
+  NSLog(@"%lu rects submitted, %lu flushed, covering %.0f square units, in %.6fs",
+    (unsigned long)[region submittedRectCount], (unsigned long)[region flushedRectCount], flushedArea, time);
+}
+#endif
@@ -11,6 +11,8 @@
 
 #import <Cocoa/Cocoa.h>
 
+#import "SKTDocumentFormat.h"
+
 extern NSString *const SKTDocumentVisibleRulerKey;
 extern NSString *const SKTDocumentScaleKey;
 extern NSString *const SKTDocumentGridColorKey;
@@ -21,7 +23,6 @@ extern NSString *const SKTDocumentGridConstrainingKey;
 
 // The keys described down below.
 extern NSString *const SKTDocumentCanvasSizeKey;
-extern NSString *const SKTDocumentGraphicsKey;
 
 
 @interface SKTDocument : NSDocument
@@ -40,6 +41,9 @@ extern NSString *const SKTDocumentGraphicsKey;
 
 @property NSDictionary *propertiesWhileOpening;
 
+// The bytes undo is holding for changes of graphic properties. KVO compliant. The SKTUndoMegabytes user default caps it.
+@property (NS_NONATOMIC_IOSONLY, readonly) NSUInteger undoByteCount;
+
 // For applescripting the align verb.
 - (void)alignBottomEdgesOfGraphics:(NSArray *)array;
 - (void)alignHorizontalCentersOfGraphics:(NSArray *)array;
@@ -13,14 +13,17 @@
 
 #import "NSArray_SKT.h"
 #import "NSColor_SKT.h"
+#import "SKTDocumentFormat.h"
 #import "SKTDocumentSVG.h"
 #import "SKTError.h"
 #import "SKTGraphic.h"
+#import "SKTGraphicChangeBus.h"
 #import "SKTGraphicsOwner.h"
 #import "SKTGraphicView.h"
 #import "SKTGrid.h"
 #import "SKTGroup.h"
 #import "SKTRenderingView.h"
+#import "SKTSVGWriter.h"
 #import "SKTEllipse.h"
 #import "SKTImage.h"
 #import "SKTLine.h"
@@ -28,63 +31,29 @@
 #import "SKTPoly.h"
 #import "SKTRectangle.h"
 #import "SKTText.h"
+#import "SKTUndoJournal.h"
 #import "SKTWindowController.h"
 
 // Most of the scripting support is in SKTGraphicsOwner.h
 
-@interface SKTDocument()<SKTGraphicsOwner> {
+@interface SKTDocument()<SKTGraphicChangeObserver, SKTGraphicsOwner> {
   // The value underlying the key-value coding (KVC) and observing (KVO) compliance described below.
   NSMutableArray *_graphics;
 
-  // State that's used by the undo machinery. It all gets cleared out each time the undo manager sends a checkpoint notification. _undoGroupInsertedGraphics is the set of graphics that have been inserted, if any have been inserted. _undoGroupOldPropertiesPerGraphic is a dictionary whose keys are graphics and whose values are other dictionaries, each of which contains old values of graphic properties, if graphic properties have changed. It uses an NSMapTable instead of an NSMutableDictionary so we can set it up not to copy the graphics that are used as keys, something not possible with NSMutableDictionary. And then because NSMapTables were not objects in Mac OS 10.4 and earlier we have to wrap them in NSObjects that can be reference-counted by NSUndoManager, hence SKTMapTableOwner. _undoGroupPresentablePropertyName is the result of invoking +[SKTGraphic presentablePropertyNameForKey:] for changed graphics, if the result of each invocation has been the same so far, nil otherwise. _undoGroupHasChangesToMultipleProperties is YES if changes have been made to more than one property, as determined by comparing the results of invoking +[SKTGraphic presentablePropertyNameForKey:] for changed graphics, NO otherwise.
+  // Where the graphics post their changes, so the undo machinery below and the graphic views hear about them without registering anything per graphic.
+  SKTGraphicChangeBus *_graphicChangeBus;
+
+  // State that's used by the undo machinery. It all gets cleared out each time the undo manager sends a checkpoint notification, and the open entry of _undoJournal is closed. _undoGroupInsertedGraphics is the set of graphics that have been inserted, if any have been inserted. _undoJournal records old values of graphic properties, if graphic properties have changed, one compact entry per undo group. _undoGroupPresentablePropertyName is the result of invoking +[SKTGraphic presentablePropertyNameForKey:] for changed graphics, if the result of each invocation has been the same so far, nil otherwise. _undoGroupHasChangesToMultipleProperties is YES if changes have been made to more than one property, as determined by comparing the results of invoking +[SKTGraphic presentablePropertyNameForKey:] for changed graphics, NO otherwise.
   NSMutableSet *_undoGroupInsertedGraphics;
-  NSMutableDictionary *_undoGroupOldPropertiesPerGraphic; // Key is an SKTWrapper so we can copy it without copying the object it points to.
+  SKTUndoJournal *_undoJournal;
   NSString *_undoGroupPresentablePropertyName;
   BOOL _undoGroupHasChangesToMultipleProperties;
 
 }
 @end
 
-// like NSPointerValue, but retains its object. Doesn't copy the object.
-@interface SKTWrapper : NSObject < NSCopying>
-@property(strong) id retainedObjectValue;
-+ (instancetype)wrap:(id)object;
-@end
-
-@implementation SKTWrapper
-
-+ (instancetype)wrap:(id)object {
-  SKTWrapper *result = [[SKTWrapper alloc] init];
-  result.retainedObjectValue = object;
-  return result;
-}
-
-
-- (NSUInteger)hash {
-  return (NSUInteger)self.retainedObjectValue;
-}
-
-- (BOOL)isEqual:(id)object {
-  SKTWrapper *other = (SKTWrapper *)object;
-  return [self class] == [other class] && [self hash] == [other hash];
-}
-
-- (instancetype)copyWithZone:(NSZone *)zone {
-  SKTWrapper *result = [[SKTWrapper alloc] init];
-  result.retainedObjectValue = self.retainedObjectValue;
-  return result;
-}
-
-#if ! NDEBUG
-- (NSString *)description {
-  return [NSString stringWithFormat:@"<%@ %p<<%@>> >", [self class], self, [self retainedObjectValue]];
-}
-#endif
-@end
-
 // String constants declared in the header.
 NSString *const SKTDocumentCanvasSizeKey = @"canvasSize";
-NSString *const SKTDocumentGraphicsKey = @"graphics";
 NSString *const SKTDocumentVisibleRulerKey = @"visibleRuler";
 NSString *const SKTDocumentScaleKey = @"scale";
 NSString *const SKTDocumentGridColorKey = @"gridColor";
@@ -92,20 +61,9 @@ NSString *const SKTDocumentGridSpacingKey = @"gridSpacing";
 NSString *const SKTDocumentGridAlwaysShownKey = @"gridAlwaysShown";
 NSString *const SKTDocumentGridConstrainingKey = @"gridConstraining";
 
-// Values that are used as contexts by this class' invocation of KVO observer registration methods. See the comment near the top of SKTGraphicView.m for a discussion of this.
-static char *const SKTDocumentUndoKeysObservationContext = "com.turbozen.SKTDocument.undoKeys";
-static char *const SKTDocumentUndoObservationContext = "com.turbozen.SKTDocument.undo";
-
 // The document type names that must also be used in the application's Info.plist file. We'll take out all uses NSPDFPboardType and NSTIFFPboardType someday when we drop 10.4 compatibility and we can just use UTIs everywhere.
 static NSString *const SKTDocumentTypeName = @"com.turbozen.FloorSketch";
 
-// More keys, and a version number, which are just used in Sketch's property-list-based file format.
-static NSString *const SKTDocumentVersionKey = @"version";
-static NSString *const SKTDocumentPrintInfoKey = @"printInfo";
-static NSString *const SKTDocumentPropertiesKey = @"docProperties";
-
-static NSInteger SKTDocumentCurrentVersion = 2;
-
 @implementation SKTDocument
 @synthesize handleWidth;
 
@@ -114,6 +72,9 @@ static NSInteger SKTDocumentCurrentVersion = 2;
   self = [super init];
   if (self) {
     _graphics = [NSMutableArray array];
+    _undoJournal = [[SKTUndoJournal alloc] initWithUndoManager:[self undoManager]];
+    _graphicChangeBus = [[SKTGraphicChangeBus alloc] init];
+    [_graphicChangeBus addObserver:self];
     // Before anything undoable happens, register for a notification we need.
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(observeUndoManagerCheckpoint:) name:NSUndoManagerCheckpointNotification object:[self undoManager]];
   }
@@ -122,9 +83,6 @@ static NSInteger SKTDocumentCurrentVersion = 2;
 
 
 - (void)dealloc {
-  // Undo some of what we did in -insertGraphics:atIndexes:.
-  [self stopObservingGraphics:[self graphics]];
-
   // Undo what we did in -init.
   [[NSNotificationCenter defaultCenter] removeObserver:self name:NSUndoManagerCheckpointNotification object:[self undoManager]];
 }
@@ -185,60 +143,53 @@ static NSInteger SKTDocumentCurrentVersion = 2;
   NSWorkspace *workspace = [NSWorkspace sharedWorkspace];
   NSDictionary *properties = nil;
   if ([workspace type:typeName conformsToType:SKTDocumentTypeName]) {
-    properties = [self propertiesSKTDocumentTypeFromData:data graphics:&graphics printInfo:&printInfo error:outError];
+    properties = [SKTDocumentFormat propertiesFromNativeData:data graphics:&graphics printInfo:&printInfo error:outError];
   } else if ([workspace type:typeName conformsToType:(NSString *)kUTTypeScalableVectorGraphics]) {
-    graphics = [self graphicsSVGTypeFromData:data printInfo:&printInfo error:outError];
+    graphics = [SKTDocumentFormat graphicsSVGTypeFromData:data printInfo:&printInfo error:outError];
     if (graphics) {
       properties = @{};
     }
   }
   didReadSuccessfully = (nil != properties);
-
-  // Did the reading work? In this method we ought to either do nothing and return an error or overwrite every property of the document. Don't leave the document in a half-baked state.
   if (didReadSuccessfully) {
-
-    // Update the document's list of graphics by going through KVC-compliant mutation methods. KVO notifications will be automatically sent to observers (which does matter, because this might be happening at some time other than document opening; reverting, for instance). Update its page setup the regular way. Don't let undo actions get registered while doing any of this. The fact that we have to explicitly protect against useless undo actions is considered an NSDocument bug nowadays, and will someday be fixed.
-    [[self undoManager] disableUndoRegistration];
-    NSIndexSet *set = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [[self graphics] count])];
-    _propertiesWhileOpening = properties[SKTDocumentPropertiesKey];
-    if (set) {
-      [self removeGraphicsAtIndexes:set];
-    }
-    [self insertGraphics:graphics atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [graphics count])]];
-    [self setPrintInfo:printInfo];
-    [[self undoManager] enableUndoRegistration];
-
+    [self replaceContentsWithGraphics:graphics properties:properties printInfo:printInfo];
   } // else it was the responsibility of something in the previous paragraph to set *outError.
   return didReadSuccessfully;
 
 }
 
-- (NSDictionary *)propertiesSKTDocumentTypeFromData:(NSData *)data graphics:(NSArray **)outGraphics printInfo:(NSPrintInfo **)outPrintInfo error:(NSError **)outError {
- // The file uses FloorSketch's new format. Read in the property list.
-  NSDictionary *properties = [NSPropertyListSerialization propertyListFromData:data mutabilityOption:NSPropertyListImmutable format:NULL errorDescription:NULL];
-  if (properties) {
-    // Get the graphics. Strictly speaking the property list of an empty document should have an empty graphics array, not no graphics array, but we cope easily with either. Don't trust the type of something you get out of a property list unless you know your process created it or it was read from your application or framework's resources.
-    NSArray *graphicPropertiesArray = properties[SKTDocumentGraphicsKey];
-    NSArray *graphics = [graphicPropertiesArray isKindOfClass:[NSArray class]] ? [SKTGraphic graphicsWithProperties:graphicPropertiesArray] : @[];
-    if (outGraphics) {
-      *outGraphics = graphics;
-    }
-
-    // Get the page setup. There's no point in considering the opening of the document to have failed if we can't get print info. A more finished app might present a panel warning the user that something's fishy though.
-    NSData *printInfoData = properties[SKTDocumentPrintInfoKey];
-    NSPrintInfo *printInfo = [printInfoData isKindOfClass:[NSData class]] ? [NSUnarchiver unarchiveObjectWithData:printInfoData] : [[NSPrintInfo alloc] init];
-    if (outPrintInfo) {
-      *outPrintInfo = printInfo;
+// SVG files can be hundreds of megabytes, so rather than have NSDocument read the whole file into an NSData for -readFromData:ofType:error:, parse them straight from the file.
+- (BOOL)readFromURL:(NSURL *)url ofType:(NSString *)typeName error:(NSError **)outError {
+  NSWorkspace *workspace = [NSWorkspace sharedWorkspace];
+  if ([url isFileURL] && [workspace type:typeName conformsToType:(NSString *)kUTTypeScalableVectorGraphics]) {
+    NSPrintInfo *printInfo = nil;
+    NSArray *graphics = [SKTDocumentFormat graphicsSVGTypeFromStream:[NSInputStream inputStreamWithURL:url] printInfo:&printInfo error:outError];
+    if (graphics) {
+      [self replaceContentsWithGraphics:graphics properties:@{} printInfo:printInfo];
     }
-  } else if (outError) {
-
-    // If property list parsing fails we have no choice but to admit that we don't know what went wrong. The error description returned by +[NSPropertyListSerialization propertyListFromData:mutabilityOption:format:errorDescription:] would be pretty technical, and not the sort of thing that we should show to a user.
-    *outError = SKTErrorWithCode(SKTUnknownFileReadError);
-
+    return nil != graphics;
+  }
+  // FloorSketch files are mapped rather than read, so their images stay on disk until they're drawn.
+  if ([url isFileURL] && [workspace type:typeName conformsToType:SKTDocumentTypeName]) {
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:outError];
+    return data && [self readFromData:data ofType:typeName error:outError];
   }
-  return properties;
+  return [super readFromURL:url ofType:typeName error:outError];
 }
 
+// Called once reading has worked. When reading we ought to either do nothing and return an error or overwrite every property of the document. Don't leave the document in a half-baked state.
+- (void)replaceContentsWithGraphics:(NSArray *)graphics properties:(NSDictionary *)properties printInfo:(NSPrintInfo *)printInfo {
+  // Update the document's list of graphics by going through KVC-compliant mutation methods. KVO notifications will be automatically sent to observers (which does matter, because this might be happening at some time other than document opening; reverting, for instance). Update its page setup the regular way. Don't let undo actions get registered while doing any of this. The fact that we have to explicitly protect against useless undo actions is considered an NSDocument bug nowadays, and will someday be fixed.
+  [[self undoManager] disableUndoRegistration];
+  NSIndexSet *set = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [[self graphics] count])];
+  _propertiesWhileOpening = properties[SKTDocumentPropertiesKey];
+  if (set) {
+    [self removeGraphicsAtIndexes:set];
+  }
+  [self insertGraphics:graphics atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [graphics count])]];
+  [self setPrintInfo:printInfo];
+  [[self undoManager] enableUndoRegistration];
+}
 
 - (NSData *)dataOfType:(NSString *)typeName error:(NSError **)outError {
 
@@ -270,14 +221,6 @@ static NSInteger SKTDocumentCurrentVersion = 2;
 }
 
 - (NSData *)dataOfSKTDocumentTypeError:(NSError **)outError {
-  NSArray *graphics = [self graphics];
-  NSPrintInfo *printInfo = [self printInfo];
-
-  // Convert the contents of the document to a property list and then flatten the property list.
-  NSMutableDictionary *properties = [NSMutableDictionary dictionary];
-  properties[SKTDocumentVersionKey] = @(SKTDocumentCurrentVersion);
-  properties[SKTDocumentGraphicsKey] = [SKTGraphic propertiesWithGraphics:graphics];
-  properties[SKTDocumentPrintInfoKey] = [NSArchiver archivedDataWithRootObject:printInfo];
   NSMutableDictionary *docProperties = [NSMutableDictionary dictionary];
   SKTWindowController *controller = (SKTWindowController *)self.windowControllers.firstObject;
   if ([controller respondsToSelector:@selector(zoomFactor)]) {
@@ -301,30 +244,43 @@ static NSInteger SKTDocumentCurrentVersion = 2;
       docProperties[SKTDocumentGridColorKey] = [[grid color] asArchiveData];
     }
   }
-  properties[SKTDocumentPropertiesKey] = docProperties;
-  NSData *data = [NSPropertyListSerialization dataFromPropertyList:properties format:NSPropertyListBinaryFormat_v1_0 errorDescription:NULL];
-  return data;
+  return [SKTDocumentFormat nativeDataWithGraphics:[self graphics] printInfo:[self printInfo] documentProperties:docProperties];
 }
 
 - (NSData *)dataOfSVGTypeError:(NSError **)outError {
-  NSArray *graphics = [self graphics];
-  NSMutableArray *result = [NSMutableArray array];
-  NSPrintInfo *printInfo = [self printInfo];
-  [result addObject:[NSString stringWithFormat:
-@"<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
-"<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
-"\"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
-"<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"%dpx\" height=\"%dpx\" viewbox=\"0 0 %d %d\">",
-    (int)printInfo.paperSize.width, (int)printInfo.paperSize.height,
-    (int)printInfo.paperSize.width, (int)printInfo.paperSize.height]];
-
-  for (NSInteger i = ((NSInteger)[graphics count]) - 1;0 <= i; --i) {
-    SKTGraphic *graphic = graphics[i];
-    [result addObject:[graphic asSVGString]];
+  NSMutableData *data = [NSMutableData data];
+  [self writeSVGToWriter:[[SKTSVGWriter alloc] initWithMutableData:data]];
+  return data;
+}
+
+// Like -readFromURL:ofType:error:, SVG can be big enough that it's worth writing straight to the file rather than building it in memory for -dataOfType:error:. So can a PNG or TIFF, which SKTRenderingView encodes as it draws.
+- (BOOL)writeToURL:(NSURL *)url ofType:(NSString *)typeName error:(NSError **)outError {
+  NSWorkspace *workspace = [NSWorkspace sharedWorkspace];
+  if ([url isFileURL] && NSOrderedSame != [SKTDocumentTypeName caseInsensitiveCompare:typeName]) {
+    if ([workspace type:(NSString *)kUTTypeScalableVectorGraphics conformsToType:typeName]) {
+      NSOutputStream *stream = [NSOutputStream outputStreamWithURL:url append:NO];
+      SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithOutputStream:stream];
+      BOOL didWrite = [self writeSVGToWriter:writer];
+      [stream close];
+      if ( ! didWrite && outError) {
+        *outError = [writer streamError];
+      }
+      return didWrite;
+    }
+    BOOL isPNG = [workspace type:(NSString *)kUTTypePNG conformsToType:typeName];
+    if (isPNG || [workspace type:(NSString *)kUTTypeTIFF conformsToType:typeName]) {
+      NSOutputStream *stream = [NSOutputStream outputStreamWithURL:url append:NO];
+      BOOL didWrite = [SKTRenderingView writeGraphics:[self graphics] type:(isPNG ? SKTRasterTypePNG : SKTRasterTypeTIFF) scale:1 toStream:stream error:outError];
+      [stream close];
+      return didWrite;
+    }
   }
-  [result addObject:@"</svg>"];
-  NSString *s = [result componentsJoinedByString:@"\n"];
-  return [s dataUsingEncoding:NSUTF8StringEncoding];
+  return [super writeToURL:url ofType:typeName error:outError];
+}
+
+// Returns NO if the writer's stream failed.
+- (BOOL)writeSVGToWriter:(SKTSVGWriter *)writer {
+  return [SKTDocumentFormat writeSVGWithGraphics:[self graphics] paperSize:[[self printInfo] paperSize] toWriter:writer];
 }
 
 - (void)setPrintInfo:(NSPrintInfo *)printInfo {
@@ -377,14 +333,18 @@ static NSInteger SKTDocumentCurrentVersion = 2;
 #pragma mark - Undo
 
 
-- (void)setGraphicProperties:(NSMutableDictionary *)propertiesPerGraphic {
-  // The passed-in dictionary is keyed by graphic with values that are dictionaries of properties, keyed by key-value coding key.
-  for (SKTWrapper *graphicWrapper in propertiesPerGraphic){
-    NSDictionary *graphicProperties = propertiesPerGraphic[graphicWrapper];
-    SKTGraphic *graphic = (SKTGraphic *)[graphicWrapper retainedObjectValue];
-    // Use a relatively unpopular method. Here we're effectively "casting" a key path to a key (see how these dictionaries get built in -observeValueForKeyPath:ofObject:change:context:). It had better really be a key or things will get confused. For example, this is one of the things that would need updating if -[SKTGraphic keysForValuesToObserveForUndo] someday becomes -[SKTGraphic keyPathsForValuesToObserveForUndo].
-    [graphic setValuesForKeysWithDictionary:graphicProperties];
-  }
+- (NSUInteger)undoByteCount {
+  return [_undoJournal byteCount];
+}
+
+
++ (NSSet *)keyPathsForValuesAffectingUndoByteCount {
+  return [NSSet setWithObject:@"undoJournal.byteCount"];
+}
+
+
+- (SKTUndoJournal *)undoJournal {
+  return _undoJournal;
 }
 
 
@@ -392,158 +352,81 @@ static NSInteger SKTDocumentCurrentVersion = 2;
   // Start the coalescing of graphic property changes over.
   _undoGroupHasChangesToMultipleProperties = NO;
   _undoGroupPresentablePropertyName = nil;
-  _undoGroupOldPropertiesPerGraphic = nil;
+  [_undoJournal closeEntry];
   _undoGroupInsertedGraphics = nil;
 
 }
 
 
+// Nothing to register per graphic: every graphic inserted points back to this document as its scripting container, and so posts its changes to the change bus, which calls the method below.
 - (void)startObservingGraphics:(NSArray *)graphics {
-  // Each graphic can have a different set of properties that need to be observed.
-  NSUInteger graphicCount = [graphics count];
-  for (NSUInteger index = 0; index < graphicCount; index++) {
-    SKTGraphic *graphic = graphics[index];
-    NSSet *keys = [graphic keysForValuesToObserveForUndo];
-    NSEnumerator *keyEnumerator = [keys objectEnumerator];
-    NSString *key;
-    while (key = [keyEnumerator nextObject]) {
-      // We use NSKeyValueObservingOptionOld because when something changes we want to record the old value, which is what has to be set in the undo operation. We use NSKeyValueObservingOptionNew because we compare the new value against the old value in an attempt to ignore changes that aren't really changes.
-      [graphic addObserver:self forKeyPath:key options:(NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld) context:SKTDocumentUndoObservationContext];
-    }
-
-    // The set of properties to be observed can itself change.
-    [graphic addObserver:self forKeyPath:SKTGraphicKeysForValuesToObserveForUndoKey options:(NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld) context:SKTDocumentUndoKeysObservationContext];
-
-  }
-
 }
 
 
 - (void)stopObservingGraphics:(NSArray *)graphics {
-
-  // Do the opposite of what's done in -startObservingGraphics:.
-  NSUInteger graphicCount = [graphics count];
-  for (NSUInteger index = 0; index < graphicCount; index++) {
-    SKTGraphic *graphic = graphics[index];
-    [graphic removeObserver:self forKeyPath:SKTGraphicKeysForValuesToObserveForUndoKey];
-    NSSet *keys = [graphic keysForValuesToObserveForUndo];
-    NSEnumerator *keyEnumerator = [keys objectEnumerator];
-    NSString *key;
-    while (key = [keyEnumerator nextObject]) {
-      [graphic removeObserver:self forKeyPath:key];
-    }
-  }
 }
 
 
-// An override of the NSObject(NSKeyValueObserving) method.
-- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(NSObject *)observedObject change:(NSDictionary *)change context:(void *)context {
-
-  // Make sure we don't intercept an observer notification that's meant for NSDocument. In Mac OS 10.5 and earlier NSDocuments don't observe anything, but that could change in the future. We can do a simple pointer comparison because KVO doesn't do anything at all with the context value, not even retain or copy it.
-  if (context == SKTDocumentUndoKeysObservationContext) {
-
-    // The set of properties that we should be observing has changed for some graphic. Stop or start observing.
-    NSSet *oldKeys = change[NSKeyValueChangeOldKey];
-    NSSet *newKeys = change[NSKeyValueChangeNewKey];
-    NSString *key;
-    NSEnumerator *oldKeyEnumerator = [oldKeys objectEnumerator];
-    while (key = [oldKeyEnumerator nextObject]) {
-      if (![newKeys containsObject:key]) {
-        [observedObject removeObserver:self forKeyPath:key];
-      }
-    }
-    NSEnumerator *newKeyEnumerator = [newKeys objectEnumerator];
-    while (key = [newKeyEnumerator nextObject]) {
-      if (![oldKeys containsObject:key]) {
-        [observedObject addObserver:self forKeyPath:key options:(NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld) context:SKTDocumentUndoObservationContext];
-      }
-    }
-
-  } else if (context == SKTDocumentUndoObservationContext) {
-
-    // The value of some graphic's property has changed. Don't waste memory by recording undo operations affecting graphics that would be removed during undo anyway. In FloorSketch this check matters when you use a creation tool to create a new graphic and then drag the mouse to resize it; there's no reason to record a change of "bounds" in that situation.
-    SKTGraphic *graphic = (SKTGraphic *)observedObject;
-    if (![_undoGroupInsertedGraphics containsObject:graphic]) {
+- (SKTGraphicChangeBus *)graphicChangeBus {
+  return _graphicChangeBus;
+}
 
-      // Ignore changes that aren't really changes. Now that Sketch's inspector panel allows you to change a property of all selected graphics at once (it didn't always, as recently as the version that appears in Mac OS 10.4's /Developer/Examples/AppKit), it's easy for the user to cause a big batch of SKTGraphics to be sent -setValue:forKeyPath: messages that don't do anything useful. Try this simple example: create 10 ellipses, and set all but one to be filled. Select them all. In the inspector panel the Fill checkbox will show the mixed state indicator (a dash). Click on it. Cocoa's bindings machinery sends [theEllipse setValue:[NSNumber numberWithBOOL:YES] forKeyPath:SKTGraphicIsDrawingFillKey] to each selected ellipse. KVO faithfully notifies this SKTDocument, which is observing all of its graphics, for each ellipse object, even though the old value of the SKTGraphicIsDrawingFillKey property for 9 out of the 10 ellipses was already YES. If we didn't actively filter out useless notifications like these we would be wasting memory by recording undo operations that don't actually do anything.
-      // How much processor time does this memory optimization cost? We don't know, because we haven't measured it. The use of NSKeyValueObservingOptionNew in -startObservingGraphics:, which makes NSKeyValueChangeNewKey entries appear in change dictionaries, definitely costs something when KVO notifications are sent (it costs virtually nothing at observer registration time). Regardless, it's probably a good idea to do simple memory optimizations like this as they're discovered and debug just enough to confirm that they're saving the expected memory (and not introducing bugs). Later on it will be easier to test for good responsiveness and sample to hunt down processor time problems than it will be to figure out where all the darn memory went when your app turns out to be notably RAM-hungry (and therefore slowing down _other_ apps on your user's computers too, if the problem is bad enough to cause paging).
-      // Is this a premature optimization? No. Leaving out this very simple check, because we're worried about the processor time cost of using NSKeyValueChangeNewKey, would be a premature optimization.
-      id newValue = change[NSKeyValueChangeNewKey];
-      id oldValue = change[NSKeyValueChangeOldKey];
-      if (![newValue isEqualTo:oldValue]) {
 
-        // Is this the first observed graphic change in the current undo group?
-        NSUndoManager *undoManager = [self undoManager];
-        if (!_undoGroupOldPropertiesPerGraphic) {
+// Conformance to the SKTGraphicChangeObserver protocol.
+- (void)graphic:(SKTGraphic *)graphic didChangeValueForKey:(NSString *)key oldValue:(id)oldValue newValue:(id)newValue {
 
-          // We haven't recorded changes for any graphics at all since the last undo manager checkpoint. Get ready to start collecting them.
-          _undoGroupOldPropertiesPerGraphic = [[NSMutableDictionary alloc] init];
+  // The value of some graphic's property has changed. Don't waste memory by recording undo operations affecting graphics that would be removed during undo anyway. In FloorSketch this check matters when you use a creation tool to create a new graphic and then drag the mouse to resize it; there's no reason to record a change of "bounds" in that situation.
+  if (![_undoGroupInsertedGraphics containsObject:graphic]) {
 
-          // Register an undo operation for any graphic property changes that are going to be coalesced between now and the next invocation of -observeUndoManagerCheckpoint:.
-          [undoManager registerUndoWithTarget:self selector:@selector(setGraphicProperties:) object:_undoGroupOldPropertiesPerGraphic];
+    // Ignore changes that aren't really changes. Now that Sketch's inspector panel allows you to change a property of all selected graphics at once (it didn't always, as recently as the version that appears in Mac OS 10.4's /Developer/Examples/AppKit), it's easy for the user to cause a big batch of SKTGraphics to be sent -setValue:forKeyPath: messages that don't do anything useful. Try this simple example: create 10 ellipses, and set all but one to be filled. Select them all. In the inspector panel the Fill checkbox will show the mixed state indicator (a dash). Click on it. Cocoa's bindings machinery sends [theEllipse setValue:[NSNumber numberWithBOOL:YES] forKeyPath:SKTGraphicIsDrawingFillKey] to each selected ellipse. The change bus faithfully notifies this SKTDocument, which hears about all of its graphics, for each ellipse object, even though the old value of the SKTGraphicIsDrawingFillKey property for 9 out of the 10 ellipses was already YES. If we didn't actively filter out useless notifications like these we would be wasting memory by recording undo operations that don't actually do anything.
+    // How much processor time does this memory optimization cost? We don't know, because we haven't measured it. Fetching the new value in -[SKTGraphicChangeBus graphic:didChangeValueForKey:] definitely costs something every time a graphic changes. Regardless, it's probably a good idea to do simple memory optimizations like this as they're discovered and debug just enough to confirm that they're saving the expected memory (and not introducing bugs). Later on it will be easier to test for good responsiveness and sample to hunt down processor time problems than it will be to figure out where all the darn memory went when your app turns out to be notably RAM-hungry (and therefore slowing down _other_ apps on your user's computers too, if the problem is bad enough to cause paging).
+    // Is this a premature optimization? No. Leaving out this very simple check, because we're worried about the processor time cost of fetching the new value, would be a premature optimization.
+    if (![newValue isEqualTo:oldValue]) {
 
-        }
+      // Record the old value for the changed property in the current undo group's journal entry, unless an older value has already been recorded there. The first change in the group makes the entry and registers it with the undo manager.
+      NSUndoManager *undoManager = [self undoManager];
+      [[_undoJournal openEntry] recordOldValue:oldValue forKey:key ofGraphic:graphic];
 
-        // Find the dictionary in which we're recording the old values of properties for the changed graphic.
-        SKTWrapper *wrappedGraphic = [SKTWrapper wrap:graphic];
-        NSMutableDictionary *oldGraphicProperties = _undoGroupOldPropertiesPerGraphic[wrappedGraphic];
-        if (!oldGraphicProperties) {
+      // Don't set the undo action name during undoing and redoing. In FloorSketch, SKTGraphicView sometimes overwrites whatever action name we set up here with something more specific (as in, "Move" or "Resize" instead of "Change of Bounds"), but only during the building of the original undo action. During undoing and redoing SKTGraphicView doesn't get a chance to do that desirable overwriting again. Just leave the action name alone during undoing and redoing and the action name from the original undo group will continue to be used.
+      if (![undoManager isUndoing] && ![undoManager isRedoing]) {
 
-          // We have to create a dictionary to hold old values for the changed graphic. -[NSMutableDictionary setObject:forKey:] always makes a copy of the key object, but we don't want to make copies of SKTGraphics here, so we use SKTWrapper.
-          oldGraphicProperties = [[NSMutableDictionary alloc] init];
-          _undoGroupOldPropertiesPerGraphic[wrappedGraphic] = oldGraphicProperties;
+        // What's the human-readable name of the property that's just been changed?
+        Class graphicClass = [graphic class];
+        NSString *presentablePropertyName = [graphicClass presentablePropertyNameForKey:key];
+        if (!presentablePropertyName) {
 
-        }
+          // Someone overrode -[SKTGraphic keysForValuesToObserveForUndo] but didn't override +[SKTGraphic presentablePropertyNameForKey:] to match. Help debug a little. Hopefully the SKTGraphic public interface makes it so that you only have to test a little bit to find bugs like this.
+          NSString *graphicClassName = NSStringFromClass(graphicClass);
+          [NSException raise:NSInternalInconsistencyException format:@"[[%@ class] keysForValuesToObserveForUndo] returns a set that includes @\"%@\", but [[%@ class] presentablePropertyNameForKey:@\"%@\"] returns nil.", graphicClassName, key, graphicClassName, key];
 
-        // Record the old value for the changed property, unless an older value has already been recorded for the current undo group. Here we're "casting" a KVC key path to a dictionary key, but that should be OK. -[NSMutableDictionary setObject:forKey:] doesn't know the difference.
-        if (!oldGraphicProperties[keyPath]) {
-          oldGraphicProperties[keyPath] = oldValue;
         }
 
-        // Don't set the undo action name during undoing and redoing. In FloorSketch, SKTGraphicView sometimes overwrites whatever action name we set up here with something more specific (as in, "Move" or "Resize" instead of "Change of Bounds"), but only during the building of the original undo action. During undoing and redoing SKTGraphicView doesn't get a chance to do that desirable overwriting again. Just leave the action name alone during undoing and redoing and the action name from the original undo group will continue to be used.
-        if (![undoManager isUndoing] && ![undoManager isRedoing]) {
-
-          // What's the human-readable name of the property that's just been changed? Here we're effectively "casting" a key path to a key. It had better really be a key or things will get confused. For example, this is one of the things that would need updating if -[SKTGraphic keysForValuesToObserveForUndo] someday becomes -[SKTGraphic keyPathsForValuesToObserveForUndo].
-          Class graphicClass = [graphic class];
-          NSString *presentablePropertyName = [graphicClass presentablePropertyNameForKey:keyPath];
-          if (!presentablePropertyName) {
-
-            // Someone overrode -[SKTGraphic keysForValuesToObserveForUndo] but didn't override +[SKTGraphic presentablePropertyNameForKey:] to match. Help debug a little. Hopefully the SKTGraphic public interface makes it so that you only have to test a little bit to find bugs like this.
-            NSString *graphicClassName = NSStringFromClass(graphicClass);
-            [NSException raise:NSInternalInconsistencyException format:@"[[%@ class] keysForValuesToObserveForUndo] returns a set that includes @\"%@\", but [[%@ class] presentablePropertyNameForKey:@\"%@\"] returns nil.", graphicClassName, keyPath, graphicClassName, keyPath];
-
-          }
-
-          // Have we set an action name for the current undo group yet?
-          if (_undoGroupPresentablePropertyName || _undoGroupHasChangesToMultipleProperties) {
+        // Have we set an action name for the current undo group yet?
+        if (_undoGroupPresentablePropertyName || _undoGroupHasChangesToMultipleProperties) {
 
-            // Yes. Have we already determined that we have to use a generic undo action name, and set it? If so, there's nothing to do.
-            if (!_undoGroupHasChangesToMultipleProperties) {
+          // Yes. Have we already determined that we have to use a generic undo action name, and set it? If so, there's nothing to do.
+          if (!_undoGroupHasChangesToMultipleProperties) {
 
-              // So far we've set an action name for the current undo group that mentions a specific property. Is the property that's just been changed the same one mentioned in that action name (regardless of which graphic has been changed)? If so, there's nothing to do.
-              if (![_undoGroupPresentablePropertyName isEqualToString:presentablePropertyName]) {
+            // So far we've set an action name for the current undo group that mentions a specific property. Is the property that's just been changed the same one mentioned in that action name (regardless of which graphic has been changed)? If so, there's nothing to do.
+            if (![_undoGroupPresentablePropertyName isEqualToString:presentablePropertyName]) {
 
-                // The undo action is going to restore the old values of different properties. Set a generic undo action name and record the fact that we've done so.
-                [undoManager setActionName:NSLocalizedStringFromTable(@"Change of Multiple Graphic Properties", @"UndoStrings", @"Generic action name for complex graphic property changes.")];
-                _undoGroupHasChangesToMultipleProperties = YES;
+              // The undo action is going to restore the old values of different properties. Set a generic undo action name and record the fact that we've done so.
+              [undoManager setActionName:NSLocalizedStringFromTable(@"Change of Multiple Graphic Properties", @"UndoStrings", @"Generic action name for complex graphic property changes.")];
+              _undoGroupHasChangesToMultipleProperties = YES;
 
-                // This is useless now.
-                _undoGroupPresentablePropertyName = nil;
-              }
+              // This is useless now.
+              _undoGroupPresentablePropertyName = nil;
             }
-          } else {
+          }
+        } else {
 
-            // So far the action of the current undo group is going to be the restoration of the value of one property. Set a specific undo action name and record the fact that we've done so.
-            [undoManager setActionName:[NSString stringWithFormat:NSLocalizedStringFromTable(@"Change of %@", @"UndoStrings", @"Specific action name for simple graphic property changes. The argument is the name of a property."), presentablePropertyName]];
-            _undoGroupPresentablePropertyName = [presentablePropertyName copy];
+          // So far the action of the current undo group is going to be the restoration of the value of one property. Set a specific undo action name and record the fact that we've done so.
+          [undoManager setActionName:[NSString stringWithFormat:NSLocalizedStringFromTable(@"Change of %@", @"UndoStrings", @"Specific action name for simple graphic property changes. The argument is the name of a property."), presentablePropertyName]];
+          _undoGroupPresentablePropertyName = [presentablePropertyName copy];
 
-          }
         }
       }
     }
-  } else {
-    // In overrides of -observeValueForKeyPath:ofObject:change:context: always invoke super when the observer notification isn't recognized. Code in the superclass is apparently doing observation of its own. NSObject's implementation of this method throws an exception. Such an exception would be indicating a programming error that should be fixed.
-    [super observeValueForKeyPath:keyPath ofObject:observedObject change:change context:context];
   }
 }
 
@@ -0,0 +1,44 @@
+/*  SKTDocumentFormat.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+@class SKTSVGWriter;
+
+// Keys of FloorSketch's document properties: the whole of a version 2 file, and its 'DOCP' chunk since version 3.
+extern NSString *const SKTDocumentGraphicsKey;
+extern NSString *const SKTDocumentVersionKey;
+extern NSString *const SKTDocumentPrintInfoKey;
+extern NSString *const SKTDocumentPropertiesKey;
+
+extern const NSInteger SKTDocumentCurrentVersion;
+
+/**
+ Reading and writing the file formats of a FloorSketch document, given just its graphics and page setup. SKTDocument
+ does its reading and writing through this class, and so does the batch converter, which has no NSDocument.
+ SVG import is in SKTDocumentSVG.h.
+ */
+@interface SKTDocumentFormat : NSObject
+
+// FloorSketch's own format, version 3 (see SKTNativeFormat.h) or the property lists of version 2 and before. Returns the document properties, or nil and sets *outError if data is neither. A file without print info gets a new one. data may be mapped: images are left in it until drawn.
++ (NSDictionary *)propertiesFromNativeData:(NSData *)data graphics:(NSArray **)outGraphics printInfo:(NSPrintInfo **)outPrintInfo error:(NSError **)outError;
+
+// documentProperties are the window settings SKTDocument saves under SKTDocumentPropertiesKey. May be nil.
++ (NSData *)nativeDataWithGraphics:(NSArray *)graphics printInfo:(NSPrintInfo *)printInfo documentProperties:(NSDictionary *)documentProperties;
+
+// The same, as the version 2 property list, for the versions of FloorSketch before 3.
++ (NSData *)propertyListDataWithGraphics:(NSArray *)graphics printInfo:(NSPrintInfo *)printInfo documentProperties:(NSDictionary *)documentProperties;
+
+// An SVG document the size of the paper. Returns NO if the writer's stream failed.
++ (BOOL)writeSVGWithGraphics:(NSArray *)graphics paperSize:(NSSize)paperSize toWriter:(SKTSVGWriter *)writer;
+
+@end
+
+#if DEBUG
+// Save and open a synthetic plan of graphicCount graphics in the version 2 property list format and the version 3 chunked format. Logs file size, save and open times, and for version 3 the time to open just the directory and decode one graphic on demand.
+void SKTNativeFormatBenchmark(NSUInteger graphicCount);
+
+// Save a synthetic plan of graphicCount graphics in the native, property list and SVG formats: once, again unchanged, again after moving one graphic, and again with every graphic's cached serialization thrown away. Logs each save's time.
+void SKTIncrementalSaveBenchmark(NSUInteger graphicCount);
+#endif
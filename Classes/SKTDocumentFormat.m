@@ -0,0 +1,218 @@
+/*  SKTDocumentFormat.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTDocumentFormat.h"
+
+#import "SKTError.h"
+#import "SKTGraphic.h"
+#import "SKTNativeFormat.h"
+#import "SKTSVGWriter.h"
+
+#if DEBUG
+#import "SKTEllipse.h"
+#import "SKTImage.h"
+#import "SKTLine.h"
+#import "SKTPath.h"
+#import "SKTPoly.h"
+#import "SKTRectangle.h"
+#endif
+
+NSString *const SKTDocumentGraphicsKey = @"graphics";
+NSString *const SKTDocumentVersionKey = @"version";
+NSString *const SKTDocumentPrintInfoKey = @"printInfo";
+NSString *const SKTDocumentPropertiesKey = @"docProperties";
+
+const NSInteger SKTDocumentCurrentVersion = 3;
+
+// The last version whose files are property lists.
+static const NSInteger SKTDocumentPropertyListVersion = 2;
+
+@implementation SKTDocumentFormat
+
++ (NSDictionary *)propertiesFromNativeData:(NSData *)data graphics:(NSArray **)outGraphics printInfo:(NSPrintInfo **)outPrintInfo error:(NSError **)outError {
+  if ([SKTNativeReader isNativeData:data]) {
+    SKTNativeReader *reader = [[SKTNativeReader alloc] initWithData:data error:outError];
+    NSDictionary *properties = [reader properties];
+    if (properties) {
+      if (outGraphics) {
+        *outGraphics = [reader graphics];
+      }
+      if (outPrintInfo) {
+        *outPrintInfo = [self printInfoOfProperties:properties];
+      }
+    }
+    return properties;
+  }
+
+ // The file uses FloorSketch's version 2 format. Read in the property list.
+  NSDictionary *properties = [NSPropertyListSerialization propertyListFromData:data mutabilityOption:NSPropertyListImmutable format:NULL errorDescription:NULL];
+  if (properties) {
+    // Get the graphics. Strictly speaking the property list of an empty document should have an empty graphics array, not no graphics array, but we cope easily with either. Don't trust the type of something you get out of a property list unless you know your process created it or it was read from your application or framework's resources.
+    NSArray *graphicPropertiesArray = properties[SKTDocumentGraphicsKey];
+    NSArray *graphics = [graphicPropertiesArray isKindOfClass:[NSArray class]] ? [SKTGraphic graphicsWithProperties:graphicPropertiesArray] : @[];
+    if (outGraphics) {
+      *outGraphics = graphics;
+    }
+
+    if (outPrintInfo) {
+      *outPrintInfo = [self printInfoOfProperties:properties];
+    }
+  } else if (outError) {
+
+    // If property list parsing fails we have no choice but to admit that we don't know what went wrong. The error description returned by +[NSPropertyListSerialization propertyListFromData:mutabilityOption:format:errorDescription:] would be pretty technical, and not the sort of thing that we should show to a user.
+    *outError = SKTErrorWithCode(SKTUnknownFileReadError);
+
+  }
+  return properties;
+}
+
++ (NSPrintInfo *)printInfoOfProperties:(NSDictionary *)properties {
+  // Get the page setup. There's no point in considering the opening of the document to have failed if we can't get print info. A more finished app might present a panel warning the user that something's fishy though.
+  NSData *printInfoData = properties[SKTDocumentPrintInfoKey];
+  NSPrintInfo *printInfo = [printInfoData isKindOfClass:[NSData class]] ? [NSUnarchiver unarchiveObjectWithData:printInfoData] : nil;
+  return [printInfo isKindOfClass:[NSPrintInfo class]] ? printInfo : [[NSPrintInfo alloc] init];
+}
+
++ (NSData *)nativeDataWithGraphics:(NSArray *)graphics printInfo:(NSPrintInfo *)printInfo documentProperties:(NSDictionary *)documentProperties {
+  // Everything but the graphics and their colors and images is still a small property list, in a chunk of its own.
+  NSMutableDictionary *properties = [NSMutableDictionary dictionary];
+  properties[SKTDocumentVersionKey] = @(SKTDocumentCurrentVersion);
+  properties[SKTDocumentPrintInfoKey] = [NSArchiver archivedDataWithRootObject:printInfo];
+  properties[SKTDocumentPropertiesKey] = documentProperties ?: @{};
+  return SKTNativeDataWithGraphics(graphics, properties);
+}
+
++ (NSData *)propertyListDataWithGraphics:(NSArray *)graphics printInfo:(NSPrintInfo *)printInfo documentProperties:(NSDictionary *)documentProperties {
+  // Convert the contents of the document to a property list and then flatten the property list.
+  NSMutableDictionary *properties = [NSMutableDictionary dictionary];
+  properties[SKTDocumentVersionKey] = @(SKTDocumentPropertyListVersion);
+  properties[SKTDocumentGraphicsKey] = [SKTGraphic propertiesWithGraphics:graphics];
+  properties[SKTDocumentPrintInfoKey] = [NSArchiver archivedDataWithRootObject:printInfo];
+  properties[SKTDocumentPropertiesKey] = documentProperties ?: @{};
+  return [NSPropertyListSerialization dataFromPropertyList:properties format:NSPropertyListBinaryFormat_v1_0 errorDescription:NULL];
+}
+
++ (BOOL)writeSVGWithGraphics:(NSArray *)graphics paperSize:(NSSize)paperSize toWriter:(SKTSVGWriter *)writer {
+  [writer writeString:[NSString stringWithFormat:
+@"<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+"<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
+"\"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
+"<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"%dpx\" height=\"%dpx\" viewbox=\"0 0 %d %d\">",
+    (int)paperSize.width, (int)paperSize.height,
+    (int)paperSize.width, (int)paperSize.height]];
+
+  for (NSInteger i = ((NSInteger)[graphics count]) - 1;0 <= i; --i) {
+    SKTGraphic *graphic = graphics[i];
+    [writer writeUTF8:"\n"];
+    [graphic writeCachedSVGToWriter:writer];
+  }
+  [writer writeUTF8:"\n</svg>"];
+  return [writer finish];
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+// A plan of walls, columns, outlines and a few photos, in three colors.
+static NSArray *BenchmarkGraphics(NSUInteger graphicCount) {
+  NSArray *colors = @[[NSColor blackColor], [NSColor colorWithCalibratedRed:0.8 green:0.2 blue:0.1 alpha:1], [NSColor colorWithCalibratedRed:0.2 green:0.4 blue:0.9 alpha:0.5]];
+  NSBitmapImageRep *rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL pixelsWide:512 pixelsHigh:512 bitsPerSample:8 samplesPerPixel:4 hasAlpha:YES isPlanar:NO colorSpaceName:NSCalibratedRGBColorSpace bytesPerRow:0 bitsPerPixel:0];
+  memset([rep bitmapData], 0x80, [rep bytesPerRow] * 512);
+  NSImage *photo = [[NSImage alloc] initWithSize:NSMakeSize(512, 512)];
+  [photo addRepresentation:rep];
+  NSMutableString *pts = [NSMutableString string];
+  for (NSUInteger i = 0; i < 24; ++i) {
+    [pts appendFormat:@"%.5g,%.5g ", 100 + 90 * cos(i * M_PI / 12), 100 + 90 * sin(i * M_PI / 12)];
+  }
+  srandom(1);
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:graphicCount];
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    NSPoint origin = NSMakePoint(10000.0 * random() / RAND_MAX, 10000.0 * random() / RAND_MAX);
+    SKTGraphic *graphic = nil;
+    switch (i % 5) {
+      case 0: graphic = [[SKTRectangle alloc] init]; [graphic setBounds:NSMakeRect(origin.x, origin.y, 120, 3)]; break;
+      case 1: graphic = [[SKTEllipse alloc] init]; [graphic setBounds:NSMakeRect(origin.x, origin.y, 20, 20)]; break;
+      case 2: graphic = [[SKTPoly alloc] initWithProperties:@{SKTPolyPoints: pts}]; break;
+      case 3: graphic = [[SKTPath alloc] initWithProperties:@{SKTPathString: @"M10,10 L200,10 C250,10 250,60 200,60 L10,60 Z"}]; break;
+      default:
+        graphic = (0 == i % 5000) ? [[SKTImage alloc] initWithPosition:origin contents:photo] : [[SKTLine alloc] init];
+        if ([graphic isKindOfClass:[SKTLine class]]) {
+          [graphic setBounds:NSMakeRect(origin.x, origin.y, 40, 30)];
+        }
+        break;
+    }
+    [graphic setValue:colors[i % 3] forKey:SKTGraphicStrokeColorKey];
+    [graphics addObject:graphic];
+  }
+  return graphics;
+}
+
+void SKTNativeFormatBenchmark(NSUInteger graphicCount) {
+  NSArray *graphics = BenchmarkGraphics(graphicCount);
+  NSPrintInfo *printInfo = [[NSPrintInfo alloc] init];
+  NSString *const names[] = {@"version 2 property list", @"version 3 chunks"};
+  for (NSUInteger v = 0; v < 2; ++v) {
+    @autoreleasepool {
+      NSDate *start = [NSDate date];
+      NSData *data = v ? [SKTDocumentFormat nativeDataWithGraphics:graphics printInfo:printInfo documentProperties:nil] : [SKTDocumentFormat propertyListDataWithGraphics:graphics printInfo:printInfo documentProperties:nil];
+      NSTimeInterval saveTime = -[start timeIntervalSinceNow];
+      NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SKTNativeFormatBenchmark.floorsketch"];
+      [data writeToFile:path atomically:NO];
+
+      // Open as SKTDocument does: map the file, then decode the graphics.
+      start = [NSDate date];
+      NSData *mapped = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:NULL];
+      NSArray *readGraphics = nil;
+      [SKTDocumentFormat propertiesFromNativeData:mapped graphics:&readGraphics printInfo:NULL error:NULL];
+      NSTimeInterval openTime = -[start timeIntervalSinceNow];
+      NSLog(@"%@: %lu bytes (%.1f per graphic), save %.3fs, open %.3fs, %lu graphics read",
+        names[v], (unsigned long)[data length], (double)[data length] / MAX(graphicCount, 1), saveTime, openTime, (unsigned long)[readGraphics count]);
+      if (v) {
+        start = [NSDate date];
+        SKTNativeReader *reader = [[SKTNativeReader alloc] initWithData:mapped error:NULL];
+        NSTimeInterval directoryTime = -[start timeIntervalSinceNow];
+        start = [NSDate date];
+        [reader graphicAtIndex:[reader graphicCount] / 2];
+        NSLog(@"%@: directory and tables only %.6fs, one graphic on demand %.6fs", names[v], directoryTime, -[start timeIntervalSinceNow]);
+      }
+      [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    }
+  }
+}
+
+// Each way of saving, timed once.
+static void SaveGraphics(NSArray *graphics, NSPrintInfo *printInfo, NSTimeInterval times[3]) {
+  @autoreleasepool {
+    NSDate *start = [NSDate date];
+    [SKTDocumentFormat nativeDataWithGraphics:graphics printInfo:printInfo documentProperties:nil];
+    times[0] = -[start timeIntervalSinceNow];
+    start = [NSDate date];
+    [SKTDocumentFormat propertyListDataWithGraphics:graphics printInfo:printInfo documentProperties:nil];
+    times[1] = -[start timeIntervalSinceNow];
+    start = [NSDate date];
+    SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:[NSMutableData data]];
+    [SKTDocumentFormat writeSVGWithGraphics:graphics paperSize:[printInfo paperSize] toWriter:writer];
+    times[2] = -[start timeIntervalSinceNow];
+  }
+}
+
+void SKTIncrementalSaveBenchmark(NSUInteger graphicCount) {
+  NSArray *graphics = BenchmarkGraphics(graphicCount);
+  NSPrintInfo *printInfo = [[NSPrintInfo alloc] init];
+  NSString *const names[] = {@"first save", @"unchanged", @"one graphic moved", @"everything changed"};
+  NSTimeInterval times[4][3];
+  SaveGraphics(graphics, printInfo, times[0]);
+  SaveGraphics(graphics, printInfo, times[1]);
+  SKTGraphic *graphic = graphics[[graphics count] / 2];
+  [graphic setBounds:NSOffsetRect([graphic bounds], 5, 5)];
+  SaveGraphics(graphics, printInfo, times[2]);
+  [graphics makeObjectsPerformSelector:@selector(invalidateSerializationCache)];
+  SaveGraphics(graphics, printInfo, times[3]);
+  for (NSUInteger i = 0; i < 4; ++i) {
+    NSLog(@"%lu graphics, %@: native %.3fs, property list %.3fs, SVG %.3fs", (unsigned long)graphicCount, names[i], times[i][0], times[i][1], times[i][2]);
+  }
+}
+#endif
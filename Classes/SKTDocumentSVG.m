@@ -4,7 +4,7 @@
 #import "SKTDocumentSVG.h"
 
 #import "NSArray_SKT.h"
-#import "NSColor_SKT.h"
+#import "SKTColorTable.h"
 #import "SKTEllipse.h"
 #import "SKTGroup.h"
 #import "SKTImage.h"
@@ -12,205 +12,161 @@
 #import "SKTPath.h"
 #import "SKTPoly.h"
 #import "SKTRectangle.h"
+#import "SKTSVGStyle.h"
 #import "SKTText.h"
 
+#include <stdatomic.h>
 
 
-@interface NSXMLNode(SVG)
-- (CGFloat)svgFloatValue;
-@end
-@implementation NSXMLNode(SVG)
-- (CGFloat)svgFloatValue {
-  float result = 0;
-  NSScanner *scanner = [[NSScanner alloc] initWithString:[self stringValue]];
-  [scanner scanFloat:&result];
-  return result;
-}
-@end
 
-static NSImage *imageFromBase64String(NSString *base64) {
-  NSData *data = [[NSData alloc] initWithBase64EncodedString:base64 options:NSDataBase64DecodingIgnoreUnknownCharacters];
-  if (data) {
-    return [[NSImage alloc] initWithData:data];
-  }
-  return nil;
+static NSData *DataFromBase64String(NSString *base64) {
+  return [[NSData alloc] initWithBase64EncodedString:base64 options:NSDataBase64DecodingIgnoreUnknownCharacters];
 }
 
+// An element's attributes, read in one pass over them.
+typedef struct ElementAttributes {
+  // The attributes FloorSketch reads, by SKTSVGAttribute, nil for those the element doesn't have. The element owns them.
+  __unsafe_unretained NSXMLNode *nodes[SKTSVGAttributeCount];
+  // What the element inherited, with its presentation attributes applied, then its style declarations, which win.
+  SKTSVGPresentation presentation;
+} ElementAttributes;
 
-static NSColor *SVGColorFromString(NSString *s) {
-  NSColor *result = nil;
-  if ([s hasPrefix:@"#"]) {
-    if ([s length] == 4) {
-      int red, green, blue;
-      int count = sscanf([s UTF8String], "#%01x%01x%01x", &red, &green, &blue);
-      result = [NSColor colorWithCalibratedRed:red/15. green:green/15. blue:blue/15. alpha:1];
-      if (count != 3) {
-        NSLog(@"%d", count);
-      }
-    } else if ([s length] == 7) {
-      int red, green, blue;
-      int count = sscanf([s UTF8String], "#%02x%02x%02x", &red, &green, &blue);
-      result = [NSColor colorWithCalibratedRed:red/255. green:green/255. blue:blue/255. alpha:1];
-      if (count != 3) {
-        NSLog(@"%d", count);
-      }
-    }
-  } else if ([s isEqual:@"black"]) {
-    return [NSColor blackColor];
-  } else if([s isEqual:@"white"]) {
-    return [NSColor whiteColor];
-  } else if ([s isEqual:@"red"]) {
-    return [NSColor redColor];
-  } else if([s isEqual:@"green"]) {
-    return [NSColor greenColor];
-  } else if([s isEqual:@"blue"]) {
-    return [NSColor blueColor];
-  } else if([s hasPrefix:@"rgb"]) {
-    NSScanner *scanner = [[NSScanner alloc] initWithString:s];
-    [scanner scanString:@"rgb" intoString:NULL];
-    float red, green, blue;
-    NSInteger redDenom = 255, greenDenom = 255, blueDenom = 255;
-    if ( [scanner scanString:@"(" intoString:NULL] && [scanner scanFloat:&red]) {
-      if ([scanner scanString:@"%" intoString:NULL]) {
-        redDenom = 100;
-      }
-      if ( [scanner scanString:@"," intoString:NULL] && [scanner scanFloat:&green]) {
-        if ([scanner scanString:@"%" intoString:NULL]) {
-          greenDenom = 100;
-        }
-        if ( [scanner scanString:@"," intoString:NULL] && [scanner scanFloat:&blue]) {
-          if ([scanner scanString:@"%" intoString:NULL]) {
-            blueDenom = 100;
-          }
-          if ( [scanner scanString:@")" intoString:NULL]) {
-            result = [NSColor colorWithCalibratedRed:red/redDenom green:green/greenDenom blue:blue/blueDenom alpha:1];
-          }
+static void ReadAttributes(NSXMLElement *element, const SKTSVGPresentation *inherited, ElementAttributes *outAttributes) {
+  memset(outAttributes->nodes, 0, sizeof outAttributes->nodes);
+  outAttributes->presentation = *inherited;
+  for (NSXMLNode *attribute in [element attributes]) {
+    SKTSVGAttribute which = SKTSVGAttributeFromName([attribute name]);
+    if (SKTSVGAttributeUnknown != which) {
+      outAttributes->nodes[which] = attribute;
+      if (SKTSVGAttributeIsPresentation(which)) {
+        const char *value = [[attribute stringValue] UTF8String];
+        if (value) {
+          SKTSVGPresentationApply(&outAttributes->presentation, which, value, strlen(value));
         }
       }
     }
   }
-  return result;
+  const char *style = [[outAttributes->nodes[SKTSVGAttributeStyle] stringValue] UTF8String];
+  if (style) {
+    SKTSVGPresentationApplyStyle(&outAttributes->presentation, style, strlen(style));
+  }
 }
 
-// If they specified a color but an opacity of 0.0, then just turn off drawing of the fill or the stroke.
-static void AdjustOpacity(NSMutableDictionary *dict, NSString *hasColorKey, NSString *colorKey, CGFloat alpha) {
-  if (0.0 <= alpha && alpha < 1) {
-    NSColor *c = [NSColor colorWithArchiveData:dict[colorKey]];
-    if (c) {
-      dict[colorKey] = [c colorWithAlphaComponent:alpha];
-    }
-  } else if (0.0 == alpha) {
-    [dict removeObjectForKey:colorKey];
-    [dict removeObjectForKey:hasColorKey];
+static NSString *StringValue(const ElementAttributes *attributes, SKTSVGAttribute which) {
+  return [attributes->nodes[which] stringValue];
+}
+
+static CGFloat FloatValue(const ElementAttributes *attributes, SKTSVGAttribute which) {
+  return SKTSVGFloatValue(StringValue(attributes, which));
+}
+
+// A hidden or fully transparent paint turns off drawing of the fill or the stroke, as none does. Unspecified leaves the
+// graphic's own default.
+static void AddPaint(NSMutableDictionary *dict, SKTSVGPaint paint, CGFloat opacity, NSString *hasColorKey, NSString *colorKey) {
+  if (SKTSVGPaintKindNone == paint.kind || (SKTSVGPaintKindColor == paint.kind && 0 == opacity)) {
+    dict[hasColorKey] = @NO;
+  } else if (SKTSVGPaintKindColor == paint.kind) {
+    dict[hasColorKey] = @YES;
+    NSColor *color = [NSColor colorWithCalibratedRed:paint.red green:paint.green blue:paint.blue alpha:opacity];
+    // Every element of this color gets the same archive, and so the graphics made from them the same NSColor.
+    dict[colorKey] = [[SKTColorTable sharedColorTable] archiveDataOfColor:color];
   }
 }
 
-static void ColorValue(NSString *value, NSMutableDictionary * dict, NSString *hasColorKey, NSString *colorKey) {
-  if ([value length] && ! [value isEqual:@"none"]) {
-    NSColor *c = SVGColorFromString(value);
-    if (c) {
-      dict[hasColorKey] = @YES;
-      dict[colorKey] = [c asArchiveData];
-    }
+static NSMutableDictionary *StylePropertiesFromAttributes(const ElementAttributes *attributes) {
+  NSMutableDictionary *result = [NSMutableDictionary dictionary];
+  const SKTSVGPresentation *presentation = &attributes->presentation;
+  BOOL isHidden = presentation->isDisplayNone || presentation->isVisibilityHidden;
+  if (isHidden) {
+    result[SKTGraphicIsDrawingFillKey] = @NO;
+    result[SKTGraphicIsDrawingStrokeKey] = @NO;
+  } else {
+    AddPaint(result, presentation->fill, presentation->fillOpacity, SKTGraphicIsDrawingFillKey, SKTGraphicFillColorKey);
+    AddPaint(result, presentation->stroke, presentation->strokeOpacity, SKTGraphicIsDrawingStrokeKey, SKTGraphicStrokeColorKey);
   }
+  if (0 <= presentation->strokeWidth) {
+    result[SKTGraphicStrokeWidthKey] = @(presentation->strokeWidth);
+  }
+  return result;
 }
 
-// Convert a string to a positive floating point number. Returns -1 on failure.
-static float PositiveFloatValue(NSString *value) {
-  if ([value length]) {
-    NSScanner *number = [[NSScanner alloc] initWithString:value];
-    float n;
-    if ([number scanFloat:&n] && 0.0 <= n) {
-      return n;
+// An SVG transform list, such as "translate(10,20) rotate(45)", as one transform. Returns NO if it is malformed.
+static BOOL TransformFromString(NSString *s, CGAffineTransform *outTransform) {
+  CGAffineTransform result = CGAffineTransformIdentity;
+  NSScanner *scanner = [[NSScanner alloc] initWithString:s];
+  NSMutableCharacterSet *skipChars = [NSMutableCharacterSet whitespaceAndNewlineCharacterSet];
+  [skipChars addCharactersInString:@","];
+  [scanner setCharactersToBeSkipped:skipChars];
+  while ( ! [scanner isAtEnd]) {
+    NSString *name;
+    if ( ! ([scanner scanCharactersFromSet:[NSCharacterSet letterCharacterSet] intoString:&name] && [scanner scanString:@"(" intoString:NULL])) {
+      return NO;
+    }
+    double args[6];
+    NSUInteger argCount = 0;
+    while (argCount < 6 && [scanner scanDouble:&args[argCount]]) {
+      argCount += 1;
+    }
+    if ( ! [scanner scanString:@")" intoString:NULL]) {
+      return NO;
+    }
+    CGAffineTransform transform;
+    if ([name isEqual:@"matrix"] && 6 == argCount) {
+      transform = CGAffineTransformMake(args[0], args[1], args[2], args[3], args[4], args[5]);
+    } else if ([name isEqual:@"translate"] && (1 == argCount || 2 == argCount)) {
+      transform = CGAffineTransformMakeTranslation(args[0], (2 == argCount) ? args[1] : 0);
+    } else if ([name isEqual:@"scale"] && (1 == argCount || 2 == argCount)) {
+      transform = CGAffineTransformMakeScale(args[0], (2 == argCount) ? args[1] : args[0]);
+    } else if ([name isEqual:@"rotate"] && (1 == argCount || 3 == argCount)) {
+      transform = CGAffineTransformMakeRotation(args[0] * M_PI / 180);
+      if (3 == argCount) {
+        // About (cx, cy): translate(cx, cy) rotate(a) translate(-cx, -cy).
+        transform = CGAffineTransformConcat(CGAffineTransformConcat(CGAffineTransformMakeTranslation(-args[1], -args[2]), transform), CGAffineTransformMakeTranslation(args[1], args[2]));
+      }
+    } else if ([name isEqual:@"skewX"] && 1 == argCount) {
+      transform = CGAffineTransformMake(1, 0, tan(args[0] * M_PI / 180), 1, 0, 0);
+    } else if ([name isEqual:@"skewY"] && 1 == argCount) {
+      transform = CGAffineTransformMake(1, tan(args[0] * M_PI / 180), 0, 1, 0, 0);
+    } else {
+      return NO;
     }
+    // Each transform in the list applies to the points before the ones to its left do.
+    result = CGAffineTransformConcat(transform, result);
   }
-  return -1;
+  *outTransform = result;
+  return YES;
 }
 
-// TODO: this should loop over the attributes, looking each one up. Not do multiple linear searches.
-static NSMutableDictionary *StylePropertiesFromAttributes(NSXMLElement *element) {
-  NSMutableDictionary *result = [NSMutableDictionary dictionary];
-  NSString *s;
-  float n;
-  CGFloat strokeOpacity = 1;
-  CGFloat fillOpacity = 1;
-  s = [[element attributeForName:@"fill"] stringValue];
-  ColorValue(s, result, SKTGraphicIsDrawingFillKey, SKTGraphicFillColorKey);
-  s = [[element attributeForName:@"stroke"] stringValue];
-  ColorValue(s, result, SKTGraphicIsDrawingStrokeKey, SKTGraphicStrokeColorKey);
-  if (0 <= (n = PositiveFloatValue([[element attributeForName:@"stroke-width"] stringValue]))) {
-    result[SKTGraphicStrokeWidthKey] = @(n);
-  }
-  if (0 <= (n = PositiveFloatValue([[element attributeForName:@"fill-opacity"] stringValue])) && n <= 1) {
-    fillOpacity = n;
-  }
-  if (0 <= (n = PositiveFloatValue([[element attributeForName:@"stroke-opacity"] stringValue])) && n <= 1) {
-    strokeOpacity = n;
-  }
-  s = [[element attributeForName:@"transform"] stringValue];
-  if ([s length]) {
-    NSLog(@"\n'%@' transform attribute ignored. TODO: fix this.", element.name);
-  }
-  s = [[element attributeForName:@"style"] stringValue];
+// Apply the transform attribute of element to the graphic made from it. Done once the graphic exists, so a <g>'s
+// transform applies after those of its children, as SVG nests them.
+static void ApplyTransformOfElement(SKTGraphic *graphic, NSXMLElement *element, const ElementAttributes *attributes) {
+  NSString *s = StringValue(attributes, SKTSVGAttributeTransform);
   if ([s length]) {
-    NSScanner *clause = [[NSScanner alloc] initWithString:s];
-    NSMutableCharacterSet *keyChars = [NSMutableCharacterSet alphanumericCharacterSet];
-    [keyChars addCharactersInString:@"-+_"];
-    while ( ! [clause isAtEnd]) {
-      NSString *key;
-      NSString *value;
-      if ( ! [clause scanCharactersFromSet:keyChars intoString:&key]) {
-        break;
-      }
-      if (! [clause scanString:@":" intoString:NULL]) {
-        break;
-      }
-      if (! [clause scanUpToString:@";" intoString:&value]) {
-        break;
-      }
-      [clause scanString:@";" intoString:NULL];
-      if ([key isEqual:@"fill"]) {
-        ColorValue(value, result, SKTGraphicIsDrawingFillKey, SKTGraphicFillColorKey);
-      } else if ([key isEqual:@"stroke"]) {
-        ColorValue(value, result, SKTGraphicIsDrawingStrokeKey, SKTGraphicStrokeColorKey);
-      } else if ([key isEqual:@"stroke-width"] && 0 <= (n = PositiveFloatValue(value))) {
-        result[SKTGraphicStrokeWidthKey] = @(n);
-      } else if ([key isEqual:@"fill-opacity"] && 0 <= (n = PositiveFloatValue(value)) && n <= 1) {
-        fillOpacity = n;
-      } else if ([key isEqual:@"stroke-opacity"] && 0 <= (n = PositiveFloatValue(value)) && n <= 1) {
-        strokeOpacity = n;
-      } else if ([key isEqual:@"display"]) {
-        if ([value isEqual:@"none"]) {
-          strokeOpacity = fillOpacity = 0;
-        }
-      } else if ([key isEqual:@"visibility"]) {
-        if ([value isEqual:@"hidden"] || [value isEqual:@"collapse"]) {
-          strokeOpacity = fillOpacity = 0;
-        }
-      }
+    CGAffineTransform transform;
+    if ( ! TransformFromString(s, &transform)) {
+      NSLog(@"\n'%@' malformed transform attribute ignored: %@", element.name, s);
+    } else if ( ! CGAffineTransformIsIdentity(transform)) {
+      [graphic applyTransform:transform];
     }
-    AdjustOpacity(result, SKTGraphicIsDrawingFillKey, SKTGraphicFillColorKey, fillOpacity);
-    AdjustOpacity(result, SKTGraphicIsDrawingStrokeKey, SKTGraphicStrokeColorKey, strokeOpacity);
   }
-  return result;
 }
 
-static NSDictionary *CirclePropertiesOfElement(NSXMLElement *element) {
-  CGFloat cx = [[element attributeForName:@"cx"] svgFloatValue];
-  CGFloat cy = [[element attributeForName:@"cy"] svgFloatValue];
-  CGFloat r = [[element attributeForName:@"r"] svgFloatValue];
+static NSDictionary *CirclePropertiesOfElement(const ElementAttributes *attributes) {
+  CGFloat cx = FloatValue(attributes, SKTSVGAttributeCx);
+  CGFloat cy = FloatValue(attributes, SKTSVGAttributeCy);
+  CGFloat r = FloatValue(attributes, SKTSVGAttributeR);
   if (r <= 0) {
     return nil;
   }
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
   CGRect bounds = CGRectMake(cx - r, cy - r, r*2, r*2);
   result[SKTGraphicBoundsKey] = NSStringFromRect(bounds);
   return result;
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfCircle(NSXMLElement *element) {
-  NSDictionary *props = CirclePropertiesOfElement(element);
+static id GraphicOfCircle(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = CirclePropertiesOfElement(attributes);
   id result = [[SKTEllipse alloc] initWithProperties:props];
   return result;
 }
@@ -221,68 +177,82 @@ static id GraphicOfDesc(NSXMLElement *element) {
   return result;
 }
 
-static NSDictionary *EllipsePropertiesOfElement(NSXMLElement *element) {
-  CGFloat cx = [[element attributeForName:@"cx"] svgFloatValue];
-  CGFloat cy = [[element attributeForName:@"cy"] svgFloatValue];
-  CGFloat rx = [[element attributeForName:@"rx"] svgFloatValue];
-  CGFloat ry = [[element attributeForName:@"ry"] svgFloatValue];
+static NSDictionary *EllipsePropertiesOfElement(const ElementAttributes *attributes) {
+  CGFloat cx = FloatValue(attributes, SKTSVGAttributeCx);
+  CGFloat cy = FloatValue(attributes, SKTSVGAttributeCy);
+  CGFloat rx = FloatValue(attributes, SKTSVGAttributeRx);
+  CGFloat ry = FloatValue(attributes, SKTSVGAttributeRy);
   if (rx <= 0 || ry <= 0) {
     return nil;
   }
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
   CGRect bounds = CGRectMake(cx - rx, cy - ry, rx*2, ry*2);
   result[SKTGraphicBoundsKey] = NSStringFromRect(bounds);
   return result;
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfEllipse(NSXMLElement *element) {
-  NSDictionary *props = EllipsePropertiesOfElement(element);
+static id GraphicOfEllipse(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = EllipsePropertiesOfElement(attributes);
   id result = [[SKTEllipse alloc] initWithProperties:props];
   return result;
 }
 
-static NSDictionary *GroupPropertiesOfElement(NSXMLElement *element) {
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
+static NSDictionary *GroupPropertiesOfElement(const ElementAttributes *attributes) {
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
   // TODO: more here: GroupPropertiesOfElement
   return result;
 }
 
-// return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfGroup(NSXMLElement *element) {
-  NSDictionary *props = GroupPropertiesOfElement(element);
+// The group described by element, holding the already converted graphics.
+static SKTGroup *GroupOfElementWithGraphics(NSXMLElement *element, const ElementAttributes *attributes, NSMutableArray *graphics) {
+  NSDictionary *props = GroupPropertiesOfElement(attributes);
   SKTGroup *result = [[SKTGroup alloc] initWithProperties:props];
-  [result setGraphics:[SKTDocument graphicsFromContainer:element error:NULL]];
+  [result setGraphics:graphics];
+  ApplyTransformOfElement(result, element, attributes);
 
   return result;
 }
 
-static NSDictionary *ImagePropertiesOfElement(NSXMLElement *element) {
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
-  NSString *s = [[element attributeForName:@"width"] stringValue];
+static NSMutableArray *GraphicsOfContainer(NSXMLElement *container, const SKTSVGPresentation *presentation, NSUInteger threadCount);
+
+// return nil to signal parse error. return @NO to signal ignored. The children are converted on up to threadCount
+// threads, the same as the group's siblings.
+static id GraphicOfGroup(NSXMLElement *element, const ElementAttributes *attributes, NSUInteger threadCount) {
+  NSMutableArray *graphics = GraphicsOfContainer(element, &attributes->presentation, threadCount);
+  return GroupOfElementWithGraphics(element, attributes, graphics);
+}
+
+static NSDictionary *ImagePropertiesOfElement(const ElementAttributes *attributes) {
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
+  NSString *s = StringValue(attributes, SKTSVGAttributeWidth);
   if (s.length) {
-    CGFloat width = [s floatValue];
+    CGFloat width = SKTSVGFloatValue(s);
     result[SKTGraphicWidthKey] = @(width);
   }
-  s = [[element attributeForName:@"height"] stringValue];
+  s = StringValue(attributes, SKTSVGAttributeHeight);
   if (s.length) {
-    CGFloat height = [s floatValue];
+    CGFloat height = SKTSVGFloatValue(s);
     result[SKTGraphicHeightKey] = @(height);
   }
-  s = [[element attributeForName:@"xlink:href"] stringValue];
+  s = StringValue(attributes, SKTSVGAttributeHref);
   if (s.length) {
     if ([s hasPrefix:@"data:"]) {
+      // Keep the bytes as they came, to be written out unchanged. They're decoded when the image is first drawn.
       static NSString *const jpegHeader = @"data:image/jpeg;base64,";
       static NSString *const pngHeader = @"data:image/png;base64,";
-      NSImage *image = nil;
+      NSString *type = nil;
+      NSData *data = nil;
       if ([s hasPrefix:jpegHeader]) {
-        image = imageFromBase64String([s substringFromIndex:[jpegHeader length]]);
+        type = @"image/jpeg";
+        data = DataFromBase64String([s substringFromIndex:[jpegHeader length]]);
       } else if ([s hasPrefix:pngHeader]) {
-        image = imageFromBase64String([s substringFromIndex:[pngHeader length]]);
+        type = @"image/png";
+        data = DataFromBase64String([s substringFromIndex:[pngHeader length]]);
       }
-      if (image) {
-        NSData *d = [NSArchiver archivedDataWithRootObject:image];
-        result[SKTImageContentsKey] = d;
+      if ([data length]) {
+        result[SKTImageEncodedDataKey] = data;
+        result[SKTImageEncodedTypeKey] = type;
       } else {
         NSLog(@"missing: interpreter for URLs of the form 'data:image/jpeg;base64,'");
       }
@@ -295,43 +265,53 @@ static NSDictionary *ImagePropertiesOfElement(NSXMLElement *element) {
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfImage(NSXMLElement *element) {
-  NSDictionary *props = ImagePropertiesOfElement(element);
+static id GraphicOfImage(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = ImagePropertiesOfElement(attributes);
   SKTImage *result = [[SKTImage alloc] initWithProperties:props];
   return result;
 }
 
-static NSDictionary *LinePropertiesOfElement(NSXMLElement *element) {
-  CGFloat x = [[element attributeForName:@"x1"] svgFloatValue];
-  CGFloat y = [[element attributeForName:@"y1"] svgFloatValue];
-  CGFloat x2 = [[element attributeForName:@"x2"] svgFloatValue];
-  CGFloat y2 = [[element attributeForName:@"y2"] svgFloatValue];
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
+static NSDictionary *LinePropertiesOfElement(const ElementAttributes *attributes) {
+  CGFloat x = FloatValue(attributes, SKTSVGAttributeX1);
+  CGFloat y = FloatValue(attributes, SKTSVGAttributeY1);
+  CGFloat x2 = FloatValue(attributes, SKTSVGAttributeX2);
+  CGFloat y2 = FloatValue(attributes, SKTSVGAttributeY2);
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
   result[SKTLineBeginPointKey] = NSStringFromPoint(CGPointMake(x, y));
   result[SKTLineEndPointKey] = NSStringFromPoint(CGPointMake(x2, y2));
   return result;
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfLine(NSXMLElement *element) {
-  NSDictionary *props = LinePropertiesOfElement(element);
+static id GraphicOfLine(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = LinePropertiesOfElement(attributes);
   id result = [[SKTLine alloc] initWithProperties:props];
   return result;
 }
 
-static NSMutableDictionary *PathPropertiesOfElement(NSXMLElement *element) {
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
-  NSString *s = [[element attributeForName:@"d"] stringValue];
+static NSMutableDictionary *PathPropertiesOfElement(const ElementAttributes *attributes) {
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
+  NSString *s = StringValue(attributes, SKTSVGAttributeD);
   if ([s respondsToSelector:@selector(characterAtIndex:)]) {
     result[SKTPathString] = s;
   }
   return result;
 }
 
+// Traced floor plans come in with thousands of nearly collinear vertices per wall. Thin them as they arrive, if the user
+// asked to, by Douglas-Peucker, which keeps straight walls straight and adds no curves. Safe on any import thread.
+static void SimplifyImportedGraphic(SKTGraphic *graphic) {
+  double tolerance = [[NSUserDefaults standardUserDefaults] doubleForKey:SKTSVGImportSimplifyToleranceKey];
+  if (0 < tolerance && [graphic canSimplify]) {
+    [graphic simplifyWithMethod:SKTSimplifyMethodDouglasPeucker tolerance:tolerance];
+  }
+}
+
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfPath(NSXMLElement *element) {
-  NSMutableDictionary *props = PathPropertiesOfElement(element);
-  id result = [[SKTPath alloc] initWithProperties:props];
+static id GraphicOfPath(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSMutableDictionary *props = PathPropertiesOfElement(attributes);
+  SKTPath *result = [[SKTPath alloc] initWithProperties:props];
+  SimplifyImportedGraphic(result);
   return result;
 }
 
@@ -341,50 +321,52 @@ static id GraphicOfPattern(NSXMLElement *element) {
   return result;
 }
 
-static NSMutableDictionary *PolyPropertiesOfElement(NSXMLElement *element) {
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
-  result[SKTPolyPoints] = [[element attributeForName:@"points"] stringValue];
+static NSMutableDictionary *PolyPropertiesOfElement(const ElementAttributes *attributes) {
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
+  result[SKTPolyPoints] = StringValue(attributes, SKTSVGAttributePoints);
   return result;
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfPolygon(NSXMLElement *element) {
-  NSMutableDictionary *props = PolyPropertiesOfElement(element);
+static id GraphicOfPolygon(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSMutableDictionary *props = PolyPropertiesOfElement(attributes);
   props[SKTGraphicClosed] = @YES;
   SKTPoly *result = [[SKTPoly alloc] initWithProperties:props];
   if (nil == result.strokeColor) {
     [result setValue:NSColor.blackColor forKey:@"strokeColor"];
   }
+  SimplifyImportedGraphic(result);
   return result;
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfPolyline(NSXMLElement *element) {
-  NSDictionary *props = PolyPropertiesOfElement(element);
+static id GraphicOfPolyline(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = PolyPropertiesOfElement(attributes);
   SKTPoly *result = [[SKTPoly alloc] initWithProperties:props];
   if (nil == result.strokeColor) {
     [result setValue:NSColor.blackColor forKey:@"strokeColor"];
   }
+  SimplifyImportedGraphic(result);
   return result;
 }
 
-static NSDictionary *RectPropertiesOfElement(NSXMLElement *element) {
-  CGFloat x = [[element attributeForName:@"x"] svgFloatValue];
-  CGFloat y = [[element attributeForName:@"y"] svgFloatValue];
-  CGFloat width = [[element attributeForName:@"width"] svgFloatValue];
-  CGFloat height = [[element attributeForName:@"height"] svgFloatValue];
+static NSDictionary *RectPropertiesOfElement(const ElementAttributes *attributes) {
+  CGFloat x = FloatValue(attributes, SKTSVGAttributeX);
+  CGFloat y = FloatValue(attributes, SKTSVGAttributeY);
+  CGFloat width = FloatValue(attributes, SKTSVGAttributeWidth);
+  CGFloat height = FloatValue(attributes, SKTSVGAttributeHeight);
   if (width <= 0  || height <= 0) {
     return nil;
   }
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
   CGRect bounds = CGRectMake(x, y, width, height);
   result[SKTGraphicBoundsKey] = NSStringFromRect(bounds);
   return result;
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfRect(NSXMLElement *element) {
-  NSDictionary *props = RectPropertiesOfElement(element);
+static id GraphicOfRect(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = RectPropertiesOfElement(attributes);
   id result = [[SKTRectangle alloc] initWithProperties:props];
   return result;
 }
@@ -401,24 +383,24 @@ static id GraphicOfSymbol(NSXMLElement *element) {
   return result;
 }
 
-static NSDictionary *TextPropertiesOfElement(NSXMLElement *element) {
-  CGFloat x = [[element attributeForName:@"x"] svgFloatValue];
-  CGFloat y = [[element attributeForName:@"y"] svgFloatValue];
-  CGFloat width = [[element attributeForName:@"width"] svgFloatValue];
-  CGFloat height = [[element attributeForName:@"height"] svgFloatValue];
-  NSMutableDictionary *result = StylePropertiesFromAttributes(element);
+static NSDictionary *TextPropertiesOfElement(NSXMLElement *element, const ElementAttributes *attributes) {
+  CGFloat x = FloatValue(attributes, SKTSVGAttributeX);
+  CGFloat y = FloatValue(attributes, SKTSVGAttributeY);
+  CGFloat width = FloatValue(attributes, SKTSVGAttributeWidth);
+  CGFloat height = FloatValue(attributes, SKTSVGAttributeHeight);
+  NSMutableDictionary *result = StylePropertiesFromAttributes(attributes);
   CGRect bounds = CGRectMake(x, y, width, height);
   result[SKTGraphicBoundsKey] = NSStringFromRect(bounds);
   NSMutableDictionary *attrs = [NSMutableDictionary dictionary];
   // interpret stroke color as foreground color, fill color as background color
   if ([result[SKTGraphicIsDrawingFillKey] boolValue]) {
-    NSColor *c = [NSColor colorWithArchiveData:result[SKTGraphicFillColorKey]];
+    NSColor *c = [[SKTColorTable sharedColorTable] colorWithArchiveData:result[SKTGraphicFillColorKey]];
     if (c) {
       [attrs setObject:c forKey:NSBackgroundColorAttributeName];
     }
   }
   if ([result[SKTGraphicIsDrawingStrokeKey] boolValue]) {
-    NSColor *c = [NSColor colorWithArchiveData:result[SKTGraphicStrokeColorKey]];
+    NSColor *c = [[SKTColorTable sharedColorTable] colorWithArchiveData:result[SKTGraphicStrokeColorKey]];
     if (c) {
       [attrs setObject:c forKey:NSForegroundColorAttributeName];
     }
@@ -430,12 +412,15 @@ static NSDictionary *TextPropertiesOfElement(NSXMLElement *element) {
 }
 
 // return nil to signal parse error. return @NO to signal ignored.
-static id GraphicOfText(NSXMLElement *element) {
-  NSDictionary *props = TextPropertiesOfElement(element);
+static id GraphicOfText(NSXMLElement *element, const ElementAttributes *attributes) {
+  NSDictionary *props = TextPropertiesOfElement(element, attributes);
   SKTText *result = [[SKTText alloc] initWithProperties:props];
-  CGRect bounds = [result bounds];
-  bounds.size = [result naturalSize];
-  [result setBounds:bounds];
+  // -naturalSize lays out with a layout manager shared by all SKTTexts, so parallel import must take turns.
+  @synchronized([SKTText class]) {
+    CGRect bounds = [result bounds];
+    bounds.size = [result naturalSize];
+    [result setBounds:bounds];
+  }
   return result;
 }
 
@@ -452,78 +437,489 @@ static id GraphicOfUse(NSXMLElement *element) {
 }
 
 
-id GraphicOfElement(NSXMLElement *element) {
+// The graphic of element, which inherits presentation from its parent. A <g>'s children are converted on up to
+// threadCount threads.
+id GraphicOfElement(NSXMLElement *element, const SKTSVGPresentation *inherited, NSUInteger threadCount) {
   id result = @NO;
   if (NSXMLElementKind == [element kind]) {
     NSString *name = [element localName];
+    ElementAttributes attributes;
+    ReadAttributes(element, inherited, &attributes);
     if ([name isEqual:@"circle"]) {
-      result = GraphicOfCircle(element);
+      result = GraphicOfCircle(element, &attributes);
     } else if ([name isEqual:@"desc"]) {
       result = GraphicOfDesc(element);
     } else if ([name isEqual:@"ellipse"]) {
-      result = GraphicOfEllipse(element);
+      result = GraphicOfEllipse(element, &attributes);
     } else if ([name isEqual:@"g"]) {
-      result = GraphicOfGroup(element);
+      result = GraphicOfGroup(element, &attributes, threadCount);
     } else if ([name isEqual:@"image"]) {
-      result = GraphicOfImage(element);
+      result = GraphicOfImage(element, &attributes);
     } else if ([name isEqual:@"line"]) {
-      result = GraphicOfLine(element);
+      result = GraphicOfLine(element, &attributes);
     } else if ([name isEqual:@"path"]) {
-      result = GraphicOfPath(element);
+      result = GraphicOfPath(element, &attributes);
     } else if ([name isEqual:@"pattern"]) {
       result = GraphicOfPattern(element);
     } else if ([name isEqual:@"polygon"]) {
-      result = GraphicOfPolygon(element);
+      result = GraphicOfPolygon(element, &attributes);
     } else if ([name isEqual:@"polyline"]) {
-      result = GraphicOfPolyline(element);
+      result = GraphicOfPolyline(element, &attributes);
     } else if ([name isEqual:@"rect"]) {
-      result = GraphicOfRect(element);
+      result = GraphicOfRect(element, &attributes);
     } else if ([name isEqual:@"style"]) {
       result = GraphicOfStyle(element);
     } else if ([name isEqual:@"symbol"]) {
       result = GraphicOfSymbol(element);
     } else if ([name isEqual:@"text"]) {
-      result = GraphicOfText(element);
+      result = GraphicOfText(element, &attributes);
     } else if ([name isEqual:@"title"]) {
       result = GraphicOfTitle(element);
     } else if ([name isEqual:@"use"]) {
       result = GraphicOfUse(element);
     }
+    // Groups apply their own, because the stream reader makes them without coming through here.
+    if ([result isKindOfClass:[SKTGraphic class]] && ! [name isEqual:@"g"]) {
+      ApplyTransformOfElement(result, element, &attributes);
+    }
   }
   return result;
 }
 
-@implementation SKTDocument(SVG)
+// True for the element names that GraphicOfElement() can turn into a graphic, other than g.
+// Every other element, and everything inside it, is ignored.
+static BOOL IsGraphicElementName(NSString *name) {
+  static NSSet *names;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    names = [NSSet setWithObjects:@"circle", @"ellipse", @"image", @"line", @"path", @"polygon", @"polyline", @"rect", @"text", nil];
+  });
+  return [names containsObject:name];
+}
+
+// The part of a qualified element name after the prefix, to match -[NSXMLNode localName].
+static NSString *LocalName(NSString *qualifiedName) {
+  NSRange colon = [qualifiedName rangeOfString:@":"];
+  if (NSNotFound == colon.location) {
+    return qualifiedName;
+  }
+  return [qualifiedName substringFromIndex:NSMaxRange(colon)];
+}
 
-+ (NSMutableArray *)graphicsFromContainer:(NSXMLElement *)root error:(NSError **)outError {
-  NSUInteger count = [root childCount];
-  NSMutableArray *graphics = [NSMutableArray array];
-  // Parse from front to back so we can properly inherit styles. TODO: inherit styles
-  for (NSUInteger i = 0; i < count; ++i) {
-    NSXMLElement *element = (NSXMLElement *)[root childAtIndex:(unsigned)i];
-    id graphic = GraphicOfElement(element);
-    if (graphic) {
-      if ( ! [graphic isEqual:@NO]) {
-        [graphics addObject:graphic];
+// A detached element with just the attributes, in the shape the GraphicOf* functions expect.
+static NSXMLElement *ElementWithAttributes(NSString *name, NSDictionary<NSString *, NSString *> *attributes) {
+  NSXMLElement *element = [NSXMLNode elementWithName:name];
+  for (NSString *key in attributes) {
+    [element addAttribute:[NSXMLNode attributeWithName:key stringValue:attributes[key]]];
+  }
+  return element;
+}
+
+// Same bookkeeping as +graphicsFromContainer: for one converted child.
+static void AddGraphicOfElement(NSMutableArray *graphics, id graphic, NSXMLElement *element) {
+  if (graphic) {
+    if ( ! [graphic isEqual:@NO]) {
+      [graphics addObject:graphic];
+    }
+  } else {
+    NSLog(@"Couldn't parse %@", element);
+  }
+}
+
+NSString *const SKTSVGImportThreadCountKey = @"SKTSVGImportThreadCount";
+NSString *const SKTSVGImportSimplifyToleranceKey = @"SKTSVGImportSimplifyTolerance";
+
+enum {
+  // Below this many siblings, converting them serially is faster than handing them to other threads.
+  kMinimumParallelCount = 64,
+  // Sibling elements are handed out to the threads this many at a time, or fewer for short lists.
+  kMaximumChunkSize = 256
+};
+
+// The user default, or one thread per active processor if it is unset or 0.
+static NSUInteger DefaultImportThreadCount(void) {
+  NSInteger threadCount = [[NSUserDefaults standardUserDefaults] integerForKey:SKTSVGImportThreadCountKey];
+  if (threadCount <= 0) {
+    threadCount = (NSInteger)[[NSProcessInfo processInfo] activeProcessorCount];
+  }
+  return (NSUInteger)threadCount;
+}
+
+// Convert elements to graphics in document order, appending them to graphics. Each GraphicOfElement() call is independent, so
+// with more than one thread the elements are split into chunks that the threads take turns claiming, and each chunk's
+// results are kept in its own array so the combined order is the same as the serial loop's. A <g> among them converts its
+// own children the same way, with the same threadCount, from whichever thread it lands on. dispatch_apply() copes with
+// being nested like that. With a threadCount of 1 everything, groups included, is converted on the calling thread.
+// Every element inherits presentation, the parent's, computed once for all of them.
+//
+// NSXMLNode isn't safe to read from several threads at once, even for reads, and siblings share their document. So
+// before the threads start, the calling thread detaches a copy of each element that still has a parent, and the
+// threads read only those: each a tree of its own, read by the one thread that claims it. The stream reader's elements
+// are detached already. A <g>'s copy is its whole subtree, so a group nested d deep is copied d times.
+static void AddGraphicsOfElements(NSMutableArray *graphics, NSArray<NSXMLNode *> *elements, const SKTSVGPresentation *presentation, NSUInteger threadCount) {
+  NSUInteger count = [elements count];
+  if (threadCount <= 1 || count < kMinimumParallelCount) {
+    for (NSXMLElement *element in elements) {
+      AddGraphicOfElement(graphics, GraphicOfElement(element, presentation, threadCount), element);
+    }
+    return;
+  }
+  NSMutableArray<NSXMLNode *> *detached = [NSMutableArray arrayWithCapacity:count];
+  for (NSXMLNode *element in elements) {
+    [detached addObject:[element parent] ? [element copy] : element];
+  }
+  NSUInteger chunkSize = MAX(kMinimumParallelCount / 4, MIN(kMaximumChunkSize, count / (threadCount * 4)));
+  NSUInteger chunkCount = (count + chunkSize - 1) / chunkSize;
+  NSMutableArray<NSMutableArray *> *chunkGraphics = [NSMutableArray arrayWithCapacity:chunkCount];
+  for (NSUInteger chunk = 0; chunk < chunkCount; ++chunk) {
+    [chunkGraphics addObject:[NSMutableArray arrayWithCapacity:chunkSize]];
+  }
+  // dispatch_apply() returns only when every worker has, so the workers may share this counter on the stack.
+  atomic_size_t nextChunk = 0;
+  atomic_size_t *nextChunkp = &nextChunk;
+  dispatch_apply(MIN(threadCount, chunkCount), DISPATCH_APPLY_AUTO, ^(size_t worker) {
+    for (size_t chunk; (chunk = atomic_fetch_add(nextChunkp, 1)) < chunkCount;) {
+      NSMutableArray *results = chunkGraphics[chunk];
+      NSUInteger end = MIN(count, (chunk + 1) * chunkSize);
+      for (NSUInteger i = chunk * chunkSize; i < end; ++i) {
+        NSXMLElement *element = (NSXMLElement *)detached[i];
+        AddGraphicOfElement(results, GraphicOfElement(element, presentation, threadCount), element);
       }
-    } else {
-      NSLog(@"Couldn't parse %@", element);
     }
+  });
+  for (NSMutableArray *results in chunkGraphics) {
+    [graphics addObjectsFromArray:results];
   }
+}
+
+// The graphics of container's children, front to back, as SKTDocument keeps them.
+static NSMutableArray *GraphicsOfContainer(NSXMLElement *container, const SKTSVGPresentation *presentation, NSUInteger threadCount) {
+  NSMutableArray *graphics = [NSMutableArray array];
+  AddGraphicsOfElements(graphics, [container children], presentation, threadCount);
   [graphics s_reverse];
   return graphics;
 }
 
-- (NSArray *)graphicsSVGTypeFromData:(NSData *)data
+// Builds graphics as elements close, instead of building the whole NSXMLDocument first. Only the open <g> elements
+// (attributes only, plus the graphics converted so far) and the one drawable element being read are held in memory,
+// and each drawable element goes through GraphicOfElement(), so the result is the same as +graphicsFromContainer:.
+@interface SKTSVGStreamReader : NSObject <NSXMLParserDelegate> {
+  // The graphics of each open container, the <svg> root first.
+  NSMutableArray<NSMutableArray *> *_graphicsStack;
+  // The open <g> elements, attributes only.
+  NSMutableArray<NSXMLElement *> *_groupStack;
+  // The ElementAttributes of the <svg> root and of each open <g>, innermost last. Their nodes belong to _root and to
+  // the elements of _groupStack.
+  NSMutableData *_attributesStack;
+  NSXMLElement *_root;
+  // Drawable elements of the innermost open container that have been read but not yet converted.
+  NSMutableArray<NSXMLElement *> *_pending;
+  NSUInteger _threadCount;
+  // The drawable element being read, and the element inside it that is currently open.
+  NSXMLElement *_element;
+  NSXMLElement *_currentElement;
+  // Characters inside _currentElement not yet added as a text node. NSXMLParser may deliver a run in pieces.
+  NSMutableString *_text;
+  // Nonzero while inside an element that is ignored.
+  NSUInteger _skipDepth;
+  BOOL _sawRoot;
+  BOOL _isSVG;
+}
+@property(readonly) NSMutableArray *graphics;
+@end
+
+@implementation SKTSVGStreamReader
+
+- (instancetype)init {
+  return [self initWithThreadCount:DefaultImportThreadCount()];
+}
+
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount {
+  self = [super init];
+  if (self) {
+    _graphicsStack = [NSMutableArray array];
+    _groupStack = [NSMutableArray array];
+    _attributesStack = [NSMutableData data];
+    _pending = [NSMutableArray array];
+    _text = [NSMutableString string];
+    _threadCount = threadCount;
+  }
+  return self;
+}
+
+- (const ElementAttributes *)innermostAttributes {
+  return (const ElementAttributes *)[_attributesStack bytes] + [_attributesStack length] / sizeof(ElementAttributes) - 1;
+}
+
+// Read the attributes of the container opening, inheriting from the one it is in, if any.
+- (void)pushAttributesOfElement:(NSXMLElement *)element {
+  ElementAttributes attributes;
+  ReadAttributes(element, [_attributesStack length] ? &[self innermostAttributes]->presentation : &SKTSVGPresentationInitial, &attributes);
+  [_attributesStack appendBytes:&attributes length:sizeof attributes];
+}
+
+- (void)popAttributes {
+  [_attributesStack setLength:[_attributesStack length] - sizeof(ElementAttributes)];
+}
+
+// Drawable elements are converted a batch at a time so they can be converted in parallel. The batch is bounded,
+// and is always converted before a container opens or closes, so it all belongs to the innermost open container.
+- (void)convertPending {
+  if ([_pending count]) {
+    AddGraphicsOfElements([_graphicsStack lastObject], _pending, &[self innermostAttributes]->presentation, _threadCount);
+    [_pending removeAllObjects];
+  }
+}
+
+// return nil on parse error or if the root element isn't svg.
+- (NSMutableArray *)graphicsFromParser:(NSXMLParser *)parser error:(NSError **)outError {
+  [parser setDelegate:self];
+  BOOL didParse = [parser parse];
+  if ( ! (didParse && _isSVG)) {
+    if (_sawRoot && ! _isSVG) {
+      return nil; // Like the DOM reader: not an error, just not an SVG document.
+    }
+    if (outError) {
+      *outError = [parser parserError];
+    }
+    return nil;
+  }
+  [self convertPending];
+  NSMutableArray *graphics = [_graphicsStack firstObject];
+  [graphics s_reverse];
+  return graphics;
+}
+
+- (void)parser:(NSXMLParser *)parser didStartElement:(NSString *)elementName namespaceURI:(NSString *)namespaceURI qualifiedName:(NSString *)qName attributes:(NSDictionary<NSString *, NSString *> *)attributeDict {
+  if (_skipDepth) {
+    _skipDepth += 1;
+  } else if (_element) {
+    [self flushText];
+    NSXMLElement *child = ElementWithAttributes(elementName, attributeDict);
+    [_currentElement addChild:child];
+    _currentElement = child;
+  } else if ( ! _sawRoot) {
+    _sawRoot = YES;
+    _isSVG = [LocalName(elementName) isEqual:@"svg"];
+    if (_isSVG) {
+      _root = ElementWithAttributes(elementName, attributeDict);
+      [self pushAttributesOfElement:_root];
+      [_graphicsStack addObject:[NSMutableArray array]];
+    } else {
+      [parser abortParsing];
+    }
+  } else {
+    NSString *name = LocalName(elementName);
+    if ([name isEqual:@"g"]) {
+      [self convertPending];
+      NSXMLElement *group = ElementWithAttributes(elementName, attributeDict);
+      [_groupStack addObject:group];
+      [self pushAttributesOfElement:group];
+      [_graphicsStack addObject:[NSMutableArray array]];
+    } else if (IsGraphicElementName(name)) {
+      _element = _currentElement = ElementWithAttributes(elementName, attributeDict);
+    } else {
+      _skipDepth = 1;
+    }
+  }
+}
+
+- (void)parser:(NSXMLParser *)parser didEndElement:(NSString *)elementName namespaceURI:(NSString *)namespaceURI qualifiedName:(NSString *)qName {
+  if (_skipDepth) {
+    _skipDepth -= 1;
+  } else if (_element) {
+    [self flushText];
+    if (_currentElement == _element) {
+      [_pending addObject:_element];
+      _element = _currentElement = nil;
+      if (kMaximumChunkSize * _threadCount <= [_pending count]) {
+        [self convertPending];
+      }
+    } else {
+      _currentElement = (NSXMLElement *)[_currentElement parent];
+    }
+  } else if ([_groupStack count]) {
+    [self convertPending];
+    NSXMLElement *group = [_groupStack lastObject];
+    ElementAttributes attributes = *[self innermostAttributes];
+    NSMutableArray *graphics = [_graphicsStack lastObject];
+    [_groupStack removeLastObject];
+    [self popAttributes];
+    [_graphicsStack removeLastObject];
+    [graphics s_reverse];
+    AddGraphicOfElement([_graphicsStack lastObject], GroupOfElementWithGraphics(group, &attributes, graphics), group);
+  }
+}
+
+// Like NSXMLDocument, drop text that is only whitespace.
+- (void)flushText {
+  if ([_text length]) {
+    if ([[_text stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] length]) {
+      [_currentElement addChild:[NSXMLNode textWithStringValue:[_text copy]]];
+    }
+    [_text setString:@""];
+  }
+}
+
+- (void)parser:(NSXMLParser *)parser foundCharacters:(NSString *)string {
+  if (_element && ! _skipDepth) {
+    [_text appendString:string];
+  }
+}
+
+- (void)parser:(NSXMLParser *)parser foundCDATA:(NSData *)CDATABlock {
+  if (_element && ! _skipDepth) {
+    NSString *string = [[NSString alloc] initWithData:CDATABlock encoding:NSUTF8StringEncoding];
+    if (string) {
+      [_text appendString:string];
+    }
+  }
+}
+
+@end
+
+@implementation SKTDocumentFormat(SVG)
+
++ (NSMutableArray *)graphicsFromContainer:(NSXMLElement *)root error:(NSError **)outError {
+  return [self graphicsFromContainer:root threadCount:DefaultImportThreadCount() error:outError];
+}
+
++ (NSMutableArray *)graphicsFromContainer:(NSXMLElement *)root threadCount:(NSUInteger)threadCount error:(NSError **)outError {
+  // The root's own presentation attributes are inherited by everything in it.
+  ElementAttributes attributes;
+  ReadAttributes(root, &SKTSVGPresentationInitial, &attributes);
+  return GraphicsOfContainer(root, &attributes.presentation, threadCount);
+}
+
++ (NSArray *)graphicsSVGTypeFromData:(NSData *)data
                            printInfo:(NSPrintInfo **)outPrintInfo
                                error:(NSError **)outError {
-  NSXMLDocument *doc = [[NSXMLDocument alloc] initWithData:data options:0 error:outError];
+  NSXMLParser *parser = [[NSXMLParser alloc] initWithData:data];
+  return [[[SKTSVGStreamReader alloc] init] graphicsFromParser:parser error:outError];
+}
+
++ (NSArray *)graphicsSVGTypeFromStream:(NSInputStream *)stream
+                             printInfo:(NSPrintInfo **)outPrintInfo
+                                 error:(NSError **)outError {
+  NSXMLParser *parser = [[NSXMLParser alloc] initWithStream:stream];
+  return [[[SKTSVGStreamReader alloc] init] graphicsFromParser:parser error:outError];
+}
+
+@end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+void SKTSVGImportBenchmark(NSUInteger elementCount) {
+  NSMutableString *svg = [NSMutableString stringWithString:@"<svg xmlns=\"http://www.w3.org/2000/svg\">\n"];
+  for (NSUInteger i = 0; i < elementCount; ++i) {
+    CGFloat x = (i % 1000) * 3, y = (i / 1000) * 3;
+    if (0 == i % 100) {
+      [svg appendString:(i ? @"</g>\n<g style=\"stroke:#336699\">\n" : @"<g style=\"stroke:#336699\">\n")];
+    }
+    switch (i % 4) {
+      case 0:
+        [svg appendFormat:@"<path d=\"M%g,%g l2,0 0,2 c-1,1 -2,0 -2,-2z\" style=\"fill:#cc0000;stroke-width:0.5\"/>\n", x, y];
+        break;
+      case 1:
+        [svg appendFormat:@"<polygon points=\"%g,%g %g,%g %g,%g\" fill=\"rgb(10,200,30)\"/>\n", x, y, x + 2, y, x + 1, y + 2];
+        break;
+      case 2:
+        [svg appendFormat:@"<rect x=\"%g\" y=\"%g\" width=\"2\" height=\"1\" fill=\"blue\" fill-opacity=\"0.5\"/>\n", x, y];
+        break;
+      default:
+        [svg appendFormat:@"<circle cx=\"%g\" cy=\"%g\" r=\"1\" stroke=\"black\"/>\n", x, y];
+        break;
+    }
+  }
+  [svg appendString:(elementCount ? @"</g>\n</svg>\n" : @"</svg>\n")];
+  NSXMLDocument *doc = [[NSXMLDocument alloc] initWithXMLString:svg options:0 error:NULL];
   NSXMLElement *root = [doc rootElement];
-  NSArray *graphics = nil;
-  if ([[root localName] isEqual:@"svg"]) {
-    graphics = [[self class] graphicsFromContainer:root error:outError];
+
+  NSTimeInterval serialTime = 0;
+  for (NSUInteger threadCount = 1; threadCount <= 8; threadCount *= 2) {
+    NSDate *start = [NSDate date];
+    NSArray *graphics = [SKTDocumentFormat graphicsFromContainer:root threadCount:threadCount error:NULL];
+    NSTimeInterval time = -[start timeIntervalSinceNow];
+    if (1 == threadCount) {
+      serialTime = time;
+    }
+    NSLog(@"%lu elements, %lu threads: %lu graphics %.3fs (%.2fx)",
+      (unsigned long)elementCount, (unsigned long)threadCount, (unsigned long)[graphics count], time,
+      time ? serialTime / time : 0);
   }
-  return graphics;
 }
 
-@end
+// An Inkscape plan: every element carries a long style attribute with the whole presentation, plus editor attributes
+// FloorSketch skips, in layers of <g>.
+static NSString *InkscapeStyleSVG(NSUInteger elementCount) {
+  NSMutableString *svg = [NSMutableString stringWithString:@"<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:inkscape=\"http://www.inkscape.org/namespaces/inkscape\" xmlns:sodipodi=\"http://sodipodi.sourceforge.net/DTD/sodipodi-0.dtd\">\n"];
+  for (NSUInteger i = 0; i < elementCount; ++i) {
+    CGFloat x = (i % 1000) * 3, y = (i / 1000) * 3;
+    if (0 == i % 100) {
+      [svg appendFormat:@"%@<g inkscape:groupmode=\"layer\" id=\"layer%lu\" inkscape:label=\"Walls %lu\" style=\"display:inline\">\n",
+        (i ? @"</g>\n" : @""), (unsigned long)i, (unsigned long)i];
+    }
+    [svg appendFormat:@"<path style=\"fill:#%06lx;fill-opacity:1;fill-rule:evenodd;stroke:#000000;stroke-width:0.26458332;"
+      "stroke-linecap:butt;stroke-linejoin:miter;stroke-miterlimit:4;stroke-dasharray:none;stroke-opacity:1\" "
+      "d=\"m %g,%g h 2 v 2 h -2 z\" id=\"path%lu\" inkscape:connector-curvature=\"0\" sodipodi:nodetypes=\"ccccc\"/>\n",
+      (unsigned long)(i % 3) * 0x404040, x, y, (unsigned long)i];
+  }
+  [svg appendString:(elementCount ? @"</g>\n</svg>\n" : @"</svg>\n")];
+  return svg;
+}
+
+// An Illustrator plan exported with presentation attributes: style set once on nested <g>s and inherited.
+static NSString *IllustratorStyleSVG(NSUInteger elementCount) {
+  NSMutableString *svg = [NSMutableString stringWithString:@"<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\" x=\"0px\" y=\"0px\" xml:space=\"preserve\">\n"];
+  for (NSUInteger i = 0; i < elementCount; ++i) {
+    CGFloat x = (i % 1000) * 3, y = (i / 1000) * 3;
+    if (0 == i % 100) {
+      [svg appendFormat:@"%@<g id=\"Layer_%lu\" fill=\"none\" stroke=\"#231F20\" stroke-width=\"0.5\" stroke-miterlimit=\"10\"><g>\n",
+        (i ? @"</g></g>\n" : @""), (unsigned long)i];
+    }
+    if (i % 2) {
+      [svg appendFormat:@"<rect x=\"%g\" y=\"%g\" fill=\"#BCBEC0\" width=\"2\" height=\"1\"/>\n", x, y];
+    } else {
+      [svg appendFormat:@"<polyline points=\"%g,%g %g,%g %g,%g\"/>\n", x, y, x + 2, y, x + 1, y + 2];
+    }
+  }
+  [svg appendString:(elementCount ? @"</g></g>\n</svg>\n" : @"</svg>\n")];
+  return svg;
+}
+
+void SKTSVGStyleImportBenchmark(NSUInteger elementCount) {
+  NSDictionary<NSString *, NSString *> *documents = @{
+    @"Inkscape" : InkscapeStyleSVG(elementCount),
+    @"Illustrator" : IllustratorStyleSVG(elementCount),
+  };
+  for (NSString *producer in documents) {
+    NSData *data = [documents[producer] dataUsingEncoding:NSUTF8StringEncoding];
+    NSXMLDocument *doc = [[NSXMLDocument alloc] initWithData:data options:0 error:NULL];
+
+    // Just the attributes: one pass per element, inheriting from the root.
+    NSDate *start = [NSDate date];
+    ElementAttributes rootAttributes;
+    ReadAttributes([doc rootElement], &SKTSVGPresentationInitial, &rootAttributes);
+    NSUInteger attributedCount = 0;
+    for (NSXMLNode *node in [[doc rootElement] nodesForXPath:@"//*" error:NULL]) {
+      ElementAttributes attributes;
+      ReadAttributes((NSXMLElement *)node, &rootAttributes.presentation, &attributes);
+      attributedCount += 1;
+    }
+    NSTimeInterval attributeTime = -[start timeIntervalSinceNow];
+
+    start = [NSDate date];
+    NSArray *graphics = [SKTDocumentFormat graphicsFromContainer:[doc rootElement] threadCount:1 error:NULL];
+    NSTimeInterval domTime = -[start timeIntervalSinceNow];
+
+    start = [NSDate date];
+    NSArray *streamGraphics = [SKTDocumentFormat graphicsSVGTypeFromData:data printInfo:NULL error:NULL];
+    NSTimeInterval streamTime = -[start timeIntervalSinceNow];
+
+    NSLog(@"%@, %lu elements: attributes %.3fus/element, DOM import %lu graphics %.3fs, stream import %lu graphics %.3fs",
+      producer, (unsigned long)elementCount, attributedCount ? attributeTime * 1e6 / attributedCount : 0,
+      (unsigned long)[graphics count], domTime, (unsigned long)[streamGraphics count], streamTime);
+  }
+}
+#endif
@@ -18,6 +18,8 @@ enum {
   SKTUnknownPasteboardReadError = 2,
   SKTWriteCouldntMakeTIFFError = 3,
   SKTWriteCouldntMakePNGError = 4,
+  SKTWriteCouldntEncodeImageError = 5,
+  SKTNewerFileVersionError = 6,
 };
 
 // Given one of the error codes declared above, return an NSError whose user info is set up to match.
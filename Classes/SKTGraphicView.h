@@ -22,6 +22,10 @@ extern NSString *const SKTGraphicViewGridBindingName;
 @property (NS_NONATOMIC_IOSONLY) BOOL rulersVisible;
 @property(readonly) CGFloat handleWidth;
 
+// Over the view's life: how many rects -setNeedsDisplayInRect: was sent, and how many of the merged rects it passed on to NSView.
+@property(readonly) NSUInteger damageRectsSubmittedCount;
+@property(readonly) NSUInteger damageRectsFlushedCount;
+
 // Action methods that are unique to SKTGraphicView, or at least are not declared by NSResponder. SKTGraphicView implements other action methods, but they're all declared by NSResponder and there's not much reason to redeclare them here. We use -showOrHideRulers: instead of -toggleRuler: because we don't want to cause accidental invocation of -[NSTextView toggleRuler:], which doesn't quite work when the text view has been added to a view that already has rulers shown in it, a situation that can arise in FloorSketch.
 - (IBAction)alignBottomEdges:(id)sender;
 - (IBAction)alignHorizontalCenters:(id)sender;
@@ -43,6 +47,7 @@ extern NSString *const SKTGraphicViewGridBindingName;
 - (IBAction)paste:(id)sender;
 - (IBAction)sendToBack:(id)sender;
 - (IBAction)showOrHideRulers:(id)sender;
+- (IBAction)simplify:(id)sender;
 - (IBAction)ungroup:(id)sender;
 - (IBAction)unlock:(id)sender;
 
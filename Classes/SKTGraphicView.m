@@ -12,13 +12,16 @@
 #import "SKTGraphicView.h"
 
 #import "NSArray_SKT.h"
+#import "SKTDamageRegion.h"
 #import "SKTGraphic.h"
+#import "SKTGraphicChangeBus.h"
 #import "SKTGraphicsOwner.h"
 #import "SKTGrid.h"
 #import "SKTGroup.h"
 #import "SKTImage.h"
 #import "SKTPoly.h"
 #import "SKTRenderingView.h"
+#import "SKTSpatialIndex.h"
 #import "SKTToolPaletteController.h"
 
 #import <UniformTypeIdentifiers/UniformTypeIdentifiers.h>
@@ -32,7 +35,6 @@ NSString *const SKTGraphicViewGridBindingName = @"grid";
 
 // The values that are used as contexts by this class' invocations of KVO observer registration methods. When an object like this one receives an -observeValueForKeyPath:ofObject:change:context: message it has to figure out why it's getting the message. It could distinguish based on the observed object and key path, but that's not perfectly safe, because code in the superclass might be observing the same thing for a different reason, and there's a danger of intercepting observer notifications that are meant for superclass code. The way to make sure that doesn't happen is to use a context, and make sure it's unlikely to be used as a context by superclass or subclass code. Strings like these whose pointers are not available to other compiled modules are pretty unlikely to be used by superclass or subclass code. In practice this is not a common problem, especially in a simple application like FloorSketch, but you should know how to do things like this the perfect way even if you decide it's not worth the hassle in your application.
 static char *const SKTGraphicViewGraphicsObservationContext = "com.turbozen.SKTGraphicView.graphics";
-static char *const SKTGraphicViewIndividualGraphicObservationContext = "com.turbozen.SKTGraphicView.individualGraphic";
 static char *const SKTGraphicViewSelectionIndexesObservationContext = "com.turbozen.SKTGraphicView.selectionIndexes";
 static char *const SKTGraphicViewAnyGridPropertyObservationContext = "com.turbozen.SKTGraphicView.anyGridProperty";
 
@@ -42,14 +44,20 @@ static NSString *const SKTGraphicViewPasteboardType = @"FloorSketch pasteboard t
 // The default value by which repetitively pasted sets of graphics are offset from each other, so the user can paste repeatedly and not end up with a pile of graphics that overlay each other so perfectly only the top set can be selected with the mouse.
 static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 
+// How far, in screen points, a click can miss a stroke and still hit it.
+static CGFloat SKTGraphicViewHitTolerance = 3.0;
 
-@interface SKTGraphicView()<SKTHasHandles> {
+
+@interface SKTGraphicView()<SKTGraphicChangeObserver, SKTHasHandles> {
   // Information that is recorded when the "graphics" and "selectionIndexes" bindings are established. Notice that we don't keep around copies of the actual graphics array and selection indexes. Those would just be unnecessary (as far as we know, so far, without having ever done any relevant performance measurement) caches of values that really live in the bound-to objects.
   NSObject *_graphicsContainer;
   NSString *_graphicsKeyPath;
   NSObject *_selectionIndexesContainer;
   NSString *_selectionIndexesKeyPath;
 
+  // The change bus of the owner of the bound-to graphics, which tells us when any of them needs redrawing.
+  SKTGraphicChangeBus *_changeBus;
+
   // The grid that is drawn in the view and used to constrain graphics as they're created and moved. In FloorSketch this is just a cache of a value that canonically lives in the SKTWindowController to which this view's grid property is bound (see SKTWindowController's comments for an explanation of why the grid lives there).
   SKTGrid *_grid;
 
@@ -82,6 +90,13 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
   // Applications are supposed to update the selection during undo and redo operations. These are the indexes of the graphics that are going to be selected at the end of an undo or redo operation.
   NSMutableIndexSet *_undoSelectionIndexes;
 
+  // Where the graphics are, for hit-testing, marquee selection and drawing. Built lazily by -spatialIndex, thrown away whenever graphics are added or removed, and kept up to date from the drawing bounds changes the change bus tells us about in between.
+  SKTSpatialIndex *_spatialIndex;
+
+  // The rects -setNeedsDisplayInRect: has been sent since the last flush, merged, and whether a flush is on its way. Created lazily by -damageRegion.
+  SKTDamageRegion *_damageRegion;
+  BOOL _isDamageFlushScheduled;
+
 }
 
 @end
@@ -129,6 +144,52 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 }
 
 
+#pragma mark - Damage
+
+
+- (SKTDamageRegion *)damageRegion {
+  if (nil == _damageRegion) {
+    _damageRegion = [[SKTDamageRegion alloc] init];
+  }
+  return _damageRegion;
+}
+
+
+// Graphics are invalidated one at a time, from loops over the selection, over inserted and removed graphics, and from every drawing bounds change the change bus reports, so a drag of a thousand graphics sends thousands of overlapping rects here. Collect them instead, and pass the few they merge into on to NSView once, at the end of the run loop pass. Common modes, so that happens during the tracking loops of drags too.
+- (void)setNeedsDisplayInRect:(NSRect)rect {
+  [[self damageRegion] addRect:rect];
+  if ( ! _isDamageFlushScheduled) {
+    _isDamageFlushScheduled = YES;
+    [self performSelector:@selector(flushDamage) withObject:nil afterDelay:0 inModes:@[NSRunLoopCommonModes]];
+  }
+}
+
+
+- (void)flushDamage {
+  _isDamageFlushScheduled = NO;
+  [_damageRegion flushUsingBlock:^(NSRect rect) {
+    [super setNeedsDisplayInRect:rect];
+  }];
+}
+
+
+// If the view is drawn before the flush comes around, because something else already needed drawing, draw the collected rects too.
+- (void)viewWillDraw {
+  [self flushDamage];
+  [super viewWillDraw];
+}
+
+
+- (NSUInteger)damageRectsSubmittedCount {
+  return [_damageRegion submittedRectCount];
+}
+
+
+- (NSUInteger)damageRectsFlushedCount {
+  return [_damageRegion flushedRectCount];
+}
+
+
 #pragma mark - Bindings
 
 
@@ -197,25 +258,36 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
   }
 }
 
-- (void)startObservingGraphics:(NSArray *)graphics {
-
-  // Start observing "drawingBounds" in each of the graphics. Use KVO's options for getting the old and new values in change notifications so we can invalidate just the old and new drawing bounds of changed graphics when they move or change size, instead of the whole view. (The new drawing bounds is easy to otherwise get using regular KVC, but the old one would otherwise have been forgotten by the time we get the notification.) Instances of SKTGraphic must therefore be KVC- and KVO-compliant for drawingBounds. SKTGraphics's use of KVO's dependency mechanism means that being KVO-compliant for drawingBounds when subclassing is as easy as overriding -drawingBounds (to compute an accurate value) and +keyPathsForValuesAffectingDrawingBounds (to trigger KVO's dependency mechanism) though.
-  NSIndexSet *allGraphicIndexes = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [graphics count])];
-  [graphics addObserver:self toObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingBoundsKey options:(NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld) context:SKTGraphicViewIndividualGraphicObservationContext];
+// The change bus of whatever owns the bound-to graphics: the object at the bound-to key path, less its last key. In FloorSketch that's the window controller's document.
+- (SKTGraphicChangeBus *)changeBusOfGraphicsOwner {
+  NSObject *owner = _graphicsContainer;
+  NSRange lastDot = [_graphicsKeyPath rangeOfString:@"." options:NSBackwardsSearch];
+  if (lastDot.location != NSNotFound) {
+    owner = [_graphicsContainer valueForKeyPath:[_graphicsKeyPath substringToIndex:lastDot.location]];
+  }
+  return [owner respondsToSelector:@selector(graphicChangeBus)] ? [(id<SKTGraphicsOwner>)owner graphicChangeBus] : nil;
+}
 
-  // Start observing "drawingContents" in each of the graphics. Don't bother using KVO's options for getting the old and new values because there is no value for drawingContents. It's just something that depends on all of the properties that affect drawing of a graphic but don't affect the drawing bounds of the graphic. Similar to what we do for drawingBounds, SKTGraphics' use of KVO's dependency mechanism means that being KVO-compliant for drawingContents when subclassing is as easy as overriding +keyPathsForValuesAffectingDrawingContents (there is no -drawingContents method to override).
-  [graphics addObserver:self toObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingContentsKey options:0 context:SKTGraphicViewIndividualGraphicObservationContext];
 
+// Rather than register with each graphic for "drawingBounds" and "drawingContents," subscribe once to the change bus the graphics post to, so that binding to, inserting, and removing a great many graphics costs nothing here. The owner can change, as when the window controller's document does, so check whenever the graphics come or go.
+- (void)updateChangeBus {
+  SKTGraphicChangeBus *changeBus = [self changeBusOfGraphicsOwner];
+  if (changeBus != _changeBus) {
+    [_changeBus removeObserver:self];
+    _changeBus = changeBus;
+    [_changeBus addObserver:self];
+  }
 }
 
 
-- (void)stopObservingGraphics:(NSArray *)graphics {
+- (void)startObservingGraphics:(NSArray *)graphics {
+  [self updateChangeBus];
+}
 
-  // Undo what we do in -startObservingGraphics:.
-  NSIndexSet *allGraphicIndexes = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [graphics count])];
-  [graphics removeObserver:self fromObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingContentsKey];
-  [graphics removeObserver:self fromObjectsAtIndexes:allGraphicIndexes forKeyPath:SKTGraphicDrawingBoundsKey];
 
+- (void)stopObservingGraphics:(NSArray *)graphics {
+  // Graphics stop posting to the change bus when they're removed from their owner, so there's nothing to do per graphic.
+  [self updateChangeBus];
 }
 
 
@@ -236,6 +308,7 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
     // Record the information about the binding.
     _graphicsContainer = observableObject;
     _graphicsKeyPath = [observableKeyPath copy];
+    _spatialIndex = nil;
 
     // Start observing changes to the array of graphics to which we're bound, and also start observing properties of the graphics themselves that might require redrawing.
     [_graphicsContainer addObserver:self forKeyPath:_graphicsKeyPath options:(NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld) context:SKTGraphicViewGraphicsObservationContext];
@@ -279,10 +352,11 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 
   // SKTGraphicView supports several different bindings. For the ones that don't use NSObject's default implementation of key-value binding, undo what we do in -bind:toObject:withKeyPath:options:, and then redraw the whole view to make the unbinding take immediate visual effect.
   if ([bindingName isEqualToString:SKTGraphicViewGraphicsBindingName]) {
-    [self stopObservingGraphics:[self graphics]];
     [_graphicsContainer removeObserver:self forKeyPath:_graphicsKeyPath];
     _graphicsContainer = nil;
     _graphicsKeyPath = nil;
+    [self updateChangeBus];
+    _spatialIndex = nil;
     [self setNeedsDisplay:YES];
   } else if ([bindingName isEqualToString:SKTGraphicViewSelectionIndexesBindingName]) {
     [_selectionIndexesContainer removeObserver:self forKeyPath:_selectionIndexesKeyPath];
@@ -305,6 +379,9 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
   // An SKTGraphicView observes several different kinds of objects, for several different reasons. Use the observation context value to distinguish between them. We can do a simple pointer comparison because KVO doesn't do anything at all with the context value, not even retain or copy it.
   if (context == SKTGraphicViewGraphicsObservationContext) {
 
+    // The indexes of the graphics have changed, so any spatial index is out of date.
+    _spatialIndex = nil;
+
     // The "old value" or "new value" in a change dictionary will be NSNull, instead of just not existing, if the corresponding option was specified at KVO registration time and the value for some key in the key path is nil. In Sketch's case there are times in an SKTGraphicView's life cycle when it's bound to the graphics of a window controller's document, and the window controller's document is nil. Don't redraw the graphic view when we get notifications about that.
 
     // Have graphics been removed from the bound-to container?
@@ -357,35 +434,6 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 
     }
 
-  } else if (context == SKTGraphicViewIndividualGraphicObservationContext) {
-
-    // Has a graphic's drawing bounds changed, or some other value that affects how it appears?
-    if ([keyPath isEqualToString:SKTGraphicDrawingBoundsKey]) {
-
-      // Redraw the part of the view that the graphic used to occupy, and the part that it now occupies.
-      NSRect oldGraphicDrawingBounds = [change[NSKeyValueChangeOldKey] rectValue];
-      oldGraphicDrawingBounds = [self insetForHandlesRect:oldGraphicDrawingBounds];
-      [self setNeedsDisplayInRect:oldGraphicDrawingBounds];
-      NSRect newGraphicDrawingBounds = [change[NSKeyValueChangeNewKey] rectValue];
-      newGraphicDrawingBounds = [self insetForHandlesRect:newGraphicDrawingBounds];
-      [self setNeedsDisplayInRect:newGraphicDrawingBounds];
-
-    } else if ([keyPath isEqualToString:SKTGraphicDrawingContentsKey]) {
-
-      // The graphic's drawing bounds hasn't changed, so just redraw the part of the view that it occupies right now.
-      NSRect graphicDrawingBounds = [self handleDrawingBoundsOfGraphic:(SKTGraphic *)observedObject];
-      [self setNeedsDisplayInRect:graphicDrawingBounds];
-
-    } // else something truly bizarre has happened.
-
-    // If undoing or redoing is being done add this graphic to the set that will be selected at the end of the undo action. -[NSArray indexOfObject:] is a dangerous method from a performance standpoint. Maybe an undo action that affects many graphics at once will be slow. Maybe something else in this very simple-looking bit of code will be a problem. We just don't yet know whether there will be a performance problem that the user can notice here. We'll check when we do real performance measurement on FloorSketch someday. At least we've limited the potential problem to undoing and redoing by checking _undoSelectionIndexes != nil. One thing we do know right now is that we're not using memory to record selection changes on the undo/redo stacks, and that's a good thing.
-    if (_undoSelectionIndexes) {
-      NSUInteger graphicIndex = [[self graphics] indexOfObject:observedObject];
-      if (graphicIndex != NSNotFound) {
-        [_undoSelectionIndexes addIndex:graphicIndex];
-      } // else something truly bizarre has happened.
-    }
-
   } else if (context == SKTGraphicViewSelectionIndexesObservationContext) {
 
     // Some selection indexes might have been removed, some might have been added. Redraw the selection handles for any graphic whose selectedness has changed, unless the binding is changing completely (signalled by null old or new value), in which case just redraw the whole view.
@@ -423,6 +471,42 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 }
 
 
+// Conformance to the SKTGraphicChangeObserver protocol.
+- (void)graphic:(SKTGraphic *)graphic didChangeDrawingBoundsFrom:(NSRect)oldDrawingBounds to:(NSRect)newDrawingBounds {
+
+  // Redraw the part of the view that the graphic used to occupy, and the part that it now occupies.
+  NSRect oldGraphicDrawingBounds = [self insetForHandlesRect:oldDrawingBounds];
+  [self setNeedsDisplayInRect:oldGraphicDrawingBounds];
+  NSRect newGraphicDrawingBounds = [self insetForHandlesRect:newDrawingBounds];
+  [self setNeedsDisplayInRect:newGraphicDrawingBounds];
+  [_spatialIndex updateGraphic:graphic handleDrawingBounds:newGraphicDrawingBounds];
+  [self addGraphicToUndoSelection:graphic];
+
+}
+
+
+- (void)graphicDidChangeDrawingContents:(SKTGraphic *)graphic {
+
+  // The graphic's drawing bounds hasn't changed, so just redraw the part of the view that it occupies right now.
+  [self setNeedsDisplayInRect:[self handleDrawingBoundsOfGraphic:graphic]];
+  [self addGraphicToUndoSelection:graphic];
+
+}
+
+
+- (void)addGraphicToUndoSelection:(SKTGraphic *)graphic {
+
+  // If undoing or redoing is being done add this graphic to the set that will be selected at the end of the undo action. -[NSArray indexOfObject:] is a dangerous method from a performance standpoint. Maybe an undo action that affects many graphics at once will be slow. Maybe something else in this very simple-looking bit of code will be a problem. We just don't yet know whether there will be a performance problem that the user can notice here. We'll check when we do real performance measurement on FloorSketch someday. At least we've limited the potential problem to undoing and redoing by checking _undoSelectionIndexes != nil. One thing we do know right now is that we're not using memory to record selection changes on the undo/redo stacks, and that's a good thing.
+  if (_undoSelectionIndexes) {
+    NSUInteger graphicIndex = [[self graphics] indexOfObject:graphic];
+    if (graphicIndex != NSNotFound) {
+      [_undoSelectionIndexes addIndex:graphicIndex];
+    } // else something truly bizarre has happened.
+  }
+
+}
+
+
 // This doesn't contribute to any KVC or KVO compliance. It's just a convenience method that's invoked down below.
 - (NSArray *)selectedGraphics {
   // Simple, because we made sure -graphics and -selectionIndexes never return nil.
@@ -452,6 +536,18 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
   return [self insetForHandlesRect:[graphic drawingBounds]];
 }
 
+- (SKTSpatialIndex *)spatialIndex {
+  if (nil == _spatialIndex) {
+    _spatialIndex = [[SKTSpatialIndex alloc] initWithGraphics:[self graphics] owner:(id<SKTGraphicsOwner>)self];
+  }
+  return _spatialIndex;
+}
+
+// Override of the NSObject(SKTGraphicsOwner) method, so -drawGraphics:view:rect: can skip graphics outside the rect without looking at them.
+- (SKTSpatialIndex *)spatialIndexOfGraphics:(NSArray<SKTGraphic *> *)graphics {
+  return (graphics == [self graphics]) ? [self spatialIndex] : nil;
+}
+
 - (NSRect)handleDrawingBoundsOfGraphics:(NSArray *)graphics {
   // The drawing bounds of an array of graphics is the union of all of their drawing bounds.
   NSRect drawingBounds = NSZeroRect;
@@ -638,59 +734,60 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 #pragma mark - Mouse Event Handling
 
 
+// How far from a stroke a click still hits it, in view units: a few screen points, whatever the zoom.
+- (CGFloat)hitTolerance {
+  return fabs([self convertSize:NSMakeSize(SKTGraphicViewHitTolerance, 0) fromView:nil].width);
+}
+
 - (SKTGraphic *)graphicUnderPoint:(NSPoint)point index:(NSUInteger *)outIndex isSelected:(BOOL *)outIsSelected handle:(NSInteger *)outHandle {
 
   // We don't touch *outIndex, *outIsSelected, or *outHandle if we return nil. Those values are undefined if we don't return a match.
 
-  // Search through all of the graphics, front to back, looking for one that claims that the point is on a selection handle (if it's selected) or in the contents of the graphic itself.
+  // Search through the graphics in the neighborhood of the point, front to back, looking for one that claims that the point is on a selection handle (if it's selected) or in the contents of the graphic itself. The spatial index has already weeded out graphics whose handle drawing bounds don't contain the point.
   SKTGraphic *graphicToReturn = nil;
   NSArray *graphics = [self graphics];
   NSIndexSet *selectionIndexes = [self selectionIndexes];
-  NSUInteger graphicCount = [graphics count];
-  for (NSUInteger index = 0; index < graphicCount; index++) {
+  NSIndexSet *candidateIndexes = [[self spatialIndex] indexesOfGraphicsContainingPoint:point];
+  CGFloat tolerance = [self hitTolerance];
+  for (NSUInteger index = [candidateIndexes firstIndex]; index != NSNotFound; index = [candidateIndexes indexGreaterThanIndex:index]) {
     SKTGraphic *graphic = graphics[index];
 
-    // Do a quick check to weed out graphics that aren't even in the neighborhood.
-    if (NSPointInRect(point, [self handleDrawingBoundsOfGraphic:graphic])) {
-
-      // Check the graphic's selection handles first, because they take precedence when they overlap the graphic's contents.
-      BOOL graphicIsSelected = [selectionIndexes containsIndex:index];
-      if (graphicIsSelected) {
-        NSInteger handle = [graphic handleUnderPoint:point inView:self];
-        if (handle != SKTGraphicNoHandle) {
-
-          // The user clicked on a handle of a selected graphic.
-          graphicToReturn = graphic;
-          if (outHandle) {
-            *outHandle = handle;
-          }
+    // Check the graphic's selection handles first, because they take precedence when they overlap the graphic's contents.
+    BOOL graphicIsSelected = [selectionIndexes containsIndex:index];
+    if (graphicIsSelected) {
+      NSInteger handle = [graphic handleUnderPoint:point inView:self];
+      if (handle != SKTGraphicNoHandle) {
 
+        // The user clicked on a handle of a selected graphic.
+        graphicToReturn = graphic;
+        if (outHandle) {
+          *outHandle = handle;
         }
-      }
-      if (!graphicToReturn) {
-        BOOL clickedOnGraphicContents = [graphic isContentsUnderPoint:point];
-        if (clickedOnGraphicContents) {
 
-          // The user clicked on the contents of a graphic.
-          graphicToReturn = graphic;
-          if (outHandle) {
-            *outHandle = SKTGraphicNoHandle;
-          }
-
-        }
       }
-      if (graphicToReturn) {
-
-        // Return values and stop looking.
-        if (outIndex) {
-          *outIndex = index;
-        }
-        if (outIsSelected) {
-          *outIsSelected = graphicIsSelected;
+    }
+    if (!graphicToReturn) {
+      BOOL clickedOnGraphicContents = [graphic isContentsUnderPoint:point tolerance:tolerance];
+      if (clickedOnGraphicContents) {
+
+        // The user clicked on the contents of a graphic.
+        graphicToReturn = graphic;
+        if (outHandle) {
+          *outHandle = SKTGraphicNoHandle;
         }
-        break;
 
       }
+    }
+    if (graphicToReturn) {
+
+      // Return values and stop looking.
+      if (outIndex) {
+        *outIndex = index;
+      }
+      if (outIsSelected) {
+        *outIsSelected = graphicIsSelected;
+      }
+      break;
 
     }
 
@@ -833,16 +930,7 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 
 
 - (NSIndexSet *)indexesOfGraphicsIntersectingRect:(NSRect)rect {
-  NSMutableIndexSet *indexSetToReturn = [NSMutableIndexSet indexSet];
-  NSArray *graphics = [self graphics];
-  NSUInteger graphicCount = [graphics count];
-  for (NSUInteger index = 0; index < graphicCount; index++) {
-    SKTGraphic *graphic = graphics[index];
-    if (NSIntersectsRect(rect, [self handleDrawingBoundsOfGraphic:graphic])) {
-      [indexSetToReturn addIndex:index];
-    }
-  }
-  return indexSetToReturn;
+  return [[self spatialIndex] indexesOfGraphicsIntersectingRect:rect];
 }
 
 
@@ -1181,9 +1269,17 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
 - (BOOL)makeNewImageFromContentsOfFile:(NSString *)filename atPoint:(NSPoint)point {
   NSString *extension = [filename pathExtension];
   if ([[NSImage imageFileTypes] containsObject:extension]) {
-    NSImage *contents = [[NSImage alloc] initWithContentsOfFile:filename];
-    if (contents) {
-      SKTImage *newImage = [[SKTImage alloc] initWithPosition:point contents:contents];
+    // PNGs and JPEGs keep their bytes, to be saved as they are.
+    NSString *mimeType = SKTImageMIMETypeOfPathExtension(extension);
+    NSData *encodedData = mimeType ? [NSData dataWithContentsOfFile:filename] : nil;
+    SKTImage *newImage = nil;
+    if (encodedData) {
+      newImage = [[SKTImage alloc] initWithPosition:point encodedData:encodedData type:mimeType];
+    } else {
+      NSImage *contents = [[NSImage alloc] initWithContentsOfFile:filename];
+      newImage = contents ? [[SKTImage alloc] initWithPosition:point contents:contents] : nil;
+    }
+    if (newImage) {
       [[self mutableGraphics] insertObject:newImage atIndex:0];
       [self changeSelectionIndexes:[NSIndexSet indexSetWithIndex:0]];
       return YES;
@@ -1447,6 +1543,8 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
     return 0 < [[self selectedGraphics] countByFilteringWithSelector:@selector(canOpenPolygon)];
   } else if (action == @selector(closePolygon:)) {
     return 0 < [[self selectedGraphics] countByFilteringWithSelector:@selector(canClosePolygon)];
+  } else if (action == @selector(simplify:)) {
+    return [self canSimplify];
   }else {
     return YES;
   }
@@ -1769,6 +1867,32 @@ static CGFloat SKTGraphicViewDefaultPasteCascadeDelta = 10.0;
   [[self undoManager] setActionName:NSLocalizedStringFromTable(@"Close Polygon", @"UndoStrings", @"Action name for closig a polygon.")];
 }
 
+- (BOOL)canSimplify {
+  for (SKTGraphic *graphic in [self selectedGraphics]) {
+    if ( ! [graphic locked] && [graphic canSimplify]) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+// Simplify the unlocked selection by curve fitting, to the tolerance in the user defaults, and tell the user how much it did.
+- (IBAction)simplify:(id)sender {
+  CGFloat tolerance = SKTSimplifyDefaultTolerance();
+  SKTSimplifyReport report = {0, 0, 0};
+  for (SKTGraphic *graphic in [self selectedGraphics]) {
+    if ( ! [graphic locked] && [graphic canSimplify]) {
+      report = SKTSimplifyReportAdd(report, [graphic simplifyWithMethod:SKTSimplifyMethodCurveFit tolerance:tolerance]);
+    }
+  }
+  [[self undoManager] setActionName:NSLocalizedStringFromTable(@"Simplify", @"UndoStrings", @"Action name for simplifying.")];
+
+  NSAlert *alert = [[NSAlert alloc] init];
+  [alert setMessageText:[NSString stringWithFormat:NSLocalizedStringFromTable(@"%lu vertices simplified to %lu.", @"SKTGraphicView", @"Message after simplifying. Arguments are the vertex counts before and after."), (unsigned long)report.originalVertexCount, (unsigned long)report.vertexCount]];
+  [alert setInformativeText:[NSString stringWithFormat:NSLocalizedStringFromTable(@"No vertex moved more than %.3g, with a tolerance of %.3g.", @"SKTGraphicView", @"Detail after simplifying. Arguments are the maximum deviation and the tolerance."), report.maxDeviation, tolerance]];
+  [alert beginSheetModalForWindow:[self window] completionHandler:nil];
+}
+
 
 
 - (IBAction)makeSameWidth:(id)sender {
@@ -53,7 +53,7 @@ extern NSString *const SKTGridAnyKey;
 // Given a rectangle, return a rectangle the four corners of which are aligned to the grid, regardless of whether this grid is constraining right now. It's a programming error invoke this when -canAlign would return NO though.
 - (NSRect)alignedRect:(NSRect)rect;
 
-// Given the bounds of a rectangular area in the coordinate space establish by a view's bounds, draw in that view the part of the grid showing in that rectangular area.
+// Given the bounds of a rectangular area in the coordinate space establish by a view's bounds, draw in that view the part of the grid showing in that rectangular area. Every fifth line is a major line, drawn darker than the minor lines between. Lines that would be too close together on screen at the view's zoom are left out, five at a time, so what's drawn is from a cached image of a patch of the grid, tiled.
 - (void)drawRect:(NSRect)rect inView:(NSView *)view;
 
 @end
@@ -19,6 +19,18 @@ NSString *const SKTGridAnyKey = @"any";
 // The number of seconds that we wait after temporarily showing the grid before we hide it again. This number has never been reviewed by an actual user interface designer, but it seems nice to at least one engineer at Apple.
 static NSTimeInterval SKTGridTemporaryShowingTime = 1.0;
 
+enum {
+  // Every this many lines is a major line, drawn darker than the minor lines between.
+  SKTGridLinesPerMajorLine = 5,
+
+  // Lines closer together than this many points on screen are left out: only every SKTGridLinesPerMajorLine'th is drawn, as often as it takes.
+  SKTGridMinimumLinePitch = 6,
+
+  // The grid is drawn by tiling an image of at least this many pixels a side. If that's not enough for one major line spacing, which is only so when zoomed well in, there are few enough lines to stroke one by one.
+  SKTGridMinimumTilePixels = 128,
+  SKTGridMaximumTilePixels = 1024,
+};
+
 @interface SKTGrid() {
   // The values underlying the key-value coding (KVC) and observing (KVO) compliance described below. There isn't a full complement of corresponding getter or setter methods. KVC's direct instance variable access, KVO's autonotifying, and KVO's property dependency mechanism make them unnecessary. If in the future we decide that we need to do more complicated things when these values are gotten or set we can add getter and setter methods then, and no bound object will know the difference (so don't let me hear any more guff about direct ivar access "breaking encapsulation").
 
@@ -26,6 +38,13 @@ static NSTimeInterval SKTGridTemporaryShowingTime = 1.0;
 
   // Sometimes we temporarily show the grid to provide feedback for user changes to the grid spacing. When we do that we use a timer to turn it off again.
   NSTimer *_hidingTimer;
+
+  // A CGImageRef of a square of the grid, a whole number of major lines a side, with lines along its left and bottom edges, and what it was drawn for.
+  id _tile;
+  NSColor *_tileColor;
+  CGFloat _tileLineSpacing;
+  CGFloat _tileSide;
+  NSInteger _tilePixels;
 }
 
 @end
@@ -198,28 +217,120 @@ static NSTimeInterval SKTGridTemporaryShowingTime = 1.0;
 }
 
 
+// How the grid looks in view right now: the spacing of the lines drawn, a multiple of _spacing by a power of SKTGridLinesPerMajorLine. Returns 0 if the view can't say how big a point of it is on screen.
+- (CGFloat)lineSpacingInView:(NSView *)view {
+  CGFloat pointsPerUnit = fabs([view convertSize:NSMakeSize(1, 1) toView:nil].width);
+  CGFloat lineSpacing = 0;
+  if (0 < pointsPerUnit) {
+    for (lineSpacing = _spacing; lineSpacing * pointsPerUnit < SKTGridMinimumLinePitch; lineSpacing *= SKTGridLinesPerMajorLine) {
+    }
+  }
+  return lineSpacing;
+}
+
+
+// Every line of the given spacing across rect, one path for the major lines and one for the minor.
+static void StrokeGridLines(NSRect rect, CGFloat lineSpacing, NSColor *majorColor, NSColor *minorColor) {
+  NSBezierPath *majorPath = [NSBezierPath bezierPath];
+  NSBezierPath *minorPath = [NSBezierPath bezierPath];
+  NSInteger lastVerticalLineNumber = floor(NSMaxX(rect) / lineSpacing);
+  for (NSInteger lineNumber = ceil(NSMinX(rect) / lineSpacing); lineNumber <= lastVerticalLineNumber; lineNumber++) {
+    NSBezierPath *path = (0 == lineNumber % SKTGridLinesPerMajorLine) ? majorPath : minorPath;
+    [path moveToPoint:NSMakePoint((lineNumber * lineSpacing), NSMinY(rect))];
+    [path lineToPoint:NSMakePoint((lineNumber * lineSpacing), NSMaxY(rect))];
+  }
+  NSInteger lastHorizontalLineNumber = floor(NSMaxY(rect) / lineSpacing);
+  for (NSInteger lineNumber = ceil(NSMinY(rect) / lineSpacing); lineNumber <= lastHorizontalLineNumber; lineNumber++) {
+    NSBezierPath *path = (0 == lineNumber % SKTGridLinesPerMajorLine) ? majorPath : minorPath;
+    [path moveToPoint:NSMakePoint(NSMinX(rect), (lineNumber * lineSpacing))];
+    [path lineToPoint:NSMakePoint(NSMaxX(rect), (lineNumber * lineSpacing))];
+  }
+  [minorPath setLineWidth:0.0];
+  [minorColor set];
+  [minorPath stroke];
+  [majorPath setLineWidth:0.0];
+  [majorColor set];
+  [majorPath stroke];
+}
+
+
+// The minor lines are the grid color, only fainter.
+- (NSColor *)minorLineColor {
+  return [_color colorWithAlphaComponent:[_color alphaComponent] * 0.5];
+}
+
+
+// Makes _tile, if the one there is isn't for this color, line spacing, and resolution. Returns NO if a tile big enough would be too big.
+- (BOOL)makeTileForLineSpacing:(CGFloat)lineSpacing pixelsPerUnit:(CGFloat)pixelsPerUnit {
+  CGFloat majorLineSpacing = lineSpacing * SKTGridLinesPerMajorLine;
+  CGFloat majorLinesPerTile = MAX(1, ceil(SKTGridMinimumTilePixels / (majorLineSpacing * pixelsPerUnit)));
+  CGFloat side = majorLinesPerTile * majorLineSpacing;
+  NSInteger pixels = ceil(side * pixelsPerUnit);
+  if (SKTGridMaximumTilePixels < pixels) {
+    return NO;
+  }
+  if (_tile && lineSpacing == _tileLineSpacing && pixels == _tilePixels && [_color isEqual:_tileColor]) {
+    return YES;
+  }
+
+  // Draw it a pixel at a time, minor lines first so the major lines cross over them. A bitmap context's origin is at its bottom left, so these are the left and bottom edges of the tile however it ends up drawn, which are where the view's lines at multiples of the major line spacing are.
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+  CGContextRef context = CGBitmapContextCreate(NULL, (size_t)pixels, (size_t)pixels, 8, 0, colorSpace, (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+  CGColorSpaceRelease(colorSpace);
+  if (NULL == context) {
+    return NO;
+  }
+  NSInteger lineCount = majorLinesPerTile * SKTGridLinesPerMajorLine;
+  CGFloat pixelsPerLine = (CGFloat)pixels / lineCount;
+  CGContextSetFillColorWithColor(context, [[self minorLineColor] CGColor]);
+  for (NSInteger lineNumber = 0; lineNumber < lineCount; lineNumber++) {
+    if (0 != lineNumber % SKTGridLinesPerMajorLine) {
+      CGFloat offset = round(lineNumber * pixelsPerLine);
+      CGContextFillRect(context, CGRectMake(offset, 0, 1, pixels));
+      CGContextFillRect(context, CGRectMake(0, offset, pixels, 1));
+    }
+  }
+  CGContextSetFillColorWithColor(context, [_color CGColor]);
+  for (NSInteger lineNumber = 0; lineNumber < lineCount; lineNumber += SKTGridLinesPerMajorLine) {
+    CGFloat offset = round(lineNumber * pixelsPerLine);
+    CGContextFillRect(context, CGRectMake(offset, 0, 1, pixels));
+    CGContextFillRect(context, CGRectMake(0, offset, pixels, 1));
+  }
+  _tile = CFBridgingRelease(CGBitmapContextCreateImage(context));
+  CGContextRelease(context);
+  _tileColor = _color;
+  _tileLineSpacing = lineSpacing;
+  _tileSide = side;
+  _tilePixels = pixels;
+  return nil != _tile;
+}
+
+
 - (void)drawRect:(NSRect)rect inView:(NSView *)view {
 
   // The grid might not be usable right now. It might be shown, but only temporarily.
   if ([self isUsable] && (_alwaysShown || _hidingTimer)) {
 
-    // Figure out a big bezier path that corresponds to the entire grid. It will consist of the vertical lines and then the horizontal lines.
-    NSBezierPath *gridPath = [NSBezierPath bezierPath];
-    NSInteger lastVerticalLineNumber = floor(NSMaxX(rect) / _spacing);
-    for (NSInteger lineNumber = ceil(NSMinX(rect) / _spacing); lineNumber <= lastVerticalLineNumber; lineNumber++) {
-      [gridPath moveToPoint:NSMakePoint((lineNumber * _spacing), NSMinY(rect))];
-      [gridPath lineToPoint:NSMakePoint((lineNumber * _spacing), NSMaxY(rect))];
-    }
-    NSInteger lastHorizontalLineNumber = floor(NSMaxY(rect) / _spacing);
-    for (NSInteger lineNumber = ceil(NSMinY(rect) / _spacing); lineNumber <= lastHorizontalLineNumber; lineNumber++) {
-      [gridPath moveToPoint:NSMakePoint(NSMinX(rect), (lineNumber * _spacing))];
-      [gridPath lineToPoint:NSMakePoint(NSMaxX(rect), (lineNumber * _spacing))];
+    // Leave out lines too close together to see, so how long this takes depends only on how big rect is on screen, whatever the spacing and zoom.
+    CGFloat lineSpacing = [self lineSpacingInView:view];
+    if (0 == lineSpacing) {
+      return;
     }
 
-    // Draw the grid as one-pixel-wide lines of a specific color.
-    [_color set];
-    [gridPath setLineWidth:0.0];
-    [gridPath stroke];
+    // Tile rect with a cached image of the grid, anchored at the origin like the lines are, and one pixel of it to one pixel of the screen, near enough. No smoothing, so the lines stay one pixel wide.
+    CGFloat pixelsPerUnit = fabs([view convertSizeToBacking:NSMakeSize(1, 1)].width);
+    if ([self makeTileForLineSpacing:lineSpacing pixelsPerUnit:pixelsPerUnit]) {
+      CGContextRef context = (CGContextRef)[[NSGraphicsContext currentContext] graphicsPort];
+      CGContextSaveGState(context);
+      CGContextClipToRect(context, NSRectToCGRect(rect));
+      CGContextSetInterpolationQuality(context, kCGInterpolationNone);
+      CGContextDrawTiledImage(context, CGRectMake(0, 0, _tileSide, _tileSide), (__bridge CGImageRef)_tile);
+      CGContextRestoreGState(context);
+    } else {
+
+      // Zoomed well in, there are only a few lines: draw them as one-pixel-wide lines of a specific color.
+      StrokeGridLines(rect, lineSpacing, _color, [self minorLineColor]);
+    }
 
   }
 
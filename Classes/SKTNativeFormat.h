@@ -0,0 +1,105 @@
+/*  SKTNativeFormat.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+@class SKTGraphic;
+
+/*
+ Version 3 of FloorSketch's own file format: a little-endian binary file of chunks, so a reader can map the file and
+ decode only what it needs, when it needs it.
+
+   header     "FLRSKTCH", uint32 version (3), uint32 chunk count
+   directory  per chunk: uint32 type, uint32 reserved (0), uint64 offset, uint64 length
+   chunks     each at an 8 byte aligned offset:
+     'DOCP'   a binary property list: SKTDocumentVersionKey, SKTDocumentPrintInfoKey, SKTDocumentPropertiesKey
+     'CLAS'   uint32 count, then per graphic class: uint32 length, UTF-8 class name
+     'COLR'   uint32 count, then per color: uint8 kind, then its components as float64s (see SKTNativeColorKind)
+     'GIDX'   per top-level graphic, front to back: the uint64 offset of its record in 'GRPH'
+     'GRPH'   the records of the top-level graphics, back to back
+     'IMAG'   one per image: the image's bytes, an NSArchiver'd NSImage, or a PNG or JPEG file's bytes as they were
+              read, as the image's record says. Images are numbered in directory order.
+
+ A graphic's record is uint32 class index, uint32 body length, then a body written by -writeNativeToWriter: and
+ read by -initWithNativeDecoder:. Coordinates are raw float64s. Colors are indexes into 'COLR', 1 based, with 0 for
+ nil. Readers skip chunk types they don't know.
+ */
+
+// Every graphic class stores what's particular to it after what its superclass stores, so each override calls super
+// first. The reading and writing must match exactly.
+@interface SKTNativeWriter : NSObject
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length;
+- (void)writeUInt8:(uint8_t)value;
+- (void)writeUInt32:(uint32_t)value;
+- (void)writeDouble:(double)value;
+- (void)writeDoubles:(const CGFloat *)values count:(NSUInteger)count;
+- (void)writePoint:(NSPoint)point;
+- (void)writeRect:(NSRect)rect;
+// Stored once in the color table, however many graphics use it. nil is allowed.
+- (void)writeColor:(NSColor *)color;
+// Length prefixed, inline.
+- (void)writeData:(NSData *)data;
+// Goes in a chunk of its own, so a reader may leave it undecoded until it's drawn.
+- (void)writeImageData:(NSData *)data;
+// Count prefixed records, as for an SKTGroup.
+- (void)writeGraphics:(NSArray *)graphics;
+
+@end
+
+// Reads one graphic's record. Reads past the end of the record return zeros and mark the decoder damaged, so a
+// graphic need only check at the end.
+@interface SKTNativeDecoder : NSObject
+
+@property(nonatomic, readonly, getter=isDamaged) BOOL damaged;
+
+// Bytes left in the record, to check a count against before allocating for it.
+@property(nonatomic, readonly) NSUInteger remainingLength;
+
+// Returns NO, and reads nothing, if there aren't length bytes left.
+- (BOOL)readBytes:(void *)bytes length:(NSUInteger)length;
+- (uint8_t)readUInt8;
+- (uint32_t)readUInt32;
+- (double)readDouble;
+// Returns NO, and reads nothing, if there aren't count values left.
+- (BOOL)readDoubles:(CGFloat *)values count:(NSUInteger)count;
+- (NSPoint)readPoint;
+- (NSRect)readRect;
+- (NSColor *)readColor;
+// Without copying: the result keeps the file's bytes alive.
+- (NSData *)readData;
+- (NSData *)readImageData;
+- (NSArray *)readGraphics;
+
+// For a graphic that can't make sense of what it read.
+- (void)markDamaged;
+
+@end
+
+@interface SKTNativeReader : NSObject
+
+// True if data starts like a version 3 or later file. Anything else may be the property list format of version 2.
++ (BOOL)isNativeData:(NSData *)data;
+
+// Reads only the header, the directory, the document properties, and the class and color tables. data may be
+// mapped: graphics and images are decoded from it as they're asked for. Returns nil, and sets *outError, if data is
+// corrupt or from a newer version.
+- (instancetype)initWithData:(NSData *)data error:(NSError **)outError;
+
+// The 'DOCP' chunk's property list.
+@property(nonatomic, readonly) NSDictionary *properties;
+
+@property(nonatomic, readonly) NSUInteger graphicCount;
+
+// Decoded on demand, so repeated calls return new graphics. nil if the record is damaged or of an unknown class.
+// Safe to call from several threads at once.
+- (SKTGraphic *)graphicAtIndex:(NSUInteger)index;
+
+// Every top-level graphic, decoded in parallel. Damaged ones are left out, as in the property list format.
+- (NSArray *)graphics;
+
+@end
+
+// Returns version 3 file data.
+NSData *SKTNativeDataWithGraphics(NSArray *graphics, NSDictionary *properties);
@@ -0,0 +1,758 @@
+/*  SKTNativeFormat.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTNativeFormat.h"
+
+#import "NSColor_SKT.h"
+#import "SKTColorTable.h"
+#import "SKTError.h"
+#import "SKTGraphic.h"
+
+#include <libkern/OSByteOrder.h>
+
+static const char kMagic[8] = {'F', 'L', 'R', 'S', 'K', 'T', 'C', 'H'};
+
+enum {
+  kVersion = 3,
+  kHeaderSize = 16,
+  kDirectoryEntrySize = 24,
+  kRecordHeaderSize = 8,
+
+  // Top-level graphics are decoded this many to a task.
+  kDecodeBatchSize = 256,
+};
+
+#define CHUNK_TYPE(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+enum {
+  kChunkDocumentProperties = CHUNK_TYPE('D', 'O', 'C', 'P'),
+  kChunkClasses = CHUNK_TYPE('C', 'L', 'A', 'S'),
+  kChunkColors = CHUNK_TYPE('C', 'O', 'L', 'R'),
+  kChunkGraphicIndex = CHUNK_TYPE('G', 'I', 'D', 'X'),
+  kChunkGraphics = CHUNK_TYPE('G', 'R', 'P', 'H'),
+  kChunkImage = CHUNK_TYPE('I', 'M', 'A', 'G'),
+};
+
+// How a color table entry is stored. The common color spaces are stored as their components, exactly. Anything else,
+// a pattern or catalog color say, is NSArchiver'd.
+typedef NS_ENUM(uint8_t, SKTNativeColorKind) {
+  SKTNativeColorCalibratedRGB = 1,   // red, green, blue, alpha
+  SKTNativeColorDeviceRGB = 2,       // red, green, blue, alpha
+  SKTNativeColorCalibratedWhite = 3, // white, alpha
+  SKTNativeColorDeviceWhite = 4,     // white, alpha
+  SKTNativeColorArchived = 255,      // uint32 length, NSArchiver'd NSColor
+};
+
+static uint32_t GetLittleEndian32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof v);
+  return OSSwapLittleToHostInt32(v);
+}
+
+static uint64_t GetLittleEndian64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof v);
+  return OSSwapLittleToHostInt64(v);
+}
+
+static double GetLittleEndianDouble(const uint8_t *p) {
+  uint64_t bits = GetLittleEndian64(p);
+  double v;
+  memcpy(&v, &bits, sizeof v);
+  return v;
+}
+
+static NSUInteger Align8(NSUInteger n) {
+  return (n + 7) & ~(NSUInteger)7;
+}
+
+#pragma mark - Writing
+
+// The fields of a record that index the writer's tables, which differ from save to save.
+typedef NS_ENUM(uint8_t, SKTNativeFixupKind) {
+  SKTNativeFixupClass,
+  SKTNativeFixupColor,
+  SKTNativeFixupImage,
+};
+
+typedef struct SKTNativeFixup {
+  uint32_t offset;
+  SKTNativeFixupKind kind;
+} SKTNativeFixup;
+
+// A graphic's record body as a save wrote it, kept as the graphic's nativeRecordCache. The next save copies the bytes
+// and points the fixups at its own tables, rather than have the graphic write itself again.
+@interface SKTNativeRecord : NSObject {
+ @public
+  NSData *_bytes;
+  // Of SKTNativeFixups, offsets from the start of _bytes.
+  NSData *_fixups;
+  // What each fixup indexes: a class name, an NSColor, or an image's NSData.
+  NSArray *_fixupObjects;
+}
+@end
+
+@implementation SKTNativeRecord
+@end
+
+@interface SKTNativeWriter () {
+ @public
+  // Where records are written: 'GRPH' while writing graphics.
+  NSMutableData *_bytes;
+  NSMutableArray<NSData *> *_images;
+
+ @private
+  NSMutableArray<NSString *> *_classNames;
+  NSMutableDictionary<NSString *, NSNumber *> *_classIndexes;
+
+  // _colors[i] has the 1 based index i + 1.
+  NSMutableArray<NSColor *> *_colors;
+  NSMutableDictionary<NSColor *, NSNumber *> *_colorIndexes;
+
+  // Of SKTNativeFixups, offsets into _bytes: every table index written, so records can be cut out as SKTNativeRecords.
+  NSMutableData *_fixups;
+}
+@end
+
+@implementation SKTNativeWriter
+
+- (instancetype)init {
+  self = [super init];
+  if (self) {
+    _bytes = [NSMutableData data];
+    _classNames = [NSMutableArray array];
+    _classIndexes = [NSMutableDictionary dictionary];
+    _colors = [NSMutableArray array];
+    _colorIndexes = [NSMutableDictionary dictionary];
+    _images = [NSMutableArray array];
+    _fixups = [NSMutableData data];
+  }
+  return self;
+}
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length {
+  [_bytes appendBytes:bytes length:length];
+}
+
+- (void)writeUInt8:(uint8_t)value {
+  [_bytes appendBytes:&value length:1];
+}
+
+- (void)writeUInt32:(uint32_t)value {
+  value = OSSwapHostToLittleInt32(value);
+  [_bytes appendBytes:&value length:sizeof value];
+}
+
+- (void)writeUInt64:(uint64_t)value {
+  value = OSSwapHostToLittleInt64(value);
+  [_bytes appendBytes:&value length:sizeof value];
+}
+
+- (void)writeDouble:(double)value {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof bits);
+  [self writeUInt64:bits];
+}
+
+- (void)writeDoubles:(const CGFloat *)values count:(NSUInteger)count {
+#if __LITTLE_ENDIAN__ && CGFLOAT_IS_DOUBLE
+  [_bytes appendBytes:values length:count * sizeof(double)];
+#else
+  for (NSUInteger i = 0; i < count; ++i) {
+    [self writeDouble:values[i]];
+  }
+#endif
+}
+
+- (void)writePoint:(NSPoint)point {
+  [self writeDoubles:(const CGFloat[]){point.x, point.y} count:2];
+}
+
+- (void)writeRect:(NSRect)rect {
+  [self writeDoubles:(const CGFloat[]){rect.origin.x, rect.origin.y, rect.size.width, rect.size.height} count:4];
+}
+
+- (void)addFixup:(SKTNativeFixupKind)kind {
+  SKTNativeFixup fixup = {(uint32_t)[_bytes length], kind};
+  [_fixups appendBytes:&fixup length:sizeof fixup];
+}
+
+- (uint32_t)indexOfColor:(NSColor *)color {
+  NSNumber *indexNumber = _colorIndexes[color];
+  if (nil == indexNumber) {
+    [_colors addObject:color];
+    indexNumber = @([_colors count]);
+    _colorIndexes[color] = indexNumber;
+  }
+  return [indexNumber unsignedIntValue];
+}
+
+- (uint32_t)indexOfClassName:(NSString *)className {
+  NSNumber *classIndex = _classIndexes[className];
+  if (nil == classIndex) {
+    classIndex = @([_classNames count]);
+    [_classNames addObject:className];
+    _classIndexes[className] = classIndex;
+  }
+  return [classIndex unsignedIntValue];
+}
+
+- (void)writeColor:(NSColor *)color {
+  if (color) {
+    [self addFixup:SKTNativeFixupColor];
+    [self writeUInt32:[self indexOfColor:color]];
+  } else {
+    [self writeUInt32:0];
+  }
+}
+
+- (void)writeData:(NSData *)data {
+  [self writeUInt32:(uint32_t)[data length]];
+  [_bytes appendData:data];
+}
+
+- (void)writeImageData:(NSData *)data {
+  [_images addObject:data ?: [NSData data]];
+  [self addFixup:SKTNativeFixupImage];
+  [self writeUInt32:(uint32_t)([_images count] - 1)];
+}
+
+// Cuts what's been written since bodyOffset, and the fixups since fixupIndex, out as a record.
+- (SKTNativeRecord *)recordFromOffset:(NSUInteger)bodyOffset fixupIndex:(NSUInteger)fixupIndex {
+  SKTNativeRecord *record = [[SKTNativeRecord alloc] init];
+  record->_bytes = [_bytes subdataWithRange:NSMakeRange(bodyOffset, [_bytes length] - bodyOffset)];
+  NSUInteger fixupCount = [_fixups length] / sizeof(SKTNativeFixup) - fixupIndex;
+  NSMutableData *fixups = [NSMutableData dataWithBytes:(const SKTNativeFixup *)[_fixups bytes] + fixupIndex length:fixupCount * sizeof(SKTNativeFixup)];
+  SKTNativeFixup *fixup = [fixups mutableBytes];
+  NSMutableArray *fixupObjects = [NSMutableArray arrayWithCapacity:fixupCount];
+  const uint8_t *bytes = [_bytes bytes];
+  for (NSUInteger i = 0; i < fixupCount; ++i) {
+    uint32_t index = GetLittleEndian32(bytes + fixup[i].offset);
+    switch (fixup[i].kind) {
+      case SKTNativeFixupClass: [fixupObjects addObject:_classNames[index]]; break;
+      case SKTNativeFixupColor: [fixupObjects addObject:_colors[index - 1]]; break;
+      case SKTNativeFixupImage: [fixupObjects addObject:_images[index]]; break;
+    }
+    fixup[i].offset -= (uint32_t)bodyOffset;
+  }
+  record->_fixups = fixups;
+  record->_fixupObjects = fixupObjects;
+  return record;
+}
+
+// Appends a record written by an earlier writer, pointing its fixups at this writer's tables.
+- (void)writeRecord:(SKTNativeRecord *)record {
+  NSUInteger bodyOffset = [_bytes length];
+  [_bytes appendData:record->_bytes];
+  uint8_t *bytes = [_bytes mutableBytes];
+  const SKTNativeFixup *fixup = [record->_fixups bytes];
+  NSUInteger fixupCount = [record->_fixups length] / sizeof(SKTNativeFixup);
+  for (NSUInteger i = 0; i < fixupCount; ++i) {
+    id object = record->_fixupObjects[i];
+    uint32_t index = 0;
+    switch (fixup[i].kind) {
+      case SKTNativeFixupClass: index = [self indexOfClassName:object]; break;
+      case SKTNativeFixupColor: index = [self indexOfColor:object]; break;
+      case SKTNativeFixupImage:
+        [_images addObject:object];
+        index = (uint32_t)([_images count] - 1);
+        break;
+    }
+    SKTNativeFixup spliced = {(uint32_t)(bodyOffset + fixup[i].offset), fixup[i].kind};
+    [_fixups appendBytes:&spliced length:sizeof spliced];
+    OSWriteLittleInt32(bytes, spliced.offset, index);
+  }
+}
+
+- (void)writeGraphic:(SKTGraphic *)graphic {
+  [self addFixup:SKTNativeFixupClass];
+  [self writeUInt32:[self indexOfClassName:NSStringFromClass([graphic class])]];
+  NSUInteger lengthOffset = [_bytes length];
+  [self writeUInt32:0];
+
+  // A graphic that hasn't changed since the last save has its record spliced in as it was.
+  SKTNativeRecord *record = [graphic nativeRecordCache];
+  if (record) {
+    [self writeRecord:record];
+  } else {
+    NSUInteger bodyOffset = [_bytes length];
+    NSUInteger fixupIndex = [_fixups length] / sizeof(SKTNativeFixup);
+    [graphic writeNativeToWriter:self];
+    [graphic setNativeRecordCache:[self recordFromOffset:bodyOffset fixupIndex:fixupIndex]];
+  }
+  uint32_t length = OSSwapHostToLittleInt32((uint32_t)([_bytes length] - lengthOffset - sizeof length));
+  [_bytes replaceBytesInRange:NSMakeRange(lengthOffset, sizeof length) withBytes:&length];
+}
+
+- (void)writeGraphics:(NSArray *)graphics {
+  [self writeUInt32:(uint32_t)[graphics count]];
+  for (SKTGraphic *graphic in graphics) {
+    [self writeGraphic:graphic];
+  }
+}
+
+// Takes what's been written so far, and starts afresh.
+- (NSData *)takeBytes {
+  NSData *bytes = _bytes;
+  _bytes = [NSMutableData data];
+  [_fixups setLength:0];
+  return bytes;
+}
+
+- (NSData *)classesChunk {
+  [self writeUInt32:(uint32_t)[_classNames count]];
+  for (NSString *className in _classNames) {
+    [self writeData:[className dataUsingEncoding:NSUTF8StringEncoding]];
+  }
+  return [self takeBytes];
+}
+
+- (NSData *)colorsChunk {
+  [self writeUInt32:(uint32_t)[_colors count]];
+  for (NSColor *color in _colors) {
+    NSString *colorSpaceName = [color colorSpaceName];
+    BOOL isCalibrated = [colorSpaceName isEqual:NSCalibratedRGBColorSpace] || [colorSpaceName isEqual:NSCalibratedWhiteColorSpace];
+    if ([colorSpaceName isEqual:NSCalibratedRGBColorSpace] || [colorSpaceName isEqual:NSDeviceRGBColorSpace]) {
+      CGFloat components[4];
+      [color getRed:&components[0] green:&components[1] blue:&components[2] alpha:&components[3]];
+      [self writeUInt8:isCalibrated ? SKTNativeColorCalibratedRGB : SKTNativeColorDeviceRGB];
+      [self writeDoubles:components count:4];
+    } else if ([colorSpaceName isEqual:NSCalibratedWhiteColorSpace] || [colorSpaceName isEqual:NSDeviceWhiteColorSpace]) {
+      CGFloat components[2];
+      [color getWhite:&components[0] alpha:&components[1]];
+      [self writeUInt8:isCalibrated ? SKTNativeColorCalibratedWhite : SKTNativeColorDeviceWhite];
+      [self writeDoubles:components count:2];
+    } else {
+      [self writeUInt8:SKTNativeColorArchived];
+      [self writeData:[color asArchiveData]];
+    }
+  }
+  return [self takeBytes];
+}
+
+@end
+
+NSData *SKTNativeDataWithGraphics(NSArray *graphics, NSDictionary *properties) {
+  SKTNativeWriter *writer = [[SKTNativeWriter alloc] init];
+
+  // The records first, since writing them is what fills the class, color and image tables.
+  NSUInteger graphicCount = [graphics count];
+  NSMutableData *graphicIndex = [NSMutableData dataWithLength:graphicCount * sizeof(uint64_t)];
+  uint8_t *offsets = [graphicIndex mutableBytes];
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    @autoreleasepool {
+      uint64_t offset = OSSwapHostToLittleInt64((uint64_t)[writer->_bytes length]);
+      memcpy(offsets + i * sizeof offset, &offset, sizeof offset);
+      [writer writeGraphic:graphics[i]];
+    }
+  }
+  NSData *graphicsChunk = [writer takeBytes];
+
+  NSMutableArray<NSData *> *chunks = [NSMutableArray array];
+  NSMutableArray<NSNumber *> *chunkTypes = [NSMutableArray array];
+  void (^addChunk)(uint32_t, NSData *) = ^(uint32_t type, NSData *chunk) {
+    [chunkTypes addObject:@(type)];
+    [chunks addObject:chunk];
+  };
+  addChunk(kChunkDocumentProperties, [NSPropertyListSerialization dataWithPropertyList:properties ?: @{} format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL] ?: [NSData data]);
+  addChunk(kChunkClasses, [writer classesChunk]);
+  addChunk(kChunkColors, [writer colorsChunk]);
+  addChunk(kChunkGraphicIndex, graphicIndex);
+  addChunk(kChunkGraphics, graphicsChunk);
+  for (NSData *image in writer->_images) {
+    addChunk(kChunkImage, image);
+  }
+
+  NSUInteger chunkCount = [chunks count];
+  NSUInteger length = Align8(kHeaderSize + chunkCount * kDirectoryEntrySize);
+  for (NSData *chunk in chunks) {
+    length = Align8(length + [chunk length]);
+  }
+  NSMutableData *data = [NSMutableData dataWithLength:length];
+  uint8_t *bytes = [data mutableBytes];
+  memcpy(bytes, kMagic, sizeof kMagic);
+  OSWriteLittleInt32(bytes, 8, kVersion);
+  OSWriteLittleInt32(bytes, 12, (uint32_t)chunkCount);
+  NSUInteger offset = Align8(kHeaderSize + chunkCount * kDirectoryEntrySize);
+  for (NSUInteger i = 0; i < chunkCount; ++i) {
+    NSData *chunk = chunks[i];
+    uint8_t *entry = bytes + kHeaderSize + i * kDirectoryEntrySize;
+    OSWriteLittleInt32(entry, 0, [chunkTypes[i] unsignedIntValue]);
+    OSWriteLittleInt64(entry, 8, offset);
+    OSWriteLittleInt64(entry, 16, [chunk length]);
+    memcpy(bytes + offset, [chunk bytes], [chunk length]);
+    offset = Align8(offset + [chunk length]);
+  }
+  return data;
+}
+
+#pragma mark - Reading
+
+@interface SKTNativeReader () {
+ @public
+  NSData *_data;
+  // Each a Class, or NSNull for a name that isn't an SKTGraphic class in this version.
+  NSArray *_classes;
+  // 1 based, like the color indexes in records: _colors[0] is NSNull, for nil.
+  NSArray *_colors;
+  // Ranges of _data.
+  NSRange _graphicIndexRange;
+  NSRange _graphicsRange;
+  NSRange *_imageRanges;
+  NSUInteger _imageCount;
+}
+@end
+
+@interface SKTNativeDecoder () {
+  SKTNativeReader *_reader;
+  const uint8_t *_cursor;
+  const uint8_t *_end;
+}
+- (instancetype)initWithReader:(SKTNativeReader *)reader range:(NSRange)range;
+- (SKTGraphic *)readGraphic;
+@end
+
+@implementation SKTNativeDecoder
+
+- (instancetype)initWithReader:(SKTNativeReader *)reader range:(NSRange)range {
+  self = [super init];
+  if (self) {
+    _reader = reader;
+    _cursor = (const uint8_t *)[reader->_data bytes] + range.location;
+    _end = _cursor + range.length;
+  }
+  return self;
+}
+
+- (NSUInteger)remainingLength {
+  return (NSUInteger)(_end - _cursor);
+}
+
+- (void)markDamaged {
+  _damaged = YES;
+}
+
+// Returns where the next length bytes are and moves past them, or returns NULL and marks the record damaged.
+- (const uint8_t *)take:(NSUInteger)length {
+  if ([self remainingLength] < length) {
+    _damaged = YES;
+    _cursor = _end;
+    return NULL;
+  }
+  const uint8_t *p = _cursor;
+  _cursor += length;
+  return p;
+}
+
+- (BOOL)readBytes:(void *)bytes length:(NSUInteger)length {
+  const uint8_t *p = [self take:length];
+  if (p) {
+    memcpy(bytes, p, length);
+  }
+  return NULL != p;
+}
+
+- (uint8_t)readUInt8 {
+  const uint8_t *p = [self take:1];
+  return p ? *p : 0;
+}
+
+- (uint32_t)readUInt32 {
+  const uint8_t *p = [self take:4];
+  return p ? GetLittleEndian32(p) : 0;
+}
+
+- (double)readDouble {
+  const uint8_t *p = [self take:8];
+  return p ? GetLittleEndianDouble(p) : 0;
+}
+
+- (BOOL)readDoubles:(CGFloat *)values count:(NSUInteger)count {
+  if (count > [self remainingLength] / sizeof(double)) {
+    _damaged = YES;
+    _cursor = _end;
+    return NO;
+  }
+  const uint8_t *p = [self take:count * sizeof(double)];
+#if __LITTLE_ENDIAN__ && CGFLOAT_IS_DOUBLE
+  memcpy(values, p, count * sizeof(double));
+#else
+  for (NSUInteger i = 0; i < count; ++i) {
+    values[i] = GetLittleEndianDouble(p + i * sizeof(double));
+  }
+#endif
+  return YES;
+}
+
+- (NSPoint)readPoint {
+  CGFloat v[2] = {0, 0};
+  [self readDoubles:v count:2];
+  return NSMakePoint(v[0], v[1]);
+}
+
+- (NSRect)readRect {
+  CGFloat v[4] = {0, 0, 0, 0};
+  [self readDoubles:v count:4];
+  return NSMakeRect(v[0], v[1], v[2], v[3]);
+}
+
+- (NSColor *)readColor {
+  uint32_t index = [self readUInt32];
+  NSArray *colors = _reader->_colors;
+  if ([colors count] <= index) {
+    _damaged = YES;
+    return nil;
+  }
+  NSColor *color = colors[index];
+  return [color isKindOfClass:[NSColor class]] ? color : nil;
+}
+
+// Without copying, and keeping the file's bytes alive for as long as the result lives.
+- (NSData *)subdataWithBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+  NSData *fileData = _reader->_data;
+  return [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:length deallocator:^(void *b, NSUInteger l) {
+    (void)fileData;
+  }];
+}
+
+- (NSData *)readData {
+  uint32_t length = [self readUInt32];
+  const uint8_t *p = [self take:length];
+  return p ? [self subdataWithBytes:p length:length] : nil;
+}
+
+- (NSData *)readImageData {
+  uint32_t index = [self readUInt32];
+  if (_reader->_imageCount <= index) {
+    _damaged = YES;
+    return nil;
+  }
+  NSRange range = _reader->_imageRanges[index];
+  return [self subdataWithBytes:(const uint8_t *)[_reader->_data bytes] + range.location length:range.length];
+}
+
+// Always moves past the record, so a damaged or unknown graphic costs only itself.
+- (SKTGraphic *)readGraphic {
+  uint32_t classIndex = [self readUInt32];
+  uint32_t length = [self readUInt32];
+  if (_damaged || [self remainingLength] < length) {
+    _damaged = YES;
+    return nil;
+  }
+  const uint8_t *outerEnd = _end;
+  _end = _cursor + length;
+  SKTGraphic *graphic = nil;
+  id class = classIndex < [_reader->_classes count] ? _reader->_classes[classIndex] : nil;
+  if (class && class != [NSNull null]) {
+    graphic = [[(Class)class alloc] initWithNativeDecoder:self];
+  }
+  if (_damaged) {
+    graphic = nil;
+  }
+  _damaged = NO;
+  _cursor = _end;
+  _end = outerEnd;
+  return graphic;
+}
+
+- (NSArray *)readGraphics {
+  uint32_t count = [self readUInt32];
+  // Each record is at least a header long.
+  if (count > [self remainingLength] / kRecordHeaderSize) {
+    _damaged = YES;
+    return @[];
+  }
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:count];
+  for (uint32_t i = 0; i < count && ! _damaged; ++i) {
+    SKTGraphic *graphic = [self readGraphic];
+    if (graphic) {
+      [graphics addObject:graphic];
+    }
+  }
+  return graphics;
+}
+
+@end
+
+@implementation SKTNativeReader
+
++ (BOOL)isNativeData:(NSData *)data {
+  return kHeaderSize <= [data length] && 0 == memcmp([data bytes], kMagic, sizeof kMagic);
+}
+
+- (void)dealloc {
+  free(_imageRanges);
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)outError {
+  self = [super init];
+  if (self) {
+    _data = data;
+    NSInteger errorCode = [self readDirectory];
+    if (errorCode) {
+      if (outError) {
+        *outError = SKTErrorWithCode(errorCode);
+      }
+      return nil;
+    }
+  }
+  return self;
+}
+
+// Returns 0, or the SKTError code of what's wrong.
+- (NSInteger)readDirectory {
+  if ( ! [[self class] isNativeData:_data]) {
+    return SKTUnknownFileReadError;
+  }
+  const uint8_t *bytes = [_data bytes];
+  NSUInteger length = [_data length];
+  if (kVersion < GetLittleEndian32(bytes + 8)) {
+    return SKTNewerFileVersionError;
+  }
+  NSUInteger chunkCount = GetLittleEndian32(bytes + 12);
+  if ((length - kHeaderSize) / kDirectoryEntrySize < chunkCount) {
+    return SKTUnknownFileReadError;
+  }
+  NSRange propertiesRange = {0, 0};
+  NSRange classesRange = {0, 0};
+  NSRange colorsRange = {0, 0};
+  _imageRanges = calloc(MAX(chunkCount, 1), sizeof(NSRange));
+  if (NULL == _imageRanges) {
+    return SKTUnknownFileReadError;
+  }
+  for (NSUInteger i = 0; i < chunkCount; ++i) {
+    const uint8_t *entry = bytes + kHeaderSize + i * kDirectoryEntrySize;
+    uint64_t offset = GetLittleEndian64(entry + 8);
+    uint64_t chunkLength = GetLittleEndian64(entry + 16);
+    if (length < offset || length - offset < chunkLength) {
+      return SKTUnknownFileReadError;
+    }
+    NSRange range = NSMakeRange((NSUInteger)offset, (NSUInteger)chunkLength);
+    switch (GetLittleEndian32(entry)) {
+      case kChunkDocumentProperties: propertiesRange = range; break;
+      case kChunkClasses: classesRange = range; break;
+      case kChunkColors: colorsRange = range; break;
+      case kChunkGraphicIndex: _graphicIndexRange = range; break;
+      case kChunkGraphics: _graphicsRange = range; break;
+      case kChunkImage: _imageRanges[_imageCount++] = range; break;
+      default: break;
+    }
+  }
+
+  NSDictionary *properties = [NSPropertyListSerialization propertyListWithData:[_data subdataWithRange:propertiesRange] options:NSPropertyListImmutable format:NULL error:NULL];
+  if ( ! [properties isKindOfClass:[NSDictionary class]]) {
+    return SKTUnknownFileReadError;
+  }
+  _properties = properties;
+  _graphicCount = _graphicIndexRange.length / sizeof(uint64_t);
+  if ( ! [self readClassesInRange:classesRange] || ! [self readColorsInRange:colorsRange]) {
+    return SKTUnknownFileReadError;
+  }
+  return 0;
+}
+
+- (BOOL)readClassesInRange:(NSRange)range {
+  SKTNativeDecoder *decoder = [[SKTNativeDecoder alloc] initWithReader:self range:range];
+  uint32_t count = [decoder readUInt32];
+  if (count > [decoder remainingLength] / sizeof(uint32_t)) {
+    return NO;
+  }
+  NSMutableArray *classes = [NSMutableArray arrayWithCapacity:count];
+  for (uint32_t i = 0; i < count; ++i) {
+    NSData *nameData = [decoder readData];
+    NSString *className = nameData ? [[NSString alloc] initWithData:nameData encoding:NSUTF8StringEncoding] : nil;
+    // Don't trust the file to name a class that's safe to instantiate.
+    Class class = className ? NSClassFromString(className) : Nil;
+    [classes addObject:(class && [class isSubclassOfClass:[SKTGraphic class]]) ? class : [NSNull null]];
+  }
+  _classes = classes;
+  return ! [decoder isDamaged];
+}
+
+- (BOOL)readColorsInRange:(NSRange)range {
+  SKTNativeDecoder *decoder = [[SKTNativeDecoder alloc] initWithReader:self range:range];
+  uint32_t count = [decoder readUInt32];
+  if (count > [decoder remainingLength]) {
+    return NO;
+  }
+  NSMutableArray *colors = [NSMutableArray arrayWithCapacity:count + 1];
+  [colors addObject:[NSNull null]];
+  for (uint32_t i = 0; i < count && ! [decoder isDamaged]; ++i) {
+    NSColor *color = nil;
+    CGFloat c[4] = {0, 0, 0, 0};
+    switch ((SKTNativeColorKind)[decoder readUInt8]) {
+      case SKTNativeColorCalibratedRGB:
+        [decoder readDoubles:c count:4];
+        color = [NSColor colorWithCalibratedRed:c[0] green:c[1] blue:c[2] alpha:c[3]];
+        break;
+      case SKTNativeColorDeviceRGB:
+        [decoder readDoubles:c count:4];
+        color = [NSColor colorWithDeviceRed:c[0] green:c[1] blue:c[2] alpha:c[3]];
+        break;
+      case SKTNativeColorCalibratedWhite:
+        [decoder readDoubles:c count:2];
+        color = [NSColor colorWithCalibratedWhite:c[0] alpha:c[1]];
+        break;
+      case SKTNativeColorDeviceWhite:
+        [decoder readDoubles:c count:2];
+        color = [NSColor colorWithDeviceWhite:c[0] alpha:c[1]];
+        break;
+      case SKTNativeColorArchived:
+        color = [NSColor colorWithArchiveData:[decoder readData]];
+        break;
+      default:
+        [decoder markDamaged];
+        break;
+    }
+    // Shared with every other graphic of that color, in this file or any other.
+    color = [[SKTColorTable sharedColorTable] internedColor:color];
+    [colors addObject:color ?: [NSNull null]];
+  }
+  _colors = colors;
+  return ! [decoder isDamaged];
+}
+
+- (SKTGraphic *)graphicAtIndex:(NSUInteger)index {
+  if (_graphicCount <= index) {
+    [NSException raise:NSRangeException format:@"Index %lu beyond %lu graphics.", (unsigned long)index, (unsigned long)_graphicCount];
+  }
+  uint64_t offset = GetLittleEndian64((const uint8_t *)[_data bytes] + _graphicIndexRange.location + index * sizeof(uint64_t));
+  if (_graphicsRange.length <= offset) {
+    return nil;
+  }
+  NSRange range = NSMakeRange(_graphicsRange.location + (NSUInteger)offset, _graphicsRange.length - (NSUInteger)offset);
+  return [[[SKTNativeDecoder alloc] initWithReader:self range:range] readGraphic];
+}
+
+- (NSArray *)graphics {
+  NSUInteger count = _graphicCount;
+  NSUInteger batchCount = (count + kDecodeBatchSize - 1) / kDecodeBatchSize;
+  NSMutableArray *batches = [NSMutableArray arrayWithCapacity:batchCount];
+  for (NSUInteger i = 0; i < batchCount; ++i) {
+    [batches addObject:[NSNull null]];
+  }
+  // The records are independent of each other, and the reader's tables are only read from here on.
+  dispatch_apply(batchCount, DISPATCH_APPLY_AUTO, ^(size_t batch) {
+    @autoreleasepool {
+      NSUInteger end = MIN((batch + 1) * kDecodeBatchSize, count);
+      NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:kDecodeBatchSize];
+      for (NSUInteger i = batch * kDecodeBatchSize; i < end; ++i) {
+        SKTGraphic *graphic = [self graphicAtIndex:i];
+        if (graphic) {
+          [graphics addObject:graphic];
+        }
+      }
+      @synchronized(batches) {
+        batches[batch] = graphics;
+      }
+    }
+  });
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:count];
+  for (NSArray *batch in batches) {
+    [graphics addObjectsFromArray:batch];
+  }
+  return graphics;
+}
+
+@end
@@ -0,0 +1,49 @@
+/*  SKTPathTokenizer.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The whole of an SVG path d attribute, tokenized in one pass.
+
+ verbs holds one explicit command letter per path command. Implicit commands (bare numbers following a command)
+ are stored as the verb they stand for, with M and m becoming L and l, so a consumer never needs to track them.
+ args holds the arguments of every command back to back: walk them with SKTPathTokenArgCount().
+ */
+typedef struct SKTPathTokens {
+  char *verbs;
+  CGFloat *args;
+  NSUInteger verbCount;
+  NSUInteger argCount;
+  NSUInteger verbCapacity;
+  NSUInteger argCapacity;
+} SKTPathTokens;
+
+/// The number of arguments consumed by the verb, 0 for Z or an unknown verb.
+NSUInteger SKTPathTokenArgCount(char verb);
+
+/// Tokenize length bytes of UTF-8 path data. Reads the bytes in place: nothing is copied and nothing is allocated
+/// other than growth of the two token buffers. Appends to tokens, so a zero-filled SKTPathTokens may be reused
+/// after SKTPathTokensReset(). Returns NO if it stopped early at malformed data; the tokens read up to that point
+/// are kept, as the old per-atom scanner did.
+BOOL SKTPathTokenize(const char *bytes, NSUInteger length, SKTPathTokens *tokens);
+
+/// Parse one number starting at *pp, the way SVG writes them: optional sign, digits with at most one period, optional
+/// exponent. "1.5.5" is two numbers, "1-2" is two numbers. Advances *pp past it. Returns NO if there is no number at *pp.
+BOOL SKTPathParseNumber(const char *_Nonnull *_Nonnull pp, const char *end, CGFloat *valp);
+
+/// Empty the buffers, keeping their storage for reuse.
+void SKTPathTokensReset(SKTPathTokens *tokens);
+
+/// Release the buffers.
+void SKTPathTokensFree(SKTPathTokens *tokens);
+
+#if DEBUG
+/// Time SKTPathTokenize against SKTPathScanner on a synthetic path of coordinateCount coordinates. Logs the result.
+void SKTPathTokenizerBenchmark(NSUInteger coordinateCount);
+#endif
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,297 @@
+/*  SKTPathTokenizer.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTPathTokenizer.h"
+
+#include <stdlib.h>
+
+#if DEBUG
+#import "SKTPathScanner.h"
+#endif
+
+// Exactly representable powers of ten. A decimal with at most 15 significant digits and a
+// decimal exponent within this table converts with a single correctly rounded multiply or divide.
+static const double kPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+enum {
+  kMaxFastDigits = 15,
+  kMaxFastExponent = 22,
+  kMaxNumberLength = 63
+};
+
+NSUInteger SKTPathTokenArgCount(char verb) {
+  switch (verb) {
+    case 'H':
+    case 'h':
+    case 'V':
+    case 'v':
+      return 1;
+    case 'L':
+    case 'l':
+    case 'M':
+    case 'm':
+    case 'T':
+    case 't':
+      return 2;
+    case 'Q':
+    case 'q':
+    case 'S':
+    case 's':
+      return 4;
+    case 'C':
+    case 'c':
+      return 6;
+    case 'A':
+    case 'a':
+      return 7;
+    default:
+      return 0;
+  }
+}
+
+static BOOL IsVerb(char c) {
+  switch (c) {
+    case 'Z':
+    case 'z':
+      return YES;
+    default:
+      return 0 != SKTPathTokenArgCount(c);
+  }
+}
+
+// whitespace and commas separate tokens.
+static BOOL IsSeparator(char c) {
+  return ' ' == c || ',' == c || '\n' == c || '\r' == c || '\t' == c || '\f' == c || '\v' == c;
+}
+
+static BOOL IsDigit(char c) {
+  return '0' <= c && c <= '9';
+}
+
+static const char *SkipSeparators(const char *p, const char *end) {
+  while (p < end && IsSeparator(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// Slow path for numbers the fast path can't convert exactly. Copies into a stack buffer, since
+// the bytes of the path aren't nul terminated, or onto the heap for a literal too long for it:
+// cutting one short would drop digits before its exponent, not round it.
+static double ParseSlow(const char *start, const char *end) {
+  char stackBuffer[kMaxNumberLength + 1];
+  NSUInteger length = (NSUInteger)(end - start);
+  char *buffer = (length <= kMaxNumberLength) ? stackBuffer : malloc(length + 1);
+  if (NULL == buffer) {
+    [NSException raise:NSMallocException format:@"Could not parse a number %lu bytes long.", (unsigned long)length];
+  }
+  memcpy(buffer, start, length);
+  buffer[length] = '\0';
+  double value = strtod(buffer, NULL);
+  if (buffer != stackBuffer) {
+    free(buffer);
+  }
+  return value;
+}
+
+BOOL SKTPathParseNumber(const char **pp, const char *end, CGFloat *valp) {
+  const char *p = *pp;
+  const char *start = p;
+  BOOL isNegative = NO;
+  if (p < end && ('-' == *p || '+' == *p)) {
+    isNegative = ('-' == *p);
+    ++p;
+  }
+  uint64_t mantissa = 0;
+  int digitCount = 0;
+  int exponent = 0;
+  BOOL sawDigit = NO;
+  for (; p < end && IsDigit(*p); ++p) {
+    sawDigit = YES;
+    if (0 == mantissa && '0' == *p) {
+      continue; // leading zeros are not significant.
+    }
+    if (digitCount < 19) {
+      mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+    } else {
+      exponent += 1;
+    }
+    digitCount += 1;
+  }
+  if (p < end && '.' == *p) {
+    ++p;
+    for (; p < end && IsDigit(*p); ++p) {
+      sawDigit = YES;
+      if (0 == mantissa && '0' == *p) {
+        exponent -= 1;
+        continue;
+      }
+      if (digitCount < 19) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        exponent -= 1;
+      }
+      digitCount += 1;
+    }
+  }
+  if ( ! sawDigit) {
+    return NO;
+  }
+  if (p < end && ('e' == *p || 'E' == *p)) {
+    const char *q = p + 1;
+    BOOL isExponentNegative = NO;
+    if (q < end && ('-' == *q || '+' == *q)) {
+      isExponentNegative = ('-' == *q);
+      ++q;
+    }
+    if (q < end && IsDigit(*q)) {
+      int explicitExponent = 0;
+      for (; q < end && IsDigit(*q); ++q) {
+        if (explicitExponent < 10000) {
+          explicitExponent = explicitExponent * 10 + (*q - '0');
+        }
+      }
+      exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+      p = q;
+    }
+    // else the 'e' is not part of this number.
+  }
+  double value;
+  if (digitCount <= kMaxFastDigits && -kMaxFastExponent <= exponent && exponent <= kMaxFastExponent) {
+    value = (double)mantissa;
+    if (exponent < 0) {
+      value /= kPowersOfTen[-exponent];
+    } else {
+      value *= kPowersOfTen[exponent];
+    }
+    if (isNegative) {
+      value = -value;
+    }
+  } else {
+    value = ParseSlow(start, p);
+  }
+  *valp = value;
+  *pp = p;
+  return YES;
+}
+
+static BOOL Reserve(SKTPathTokens *tokens, NSUInteger verbs, NSUInteger args) {
+  if (tokens->verbCapacity < tokens->verbCount + verbs) {
+    NSUInteger capacity = tokens->verbCapacity ? tokens->verbCapacity * 2 : 64;
+    while (capacity < tokens->verbCount + verbs) {
+      capacity *= 2;
+    }
+    char *verbBuffer = realloc(tokens->verbs, capacity);
+    if (NULL == verbBuffer) {
+      return NO;
+    }
+    tokens->verbs = verbBuffer;
+    tokens->verbCapacity = capacity;
+  }
+  if (tokens->argCapacity < tokens->argCount + args) {
+    NSUInteger capacity = tokens->argCapacity ? tokens->argCapacity * 2 : 256;
+    while (capacity < tokens->argCount + args) {
+      capacity *= 2;
+    }
+    CGFloat *argBuffer = realloc(tokens->args, capacity * sizeof(CGFloat));
+    if (NULL == argBuffer) {
+      return NO;
+    }
+    tokens->args = argBuffer;
+    tokens->argCapacity = capacity;
+  }
+  return YES;
+}
+
+BOOL SKTPathTokenize(const char *bytes, NSUInteger length, SKTPathTokens *tokens) {
+  const char *p = bytes;
+  const char *end = bytes + length;
+  char previousVerb = '\0';
+  for (;;) {
+    p = SkipSeparators(p, end);
+    if (end <= p) {
+      return YES;
+    }
+    char verb = *p;
+    if (IsVerb(verb)) {
+      ++p;
+    } else if (IsDigit(verb) || '-' == verb || '+' == verb || '.' == verb) {
+      // A bare number repeats the previous explicit verb. But if previous is a move, then implicit is a line.
+      verb = previousVerb;
+      if ('m' == verb) {
+        verb = 'l';
+      } else if ('M' == verb) {
+        verb = 'L';
+      }
+      if (0 == SKTPathTokenArgCount(verb)) {
+        return NO;  // numbers with no verb, or after Z.
+      }
+    } else {
+      return NO;
+    }
+    NSUInteger argCount = SKTPathTokenArgCount(verb);
+    if ( ! Reserve(tokens, 1, argCount)) {
+      return NO;
+    }
+    CGFloat *args = tokens->args + tokens->argCount;
+    for (NSUInteger i = 0; i < argCount; ++i) {
+      p = SkipSeparators(p, end);
+      if ( ! SKTPathParseNumber(&p, end, &args[i])) {
+        return NO;
+      }
+    }
+    tokens->verbs[tokens->verbCount++] = verb;
+    tokens->argCount += argCount;
+    previousVerb = verb;
+  }
+}
+
+void SKTPathTokensReset(SKTPathTokens *tokens) {
+  tokens->verbCount = 0;
+  tokens->argCount = 0;
+}
+
+void SKTPathTokensFree(SKTPathTokens *tokens) {
+  free(tokens->verbs);
+  free(tokens->args);
+  memset(tokens, 0, sizeof *tokens);
+}
+
+#pragma mark - Benchmark
+
+#if DEBUG
+void SKTPathTokenizerBenchmark(NSUInteger coordinateCount) {
+  NSMutableString *s = [NSMutableString stringWithString:@"M0,0"];
+  for (NSUInteger i = 2; i < coordinateCount; i += 2) {
+    [s appendFormat:@" L%.5g,%.5g", i * 0.37, i * -1.25e-3];
+  }
+  NSString *path = [s copy];
+
+  NSDate *start = [NSDate date];
+  SKTPathScanner *scanner = [SKTPathScanner scannerWithString:path];
+  unichar verb;
+  NSUInteger argCount;
+  CGFloat args[SKTScannerMaxArgCount];
+  NSUInteger scannerVerbs = 0;
+  while ([scanner getVerb:&verb argCount:&argCount args:args]) {
+    scannerVerbs += 1;
+  }
+  NSTimeInterval scannerTime = -[start timeIntervalSinceNow];
+
+  start = [NSDate date];
+  SKTPathTokens tokens = {0};
+  const char *bytes = [path UTF8String];
+  SKTPathTokenize(bytes, strlen(bytes), &tokens);
+  NSTimeInterval tokenizerTime = -[start timeIntervalSinceNow];
+
+  NSLog(@"%lu coordinates: SKTPathScanner %lu verbs %.3fs, SKTPathTokenize %lu verbs %.3fs (%.1fx)",
+    (unsigned long)coordinateCount,
+    (unsigned long)scannerVerbs, scannerTime,
+    (unsigned long)tokens.verbCount, tokenizerTime,
+    tokenizerTime ? scannerTime / tokenizerTime : 0);
+  SKTPathTokensFree(&tokens);
+}
+#endif
@@ -0,0 +1,39 @@
+/*  SKTRasterEncoder.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+@class SKTSVGWriter;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, SKTRasterType) {
+  SKTRasterTypePNG,
+  SKTRasterTypeTIFF
+};
+
+/**
+ Encodes an image as PNG or TIFF a band of rows at a time, top to bottom, through an SKTSVGWriter (which is a plain
+ buffered byte writer underneath), so the whole bitmap never has to be in memory at once. Pixels come in as 8 bit
+ RGBA with premultiplied alpha, as a CGBitmapContext draws them.
+ */
+@interface SKTRasterEncoder : NSObject
+
+/// bandHeight is the number of rows in every call to -writeRows:count:bytesPerRow: but the last. The TIFF encoder
+/// makes one strip of each band, so must know it up front. Writes the file header.
+- (instancetype)initWithType:(SKTRasterType)type width:(size_t)width height:(size_t)height bandHeight:(size_t)bandHeight writer:(SKTSVGWriter *)writer NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Set for an image too big for the format, or if the compressor fails. Once set, further writes are ignored.
+@property(nonatomic, readonly, nullable) NSError *encodingError;
+
+- (void)writeRows:(const uint8_t *)rows count:(size_t)rowCount bytesPerRow:(size_t)bytesPerRow;
+
+/// Write the end of the file and finish the writer. Returns NO if encoding or the writer's stream failed.
+- (BOOL)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
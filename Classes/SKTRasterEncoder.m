@@ -0,0 +1,331 @@
+/*  SKTRasterEncoder.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTRasterEncoder.h"
+
+#import "SKTError.h"
+#import "SKTSVGWriter.h"
+
+#include <zlib.h>
+
+enum {
+  // Compressed PNG data goes out as an IDAT chunk whenever this much of it has built up.
+  kIDATSize = 64 * 1024,
+
+  // Each PNG row is stored as its difference from the row above: a floor plan is mostly rows like the one above it,
+  // and rows of a poster-size image are far wider than deflate's 32K window, so it would not find them otherwise.
+  kPNGFilterUp = 2,
+
+  // The TIFF directory entries, in the ascending tag order TIFF requires.
+  kTIFFTagImageWidth = 256,
+  kTIFFTagImageLength = 257,
+  kTIFFTagBitsPerSample = 258,
+  kTIFFTagCompression = 259,
+  kTIFFTagPhotometric = 262,
+  kTIFFTagStripOffsets = 273,
+  kTIFFTagSamplesPerPixel = 277,
+  kTIFFTagRowsPerStrip = 278,
+  kTIFFTagStripByteCounts = 279,
+  kTIFFTagPlanarConfiguration = 284,
+  kTIFFTagExtraSamples = 338,
+  kTIFFEntryCount = 11,
+
+  kTIFFTypeShort = 3,
+  kTIFFTypeLong = 4,
+
+  kTIFFHeaderSize = 8,
+  kTIFFDirectorySize = 2 + kTIFFEntryCount * 12 + 4,
+};
+
+static void PutBigEndian32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static void PutLittleEndian16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void PutLittleEndian32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+// A value of count 1 that fits is stored in the entry itself, left justified. Otherwise the entry holds its offset.
+static uint8_t *PutTIFFEntry(uint8_t *p, uint16_t tag, uint16_t type, uint32_t count, uint32_t valueOrOffset) {
+  PutLittleEndian16(p, tag);
+  PutLittleEndian16(p + 2, type);
+  PutLittleEndian32(p + 4, count);
+  if (kTIFFTypeShort == type && 1 == count) {
+    PutLittleEndian32(p + 8, 0);
+    PutLittleEndian16(p + 8, (uint16_t)valueOrOffset);
+  } else {
+    PutLittleEndian32(p + 8, valueOrOffset);
+  }
+  return p + 12;
+}
+
+@interface SKTRasterEncoder () {
+  SKTRasterType _type;
+  size_t _width;
+  size_t _height;
+  size_t _bandHeight;
+  size_t _rowsWritten;
+  SKTSVGWriter *_writer;
+  NSError *_encodingError;
+
+  // PNG only.
+  z_stream _zStream;
+  BOOL _isZStreamOpen;
+  uint8_t *_previousRow;  // Unpremultiplied, for the Up filter of the next row.
+  uint8_t *_row;          // Unpremultiplied.
+  uint8_t *_filteredRow;  // The filter type byte, then the filtered row.
+  uint8_t *_idat;
+}
+
+@end
+
+@implementation SKTRasterEncoder
+
+- (instancetype)initWithType:(SKTRasterType)type width:(size_t)width height:(size_t)height bandHeight:(size_t)bandHeight writer:(SKTSVGWriter *)writer {
+  self = [super init];
+  if (self) {
+    _type = type;
+    _width = width;
+    _height = height;
+    _bandHeight = MAX(bandHeight, 1);
+    _writer = writer;
+    if (SKTRasterTypePNG == type) {
+      [self writePNGHeader];
+    } else {
+      [self writeTIFFHeader];
+    }
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (_isZStreamOpen) {
+    deflateEnd(&_zStream);
+  }
+  free(_previousRow);
+  free(_row);
+  free(_filteredRow);
+  free(_idat);
+}
+
+- (NSError *)encodingError {
+  return _encodingError;
+}
+
+- (void)failEncoding {
+  if (nil == _encodingError) {
+    _encodingError = SKTErrorWithCode(SKTWriteCouldntEncodeImageError);
+  }
+}
+
+- (void)writeRows:(const uint8_t *)rows count:(size_t)rowCount bytesPerRow:(size_t)bytesPerRow {
+  if (_encodingError) {
+    return;
+  }
+  rowCount = MIN(rowCount, _height - _rowsWritten);
+  if (SKTRasterTypePNG == _type) {
+    for (size_t i = 0; i < rowCount; ++i) {
+      [self writePNGRow:rows + i * bytesPerRow];
+    }
+  } else if (bytesPerRow == _width * 4) {
+    [_writer writeBytes:rows length:rowCount * bytesPerRow];
+  } else {
+    for (size_t i = 0; i < rowCount; ++i) {
+      [_writer writeBytes:rows + i * bytesPerRow length:_width * 4];
+    }
+  }
+  _rowsWritten += rowCount;
+}
+
+- (BOOL)finish {
+  if (nil == _encodingError && _rowsWritten != _height) {
+    [self failEncoding];
+  }
+  if (SKTRasterTypePNG == _type && nil == _encodingError) {
+    [self finishPNG];
+  }
+  BOOL didWrite = [_writer finish];
+  return didWrite && nil == _encodingError;
+}
+
+#pragma mark - PNG
+
+- (void)writePNGChunk:(const char *)chunkType data:(const uint8_t *)data length:(uint32_t)length {
+  uint8_t header[8];
+  PutBigEndian32(header, length);
+  memcpy(header + 4, chunkType, 4);
+  uLong crc = crc32(0, header + 4, 4);
+  if (0 < length) {
+    crc = crc32(crc, data, length);  // Not for IEND: given NULL, crc32() starts over.
+  }
+  uint8_t trailer[4];
+  PutBigEndian32(trailer, (uint32_t)crc);
+  [_writer writeBytes:header length:sizeof header];
+  [_writer writeBytes:data length:length];
+  [_writer writeBytes:trailer length:sizeof trailer];
+}
+
+- (void)writePNGHeader {
+  // PNG allows up to 2^31 - 1 pixels on a side, and each filtered row must fit in one zlib input buffer.
+  if (0 == _width || 0 == _height || 0x7FFFFFFF < _height || 0x7FFFFFFF / 4 < _width) {
+    [self failEncoding];
+    return;
+  }
+  size_t rowSize = _width * 4;
+  _previousRow = calloc(rowSize, 1);
+  _row = malloc(rowSize);
+  _filteredRow = malloc(1 + rowSize);
+  _idat = malloc(kIDATSize);
+  if (NULL == _previousRow || NULL == _row || NULL == _filteredRow || NULL == _idat) {
+    [NSException raise:NSMallocException format:@"%@ couldn't allocate PNG rows of %lu pixels", [self class], (unsigned long)_width];
+  }
+  if (Z_OK != deflateInit(&_zStream, Z_DEFAULT_COMPRESSION)) {
+    [self failEncoding];
+    return;
+  }
+  _isZStreamOpen = YES;
+  _zStream.next_out = _idat;
+  _zStream.avail_out = kIDATSize;
+
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  [_writer writeBytes:kSignature length:sizeof kSignature];
+  uint8_t ihdr[13];
+  PutBigEndian32(ihdr, (uint32_t)_width);
+  PutBigEndian32(ihdr + 4, (uint32_t)_height);
+  ihdr[8] = 8;   // bits per sample
+  ihdr[9] = 6;   // RGBA
+  ihdr[10] = 0;  // deflate
+  ihdr[11] = 0;  // adaptive filtering, one filter type byte per row
+  ihdr[12] = 0;  // not interlaced
+  [self writePNGChunk:"IHDR" data:ihdr length:sizeof ihdr];
+}
+
+// Feed the compressor, writing an IDAT chunk each time its output fills.
+- (void)deflateBytes:(const uint8_t *)bytes length:(size_t)length flush:(int)flush {
+  _zStream.next_in = (Bytef *)bytes;
+  _zStream.avail_in = (uInt)length;
+  for (;;) {
+    int status = deflate(&_zStream, flush);
+    if (Z_STREAM_ERROR == status) {
+      [self failEncoding];
+      return;
+    }
+    if (0 == _zStream.avail_out) {
+      [self writePNGChunk:"IDAT" data:_idat length:kIDATSize];
+      _zStream.next_out = _idat;
+      _zStream.avail_out = kIDATSize;
+    } else if (Z_FINISH == flush ? Z_STREAM_END == status : 0 == _zStream.avail_in) {
+      return;
+    }
+  }
+}
+
+- (void)writePNGRow:(const uint8_t *)pixels {
+  if (_encodingError) {
+    return;
+  }
+  // PNG alpha is not premultiplied.
+  size_t rowSize = _width * 4;
+  for (size_t i = 0; i < rowSize; i += 4) {
+    unsigned alpha = pixels[i + 3];
+    if (255 == alpha) {
+      memcpy(_row + i, pixels + i, 4);
+    } else if (0 == alpha) {
+      memset(_row + i, 0, 4);
+    } else {
+      for (size_t c = 0; c < 3; ++c) {
+        _row[i + c] = (uint8_t)MIN(255u, (pixels[i + c] * 255u + alpha / 2) / alpha);
+      }
+      _row[i + 3] = (uint8_t)alpha;
+    }
+  }
+  _filteredRow[0] = kPNGFilterUp;
+  for (size_t i = 0; i < rowSize; ++i) {
+    _filteredRow[1 + i] = (uint8_t)(_row[i] - _previousRow[i]);
+  }
+  uint8_t *swap = _previousRow;
+  _previousRow = _row;
+  _row = swap;
+  [self deflateBytes:_filteredRow length:1 + rowSize flush:Z_NO_FLUSH];
+}
+
+- (void)finishPNG {
+  [self deflateBytes:NULL length:0 flush:Z_FINISH];
+  if (nil == _encodingError) {
+    [self writePNGChunk:"IDAT" data:_idat length:(uint32_t)(kIDATSize - _zStream.avail_out)];
+    [self writePNGChunk:"IEND" data:NULL length:0];
+  }
+  deflateEnd(&_zStream);
+  _isZStreamOpen = NO;
+}
+
+#pragma mark - TIFF
+
+// Uncompressed, so the size of every strip is known before any pixels are, and the whole directory can go first:
+// the pixels then stream straight through behind it. The alpha is premultiplied, which TIFF calls associated alpha.
+- (void)writeTIFFHeader {
+  if (0 == _width || 0 == _height) {
+    [self failEncoding];
+    return;
+  }
+  size_t stripCount = (_height + _bandHeight - 1) / _bandHeight;
+  size_t stripSize = _width * 4 * _bandHeight;
+  size_t lastStripSize = _width * 4 * (_height - (stripCount - 1) * _bandHeight);
+  size_t arraysOffset = kTIFFHeaderSize + kTIFFDirectorySize + 4 * sizeof(uint16_t);
+  size_t pixelsOffset = arraysOffset + ((1 < stripCount) ? 2 * 4 * stripCount : 0);
+  // Classic TIFF addresses the file with 32 bit offsets.
+  if (_width > UINT32_MAX / 4 || _height > UINT32_MAX || (UINT32_MAX - pixelsOffset) / (_width * 4) < _height) {
+    [self failEncoding];
+    return;
+  }
+  NSMutableData *header = [NSMutableData dataWithLength:pixelsOffset];
+  uint8_t *bytes = [header mutableBytes];
+  memcpy(bytes, "II", 2);
+  PutLittleEndian16(bytes + 2, 42);
+  PutLittleEndian32(bytes + 4, kTIFFHeaderSize);
+
+  uint32_t bitsPerSampleOffset = kTIFFHeaderSize + kTIFFDirectorySize;
+  uint32_t stripOffsets = (uint32_t)pixelsOffset;
+  uint32_t stripByteCounts = (uint32_t)lastStripSize;
+  if (1 < stripCount) {
+    stripOffsets = (uint32_t)arraysOffset;
+    stripByteCounts = (uint32_t)(arraysOffset + 4 * stripCount);
+    for (size_t i = 0; i < stripCount; ++i) {
+      PutLittleEndian32(bytes + arraysOffset + 4 * i, (uint32_t)(pixelsOffset + i * stripSize));
+      PutLittleEndian32(bytes + arraysOffset + 4 * (stripCount + i), (uint32_t)((i + 1 < stripCount) ? stripSize : lastStripSize));
+    }
+  }
+  uint8_t *p = bytes + kTIFFHeaderSize;
+  PutLittleEndian16(p, kTIFFEntryCount);
+  p += 2;
+  p = PutTIFFEntry(p, kTIFFTagImageWidth, kTIFFTypeLong, 1, (uint32_t)_width);
+  p = PutTIFFEntry(p, kTIFFTagImageLength, kTIFFTypeLong, 1, (uint32_t)_height);
+  p = PutTIFFEntry(p, kTIFFTagBitsPerSample, kTIFFTypeShort, 4, bitsPerSampleOffset);
+  p = PutTIFFEntry(p, kTIFFTagCompression, kTIFFTypeShort, 1, 1);  // none
+  p = PutTIFFEntry(p, kTIFFTagPhotometric, kTIFFTypeShort, 1, 2);  // RGB
+  p = PutTIFFEntry(p, kTIFFTagStripOffsets, kTIFFTypeLong, (uint32_t)stripCount, stripOffsets);
+  p = PutTIFFEntry(p, kTIFFTagSamplesPerPixel, kTIFFTypeShort, 1, 4);
+  p = PutTIFFEntry(p, kTIFFTagRowsPerStrip, kTIFFTypeLong, 1, (uint32_t)MIN(_bandHeight, _height));
+  p = PutTIFFEntry(p, kTIFFTagStripByteCounts, kTIFFTypeLong, (uint32_t)stripCount, stripByteCounts);
+  p = PutTIFFEntry(p, kTIFFTagPlanarConfiguration, kTIFFTypeShort, 1, 1);  // chunky
+  p = PutTIFFEntry(p, kTIFFTagExtraSamples, kTIFFTypeShort, 1, 1);  // associated alpha
+  PutLittleEndian32(p, 0);  // no next directory
+  for (size_t i = 0; i < 4; ++i) {
+    PutLittleEndian16(bytes + bitsPerSampleOffset + 2 * i, 8);
+  }
+  [_writer writeBytes:bytes length:pixelsOffset];
+}
+
+@end
@@ -11,6 +11,8 @@
 
 #import <Cocoa/Cocoa.h>
 
+#import "SKTRasterEncoder.h"
+
 @interface SKTRenderingView : NSView
 
 // Return the array of graphics as a PDF image.
@@ -22,6 +24,9 @@
 // Return the array of graphics as a PNG image.
 + (NSData *)pngDataWithGraphics:(NSArray *)graphics error:(NSError **)outError;
 
+// Write the array of graphics to stream as a PNG or TIFF image of scale pixels per point. The image is drawn in tiles on several threads and encoded as it's drawn, so it need not fit in memory. Returns NO, and sets *outError, if the image would be empty or too big for the type, or the stream fails.
++ (BOOL)writeGraphics:(NSArray *)graphics type:(SKTRasterType)type scale:(CGFloat)scale toStream:(NSOutputStream *)stream error:(NSError **)outError;
+
 
 // This class' designated initializer. printJobTitle must be non-nil if the view is going to be used as the view of an NSPrintOperation.
 - (instancetype)initWithFrame:(NSRect)frame graphics:(NSArray *)graphics printJobTitle:(NSString *)printJobTitle NS_DESIGNATED_INITIALIZER;
@@ -29,3 +34,8 @@
 - (instancetype)initWithFrame:(NSRect)frame NS_UNAVAILABLE;
 - (instancetype)initWithCoder:(NSCoder *)coder NS_UNAVAILABLE;
 @end
+
+#if DEBUG
+// Export a plan of graphicCount graphics as a 20000 by 20000 pixel PNG and TIFF to temporary files. Logs the time, file size and peak memory of each.
+void SKTRasterExportBenchmark(NSUInteger graphicCount);
+#endif
@@ -12,6 +12,19 @@
 #import "SKTRenderingView.h"
 #import "SKTError.h"
 #import "SKTGraphic.h"
+#import "SKTSVGWriter.h"
+
+#if DEBUG
+#import "SKTEllipse.h"
+#import "SKTRectangle.h"
+
+#include <sys/resource.h>
+#endif
+
+enum {
+  // Raster export draws square tiles this many pixels on a side, a band of them across the image at a time.
+  kRasterTileSize = 512
+};
 
 @interface SKTRenderingView() {
   // The graphics and print job title that were specified at initialization time.
@@ -49,62 +62,128 @@
 }
 
 
-+ (NSImage *)imageWithGraphics:(NSArray *)graphics error:(NSError **)outError {
-  NSImage *image = nil;
+// The image runs from 0,0 to the far corner of the graphics, a band of tiles at a time. Each tile is drawn by its own thread into its own part of the band, drawing only the graphics that reach into it. One band is drawn while the one before it is encoded, so at most two bands are ever in memory: a row of tiles is as little as the encoders can take, since PNG and TIFF both store whole rows.
++ (BOOL)writeGraphics:(NSArray *)graphics type:(SKTRasterType)type scale:(CGFloat)scale toWriter:(SKTSVGWriter *)writer error:(NSError **)outError {
   NSRect bounds = [self drawingBoundsOfGraphics:graphics];
-  bounds.size.width += bounds.origin.x;
-  bounds.size.height += bounds.origin.y;
-  bounds.origin = CGPointZero;
-  if (! NSIsEmptyRect(bounds)) {
-    // Create a new image and prepare to draw in it. Get the graphics context for it after we lock focus, not before.
-    image = [NSImage imageWithSize:bounds.size flipped:YES drawingHandler:^(NSRect dstRect){
-      NSGraphicsContext *currentContext = [NSGraphicsContext currentContext];
-
-      // We're not drawing a page image here, just the rectangle that contains the graphics being drawn, so make sure they get drawn in the right place.
-      NSAffineTransform *transform = [NSAffineTransform transform];
-      [transform translateXBy:(0.0f - dstRect.origin.x) yBy:(0.0f - dstRect.origin.y)];
-      [transform concat];
-
-      // Draw the graphics back to front.
-
-      for (int graphicIndex = ((int)[graphics count]) - 1;0 <= graphicIndex; --graphicIndex) {
-        SKTGraphic *graphic = graphics[graphicIndex];
-        [currentContext saveGraphicsState];
-        [NSBezierPath clipRect:[graphic drawingBounds]];
-        [graphic drawContentsInView:nil rect:bounds isBeingCreateOrEdited:NO];
-        [currentContext restoreGraphicsState];
+  size_t width = (size_t)ceil(MAX(NSMaxX(bounds), 0) * scale);
+  size_t height = (size_t)ceil(MAX(NSMaxY(bounds), 0) * scale);
+  if (NSIsEmptyRect(bounds) || 0 == width || 0 == height) {
+    // In FloorSketch there are lots of places to catch this situation earlier. For example, we could have overridden -writableTypesForSaveOperation: and made it not return NSTIFFPboardType, but then the user would have no idea why TIFF isn't showing up in the save panel's File Format popup. This way we can present a nice descriptive errror message.
+    if (outError) {
+      *outError = SKTErrorWithCode((SKTRasterTypePNG == type) ? SKTWriteCouldntMakePNGError : SKTWriteCouldntMakeTIFFError);
+    }
+    return NO;
+  }
+
+  // Read every graphic's drawing bounds once, here, rather than in every tile.
+  NSUInteger graphicCount = [graphics count];
+  NSRect *drawingBounds = malloc(graphicCount * sizeof(NSRect));
+  size_t bytesPerRow = width * 4;
+  size_t bandHeight = MIN((size_t)kRasterTileSize, height);
+  uint8_t *firstBand = malloc(bytesPerRow * bandHeight);
+  uint8_t *secondBand = malloc(bytesPerRow * bandHeight);
+  if (NULL == drawingBounds || NULL == firstBand || NULL == secondBand) {
+    free(drawingBounds);
+    free(firstBand);
+    free(secondBand);
+    [NSException raise:NSMallocException format:@"%@ couldn't allocate bands of %lu by %lu pixels", self, (unsigned long)width, (unsigned long)bandHeight];
+  }
+  for (NSUInteger index = 0; index < graphicCount; index++) {
+    drawingBounds[index] = [graphics[index] drawingBounds];
+  }
+
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+  dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+  size_t tilesAcross = (width + kRasterTileSize - 1) / kRasterTileSize;
+  void (^renderBand)(size_t, uint8_t *) = ^(size_t band, uint8_t *pixels) {
+    size_t top = band * bandHeight;
+    size_t rows = MIN(bandHeight, height - top);
+    memset(pixels, 0, rows * bytesPerRow);
+
+    // The graphics that reach into this band, back to front. In FloorSketch the frontmost graphics have the lowest indexes.
+    NSRect bandRect = NSMakeRect(0, top / scale, width / scale, rows / scale);
+    NSUInteger *bandIndexes = malloc(MAX(graphicCount, 1) * sizeof(NSUInteger));
+    NSUInteger bandIndexCount = 0;
+    for (NSUInteger index = graphicCount; 0 < index--;) {
+      if (NSIntersectsRect(bandRect, drawingBounds[index])) {
+        bandIndexes[bandIndexCount++] = index;
       }
-      return YES;
-    }];
+    }
+    dispatch_apply(tilesAcross, queue, ^(size_t column) {
+      @autoreleasepool {
+        size_t left = column * kRasterTileSize;
+        size_t columns = MIN((size_t)kRasterTileSize, width - left);
+        CGContextRef context = CGBitmapContextCreate(pixels + left * 4, columns, rows, 8, bytesPerRow, colorSpace, (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+        NSRect tileRect = NSMakeRect(left / scale, top / scale, columns / scale, rows / scale);
+
+        // Put (0, 0) at the top-left of the image, as in a flipped view, in points.
+        CGContextTranslateCTM(context, 0, rows);
+        CGContextScaleCTM(context, scale, -scale);
+        CGContextTranslateCTM(context, -NSMinX(tileRect), -NSMinY(tileRect));
+        NSGraphicsContext *tileContext = [NSGraphicsContext graphicsContextWithCGContext:context flipped:YES];
+        [NSGraphicsContext saveGraphicsState];
+        [NSGraphicsContext setCurrentContext:tileContext];
+        for (NSUInteger i = 0; i < bandIndexCount; i++) {
+          NSUInteger index = bandIndexes[i];
+          if (NSIntersectsRect(tileRect, drawingBounds[index])) {
+            // Graphics cache what they draw as they draw it, so a graphic that spans tiles is drawn by one of them at a time.
+            SKTGraphic *graphic = graphics[index];
+            @synchronized(graphic) {
+              [tileContext saveGraphicsState];
+              [NSBezierPath clipRect:drawingBounds[index]];
+              [graphic drawContentsInView:nil rect:tileRect isBeingCreateOrEdited:NO];
+              [tileContext restoreGraphicsState];
+            }
+          }
+        }
+        [NSGraphicsContext restoreGraphicsState];
+        CGContextRelease(context);
+      }
+    });
+    free(bandIndexes);
+  };
+
+  SKTRasterEncoder *encoder = [[SKTRasterEncoder alloc] initWithType:type width:width height:height bandHeight:bandHeight writer:writer];
+  size_t bandCount = (height + bandHeight - 1) / bandHeight;
+  dispatch_group_t group = dispatch_group_create();
+  dispatch_group_async(group, queue, ^{ renderBand(0, firstBand); });
+  for (size_t band = 0; band < bandCount && nil == [encoder encodingError] && nil == [writer streamError]; band++) {
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    uint8_t *pixels = (band % 2) ? secondBand : firstBand;
+    if (band + 1 < bandCount) {
+      uint8_t *nextPixels = (band % 2) ? firstBand : secondBand;
+      dispatch_group_async(group, queue, ^{ renderBand(band + 1, nextPixels); });
+    }
+    [encoder writeRows:pixels count:MIN(bandHeight, height - band * bandHeight) bytesPerRow:bytesPerRow];
+  }
+  dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+  BOOL didWrite = [encoder finish];
+  if ( ! didWrite && outError) {
+    *outError = [encoder encodingError] ?: [writer streamError];
   }
-  return image;
+  CGColorSpaceRelease(colorSpace);
+  free(drawingBounds);
+  free(firstBand);
+  free(secondBand);
+  return didWrite;
+}
+
++ (BOOL)writeGraphics:(NSArray *)graphics type:(SKTRasterType)type scale:(CGFloat)scale toStream:(NSOutputStream *)stream error:(NSError **)outError {
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithOutputStream:stream];
+  return [self writeGraphics:graphics type:type scale:scale toWriter:writer error:outError];
 }
 
 + (NSData *)pngDataWithGraphics:(NSArray *)graphics error:(NSError **)outError {
-  NSData *result = nil;
-  NSImage *image = [self imageWithGraphics:graphics error:outError];
-  NSRect bounds = [self drawingBoundsOfGraphics:graphics];
-  bounds.size.width += bounds.origin.x;
-  bounds.size.height += bounds.origin.y;
-  bounds.origin = CGPointZero;
-  NSGraphicsContext *currentContext = [NSGraphicsContext currentContext];
-  CGImageRef cgImage = [image CGImageForProposedRect:&bounds context:currentContext hints:nil];
-  if (cgImage) {
-    NSBitmapImageRep *bitmapImage = [[NSBitmapImageRep alloc] initWithCGImage:cgImage];
-    result = [bitmapImage representationUsingType:NSPNGFileType properties:@{}];
-  }
-  return result;
+  NSMutableData *pngData = [NSMutableData data];
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:pngData];
+  return [self writeGraphics:graphics type:SKTRasterTypePNG scale:1 toWriter:writer error:outError] ? pngData : nil;
 }
 
 + (NSData *)tiffDataWithGraphics:(NSArray *)graphics error:(NSError **)outError {
-  // How big of a TIFF are we going to make? Regardless of what NSImage supports, FloorSketch doesn't support the creation of TIFFs that are 0 by 0 pixels. (We have to demonstrate a custom saving error somewhere, and this is an easy place to do it...)
-  NSImage *image = [self imageWithGraphics:graphics error:outError];
-  NSData *tiffData = [image TIFFRepresentation];
-  if (nil == tiffData && outError) {
-    // In FloorSketch there are lots of places to catch this situation earlier. For example, we could have overridden -writableTypesForSaveOperation: and made it not return NSTIFFPboardType, but then the user would have no idea why TIFF isn't showing up in the save panel's File Format popup. This way we can present a nice descriptive errror message.
-    *outError = SKTErrorWithCode(SKTWriteCouldntMakeTIFFError);
-  }
-  return tiffData;
+  // How big of a TIFF are we going to make? Regardless of what the encoder supports, FloorSketch doesn't support the creation of TIFFs that are 0 by 0 pixels. (We have to demonstrate a custom saving error somewhere, and this is an easy place to do it...)
+  NSMutableData *tiffData = [NSMutableData data];
+  SKTSVGWriter *writer = [[SKTSVGWriter alloc] initWithMutableData:tiffData];
+  return [self writeGraphics:graphics type:SKTRasterTypeTIFF scale:1 toWriter:writer error:outError] ? tiffData : nil;
 }
 
 - (instancetype)initWithFrame:(NSRect)frame graphics:(NSArray *)graphics printJobTitle:(NSString *)printJobTitle {
@@ -163,3 +242,54 @@
 
 }
 @end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+static double PeakResidentMegabytes(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / (1024.0 * 1024.0);  // bytes, on macOS.
+}
+
+void SKTRasterExportBenchmark(NSUInteger graphicCount) {
+  enum { kPixelSide = 20000 };
+  // A plan 10000 points on a side, scaled up to print resolution: an outline, then walls and columns scattered over it.
+  const CGFloat side = 10000;
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:graphicCount + 1];
+  SKTRectangle *outline = [[SKTRectangle alloc] init];
+  [outline setBounds:NSMakeRect(0, 0, side, side)];
+  [graphics addObject:outline];
+  srandom(1);
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    SKTGraphic *graphic = (i % 4) ? [[SKTRectangle alloc] init] : [[SKTEllipse alloc] init];
+    NSSize size = (i % 4) ? ((i % 2) ? NSMakeSize(120, 3) : NSMakeSize(3, 120)) : NSMakeSize(20, 20);
+    [graphic setBounds:NSMakeRect((side - size.width) * random() / RAND_MAX, (side - size.height) * random() / RAND_MAX, size.width, size.height)];
+    [graphics addObject:graphic];
+  }
+  NSRect bounds = [SKTRenderingView drawingBoundsOfGraphics:graphics];
+  CGFloat scale = kPixelSide / MAX(NSMaxX(bounds), NSMaxY(bounds));
+  NSLog(@"%lu graphics at %.3f pixels per point. The whole bitmap would be %.0f MB.",
+    (unsigned long)[graphics count], scale, NSMaxX(bounds) * scale * NSMaxY(bounds) * scale * 4 / (1024.0 * 1024.0));
+
+  NSString *const names[] = {@"PNG", @"TIFF"};
+  const SKTRasterType types[] = {SKTRasterTypePNG, SKTRasterTypeTIFF};
+  for (NSUInteger t = 0; t < 2; ++t) {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[@"SKTRasterExportBenchmark." stringByAppendingString:[names[t] lowercaseString]]];
+    NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+    double peakBefore = PeakResidentMegabytes();
+    NSError *error = nil;
+    NSDate *start = [NSDate date];
+    BOOL didWrite = [SKTRenderingView writeGraphics:graphics type:types[t] scale:scale toStream:stream error:&error];
+    NSTimeInterval time = -[start timeIntervalSinceNow];
+    [stream close];
+    unsigned long long fileSize = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL] fileSize];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    if ( ! didWrite) {
+      NSLog(@"%@ failed: %@", names[t], error);
+      continue;
+    }
+    NSLog(@"%@: %.2fs, %llu bytes, peak resident %.0f MB (%.0f MB before)", names[t], time, fileSize, PeakResidentMegabytes(), peakBefore);
+  }
+}
+#endif
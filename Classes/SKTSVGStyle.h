@@ -0,0 +1,102 @@
+/*  SKTSVGStyle.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The SVG attributes FloorSketch reads, and the presentation state they and style declarations set, parsed over raw
+ bytes.
+
+ An attribute name is looked up with one perfect hash probe and one compare, so an element's attributes are read in a
+ single pass over them. Presentation properties, fill and the like, are inherited in SVG, so the importer computes an
+ SKTSVGPresentation once per <g> and each child starts from a copy of it.
+ */
+
+typedef NS_ENUM(NSUInteger, SKTSVGAttribute) {
+  SKTSVGAttributeUnknown,
+  SKTSVGAttributeCx,
+  SKTSVGAttributeCy,
+  SKTSVGAttributeD,
+  SKTSVGAttributeDisplay,
+  SKTSVGAttributeFill,
+  SKTSVGAttributeFillOpacity,
+  SKTSVGAttributeHeight,
+  /// href or xlink:href.
+  SKTSVGAttributeHref,
+  SKTSVGAttributePoints,
+  SKTSVGAttributeR,
+  SKTSVGAttributeRx,
+  SKTSVGAttributeRy,
+  SKTSVGAttributeStroke,
+  SKTSVGAttributeStrokeOpacity,
+  SKTSVGAttributeStrokeWidth,
+  SKTSVGAttributeStyle,
+  SKTSVGAttributeTransform,
+  SKTSVGAttributeVisibility,
+  SKTSVGAttributeWidth,
+  SKTSVGAttributeX,
+  SKTSVGAttributeX1,
+  SKTSVGAttributeX2,
+  SKTSVGAttributeY,
+  SKTSVGAttributeY1,
+  SKTSVGAttributeY2,
+  SKTSVGAttributeCount
+};
+
+/// The attribute, or style property, named by length bytes. SKTSVGAttributeUnknown for any other name.
+SKTSVGAttribute SKTSVGAttributeFromBytes(const char *bytes, NSUInteger length);
+
+/// The attribute named, as -[NSXMLNode name] gives it.
+SKTSVGAttribute SKTSVGAttributeFromName(NSString *name);
+
+/// Whether the attribute is a presentation attribute, which may also be set in a style declaration, and is inherited.
+BOOL SKTSVGAttributeIsPresentation(SKTSVGAttribute attribute);
+
+typedef NS_ENUM(NSInteger, SKTSVGPaintKind) {
+  /// Not set anywhere yet: the graphic's own default applies.
+  SKTSVGPaintKindUnspecified,
+  SKTSVGPaintKindNone,
+  SKTSVGPaintKindColor,
+};
+
+typedef struct SKTSVGPaint {
+  SKTSVGPaintKind kind;
+  /// 0 to 1. Only for SKTSVGPaintKindColor.
+  CGFloat red, green, blue;
+} SKTSVGPaint;
+
+/// What an element draws with, from what it inherits, its presentation attributes and its style declarations.
+typedef struct SKTSVGPresentation {
+  SKTSVGPaint fill;
+  SKTSVGPaint stroke;
+  /// Negative until set.
+  CGFloat strokeWidth;
+  CGFloat fillOpacity;
+  CGFloat strokeOpacity;
+  /// display:none here or on an ancestor. A descendant can't undo it.
+  BOOL isDisplayNone;
+  /// visibility:hidden or collapse, until a descendant sets visibility:visible.
+  BOOL isVisibilityHidden;
+} SKTSVGPresentation;
+
+/// Nothing set: what the <svg> root inherits.
+extern const SKTSVGPresentation SKTSVGPresentationInitial;
+
+/// Apply the value of one presentation attribute, or style property, to presentation. Values that don't parse, and
+/// attributes that aren't presentation attributes, are ignored, as is inherit, which leaves the inherited value.
+void SKTSVGPresentationApply(SKTSVGPresentation *presentation, SKTSVGAttribute attribute, const char *value, NSUInteger length);
+
+/// Apply the declarations of a style attribute, "fill:#ff0000;stroke-width:2", in order.
+void SKTSVGPresentationApplyStyle(SKTSVGPresentation *presentation, const char *bytes, NSUInteger length);
+
+/// Parse a paint: none, #rgb, #rrggbb, rgb(r, g, b) with numbers or percentages, or any of the 148 CSS color names,
+/// looked up by perfect hash. Returns NO, leaving *outPaint alone, for anything else.
+BOOL SKTSVGPaintFromBytes(const char *bytes, NSUInteger length, SKTSVGPaint *outPaint);
+
+/// A number at the start of s, after any whitespace, ignoring units. 0 if there is none.
+CGFloat SKTSVGFloatValue(NSString *_Nullable s);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,497 @@
+/*  SKTSVGStyle.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTSVGStyle.h"
+
+#import "SKTPathTokenizer.h"
+
+enum {
+  kAttributeTableSize = 64,
+  // Longer than any name in the table.
+  kMaxAttributeNameLength = 31
+};
+
+typedef struct AttributeEntry {
+  const char *name;
+  NSUInteger length;
+  SKTSVGAttribute attribute;
+} AttributeEntry;
+
+// Indexed by AttributeHash(). Collision free for these names: a name that hashes to a slot is its name or unknown.
+static const AttributeEntry kAttributeTable[kAttributeTableSize] = {
+  [3] = {"fill-opacity", 12, SKTSVGAttributeFillOpacity},
+  [5] = {"x1", 2, SKTSVGAttributeX1},
+  [6] = {"href", 4, SKTSVGAttributeHref},
+  [7] = {"y1", 2, SKTSVGAttributeY1},
+  [8] = {"x2", 2, SKTSVGAttributeX2},
+  [10] = {"y2", 2, SKTSVGAttributeY2},
+  [14] = {"rx", 2, SKTSVGAttributeRx},
+  [17] = {"ry", 2, SKTSVGAttributeRy},
+  [20] = {"fill", 4, SKTSVGAttributeFill},
+  [25] = {"x", 1, SKTSVGAttributeX},
+  [26] = {"style", 5, SKTSVGAttributeStyle},
+  [27] = {"stroke", 6, SKTSVGAttributeStroke},
+  [30] = {"y", 1, SKTSVGAttributeY},
+  [31] = {"stroke-opacity", 14, SKTSVGAttributeStrokeOpacity},
+  [33] = {"visibility", 10, SKTSVGAttributeVisibility},
+  [42] = {"stroke-width", 12, SKTSVGAttributeStrokeWidth},
+  [43] = {"width", 5, SKTSVGAttributeWidth},
+  [44] = {"xlink:href", 10, SKTSVGAttributeHref},
+  [48] = {"cx", 2, SKTSVGAttributeCx},
+  [50] = {"height", 6, SKTSVGAttributeHeight},
+  [51] = {"cy", 2, SKTSVGAttributeCy},
+  [53] = {"d", 1, SKTSVGAttributeD},
+  [56] = {"transform", 9, SKTSVGAttributeTransform},
+  [58] = {"display", 7, SKTSVGAttributeDisplay},
+  [59] = {"r", 1, SKTSVGAttributeR},
+  [63] = {"points", 6, SKTSVGAttributePoints},
+};
+
+// Found by search over small multipliers: the length and the first and last bytes tell all the names above apart.
+static NSUInteger AttributeHash(const char *bytes, NSUInteger length) {
+  return (length + 2 * (unsigned char)bytes[0] + 3 * (unsigned char)bytes[length - 1]) & (kAttributeTableSize - 1);
+}
+
+SKTSVGAttribute SKTSVGAttributeFromBytes(const char *bytes, NSUInteger length) {
+  if (0 == length) {
+    return SKTSVGAttributeUnknown;
+  }
+  const AttributeEntry *entry = &kAttributeTable[AttributeHash(bytes, length)];
+  if (entry->length == length && 0 == memcmp(entry->name, bytes, length)) {
+    return entry->attribute;
+  }
+  return SKTSVGAttributeUnknown;
+}
+
+SKTSVGAttribute SKTSVGAttributeFromName(NSString *name) {
+  char buffer[kMaxAttributeNameLength + 1];
+  if ( ! [name getCString:buffer maxLength:sizeof buffer encoding:NSASCIIStringEncoding]) {
+    return SKTSVGAttributeUnknown;
+  }
+  return SKTSVGAttributeFromBytes(buffer, strlen(buffer));
+}
+
+BOOL SKTSVGAttributeIsPresentation(SKTSVGAttribute attribute) {
+  switch (attribute) {
+    case SKTSVGAttributeDisplay:
+    case SKTSVGAttributeFill:
+    case SKTSVGAttributeFillOpacity:
+    case SKTSVGAttributeStroke:
+    case SKTSVGAttributeStrokeOpacity:
+    case SKTSVGAttributeStrokeWidth:
+    case SKTSVGAttributeVisibility:
+      return YES;
+    default:
+      return NO;
+  }
+}
+
+const SKTSVGPresentation SKTSVGPresentationInitial = {
+  .fill = {SKTSVGPaintKindUnspecified, 0, 0, 0},
+  .stroke = {SKTSVGPaintKindUnspecified, 0, 0, 0},
+  .strokeWidth = -1,
+  .fillOpacity = 1,
+  .strokeOpacity = 1,
+  .isDisplayNone = NO,
+  .isVisibilityHidden = NO,
+};
+
+#pragma mark - Bytes
+
+static BOOL IsSpace(char c) {
+  return ' ' == c || '\n' == c || '\r' == c || '\t' == c || '\f' == c;
+}
+
+// Narrow [*pp, *endp) to leave out whitespace at either end.
+static void Trim(const char **pp, const char **endp) {
+  const char *p = *pp;
+  const char *end = *endp;
+  while (p < end && IsSpace(*p)) {
+    ++p;
+  }
+  while (p < end && IsSpace(end[-1])) {
+    --end;
+  }
+  *pp = p;
+  *endp = end;
+}
+
+static BOOL IsEqualBytes(const char *p, const char *end, const char *literal) {
+  size_t length = strlen(literal);
+  return (size_t)(end - p) == length && 0 == memcmp(p, literal, length);
+}
+
+static int HexDigitValue(char c) {
+  if ('0' <= c && c <= '9') {
+    return c - '0';
+  } else if ('a' <= c && c <= 'f') {
+    return c - 'a' + 10;
+  } else if ('A' <= c && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// One rgb() argument, a number out of 255 or a percentage, with the comma or closing parenthesis after it.
+static BOOL ParseColorComponent(const char **pp, const char *end, char terminator, CGFloat *outComponent) {
+  const char *p = *pp;
+  while (p < end && IsSpace(*p)) {
+    ++p;
+  }
+  CGFloat n;
+  if ( ! SKTPathParseNumber(&p, end, &n)) {
+    return NO;
+  }
+  CGFloat denominator = 255;
+  if (p < end && '%' == *p) {
+    denominator = 100;
+    ++p;
+  }
+  while (p < end && IsSpace(*p)) {
+    ++p;
+  }
+  if ( ! (p < end && terminator == *p)) {
+    return NO;
+  }
+  *outComponent = n / denominator;
+  *pp = p + 1;
+  return YES;
+}
+
+enum {
+  kColorNameBucketCount = 64,
+  kColorNameTableSize = 256,
+  kMaxColorNameLength = 20
+};
+
+typedef struct ColorNameEntry {
+  const char *name;
+  uint32_t rgb;
+} ColorNameEntry;
+
+// The CSS named colors, placed by hash and displace: a name's first hash picks its bucket, and the bucket's
+// displacement seeds its second hash, which picks its slot. The displacements were searched for so that no two names
+// share a slot. Buckets with no names have 0.
+static const uint8_t kColorNameDisplacements[kColorNameBucketCount] = {
+  0, 0, 0, 6, 1, 2, 1, 0, 2, 1, 2, 0, 2, 1, 2, 2,
+  4, 1, 3, 2, 2, 3, 1, 2, 4, 2, 1, 0, 2, 1, 1, 3,
+  3, 0, 1, 0, 4, 0, 1, 2, 1, 2, 1, 1, 1, 5, 1, 1,
+  5, 3, 5, 3, 8, 1, 1, 3, 0, 5, 1, 1, 1, 5, 1, 14,
+};
+
+static const ColorNameEntry kColorNames[kColorNameTableSize] = {
+  [0] = {"mediumpurple", 0x9370db},
+  [1] = {"aquamarine", 0x7fffd4},
+  [3] = {"darkgrey", 0xa9a9a9},
+  [4] = {"whitesmoke", 0xf5f5f5},
+  [5] = {"lightgoldenrodyellow", 0xfafad2},
+  [6] = {"lightcoral", 0xf08080},
+  [8] = {"linen", 0xfaf0e6},
+  [9] = {"mediumturquoise", 0x48d1cc},
+  [10] = {"goldenrod", 0xdaa520},
+  [11] = {"coral", 0xff7f50},
+  [13] = {"fuchsia", 0xff00ff},
+  [14] = {"thistle", 0xd8bfd8},
+  [16] = {"darkseagreen", 0x8fbc8f},
+  [19] = {"lightsteelblue", 0xb0c4de},
+  [20] = {"darkblue", 0x00008b},
+  [22] = {"darkred", 0x8b0000},
+  [24] = {"blueviolet", 0x8a2be2},
+  [25] = {"purple", 0x800080},
+  [27] = {"lightsalmon", 0xffa07a},
+  [28] = {"wheat", 0xf5deb3},
+  [29] = {"lime", 0x00ff00},
+  [30] = {"palevioletred", 0xdb7093},
+  [33] = {"lemonchiffon", 0xfffacd},
+  [34] = {"khaki", 0xf0e68c},
+  [40] = {"slategray", 0x708090},
+  [41] = {"darkturquoise", 0x00ced1},
+  [43] = {"greenyellow", 0xadff2f},
+  [44] = {"darksalmon", 0xe9967a},
+  [45] = {"dimgrey", 0x696969},
+  [47] = {"chocolate", 0xd2691e},
+  [49] = {"rosybrown", 0xbc8f8f},
+  [53] = {"firebrick", 0xb22222},
+  [54] = {"olivedrab", 0x6b8e23},
+  [55] = {"dodgerblue", 0x1e90ff},
+  [57] = {"saddlebrown", 0x8b4513},
+  [58] = {"olive", 0x808000},
+  [62] = {"mediumaquamarine", 0x66cdaa},
+  [72] = {"skyblue", 0x87ceeb},
+  [73] = {"lightskyblue", 0x87cefa},
+  [74] = {"indianred", 0xcd5c5c},
+  [75] = {"palegoldenrod", 0xeee8aa},
+  [78] = {"mediumseagreen", 0x3cb371},
+  [79] = {"bisque", 0xffe4c4},
+  [81] = {"white", 0xffffff},
+  [83] = {"lavender", 0xe6e6fa},
+  [85] = {"turquoise", 0x40e0d0},
+  [86] = {"plum", 0xdda0dd},
+  [87] = {"sandybrown", 0xf4a460},
+  [88] = {"ghostwhite", 0xf8f8ff},
+  [91] = {"slategrey", 0x708090},
+  [92] = {"teal", 0x008080},
+  [94] = {"lightcyan", 0xe0ffff},
+  [95] = {"grey", 0x808080},
+  [96] = {"lightyellow", 0xffffe0},
+  [98] = {"yellowgreen", 0x9acd32},
+  [99] = {"violet", 0xee82ee},
+  [100] = {"paleturquoise", 0xafeeee},
+  [103] = {"rebeccapurple", 0x663399},
+  [104] = {"navy", 0x000080},
+  [105] = {"springgreen", 0x00ff7f},
+  [107] = {"gray", 0x808080},
+  [108] = {"pink", 0xffc0cb},
+  [113] = {"ivory", 0xfffff0},
+  [116] = {"mediumblue", 0x0000cd},
+  [118] = {"cornflowerblue", 0x6495ed},
+  [119] = {"seashell", 0xfff5ee},
+  [121] = {"moccasin", 0xffe4b5},
+  [122] = {"blanchedalmond", 0xffebcd},
+  [123] = {"magenta", 0xff00ff},
+  [128] = {"deeppink", 0xff1493},
+  [129] = {"slateblue", 0x6a5acd},
+  [130] = {"beige", 0xf5f5dc},
+  [131] = {"darkorchid", 0x9932cc},
+  [132] = {"hotpink", 0xff69b4},
+  [133] = {"gold", 0xffd700},
+  [134] = {"palegreen", 0x98fb98},
+  [136] = {"blue", 0x0000ff},
+  [140] = {"darkolivegreen", 0x556b2f},
+  [142] = {"lightpink", 0xffb6c1},
+  [143] = {"darkcyan", 0x008b8b},
+  [144] = {"brown", 0xa52a2a},
+  [145] = {"azure", 0xf0ffff},
+  [146] = {"mistyrose", 0xffe4e1},
+  [148] = {"darkslategray", 0x2f4f4f},
+  [149] = {"orangered", 0xff4500},
+  [151] = {"darkviolet", 0x9400d3},
+  [152] = {"gainsboro", 0xdcdcdc},
+  [154] = {"indigo", 0x4b0082},
+  [155] = {"darkgreen", 0x006400},
+  [160] = {"black", 0x000000},
+  [161] = {"crimson", 0xdc143c},
+  [162] = {"peachpuff", 0xffdab9},
+  [163] = {"royalblue", 0x4169e1},
+  [164] = {"seagreen", 0x2e8b57},
+  [165] = {"mediumspringgreen", 0x00fa9a},
+  [166] = {"steelblue", 0x4682b4},
+  [167] = {"papayawhip", 0xffefd5},
+  [169] = {"cadetblue", 0x5f9ea0},
+  [171] = {"cornsilk", 0xfff8dc},
+  [172] = {"mintcream", 0xf5fffa},
+  [173] = {"mediumslateblue", 0x7b68ee},
+  [174] = {"red", 0xff0000},
+  [175] = {"burlywood", 0xdeb887},
+  [176] = {"mediumorchid", 0xba55d3},
+  [177] = {"navajowhite", 0xffdead},
+  [178] = {"darkorange", 0xff8c00},
+  [180] = {"midnightblue", 0x191970},
+  [182] = {"lavenderblush", 0xfff0f5},
+  [185] = {"lightslategray", 0x778899},
+  [190] = {"orange", 0xffa500},
+  [191] = {"darkmagenta", 0x8b008b},
+  [195] = {"darkslategrey", 0x2f4f4f},
+  [196] = {"yellow", 0xffff00},
+  [201] = {"antiquewhite", 0xfaebd7},
+  [202] = {"oldlace", 0xfdf5e6},
+  [204] = {"chartreuse", 0x7fff00},
+  [205] = {"darkslateblue", 0x483d8b},
+  [208] = {"lightslategrey", 0x778899},
+  [211] = {"cyan", 0x00ffff},
+  [212] = {"honeydew", 0xf0fff0},
+  [213] = {"peru", 0xcd853f},
+  [214] = {"darkkhaki", 0xbdb76b},
+  [215] = {"lightgray", 0xd3d3d3},
+  [216] = {"salmon", 0xfa8072},
+  [219] = {"mediumvioletred", 0xc71585},
+  [220] = {"floralwhite", 0xfffaf0},
+  [224] = {"lightseagreen", 0x20b2aa},
+  [225] = {"tomato", 0xff6347},
+  [227] = {"deepskyblue", 0x00bfff},
+  [229] = {"powderblue", 0xb0e0e6},
+  [233] = {"lawngreen", 0x7cfc00},
+  [235] = {"snow", 0xfffafa},
+  [236] = {"tan", 0xd2b48c},
+  [237] = {"aliceblue", 0xf0f8ff},
+  [238] = {"sienna", 0xa0522d},
+  [239] = {"green", 0x008000},
+  [241] = {"dimgray", 0x696969},
+  [242] = {"lightgrey", 0xd3d3d3},
+  [243] = {"silver", 0xc0c0c0},
+  [244] = {"lightblue", 0xadd8e6},
+  [245] = {"forestgreen", 0x228b22},
+  [246] = {"darkgoldenrod", 0xb8860b},
+  [247] = {"darkgray", 0xa9a9a9},
+  [249] = {"limegreen", 0x32cd32},
+  [251] = {"lightgreen", 0x90ee90},
+  [252] = {"maroon", 0x800000},
+  [254] = {"aqua", 0x00ffff},
+  [255] = {"orchid", 0xda70d6},
+};
+
+// FNV-1a, seeded.
+static uint32_t ColorNameHash(const char *p, const char *end, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (; p < end; ++p) {
+    hash = (hash ^ (unsigned char)*p) * 16777619u;
+  }
+  return hash;
+}
+
+// Color names are case insensitive: look up the lowercase form. None is longer than lightgoldenrodyellow.
+static BOOL PaintOfColorName(const char *name, const char *nameEnd, SKTSVGPaint *outPaint) {
+  char lowercase[kMaxColorNameLength];
+  if (kMaxColorNameLength < nameEnd - name) {
+    return NO;
+  }
+  const char *p = lowercase;
+  const char *end = lowercase + (nameEnd - name);
+  for (ptrdiff_t i = 0; i < nameEnd - name; ++i) {
+    lowercase[i] = ('A' <= name[i] && name[i] <= 'Z') ? (char)(name[i] - 'A' + 'a') : name[i];
+  }
+  uint8_t displacement = kColorNameDisplacements[ColorNameHash(p, end, 0) % kColorNameBucketCount];
+  const ColorNameEntry *entry = &kColorNames[ColorNameHash(p, end, displacement) % kColorNameTableSize];
+  if (entry->name && IsEqualBytes(p, end, entry->name)) {
+    *outPaint = (SKTSVGPaint){SKTSVGPaintKindColor,
+      (entry->rgb >> 16) / 255., ((entry->rgb >> 8) & 0xFF) / 255., (entry->rgb & 0xFF) / 255.};
+    return YES;
+  }
+  return NO;
+}
+
+BOOL SKTSVGPaintFromBytes(const char *bytes, NSUInteger length, SKTSVGPaint *outPaint) {
+  const char *p = bytes;
+  const char *end = bytes + length;
+  Trim(&p, &end);
+  if (IsEqualBytes(p, end, "none")) {
+    *outPaint = (SKTSVGPaint){SKTSVGPaintKindNone, 0, 0, 0};
+    return YES;
+  }
+  if (p < end && '#' == *p) {
+    NSUInteger digitCount = (NSUInteger)(end - p - 1);
+    if (3 != digitCount && 6 != digitCount) {
+      return NO;
+    }
+    int digits[6];
+    for (NSUInteger i = 0; i < digitCount; ++i) {
+      if ((digits[i] = HexDigitValue(p[1 + i])) < 0) {
+        return NO;
+      }
+    }
+    if (3 == digitCount) {
+      *outPaint = (SKTSVGPaint){SKTSVGPaintKindColor, digits[0] / 15., digits[1] / 15., digits[2] / 15.};
+    } else {
+      *outPaint = (SKTSVGPaint){SKTSVGPaintKindColor,
+        (digits[0] * 16 + digits[1]) / 255., (digits[2] * 16 + digits[3]) / 255., (digits[4] * 16 + digits[5]) / 255.};
+    }
+    return YES;
+  }
+  if (4 <= end - p && 0 == memcmp(p, "rgb(", 4)) {
+    p += 4;
+    CGFloat red, green, blue;
+    if (ParseColorComponent(&p, end, ',', &red) && ParseColorComponent(&p, end, ',', &green) &&
+        ParseColorComponent(&p, end, ')', &blue) && p == end) {
+      *outPaint = (SKTSVGPaint){SKTSVGPaintKindColor, red, green, blue};
+      return YES;
+    }
+    return NO;
+  }
+  return PaintOfColorName(p, end, outPaint);
+}
+
+// A non-negative number, ignoring any units after it. Returns NO if there is none.
+static BOOL ParseNonNegative(const char *p, const char *end, CGFloat *outValue) {
+  CGFloat n;
+  if (SKTPathParseNumber(&p, end, &n) && 0 <= n) {
+    *outValue = n;
+    return YES;
+  }
+  return NO;
+}
+
+#pragma mark - Presentation
+
+void SKTSVGPresentationApply(SKTSVGPresentation *presentation, SKTSVGAttribute attribute, const char *value, NSUInteger length) {
+  const char *p = value;
+  const char *end = value + length;
+  Trim(&p, &end);
+  if (IsEqualBytes(p, end, "inherit")) {
+    return;
+  }
+  CGFloat n;
+  switch (attribute) {
+    case SKTSVGAttributeFill:
+      SKTSVGPaintFromBytes(p, (NSUInteger)(end - p), &presentation->fill);
+      break;
+    case SKTSVGAttributeStroke:
+      SKTSVGPaintFromBytes(p, (NSUInteger)(end - p), &presentation->stroke);
+      break;
+    case SKTSVGAttributeStrokeWidth:
+      if (ParseNonNegative(p, end, &n)) {
+        presentation->strokeWidth = n;
+      }
+      break;
+    case SKTSVGAttributeFillOpacity:
+      if (ParseNonNegative(p, end, &n) && n <= 1) {
+        presentation->fillOpacity = n;
+      }
+      break;
+    case SKTSVGAttributeStrokeOpacity:
+      if (ParseNonNegative(p, end, &n) && n <= 1) {
+        presentation->strokeOpacity = n;
+      }
+      break;
+    case SKTSVGAttributeDisplay:
+      if (IsEqualBytes(p, end, "none")) {
+        presentation->isDisplayNone = YES;
+      }
+      break;
+    case SKTSVGAttributeVisibility:
+      if (IsEqualBytes(p, end, "hidden") || IsEqualBytes(p, end, "collapse")) {
+        presentation->isVisibilityHidden = YES;
+      } else if (IsEqualBytes(p, end, "visible")) {
+        presentation->isVisibilityHidden = NO;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void SKTSVGPresentationApplyStyle(SKTSVGPresentation *presentation, const char *bytes, NSUInteger length) {
+  const char *p = bytes;
+  const char *end = bytes + length;
+  while (p < end) {
+    const char *declarationEnd = memchr(p, ';', (size_t)(end - p));
+    if (NULL == declarationEnd) {
+      declarationEnd = end;
+    }
+    const char *colon = memchr(p, ':', (size_t)(declarationEnd - p));
+    if (colon) {
+      const char *key = p;
+      const char *keyEnd = colon;
+      Trim(&key, &keyEnd);
+      SKTSVGAttribute attribute = SKTSVGAttributeFromBytes(key, (NSUInteger)(keyEnd - key));
+      if (SKTSVGAttributeIsPresentation(attribute)) {
+        SKTSVGPresentationApply(presentation, attribute, colon + 1, (NSUInteger)(declarationEnd - colon - 1));
+      }
+    }
+    p = declarationEnd + (declarationEnd < end);
+  }
+}
+
+CGFloat SKTSVGFloatValue(NSString *s) {
+  const char *p = [s UTF8String];
+  if (NULL == p) {
+    return 0;
+  }
+  const char *end = p + strlen(p);
+  while (p < end && IsSpace(*p)) {
+    ++p;
+  }
+  CGFloat result = 0;
+  SKTPathParseNumber(&p, end, &result);
+  return result;
+}
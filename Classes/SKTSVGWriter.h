@@ -0,0 +1,60 @@
+/*  SKTSVGWriter.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+enum {
+  // Big enough for any number SKTFormatFloat() writes, plus a terminating nul.
+  SKTFormatFloatBufferSize = 32
+};
+
+/// Write value into buffer exactly as printf's "%.5g" would, without going through printf for the common cases.
+/// Returns the number of chars written, not counting the terminating nul.
+NSUInteger SKTFormatFloat(char *buffer, CGFloat value);
+
+/**
+ Writes SVG as UTF-8 bytes into a fixed size buffer, and hands the buffer to an output stream or an NSMutableData
+ whenever it fills, so a document is never held in memory as one big string.
+ */
+@interface SKTSVGWriter : NSObject
+
+/// Writes to stream, opening it if needed. Call -finish when done.
+- (instancetype)initWithOutputStream:(NSOutputStream *)stream NS_DESIGNATED_INITIALIZER;
+
+/// Appends to data. Call -finish when done.
+- (instancetype)initWithMutableData:(NSMutableData *)data NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// The first error reported by the output stream. Once set, further writes are ignored.
+@property(nonatomic, readonly, nullable) NSError *streamError;
+
+- (void)writeString:(NSString *)s;
+
+/// s must be a nul terminated UTF-8 string, typically a literal.
+- (void)writeUTF8:(const char *)s;
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length;
+
+/// Formatted as "%.5g".
+- (void)writeFloat:(CGFloat)f;
+
+/// Formatted as "%.5g,%.5g".
+- (void)writePoint:(CGPoint)p;
+
+/// Escapes &, < and >.
+- (void)writeEscapedString:(NSString *)s;
+
+/// Base64 in lines of 76 characters separated by line feeds, as -[NSData base64EncodedStringWithOptions:] would
+/// write it, but straight into the buffer rather than through one big string.
+- (void)writeBase64Data:(NSData *)data;
+
+/// Write out anything still buffered. Returns NO if the stream reported an error.
+- (BOOL)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,268 @@
+/*  SKTSVGWriter.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTSVGWriter.h"
+
+#include <math.h>
+#include <stdio.h>
+
+enum {
+  kBufferSize = 64 * 1024
+};
+
+// Powers of ten for the fast path of SKTFormatFloat(). All exact in a double.
+static const double kPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+// "%.5g" keeps 5 significant digits and uses plain notation for exponents -4 through 4, dropping trailing zeros.
+// For values in that range, scale to a 5 digit integer and lay out the digits directly. Anything else, or a value whose
+// scaled fraction is too close to one half to be sure which way printf would round it, goes to snprintf.
+NSUInteger SKTFormatFloat(char *buffer, CGFloat value) {
+  double magnitude = fabs(value);
+  if (0 == magnitude) {
+    return (NSUInteger)snprintf(buffer, SKTFormatFloatBufferSize, "%.5g", value);  // keeps "-0".
+  }
+  if ( ! (1e-4 <= magnitude && magnitude < 1e5)) {
+    return (NSUInteger)snprintf(buffer, SKTFormatFloatBufferSize, "%.5g", value);
+  }
+  int exponent = 4;
+  while (magnitude < kPowersOfTen[exponent]) {
+    exponent -= 1;
+    if (exponent < 0) {
+      break;
+    }
+  }
+  double scaled = magnitude * kPowersOfTen[4 - exponent];
+  // For magnitude < 1 the loop stopped at -1, so find the real exponent. The extra multiplies are far too small
+  // an error to matter next to the check for one half below.
+  while (scaled < 10000) {
+    scaled *= 10;
+    exponent -= 1;
+  }
+  double fraction = scaled - floor(scaled);
+  if (fabs(fraction - 0.5) < 1e-6) {
+    return (NSUInteger)snprintf(buffer, SKTFormatFloatBufferSize, "%.5g", value);
+  }
+  unsigned digits = (unsigned)floor(scaled + 0.5);
+  if (100000 <= digits) {
+    // Rounding carried into a sixth digit.
+    digits /= 10;
+    exponent += 1;
+    if (5 <= exponent) {
+      return (NSUInteger)snprintf(buffer, SKTFormatFloatBufferSize, "%.5g", value);
+    }
+  }
+  char digitChars[5];
+  for (int i = 4; 0 <= i; --i) {
+    digitChars[i] = (char)('0' + digits % 10);
+    digits /= 10;
+  }
+  int significant = 5;
+  while (1 < significant && '0' == digitChars[significant - 1]) {
+    significant -= 1;
+  }
+  char *p = buffer;
+  if (value < 0) {
+    *p++ = '-';
+  }
+  if (0 <= exponent) {
+    int integerDigits = exponent + 1;
+    for (int i = 0; i < integerDigits; ++i) {
+      *p++ = digitChars[i];
+    }
+    if (integerDigits < significant) {
+      *p++ = '.';
+      for (int i = integerDigits; i < significant; ++i) {
+        *p++ = digitChars[i];
+      }
+    }
+  } else {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = -1; exponent < i; --i) {
+      *p++ = '0';
+    }
+    for (int i = 0; i < significant; ++i) {
+      *p++ = digitChars[i];
+    }
+  }
+  *p = '\0';
+  return (NSUInteger)(p - buffer);
+}
+
+@interface SKTSVGWriter () {
+  NSOutputStream *_stream;
+  NSMutableData *_data;
+  uint8_t *_buffer;
+  NSUInteger _count;
+}
+@property(nonatomic, readwrite, nullable) NSError *streamError;
+@end
+
+@implementation SKTSVGWriter
+
+- (instancetype)initWithOutputStream:(NSOutputStream *)stream {
+  self = [super init];
+  if (self) {
+    _stream = stream;
+    if (NSStreamStatusNotOpen == [_stream streamStatus]) {
+      [_stream open];
+    }
+    _buffer = malloc(kBufferSize);
+  }
+  return self;
+}
+
+- (instancetype)initWithMutableData:(NSMutableData *)data {
+  self = [super init];
+  if (self) {
+    _data = data;
+    _buffer = malloc(kBufferSize);
+  }
+  return self;
+}
+
+- (void)dealloc {
+  free(_buffer);
+}
+
+- (void)writeThrough:(const uint8_t *)p length:(NSUInteger)length {
+  if (_data) {
+    [_data appendBytes:p length:length];
+  } else {
+    while (length && nil == _streamError) {
+      NSInteger written = [_stream write:p maxLength:length];
+      if (written <= 0) {
+        self.streamError = [_stream streamError] ?: [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+      } else {
+        p += written;
+        length -= (NSUInteger)written;
+      }
+    }
+  }
+}
+
+- (void)flushBuffer {
+  [self writeThrough:_buffer length:_count];
+  _count = 0;
+}
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length {
+  if (_streamError) {
+    return;
+  }
+  if (kBufferSize - _count < length) {
+    [self flushBuffer];
+    if (kBufferSize < length) {
+      // Too big to be worth buffering.
+      [self writeThrough:bytes length:length];
+      return;
+    }
+  }
+  memcpy(_buffer + _count, bytes, length);
+  _count += length;
+}
+
+- (void)writeUTF8:(const char *)s {
+  [self writeBytes:s length:strlen(s)];
+}
+
+- (void)writeString:(NSString *)s {
+  NSUInteger length = [s length];
+  NSRange remaining = NSMakeRange(0, length);
+  while (remaining.length && nil == _streamError) {
+    if (kBufferSize - _count < 4) {
+      [self flushBuffer];
+    }
+    NSUInteger used = 0;
+    NSRange rest;
+    if ( ! [s getBytes:_buffer + _count maxLength:kBufferSize - _count usedLength:&used encoding:NSUTF8StringEncoding options:0 range:remaining remainingRange:&rest]) {
+      // Unpaired surrogates and the like: let NSString decide how to convert them.
+      NSData *data = [[s substringWithRange:remaining] dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:YES];
+      [self writeBytes:[data bytes] length:[data length]];
+      return;
+    }
+    _count += used;
+    remaining = rest;
+  }
+}
+
+- (void)writeFloat:(CGFloat)f {
+  if (kBufferSize - _count < SKTFormatFloatBufferSize) {
+    [self flushBuffer];
+  }
+  if (nil == _streamError) {
+    _count += SKTFormatFloat((char *)_buffer + _count, f);
+  }
+}
+
+- (void)writePoint:(CGPoint)p {
+  [self writeFloat:p.x];
+  [self writeBytes:"," length:1];
+  [self writeFloat:p.y];
+}
+
+- (void)writeEscapedString:(NSString *)s {
+  NSCharacterSet *special = [NSCharacterSet characterSetWithCharactersInString:@"&<>"];
+  NSUInteger length = [s length];
+  NSUInteger start = 0;
+  for (;;) {
+    NSRange found = [s rangeOfCharacterFromSet:special options:NSLiteralSearch range:NSMakeRange(start, length - start)];
+    if (NSNotFound == found.location) {
+      break;
+    }
+    [self writeString:[s substringWithRange:NSMakeRange(start, found.location - start)]];
+    switch ([s characterAtIndex:found.location]) {
+      case '&': [self writeUTF8:"&amp;"]; break;
+      case '<': [self writeUTF8:"&lt;"]; break;
+      default: [self writeUTF8:"&gt;"]; break;
+    }
+    start = NSMaxRange(found);
+  }
+  [self writeString:(0 == start) ? s : [s substringFromIndex:start]];
+}
+
+- (void)writeBase64Data:(NSData *)data {
+  static const char kDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  enum {
+    kLineBytes = 57,  // 76 characters.
+  };
+  const uint8_t *p = [data bytes];
+  NSUInteger length = [data length];
+  for (NSUInteger lineStart = 0; lineStart < length && nil == _streamError; lineStart += kLineBytes) {
+    if (kBufferSize - _count < 80) {
+      [self flushBuffer];
+    }
+    uint8_t *out = _buffer + _count;
+    if (lineStart) {
+      *out++ = '\n';
+    }
+    NSUInteger lineEnd = MIN(lineStart + kLineBytes, length);
+    NSUInteger i = lineStart;
+    for (; i + 3 <= lineEnd; i += 3) {
+      uint32_t group = ((uint32_t)p[i] << 16) | ((uint32_t)p[i + 1] << 8) | p[i + 2];
+      *out++ = kDigits[group >> 18];
+      *out++ = kDigits[(group >> 12) & 0x3F];
+      *out++ = kDigits[(group >> 6) & 0x3F];
+      *out++ = kDigits[group & 0x3F];
+    }
+    if (i < lineEnd) {
+      uint32_t group = (uint32_t)p[i] << 16;
+      if (i + 1 < lineEnd) {
+        group |= (uint32_t)p[i + 1] << 8;
+      }
+      *out++ = kDigits[group >> 18];
+      *out++ = kDigits[(group >> 12) & 0x3F];
+      *out++ = (i + 1 < lineEnd) ? kDigits[(group >> 6) & 0x3F] : '=';
+      *out++ = '=';
+    }
+    _count = (NSUInteger)(out - _buffer);
+  }
+}
+
+- (BOOL)finish {
+  [self flushBuffer];
+  return nil == _streamError;
+}
+
+@end
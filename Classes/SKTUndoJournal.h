@@ -0,0 +1,48 @@
+/*  SKTUndoJournal.h
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+@class SKTGraphic;
+
+// The user default for SKTUndoJournal's byteLimit, in megabytes.
+extern NSString *const SKTUndoMegabytesKey;
+
+// The old values of the graphic properties changed in one undo group. Rather than a dictionary of boxed values per
+// graphic, they're typed records in flat buffers: a bounds is four doubles, a flag or a width one, and a color is
+// stored once however many graphics had it. Once closed, a bounds that only moved keeps just how far it moved, and
+// if every graphic moved the same way, as in a drag, that offset is kept once for the whole entry.
+@interface SKTUndoJournalEntry : NSObject
+
+// Returns NO, and keeps nothing, if an older value of key of graphic is already recorded: the first value changed
+// from in the group is the one to go back to.
+- (BOOL)recordOldValue:(id)oldValue forKey:(NSString *)key ofGraphic:(SKTGraphic *)graphic;
+
+@property(nonatomic, readonly) NSUInteger recordCount;
+
+// Of the buffers, roughly.
+@property(nonatomic, readonly) NSUInteger byteCount;
+
+@end
+
+// Makes an SKTUndoJournalEntry per undo group that changes graphic properties, and registers it with the undo
+// manager, which undoes it by setting the old values back. Keeps count of the bytes of every entry the undo manager
+// still holds. Past the limit, the oldest undo groups are dropped.
+@interface SKTUndoJournal : NSObject
+
+- (instancetype)initWithUndoManager:(NSUndoManager *)undoManager;
+
+// Default: the SKTUndoMegabytesKey user default, or 128 MB.
+@property(nonatomic) NSUInteger byteLimit;
+
+// KVO compliant, on the main thread.
+@property(nonatomic, readonly) NSUInteger byteCount;
+
+// The entry of the current undo group, made and registered with the undo manager when first asked for.
+- (SKTUndoJournalEntry *)openEntry;
+
+// Call at each undo manager checkpoint. Compacts the open entry, if any, so the next change starts a new one.
+- (void)closeEntry;
+
+@end
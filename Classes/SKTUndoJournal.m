@@ -0,0 +1,408 @@
+/*  SKTUndoJournal.m
+ Additional material Copyright © 2016 David Phillip Oster. All Rights Reserved.
+*/
+
+#import "SKTUndoJournal.h"
+
+#import "SKTGraphic.h"
+
+NSString *const SKTUndoMegabytesKey = @"SKTUndoMegabytes";
+
+enum {
+  kDefaultMegabytes = 128,
+};
+
+// How a record's old value is stored, and how many doubles of _values it takes.
+typedef NS_ENUM(uint8_t, SKTUndoValueKind) {
+  SKTUndoValueRect,         // 4: x, y, width, height.
+  SKTUndoValueOffset,       // 2: a bounds that only moved. Old origin minus the origin when the entry closed.
+  SKTUndoValueSharedOffset, // 0: likewise, by the entry's _sharedOffset.
+  SKTUndoValuePoint,        // 2
+  SKTUndoValueNumber,       // 1: BOOLs and CGFloats alike. KVC converts back.
+  SKTUndoValueObject,       // 0: value is an index into _objects. nil is stored as NSNull.
+};
+
+typedef struct {
+  uint32_t graphic;  // Index into _graphics.
+  uint16_t key;      // Index into _keys.
+  uint8_t kind;      // SKTUndoValueKind
+  uint32_t value;    // Index of its first double in _values, or into _objects.
+} SKTUndoRecord;
+
+// Grows a malloc'd buffer to hold at least needed items.
+static void *GrowBuffer(void *buffer, NSUInteger *capacity, NSUInteger needed, size_t itemSize) {
+  if (needed <= *capacity) {
+    return buffer;
+  }
+  NSUInteger newCapacity = MAX(*capacity * 2, MAX(needed, 16u));
+  void *newBuffer = realloc(buffer, newCapacity * itemSize);
+  if (NULL == newBuffer) {
+    [NSException raise:NSMallocException format:@"SKTUndoJournal: can't grow to %lu items", (unsigned long)newCapacity];
+  }
+  *capacity = newCapacity;
+  return newBuffer;
+}
+
+@interface SKTUndoJournal ()
+- (void)forgetByteCount:(NSUInteger)byteCount;
+@end
+
+@interface SKTUndoJournalEntry () {
+ @public
+  __weak SKTUndoJournal *_journal;
+  NSUInteger _byteCount;
+
+ @private
+  NSMutableArray *_graphics;
+  NSMutableArray<NSString *> *_keys;
+  NSMutableArray *_objects;
+  SKTUndoRecord *_records;
+  NSUInteger _recordCount;
+  NSUInteger _recordCapacity;
+  double *_values;
+  NSUInteger _valueCount;
+  NSUInteger _valueCapacity;
+  NSPoint _sharedOffset;
+  BOOL _isClosed;
+
+  // Only while the entry is open, to find what's already recorded. Graphic to its index plus one.
+  NSMapTable *_graphicIndexes;
+  NSMutableDictionary *_objectIndexes;
+  // Per graphic, a bit per key index, for the first 64 keys.
+  uint64_t *_keyMasks;
+  NSUInteger _keyMaskCapacity;
+}
+@end
+
+@implementation SKTUndoJournalEntry
+
+- (instancetype)init {
+  self = [super init];
+  if (self) {
+    _graphics = [NSMutableArray array];
+    _keys = [NSMutableArray array];
+    _objects = [NSMutableArray array];
+    _graphicIndexes = [NSMapTable mapTableWithKeyOptions:(NSPointerFunctionsObjectPointerPersonality | NSPointerFunctionsStrongMemory) valueOptions:(NSPointerFunctionsOpaquePersonality | NSPointerFunctionsOpaqueMemory)];
+    _objectIndexes = [NSMutableDictionary dictionary];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  free(_records);
+  free(_values);
+  free(_keyMasks);
+  if (_isClosed) {
+    [_journal forgetByteCount:_byteCount];
+  }
+}
+
+- (NSUInteger)recordCount {
+  return _recordCount;
+}
+
+- (double *)appendValueCount:(NSUInteger)count {
+  _values = GrowBuffer(_values, &_valueCapacity, _valueCount + count, sizeof(double));
+  double *values = _values + _valueCount;
+  _valueCount += count;
+  return values;
+}
+
+- (BOOL)isRecordedKeyIndex:(NSUInteger)keyIndex graphicIndex:(NSUInteger)graphicIndex {
+  if (keyIndex < 64) {
+    return 0 != (_keyMasks[graphicIndex] & ((uint64_t)1 << keyIndex));
+  }
+  for (NSUInteger i = 0; i < _recordCount; ++i) {
+    if (_records[i].graphic == graphicIndex && _records[i].key == keyIndex) {
+      return YES;
+    }
+  }
+  return NO;
+}
+
+- (BOOL)recordOldValue:(id)oldValue forKey:(NSString *)key ofGraphic:(SKTGraphic *)graphic {
+  NSAssert( ! _isClosed, @"SKTUndoJournalEntry: recording into a closed entry");
+
+  // There are only ever a handful of keys.
+  NSUInteger keyIndex = [_keys indexOfObject:key];
+  if (NSNotFound == keyIndex) {
+    keyIndex = [_keys count];
+    [_keys addObject:key];
+  }
+  NSUInteger graphicIndex = (NSUInteger)NSMapGet(_graphicIndexes, (__bridge void *)graphic);
+  if (graphicIndex) {
+    graphicIndex -= 1;
+    if ([self isRecordedKeyIndex:keyIndex graphicIndex:graphicIndex]) {
+      return NO;
+    }
+  } else {
+    graphicIndex = [_graphics count];
+    [_graphics addObject:graphic];
+    NSMapInsert(_graphicIndexes, (__bridge void *)graphic, (void *)(graphicIndex + 1));
+    _keyMasks = GrowBuffer(_keyMasks, &_keyMaskCapacity, graphicIndex + 1, sizeof(uint64_t));
+    _keyMasks[graphicIndex] = 0;
+  }
+  if (keyIndex < 64) {
+    _keyMasks[graphicIndex] |= (uint64_t)1 << keyIndex;
+  }
+
+  _records = GrowBuffer(_records, &_recordCapacity, _recordCount + 1, sizeof(SKTUndoRecord));
+  SKTUndoRecord *record = &_records[_recordCount++];
+  record->graphic = (uint32_t)graphicIndex;
+  record->key = (uint16_t)keyIndex;
+  record->value = (uint32_t)_valueCount;
+  if ([oldValue isKindOfClass:[NSNumber class]]) {
+    record->kind = SKTUndoValueNumber;
+    *[self appendValueCount:1] = [oldValue doubleValue];
+  } else if ([oldValue isKindOfClass:[NSValue class]] && 0 == strcmp([oldValue objCType], @encode(NSRect))) {
+    NSRect rect = [oldValue rectValue];
+    record->kind = SKTUndoValueRect;
+    double *values = [self appendValueCount:4];
+    values[0] = rect.origin.x;
+    values[1] = rect.origin.y;
+    values[2] = rect.size.width;
+    values[3] = rect.size.height;
+  } else if ([oldValue isKindOfClass:[NSValue class]] && 0 == strcmp([oldValue objCType], @encode(NSPoint))) {
+    NSPoint point = [oldValue pointValue];
+    record->kind = SKTUndoValuePoint;
+    double *values = [self appendValueCount:2];
+    values[0] = point.x;
+    values[1] = point.y;
+  } else {
+    // Colors, mostly. Changing the color of many graphics at once mostly changes them from a few colors.
+    id object = oldValue ?: [NSNull null];
+    NSNumber *objectIndex = _objectIndexes[object];
+    if (nil == objectIndex) {
+      objectIndex = @([_objects count]);
+      [_objects addObject:object];
+      _objectIndexes[object] = objectIndex;
+    }
+    record->kind = SKTUndoValueObject;
+    record->value = (uint32_t)[objectIndex unsignedIntegerValue];
+  }
+  return YES;
+}
+
+// Bounds that kept their size keep only the offset back to where they were, and if every one of them moved the same
+// way, not even that. Then the buffers shrink to fit.
+- (void)close {
+  if (_isClosed) {
+    return;
+  }
+  _isClosed = YES;
+  _graphicIndexes = nil;
+  _objectIndexes = nil;
+  free(_keyMasks);
+  _keyMasks = NULL;
+
+  NSUInteger offsetCount = 0;
+  BOOL isShared = YES;
+  NSPoint *offsets = calloc(MAX(_recordCount, 1u), sizeof(NSPoint));
+  BOOL *isOffset = calloc(MAX(_recordCount, 1u), sizeof(BOOL));
+  if (NULL == offsets || NULL == isOffset) {
+    free(offsets);
+    free(isOffset);
+    [NSException raise:NSMallocException format:@"SKTUndoJournal: can't close an entry of %lu records", (unsigned long)_recordCount];
+  }
+  for (NSUInteger i = 0; i < _recordCount; ++i) {
+    SKTUndoRecord *record = &_records[i];
+    if (SKTUndoValueRect == record->kind) {
+      const double *old = _values + record->value;
+      NSRect now = [[_graphics[record->graphic] valueForKey:_keys[record->key]] rectValue];
+      if (old[2] == now.size.width && old[3] == now.size.height) {
+        NSPoint offset = NSMakePoint(old[0] - now.origin.x, old[1] - now.origin.y);
+        if (0 == offsetCount) {
+          _sharedOffset = offset;
+        } else if ( ! NSEqualPoints(offset, _sharedOffset)) {
+          isShared = NO;
+        }
+        offsets[i] = offset;
+        isOffset[i] = YES;
+        offsetCount += 1;
+      }
+    }
+  }
+
+  double *values = malloc(MAX(_valueCount, 1u) * sizeof(double));
+  if (NULL == values) {
+    free(offsets);
+    free(isOffset);
+    [NSException raise:NSMallocException format:@"SKTUndoJournal: can't close an entry of %lu values", (unsigned long)_valueCount];
+  }
+  NSUInteger valueCount = 0;
+  for (NSUInteger i = 0; i < _recordCount; ++i) {
+    SKTUndoRecord *record = &_records[i];
+    const double *old = _values + record->value;
+    if (isOffset[i] && isShared) {
+      record->kind = SKTUndoValueSharedOffset;
+      record->value = 0;
+    } else if (isOffset[i]) {
+      record->kind = SKTUndoValueOffset;
+      record->value = (uint32_t)valueCount;
+      values[valueCount++] = offsets[i].x;
+      values[valueCount++] = offsets[i].y;
+    } else if (SKTUndoValueObject != record->kind) {
+      NSUInteger count = (SKTUndoValueRect == record->kind) ? 4 : (SKTUndoValuePoint == record->kind) ? 2 : 1;
+      record->value = (uint32_t)valueCount;
+      memcpy(values + valueCount, old, count * sizeof(double));
+      valueCount += count;
+    }
+  }
+  free(offsets);
+  free(isOffset);
+  free(_values);
+  _values = realloc(values, MAX(valueCount, 1u) * sizeof(double)) ?: values;
+  _valueCount = _valueCapacity = valueCount;
+  SKTUndoRecord *records = realloc(_records, MAX(_recordCount, 1u) * sizeof(SKTUndoRecord));
+  if (records) {
+    _records = records;
+    _recordCapacity = MAX(_recordCount, 1u);
+  }
+  _byteCount = _recordCount * sizeof(SKTUndoRecord) + _valueCount * sizeof(double) + ([_graphics count] + [_objects count] + [_keys count]) * sizeof(id);
+}
+
+- (void)restore {
+  for (NSUInteger i = 0; i < _recordCount; ++i) {
+    const SKTUndoRecord *record = &_records[i];
+    SKTGraphic *graphic = _graphics[record->graphic];
+    NSString *key = _keys[record->key];
+    const double *values = _values + record->value;
+    id value = nil;
+    switch ((SKTUndoValueKind)record->kind) {
+      case SKTUndoValueRect:
+        value = [NSValue valueWithRect:NSMakeRect(values[0], values[1], values[2], values[3])];
+        break;
+      case SKTUndoValueOffset:
+      case SKTUndoValueSharedOffset: {
+        NSPoint offset = (SKTUndoValueOffset == record->kind) ? NSMakePoint(values[0], values[1]) : _sharedOffset;
+        NSRect rect = [[graphic valueForKey:key] rectValue];
+        value = [NSValue valueWithRect:NSOffsetRect(rect, offset.x, offset.y)];
+        break;
+      }
+      case SKTUndoValuePoint:
+        value = [NSValue valueWithPoint:NSMakePoint(values[0], values[1])];
+        break;
+      case SKTUndoValueNumber:
+        value = @(values[0]);
+        break;
+      case SKTUndoValueObject:
+        value = _objects[record->value];
+        if ([NSNull null] == value) {
+          value = nil;
+        }
+        break;
+    }
+    [graphic setValue:value forKey:key];
+  }
+}
+
+@end
+
+@interface SKTUndoJournal () {
+  __weak NSUndoManager *_undoManager;
+  // Weakly: the undo manager owns the entries. Oldest first.
+  NSPointerArray *_entries;
+  SKTUndoJournalEntry *_openEntry;
+  BOOL _isTrimScheduled;
+}
+@end
+
+@implementation SKTUndoJournal
+
+- (instancetype)initWithUndoManager:(NSUndoManager *)undoManager {
+  self = [super init];
+  if (self) {
+    _undoManager = undoManager;
+    _entries = [NSPointerArray weakObjectsPointerArray];
+    NSInteger megabytes = [[NSUserDefaults standardUserDefaults] integerForKey:SKTUndoMegabytesKey];
+    _byteLimit = (NSUInteger)(0 < megabytes ? megabytes : kDefaultMegabytes) * 1024 * 1024;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [NSObject cancelPreviousPerformRequestsWithTarget:self];
+}
+
+- (void)setByteLimit:(NSUInteger)byteLimit {
+  _byteLimit = byteLimit;
+  [self scheduleTrim];
+}
+
+- (SKTUndoJournalEntry *)openEntry {
+  if (nil == _openEntry) {
+    _openEntry = [[SKTUndoJournalEntry alloc] init];
+    _openEntry->_journal = self;
+    [_entries addPointer:(__bridge void *)_openEntry];
+
+    // Register an undo operation for any graphic property changes that are going to be coalesced between now and the next -closeEntry.
+    [_undoManager registerUndoWithTarget:self selector:@selector(undoEntry:) object:_openEntry];
+  }
+  return _openEntry;
+}
+
+- (void)undoEntry:(SKTUndoJournalEntry *)entry {
+  [entry restore];
+}
+
+- (void)closeEntry {
+  if (_openEntry) {
+    [_openEntry close];
+    [self willChangeValueForKey:@"byteCount"];
+    _byteCount += _openEntry->_byteCount;
+    [self didChangeValueForKey:@"byteCount"];
+    _openEntry = nil;
+    [self scheduleTrim];
+  }
+}
+
+- (void)forgetByteCount:(NSUInteger)byteCount {
+  [self willChangeValueForKey:@"byteCount"];
+  _byteCount -= MIN(byteCount, _byteCount);
+  [self didChangeValueForKey:@"byteCount"];
+}
+
+- (void)scheduleTrim {
+  if (_byteLimit < _byteCount && ! _isTrimScheduled) {
+    _isTrimScheduled = YES;
+    [self performSelector:@selector(trim) withObject:nil afterDelay:0];
+  }
+}
+
+// NSUndoManager can only drop whole undo groups, oldest first, by lowering levelsOfUndo. Each entry is in a group
+// of its own, so keeping as many groups as there are newest entries that fit keeps the entries within the limit, and
+// may drop older groups that had none. levelsOfUndo bounds the redo stack the same way, so this is a bound, not an
+// exact count.
+- (void)trim {
+  _isTrimScheduled = NO;
+  NSUndoManager *undoManager = _undoManager;
+  if (_byteCount <= _byteLimit || nil == undoManager) {
+    return;
+  }
+  if ([undoManager groupingLevel]) {
+    // Wait for the group being built to close.
+    [self scheduleTrim];
+    return;
+  }
+
+  // -compact only removes the nils of zeroed weak pointers if a NULL has been added explicitly.
+  [_entries addPointer:NULL];
+  [_entries compact];
+  NSUInteger keptCount = 0;
+  NSUInteger keptBytes = 0;
+  for (NSUInteger i = [_entries count]; 0 < i--;) {
+    SKTUndoJournalEntry *entry = (__bridge SKTUndoJournalEntry *)[_entries pointerAtIndex:i];
+    if (entry) {
+      if (_byteLimit < keptBytes + entry->_byteCount) {
+        break;
+      }
+      keptBytes += entry->_byteCount;
+      keptCount += 1;
+    }
+  }
+  NSUInteger levelsOfUndo = [undoManager levelsOfUndo];
+  [undoManager setLevelsOfUndo:MAX(keptCount, 1u)];
+  [undoManager setLevelsOfUndo:levelsOfUndo];
+}
+
+@end
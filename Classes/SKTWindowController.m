@@ -22,6 +22,9 @@
 
 // A value that's used as a context by this class' invocation of a KVO observer registration method. See the comment near the top of SKTGraphicView.m for a discussion of this.
 static char *const SKTWindowControllerCanvasSizeObservationContext = "com.turbozen.SKTWindowController.canvasSize";
+#if DEBUG
+static char *const SKTWindowControllerUndoByteCountObservationContext = "com.turbozen.SKTWindowController.undoByteCount";
+#endif
 
 @interface SKTWindowController() {
   // The values underlying the key-value coding (KVC) and observing (KVO) compliance described below.
@@ -56,6 +59,9 @@ static char *const SKTWindowControllerCanvasSizeObservationContext = "com.turboz
 
   // Stop observing the document's canvas size.
   [[self document] removeObserver:self forKeyPath:SKTDocumentCanvasSizeKey];
+#if DEBUG
+  [[self document] removeObserver:self forKeyPath:@"undoByteCount"];
+#endif
 }
 
 #pragma mark - Observing
@@ -79,6 +85,10 @@ static char *const SKTWindowControllerCanvasSizeObservationContext = "com.turboz
       [self observeDocumentCanvasSize:[documentCanvasSizeValue sizeValue]];
     }
 
+#if DEBUG
+  } else if (context == SKTWindowControllerUndoByteCountObservationContext) {
+    [self synchronizeWindowTitleWithDocumentName];
+#endif
   } else {
 
     // In overrides of -observeValueForKeyPath:ofObject:change:context: always invoke super when the observer notification isn't recognized. Code in the superclass is apparently doing observation of its own. NSObject's implementation of this method throws an exception. Such an exception would be indicating a programming error that should be fixed.
@@ -115,10 +125,24 @@ static char *const SKTWindowControllerCanvasSizeObservationContext = "com.turboz
 
   // Redo the observing of the document's canvas size when the document changes. You would think we would just be able to observe self's "document.canvasSize" in -windowDidLoad or maybe even -init, but KVO wasn't really designed with observing of self in mind so things get a little squirrelly.
   [[self document] removeObserver:self forKeyPath:SKTDocumentCanvasSizeKey];
+#if DEBUG
+  [[self document] removeObserver:self forKeyPath:@"undoByteCount"];
+#endif
   [super setDocument:document];
   [[self document] addObserver:self forKeyPath:SKTDocumentCanvasSizeKey options:NSKeyValueObservingOptionNew context:SKTWindowControllerCanvasSizeObservationContext];
+#if DEBUG
+  [[self document] addObserver:self forKeyPath:@"undoByteCount" options:0 context:SKTWindowControllerUndoByteCountObservationContext];
+#endif
 }
 
+#if DEBUG
+// A readout of the memory undo is holding, to watch it stay within its budget during long editing sessions.
+- (NSString *)windowTitleForDocumentDisplayName:(NSString *)displayName {
+  NSUInteger undoByteCount = [(SKTDocument *)[self document] undoByteCount];
+  return [NSString stringWithFormat:@"%@ (undo: %.1f KB)", [super windowTitleForDocumentDisplayName:displayName], undoByteCount / 1024.0];
+}
+#endif
+
 
 - (void)windowDidLoad {
   [super windowDidLoad];
@@ -24,3 +24,8 @@ extern NSString *SKTZoomingScrollViewFactor;
 - (IBAction)zoomOut:(id)sender;
 
 @end
+
+#if DEBUG
+// Draw a plan of graphicCount graphics into a window-sized bitmap at each zoom factor in the popup, in full detail and at a level of detail. Logs the time of the first frame at each, which builds any caches, and of the frames after.
+void SKTLevelOfDetailBenchmark(NSUInteger graphicCount);
+#endif
@@ -11,6 +11,14 @@
 
 #import "SKTZoomingScrollView.h"
 
+#if DEBUG
+#import "SKTGroup.h"
+#import "SKTPath.h"
+#import "SKTPoly.h"
+#import "SKTRectangle.h"
+#import "SKTText.h"
+#endif
+
 
 // The name of the binding supported by this class, in addition to the ones whose support is inherited from NSView.
 NSString *SKTZoomingScrollViewFactor = @"factor";
@@ -185,3 +193,90 @@ static const NSInteger SKTZoomingScrollViewPopUp100 = 4;
 
 
 @end
+
+#pragma mark - Benchmark
+
+#if DEBUG
+// A plan 10000 points on a side: walls, fixtures too small to see when zoomed out, labels, and a few dense traced outlines.
+static NSArray *BenchmarkGraphics(NSUInteger graphicCount) {
+  NSMutableString *outline = [NSMutableString string];
+  for (NSUInteger i = 0; i < 5000; ++i) {
+    CGFloat radius = 200 + 20 * sin(i * M_PI / 50);
+    [outline appendFormat:@"%.5g,%.5g ", radius * cos(i * 2 * M_PI / 5000), radius * sin(i * 2 * M_PI / 5000)];
+  }
+  NSMutableString *curves = [NSMutableString stringWithString:@"M0,0"];
+  for (NSUInteger i = 0; i < 2000; ++i) {
+    [curves appendFormat:@" C%lu,10 %lu,-10 %lu,0", (unsigned long)i * 3 + 1, (unsigned long)i * 3 + 2, (unsigned long)i * 3 + 3];
+  }
+  NSAttributedString *label = [[NSAttributedString alloc] initWithString:@"Bedroom 2" attributes:@{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:10]}];
+  srandom(1);
+  NSMutableArray *graphics = [NSMutableArray arrayWithCapacity:graphicCount];
+  for (NSUInteger i = 0; i < graphicCount; ++i) {
+    NSPoint origin = NSMakePoint(10000.0 * random() / RAND_MAX, 10000.0 * random() / RAND_MAX);
+    SKTGraphic *graphic = nil;
+    if (0 == i % 100) {
+      graphic = [[SKTPoly alloc] initWithProperties:@{SKTPolyPoints: outline}];
+    } else if (50 == i % 100) {
+      graphic = [[SKTPath alloc] initWithProperties:@{SKTPathString: curves}];
+    } else if (0 == i % 10) {
+      graphic = [[SKTText alloc] init];
+      [graphic setBounds:NSMakeRect(origin.x, origin.y, 60, 14)];
+      [[graphic valueForKey:SKTTextScriptingContentsKey] setAttributedString:label];
+    } else {
+      graphic = [[SKTRectangle alloc] init];
+      [graphic setBounds:(i % 2) ? NSMakeRect(origin.x, origin.y, 120, 3) : NSMakeRect(origin.x, origin.y, 2, 2)];
+    }
+    if ([graphic isKindOfClass:[SKTPoly class]] || [graphic isKindOfClass:[SKTPath class]]) {
+      [graphic setBounds:NSOffsetRect([graphic bounds], origin.x, origin.y)];
+    }
+    [graphics addObject:graphic];
+  }
+  return graphics;
+}
+
+void SKTLevelOfDetailBenchmark(NSUInteger graphicCount) {
+  // Drawn as SKTGraphicView draws, through an owner of the graphics, into a 1440 by 900 point window at 2 pixels per point.
+  SKTGroup *group = [[SKTGroup alloc] init];
+  [group setGraphics:[BenchmarkGraphics(graphicCount) mutableCopy]];
+  NSSize windowSize = NSMakeSize(1440, 900);
+  NSView *view = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, windowSize.width, windowSize.height)];
+  NSBitmapImageRep *rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL pixelsWide:2 * windowSize.width pixelsHigh:2 * windowSize.height bitsPerSample:8 samplesPerPixel:4 hasAlpha:YES isPlanar:NO colorSpaceName:NSCalibratedRGBColorSpace bytesPerRow:0 bitsPerPixel:0];
+  NSGraphicsContext *context = [NSGraphicsContext graphicsContextWithBitmapImageRep:rep];
+  [NSGraphicsContext saveGraphicsState];
+  [NSGraphicsContext setCurrentContext:context];
+  for (NSInteger index = 0; index < SKTZoomingScrollViewPopUpButtonItemCount; ++index) {
+    CGFloat factor = SKTZoomingScrollViewFactors[index];
+    NSRect rect = NSMakeRect(0, 0, windowSize.width / factor, windowSize.height / factor);
+    NSTimeInterval firstFrameTimes[2];
+    NSTimeInterval frameTimes[2];
+    for (NSUInteger lod = 0; lod < 2; ++lod) {
+      SKTGraphicSetLevelOfDetailEnabled(lod);
+      [context saveGraphicsState];
+      CGContextScaleCTM((CGContextRef)[context graphicsPort], 2 * factor, 2 * factor);
+
+      // The first frame at a zoom level builds whatever's cached for it. Then three more.
+      for (NSUInteger frame = 0; frame < 4; ++frame) {
+        @autoreleasepool {
+          NSDate *start = [NSDate date];
+          [[NSColor whiteColor] set];
+          NSRectFill(rect);
+          [group drawContentsInView:view rect:rect isBeingCreateOrEdited:NO];
+          CGContextFlush((CGContextRef)[context graphicsPort]);
+          NSTimeInterval time = -[start timeIntervalSinceNow];
+          if (0 == frame) {
+            firstFrameTimes[lod] = time;
+            frameTimes[lod] = 0;
+          } else {
+            frameTimes[lod] += time / 3;
+          }
+        }
+      }
+      [context restoreGraphicsState];
+    }
+    NSLog(@"%@ (%lu graphics): full detail first frame %.1fms, then %.1fms; level of detail first frame %.1fms, then %.1fms",
+      SKTZoomingScrollViewLabels[index], (unsigned long)graphicCount, 1000 * firstFrameTimes[0], 1000 * frameTimes[0], 1000 * firstFrameTimes[1], 1000 * frameTimes[1]);
+  }
+  SKTGraphicSetLevelOfDetailEnabled(YES);
+  [NSGraphicsContext restoreGraphicsState];
+}
+#endif
@@ -0,0 +1,79 @@
+#import <Cocoa/Cocoa.h>
+
+#import "SKTGraphic.h"
+
+@interface SKTSimplifyCommand : NSScriptCommand
+@end
+
+@implementation SKTSimplifyCommand
+
+- (BOOL)isWellFormed {
+  BOOL isArray = [[self directParameter] respondsToSelector:@selector(indexOfObject:)];
+  BOOL isObjectSpec = [[self directParameter] isKindOfClass:[NSScriptObjectSpecifier class]];
+  return (isArray && 0 < [[self directParameter] count]) || isObjectSpec;
+}
+
+// Note: experiment shows that naming this method performDefaultImplementation does not work.
+// We must parse the arguments out of the command. It might be an explicit array like:
+//
+// tell document 1
+//   simplify {path 1, polygon 2} tolerance 0.25 using Visvalingam Whyatt
+// end tell
+//
+// or an implicit one like
+//
+// simplify graphics of document 1
+//
+// Returns a simplification report record, from a dictionary keyed by the sdef's cocoa keys.
+- (nullable id)executeCommand {
+  NSMutableArray *receivers = [NSMutableArray array];
+  BOOL isArray = [[self directParameter] respondsToSelector:@selector(indexOfObject:)];
+  if (isArray) {
+    for (NSScriptObjectSpecifier *spec in [self directParameter]) {
+      SKTGraphic *graphic = (SKTGraphic *)[spec objectsByEvaluatingSpecifier];
+      if ([graphic isKindOfClass:[SKTGraphic class]]) {
+        [receivers addObject:graphic];
+      }
+    }
+  } else {
+    id graphics = [[self directParameter] objectsByEvaluatingSpecifier];
+    if ([graphics respondsToSelector:@selector(indexOfObject:)]) {
+      [receivers addObjectsFromArray:graphics];
+    } else if ([graphics isKindOfClass:[SKTGraphic class]]) {
+      [receivers addObject:graphics];
+    }
+  }
+
+  NSNumber *toleranceNumber = [[self arguments] objectForKey:@"tolerance"];
+  CGFloat tolerance = toleranceNumber ? [toleranceNumber doubleValue] : SKTSimplifyDefaultTolerance();
+  if ( ! (0 < tolerance)) {
+    [self setScriptErrorNumber:NSArgumentsWrongScriptError];
+    [self setScriptErrorString:@"The tolerance must be more than 0."];
+    return nil;
+  }
+  SKTSimplifyMethod method = SKTSimplifyMethodCurveFit;
+  switch ([[[self arguments] objectForKey:@"method"] unsignedIntegerValue]) {
+  case 'dgpk':  method = SKTSimplifyMethodDouglasPeucker; break;
+  case 'vswy':  method = SKTSimplifyMethodVisvalingamWhyatt; break;
+  default:      break;
+  }
+
+  SKTSimplifyReport report = {0, 0, 0};
+  NSUndoManager *undoManager = nil;
+  for (SKTGraphic *graphic in receivers) {
+    if ( ! [graphic locked] && [graphic canSimplify]) {
+      report = SKTSimplifyReportAdd(report, [graphic simplifyWithMethod:method tolerance:tolerance]);
+      if (nil == undoManager && [[graphic scriptingContainer] respondsToSelector:@selector(undoManager)]) {
+        undoManager = [[graphic scriptingContainer] performSelector:@selector(undoManager)];
+      }
+    }
+  }
+  [undoManager setActionName:NSLocalizedStringFromTable(@"Simplify", @"UndoStrings", @"Action name for simplifying.")];
+  return @{
+    @"originalCount" : @(report.originalVertexCount),
+    @"simplifiedCount" : @(report.vertexCount),
+    @"maximumDeviation" : @(report.maxDeviation),
+  };
+}
+
+@end